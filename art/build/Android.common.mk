@@ -177,6 +177,13 @@ ifeq ($(TARGET_ARCH),arm)
   endif
 endif
 
+# Portable code keeps Thread* in x18 and expects it to survive its calls, so every ART target
+# module that can run below a portable frame is built without x18: the runtime, the compiler (the
+# JIT compiles in process), the executables and the test libraries.
+ifeq ($(ART_USE_PORTABLE_COMPILER),true)
+  ART_TARGET_CFLAGS_arm64 := -ffixed-x18
+endif
+
 ART_HOST_NON_DEBUG_CFLAGS := $(art_non_debug_cflags)
 ART_TARGET_NON_DEBUG_CFLAGS := $(art_non_debug_cflags)
 
@@ -69,6 +69,7 @@ define build-art-executable
     LOCAL_CLANG := $(ART_TARGET_CLANG)
     LOCAL_CFLAGS += $(ART_TARGET_CFLAGS)
     LOCAL_CFLAGS_x86 += $(ART_TARGET_CFLAGS_x86)
+    LOCAL_CFLAGS_arm64 += $(ART_TARGET_CFLAGS_arm64)
     ifeq ($$(art_ndebug_or_debug),debug)
       LOCAL_CFLAGS += $(ART_TARGET_DEBUG_CFLAGS)
     else
@@ -51,6 +51,7 @@ RUNTIME_GTEST_COMMON_SRC_FILES := \
 	runtime/indenter_test.cc \
 	runtime/indirect_reference_table_test.cc \
 	runtime/instruction_set_test.cc \
+	runtime/intern_table_benchmark_test.cc \
 	runtime/intern_table_test.cc \
 	runtime/leb128_test.cc \
 	runtime/mem_map_test.cc \
@@ -71,6 +72,7 @@ COMPILER_GTEST_COMMON_SRC_FILES := \
 	runtime/reflection_test.cc \
 	compiler/dex/local_value_numbering_test.cc \
 	compiler/dex/mir_optimization_test.cc \
+	compiler/dex/verification_results_test.cc \
 	compiler/driver/compiler_driver_test.cc \
 	compiler/elf_writer_test.cc \
 	compiler/image_test.cc \
@@ -85,10 +87,16 @@ COMPILER_GTEST_COMMON_SRC_FILES := \
 	compiler/output_stream_test.cc \
 	compiler/utils/arena_allocator_test.cc \
 	compiler/utils/dedupe_set_test.cc \
+	compiler/utils/spill_file_test.cc \
 	compiler/utils/arm/managed_register_arm_test.cc \
 	compiler/utils/arm64/managed_register_arm64_test.cc \
 	compiler/utils/x86/managed_register_x86_test.cc \
 
+ifeq ($(ART_USE_PORTABLE_COMPILER),true)
+COMPILER_GTEST_COMMON_SRC_FILES += \
+	compiler/llvm/llvm_jit_test.cc
+endif
+
 ifeq ($(ART_SEA_IR_MODE),true)
 COMPILER_GTEST_COMMON_SRC_FILES += \
 	compiler/utils/scoped_hashtable_test.cc \
@@ -184,6 +192,7 @@ define build-art-test
     LOCAL_CLANG := $(ART_TARGET_CLANG)
     LOCAL_CFLAGS += $(ART_TARGET_CFLAGS) $(ART_TARGET_DEBUG_CFLAGS)
     LOCAL_CFLAGS_x86 := $(ART_TARGET_CFLAGS_x86)
+    LOCAL_CFLAGS_arm64 := $(ART_TARGET_CFLAGS_arm64)
     LOCAL_SHARED_LIBRARIES += libdl libicuuc libicui18n libnativehelper libz libcutils libvixl
     LOCAL_STATIC_LIBRARIES += libgtest
     LOCAL_MODULE_PATH_32 := $(ART_BASE_NATIVETEST_OUT)
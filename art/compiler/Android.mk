@@ -102,7 +102,9 @@ LIBART_COMPILER_SRC_FILES := \
 	utils/x86_64/assembler_x86_64.cc \
 	utils/x86_64/managed_register_x86_64.cc \
 	utils/scoped_arena_allocator.cc \
+	utils/spill_file.cc \
 	buffered_output_stream.cc \
+	chunked_file_output_stream.cc \
 	compilers.cc \
 	compiler.cc \
 	elf_fixup.cc \
@@ -139,10 +141,14 @@ LIBART_COMPILER_SRC_FILES += \
 	llvm/intrinsic_helper.cc \
 	llvm/ir_builder.cc \
 	llvm/llvm_compilation_unit.cc \
+	llvm/llvm_jit.cc \
 	llvm/md_builder.cc \
 	llvm/runtime_support_builder.cc \
 	llvm/runtime_support_builder_arm.cc \
-	llvm/runtime_support_builder_x86.cc
+	llvm/runtime_support_builder_arm64.cc \
+	llvm/runtime_support_builder_x86.cc \
+	llvm/runtime_support_builder_x86_64.cc \
+	llvm/whole_program_module.cc
 LIBART_COMPILER_CFLAGS += -DART_USE_PORTABLE_COMPILER=1
 endif
 
@@ -198,6 +204,7 @@ $$(ENUM_OPERATOR_OUT_GEN): $$(GENERATED_SRC_DIR)/%_operator_out.cc : $(LOCAL_PAT
   ifeq ($$(art_target_or_host),target)
     LOCAL_CLANG := $(ART_TARGET_CLANG)
     LOCAL_CFLAGS += $(ART_TARGET_CFLAGS)
+    LOCAL_CFLAGS_arm64 += $(ART_TARGET_CFLAGS_arm64)
   else # host
     LOCAL_CLANG := $(ART_HOST_CLANG)
     LOCAL_CFLAGS += $(ART_HOST_CFLAGS)
@@ -227,15 +234,14 @@ $$(ENUM_OPERATOR_OUT_GEN): $$(GENERATED_SRC_DIR)/%_operator_out.cc : $(LOCAL_PAT
     LOCAL_CFLAGS += -DART_USE_PORTABLE_COMPILER=1
     ifeq ($$(art_target_or_host),target)
       LOCAL_STATIC_LIBRARIES_arm += libmcldARMInfo libmcldARMTarget
+      LOCAL_STATIC_LIBRARIES_arm64 += libmcldAArch64Info libmcldAArch64Target
       LOCAL_STATIC_LIBRARIES_x86 += libmcldX86Info libmcldX86Target
       LOCAL_STATIC_LIBRARIES_x86_64 += libmcldX86Info libmcldX86Target
       LOCAL_STATIC_LIBRARIES_mips += libmcldMipsInfo libmcldMipsTarget
-      ifeq ($(TARGET_ARCH),arm64)
-         $$(info TODOAArch64: $$(LOCAL_PATH)/Android.mk Add Arm64 specific MCLinker libraries)
-      endif # TARGET_ARCH != arm64
       include $(LLVM_DEVICE_BUILD_MK)
     else # host
       LOCAL_STATIC_LIBRARIES += libmcldARMInfo libmcldARMTarget
+      LOCAL_STATIC_LIBRARIES += libmcldAArch64Info libmcldAArch64Target
       LOCAL_STATIC_LIBRARIES += libmcldX86Info libmcldX86Target
       LOCAL_STATIC_LIBRARIES += libmcldMipsInfo libmcldMipsTarget
       include $(LLVM_HOST_BUILD_MK)
@@ -35,10 +35,12 @@ class BufferedOutputStream : public OutputStream {
 
   virtual off_t Seek(off_t offset, Whence whence);
 
+  virtual bool Flush();
+
  private:
   static const size_t kBufferSize = 8 * KB;
 
-  bool Flush();
+  bool FlushBuffer();
 
   OutputStream* const out_;
 
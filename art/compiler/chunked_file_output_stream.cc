@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chunked_file_output_stream.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/unix_file/fd_file.h"
+#include "utils.h"
+
+namespace art {
+
+constexpr size_t ChunkedFileOutputStream::kChunkSize;
+
+ChunkedFileOutputStream::ChunkedFileOutputStream(File* file)
+    : OutputStream(file->GetPath()), file_(file), chunk_(new uint8_t[kChunkSize]), used_(0),
+      write_count_(0), moves_file_position_(true) {
+  StartChunk(lseek(file_->Fd(), 0, SEEK_CUR));
+}
+
+ChunkedFileOutputStream::ChunkedFileOutputStream(File* file, off_t offset)
+    : OutputStream(file->GetPath()), file_(file), chunk_(new uint8_t[kChunkSize]), used_(0),
+      write_count_(0), moves_file_position_(false) {
+  StartChunk(offset);
+}
+
+ChunkedFileOutputStream::~ChunkedFileOutputStream() {
+  if (used_ != 0 && !Flush()) {
+    PLOG(ERROR) << "Failed to flush " << GetLocation();
+  }
+}
+
+void ChunkedFileOutputStream::StartChunk(off_t offset) {
+  chunk_offset_ = offset;
+  chunk_limit_ = kChunkSize - static_cast<size_t>(offset % kChunkSize);
+  used_ = 0;
+}
+
+bool ChunkedFileOutputStream::PwriteFully(const uint8_t* buffer, size_t byte_count,
+                                          off_t offset) {
+  while (byte_count > 0) {
+    ssize_t bytes_written = TEMP_FAILURE_RETRY(pwrite(file_->Fd(), buffer, byte_count, offset));
+    ++write_count_;
+    if (bytes_written == -1) {
+      return false;
+    }
+    buffer += bytes_written;
+    byte_count -= bytes_written;
+    offset += bytes_written;
+  }
+  return true;
+}
+
+bool ChunkedFileOutputStream::FlushChunk() {
+  if (used_ == 0) {
+    return true;
+  }
+  if (!PwriteFully(&chunk_[0], used_, chunk_offset_)) {
+    return false;
+  }
+  StartChunk(chunk_offset_ + used_);
+  return true;
+}
+
+bool ChunkedFileOutputStream::WriteFully(const void* buffer, size_t byte_count) {
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(buffer);
+  while (byte_count > 0) {
+    if (used_ == 0 && byte_count >= chunk_limit_) {
+      // Write all whole chunks directly, the remainder starts the next chunk.
+      size_t direct_bytes = chunk_limit_ + RoundDown(byte_count - chunk_limit_, kChunkSize);
+      if (!PwriteFully(src, direct_bytes, chunk_offset_)) {
+        return false;
+      }
+      StartChunk(chunk_offset_ + direct_bytes);
+      src += direct_bytes;
+      byte_count -= direct_bytes;
+      continue;
+    }
+    size_t copy_bytes = std::min(byte_count, chunk_limit_ - used_);
+    memcpy(&chunk_[used_], src, copy_bytes);
+    used_ += copy_bytes;
+    src += copy_bytes;
+    byte_count -= copy_bytes;
+    if (used_ == chunk_limit_ && !FlushChunk()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+off_t ChunkedFileOutputStream::Seek(off_t offset, Whence whence) {
+  const off_t position = chunk_offset_ + used_;
+  off_t new_position;
+  switch (whence) {
+    case kSeekSet:
+      new_position = offset;
+      break;
+    case kSeekCurrent:
+      new_position = position + offset;
+      break;
+    case kSeekEnd: {
+      if (!FlushChunk()) {
+        return -1;
+      }
+      struct stat st;
+      if (fstat(file_->Fd(), &st) != 0) {
+        return -1;
+      }
+      new_position = st.st_size + offset;
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unexpected whence " << whence;
+      return -1;
+  }
+  if (new_position < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (new_position != position) {
+    // The skipped bytes keep what the file has there, as with lseek.
+    if (!FlushChunk()) {
+      return -1;
+    }
+    StartChunk(new_position);
+  }
+  return new_position;
+}
+
+bool ChunkedFileOutputStream::Flush() {
+  if (!FlushChunk()) {
+    return false;
+  }
+  if (!moves_file_position_) {
+    return true;
+  }
+  return lseek(file_->Fd(), chunk_offset_, SEEK_SET) == chunk_offset_;
+}
+
+}  // namespace art
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_CHUNKED_FILE_OUTPUT_STREAM_H_
+#define ART_COMPILER_CHUNKED_FILE_OUTPUT_STREAM_H_
+
+#include "output_stream.h"
+
+#include "globals.h"
+#include "os.h"
+#include "UniquePtr.h"
+
+namespace art {
+
+// Writes to a file in large chunks that are aligned to the chunk size in the file, with pwrite at
+// the tracked position. Small writes are gathered in the chunk buffer, large writes go to the file
+// directly once the buffered chunk is filled up to its boundary. Seeking only flushes when the
+// position actually changes, so asking for the current position is cheap.
+//
+// The stream starts at the current position of the file. Flush writes out the buffered data and
+// moves the file position to the end of the written data, like writing through FileOutputStream.
+class ChunkedFileOutputStream : public OutputStream {
+ public:
+  explicit ChunkedFileOutputStream(File* file);
+
+  // Starts at the offset and never moves the file position, Flush only writes out the buffered
+  // data. Streams over disjoint ranges of one file can then write from different threads.
+  ChunkedFileOutputStream(File* file, off_t offset);
+
+  virtual ~ChunkedFileOutputStream();
+
+  virtual bool WriteFully(const void* buffer, size_t byte_count);
+
+  virtual off_t Seek(off_t offset, Whence whence);
+
+  virtual bool Flush();
+
+  // Returns the number of pwrite calls, for tests.
+  size_t GetWriteCount() const {
+    return write_count_;
+  }
+
+  static constexpr size_t kChunkSize = 1 * MB;
+
+ private:
+  bool FlushChunk();
+  bool PwriteFully(const uint8_t* buffer, size_t byte_count, off_t offset);
+  void StartChunk(off_t offset);
+
+  File* const file_;
+  UniquePtr<uint8_t[]> chunk_;
+
+  // The file offset of the first byte of the chunk.
+  off_t chunk_offset_;
+  // The bytes that fit in the chunk until the next aligned boundary.
+  size_t chunk_limit_;
+  size_t used_;
+
+  size_t write_count_;
+
+  // Whether Flush moves the file position to the end of the written data.
+  const bool moves_file_position_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkedFileOutputStream);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_CHUNKED_FILE_OUTPUT_STREAM_H_
@@ -16,38 +16,36 @@
 
 #include "compiled_method.h"
 #include "driver/compiler_driver.h"
+#include "utils/spill_file.h"
 
 namespace art {
 
 CompiledCode::CompiledCode(CompilerDriver* compiler_driver, InstructionSet instruction_set,
                            const std::vector<uint8_t>& quick_code)
     : compiler_driver_(compiler_driver), instruction_set_(instruction_set),
-      portable_code_(nullptr), quick_code_(nullptr) {
+      quick_code_(nullptr), spilled_portable_code_offset_(-1), spilled_portable_code_size_(0) {
   SetCode(&quick_code, nullptr);
 }
 
 CompiledCode::CompiledCode(CompilerDriver* compiler_driver, InstructionSet instruction_set,
                            const std::string& elf_object, const std::string& symbol)
     : compiler_driver_(compiler_driver), instruction_set_(instruction_set),
-      portable_code_(nullptr), quick_code_(nullptr), symbol_(symbol) {
+      quick_code_(nullptr), symbol_(symbol), spilled_portable_code_offset_(-1),
+      spilled_portable_code_size_(0) {
   CHECK_NE(elf_object.size(), 0U);
   CHECK_NE(symbol.size(), 0U);
-  std::vector<uint8_t> temp_code(elf_object.size());
-  for (size_t i = 0; i < elf_object.size(); ++i) {
-    temp_code[i] = elf_object[i];
-  }
   // TODO: we shouldn't just shove ELF objects in as "code" but
   // change to have different kinds of compiled methods.  This is
   // being deferred until we work on hybrid execution or at least
   // until we work on batch compilation.
-  SetCode(nullptr, &temp_code);
+  portable_code_.reset(new std::vector<uint8_t>(elf_object.begin(), elf_object.end()));
 }
 
 void CompiledCode::SetCode(const std::vector<uint8_t>* quick_code,
                            const std::vector<uint8_t>* portable_code) {
   if (portable_code != nullptr) {
     CHECK(!portable_code->empty());
-    portable_code_ = compiler_driver_->DeduplicateCode(*portable_code);
+    portable_code_.reset(new std::vector<uint8_t>(*portable_code));
   }
   if (quick_code != nullptr) {
     CHECK(!quick_code->empty());
@@ -64,8 +62,8 @@ bool CompiledCode::operator==(const CompiledCode& rhs) const {
     } else {
       return std::equal(quick_code_->begin(), quick_code_->end(), rhs.quick_code_->begin());
     }
-  } else if (portable_code_ != nullptr) {
-    if (rhs.portable_code_ == nullptr) {
+  } else if (portable_code_.get() != nullptr) {
+    if (rhs.portable_code_.get() == nullptr) {
       return false;
     } else if (portable_code_->size() != rhs.portable_code_->size()) {
       return false;
@@ -74,7 +72,49 @@ bool CompiledCode::operator==(const CompiledCode& rhs) const {
                         rhs.portable_code_->begin());
     }
   }
-  return (rhs.quick_code_ == nullptr) && (rhs.portable_code_ == nullptr);
+  return (rhs.quick_code_ == nullptr) && (rhs.portable_code_.get() == nullptr);
+}
+
+const uint8_t* CompiledCode::GetPortableCodeData() const {
+  if (portable_code_.get() != nullptr) {
+    return &(*portable_code_)[0];
+  }
+  CHECK_NE(spilled_portable_code_offset_, -1) << symbol_;
+  return compiler_driver_->GetSpillFile()->GetData(spilled_portable_code_offset_);
+}
+
+size_t CompiledCode::GetPortableCodeSize() const {
+  if (portable_code_.get() != nullptr) {
+    return portable_code_->size();
+  }
+  CHECK_NE(spilled_portable_code_offset_, -1) << symbol_;
+  return spilled_portable_code_size_;
+}
+
+bool CompiledCode::SpillPortableCode(SpillFile* spill_file) {
+  CHECK(portable_code_.get() != nullptr) << symbol_;
+  off_t offset = spill_file->Append(&(*portable_code_)[0], portable_code_->size());
+  if (offset == -1) {
+    return false;
+  }
+  spilled_portable_code_offset_ = offset;
+  spilled_portable_code_size_ = portable_code_->size();
+  portable_code_.reset();
+  return true;
+}
+
+bool CompiledCode::UnspillPortableCode(const SpillFile* spill_file) {
+  CHECK_NE(spilled_portable_code_offset_, -1) << symbol_;
+  UniquePtr<std::vector<uint8_t> > portable_code(
+      new std::vector<uint8_t>(spilled_portable_code_size_));
+  if (!spill_file->Read(spilled_portable_code_offset_, spilled_portable_code_size_,
+                        &(*portable_code)[0])) {
+    return false;
+  }
+  portable_code_.reset(portable_code.release());
+  spilled_portable_code_offset_ = -1;
+  spilled_portable_code_size_ = 0;
+  return true;
 }
 
 uint32_t CompiledCode::AlignCode(uint32_t offset) const {
@@ -17,6 +17,8 @@
 #ifndef ART_COMPILER_COMPILED_METHOD_H_
 #define ART_COMPILER_COMPILED_METHOD_H_
 
+#include <sys/types.h>
+
 #include <string>
 #include <vector>
 
@@ -31,6 +33,7 @@ namespace llvm {
 namespace art {
 
 class CompilerDriver;
+class SpillFile;
 
 class CompiledCode {
  public:
@@ -46,8 +49,29 @@ class CompiledCode {
     return instruction_set_;
   }
 
+  // Returns null once the ELF object was spilled, see SpillPortableCode.
   const std::vector<uint8_t>* GetPortableCode() const {
-    return portable_code_;
+    return portable_code_.get();
+  }
+
+  bool HasPortableCode() const {
+    return portable_code_.get() != nullptr || spilled_portable_code_offset_ != -1;
+  }
+
+  // The ELF object for portable, read from the spill file of the driver if it was spilled.
+  const uint8_t* GetPortableCodeData() const;
+  size_t GetPortableCodeSize() const;
+
+  // Moves the ELF object to the spill file and frees its memory. Returns false if it cannot be
+  // written.
+  bool SpillPortableCode(SpillFile* spill_file);
+
+  // Reads a spilled ELF object back into memory, for when the spill file cannot be mapped. Returns
+  // false if it cannot be read.
+  bool UnspillPortableCode(const SpillFile* spill_file);
+
+  bool IsPortableCodeSpilled() const {
+    return spilled_portable_code_offset_ != -1;
   }
 
   const std::vector<uint8_t>* GetQuickCode() const {
@@ -83,8 +107,9 @@ class CompiledCode {
 
   const InstructionSet instruction_set_;
 
-  // The ELF image for portable.
-  std::vector<uint8_t>* portable_code_;
+  // The ELF image for portable. Unlike quick code it is not deduplicated, it contains the unique
+  // symbol of the method.
+  UniquePtr<std::vector<uint8_t> > portable_code_;
 
   // Used to store the PIC code for Quick.
   std::vector<uint8_t>* quick_code_;
@@ -92,6 +117,10 @@ class CompiledCode {
   // Used for the Portable ELF symbol name.
   const std::string symbol_;
 
+  // Where the ELF image is in the spill file once it has been spilled, -1 before.
+  off_t spilled_portable_code_offset_;
+  size_t spilled_portable_code_size_;
+
   // There are offsets from the oatdata symbol to where the offset to
   // the compiled method will be found. These are computed by the
   // OatWriter and then used by the ElfWriter to add relocations so
@@ -42,6 +42,17 @@ extern "C" art::CompiledMethod* ArtLLVMJniCompileMethod(art::CompilerDriver* dri
 extern "C" void compilerLLVMSetBitcodeFileName(art::CompilerDriver* driver,
                                                std::string const& filename);
 
+extern "C" void compilerLLVMSetWholeProgramModule(art::CompilerDriver* driver,
+                                                  std::string const& filename,
+                                                  size_t num_partitions);
+
+extern "C" bool compilerLLVMWriteWholeProgramModule(art::CompilerDriver* driver,
+                                                    size_t thread_count);
+
+extern "C" bool compilerLLVMGetWholeProgramObjects(art::CompilerDriver* driver,
+                                                   std::vector<std::string>* object_filenames,
+                                                   std::set<std::string>* method_symbols);
+
 
 class LLVMCompiler FINAL : public Compiler {
  public:
@@ -110,7 +121,7 @@ class LLVMCompiler FINAL : public Compiler {
     return true;
   }
 
-  void SetBitcodeFileName(const CompilerDriver& driver, const std::string& filename) {
+  void SetBitcodeFileName(const CompilerDriver& driver, const std::string& filename) OVERRIDE {
     typedef void (*SetBitcodeFileNameFn)(const CompilerDriver&, const std::string&);
 
     SetBitcodeFileNameFn set_bitcode_file_name =
@@ -119,6 +130,37 @@ class LLVMCompiler FINAL : public Compiler {
     set_bitcode_file_name(driver, filename);
   }
 
+  void SetWholeProgramModule(const CompilerDriver& driver, const std::string& filename,
+                             size_t num_partitions) OVERRIDE {
+    typedef void (*SetWholeProgramModuleFn)(const CompilerDriver&, const std::string&, size_t);
+
+    SetWholeProgramModuleFn set_whole_program_module =
+      reinterpret_cast<SetWholeProgramModuleFn>(compilerLLVMSetWholeProgramModule);
+
+    set_whole_program_module(driver, filename, num_partitions);
+  }
+
+  bool WriteWholeProgramModule(const CompilerDriver& driver, size_t thread_count) OVERRIDE {
+    typedef bool (*WriteWholeProgramModuleFn)(const CompilerDriver&, size_t);
+
+    WriteWholeProgramModuleFn write_whole_program_module =
+      reinterpret_cast<WriteWholeProgramModuleFn>(compilerLLVMWriteWholeProgramModule);
+
+    return write_whole_program_module(driver, thread_count);
+  }
+
+  bool GetWholeProgramObjects(const CompilerDriver& driver,
+                              std::vector<std::string>* object_filenames,
+                              std::set<std::string>* method_symbols) const OVERRIDE {
+    typedef bool (*GetWholeProgramObjectsFn)(const CompilerDriver&, std::vector<std::string>*,
+                                             std::set<std::string>*);
+
+    GetWholeProgramObjectsFn get_whole_program_objects =
+      reinterpret_cast<GetWholeProgramObjectsFn>(compilerLLVMGetWholeProgramObjects);
+
+    return get_whole_program_objects(driver, object_filenames, method_symbols);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(LLVMCompiler);
 };
@@ -17,6 +17,8 @@
 #ifndef ART_COMPILER_COMPILER_H_
 #define ART_COMPILER_COMPILER_H_
 
+#include <set>
+
 #include "dex_file.h"
 #include "os.h"
 
@@ -77,11 +79,38 @@ class Compiler {
     return false;
   }
 
-  void SetBitcodeFileName(const CompilerDriver& driver, const std::string& filename) {
+  virtual void SetBitcodeFileName(const CompilerDriver& driver, const std::string& filename) {
     UNUSED(driver);
     UNUSED(filename);
   }
 
+  // Requests that all compiled methods are also emitted as a single module, which is optimized
+  // and written by WriteWholeProgramModule once compilation is done.
+  virtual void SetWholeProgramModule(const CompilerDriver& driver, const std::string& filename,
+                                     size_t num_partitions) {
+    UNUSED(driver);
+    UNUSED(filename);
+    UNUSED(num_partitions);
+  }
+
+  virtual bool WriteWholeProgramModule(const CompilerDriver& driver, size_t thread_count) {
+    UNUSED(driver);
+    UNUSED(thread_count);
+    return false;
+  }
+
+  // Returns the objects generated by WriteWholeProgramModule, together with the symbols of the
+  // methods whose code they hold, or false if there are none. The objects replace those of the
+  // individual methods when the oat file is linked.
+  virtual bool GetWholeProgramObjects(const CompilerDriver& driver,
+                                      std::vector<std::string>* object_filenames,
+                                      std::set<std::string>* method_symbols) const {
+    UNUSED(driver);
+    UNUSED(object_filenames);
+    UNUSED(method_symbols);
+    return false;
+  }
+
   virtual void InitCompilationUnit(CompilationUnit& cu) const = 0;
 
   virtual ~Compiler() {}
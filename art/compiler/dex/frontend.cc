@@ -109,20 +109,22 @@ CompilationUnit::CompilationUnit(ArenaPool* pool)
 CompilationUnit::~CompilationUnit() {
 }
 
+// Splits are collected whenever the driver has a timings logger, they are cheap now that each
+// thread accumulates its own. --dump-passes only decides whether they are dumped.
 void CompilationUnit::StartTimingSplit(const char* label) {
-  if (compiler_driver->GetDumpPasses()) {
+  if (compiler_driver->GetTimingsLogger() != NULL) {
     timings.StartSplit(label);
   }
 }
 
 void CompilationUnit::NewTimingSplit(const char* label) {
-  if (compiler_driver->GetDumpPasses()) {
+  if (compiler_driver->GetTimingsLogger() != NULL) {
     timings.NewSplit(label);
   }
 }
 
 void CompilationUnit::EndTiming() {
-  if (compiler_driver->GetDumpPasses()) {
+  if (compiler_driver->GetTimingsLogger() != NULL) {
     timings.EndSplit();
     if (enable_debug & (1 << kDebugTimings)) {
       LOG(INFO) << "TIMINGS " << PrettyMethod(method_idx, *dex_file);
@@ -443,8 +445,9 @@ static bool CanCompileShorty(const char* shorty) {
 // Skip the method that we do not support currently.
 static bool CanCompileMethod(uint32_t method_idx, const DexFile& dex_file,
                              CompilationUnit& cu) {
-  // There is some limitation with current ARM 64 backend.
-  if (cu.instruction_set == kArm64) {
+  // There is some limitation with current ARM 64 backend. The portable backend leaves code
+  // generation to LLVM, which handles every shorty and opcode.
+  if (cu.instruction_set == kArm64 && !cu.compiler->IsPortable()) {
     // Check if we can compile the prototype.
     const char* shorty = dex_file.GetMethodShorty(dex_file.GetMethodId(method_idx));
     if (!CanCompileShorty(shorty)) {
@@ -579,7 +582,7 @@ static CompiledMethod* CompileMethod(CompilerDriver& driver,
         (1 << kPromoteCompilerTemps));
   }
 
-  if (cu.instruction_set == kArm64) {
+  if (cu.instruction_set == kArm64 && !compiler->IsPortable()) {
     // TODO(Arm64): enable optimizations once backend is mature enough.
     cu.disable_opt = ~(uint32_t)0;
   }
@@ -673,7 +676,8 @@ static CompiledMethod* CompileMethod(CompilerDriver& driver,
   }
 
   cu.EndTiming();
-  driver.GetTimingsLogger()->AddLogger(cu.timings);
+  // Accumulated per thread and merged by the driver, the workers do not share a lock for this.
+  driver.GetTls()->GetTimings()->AddLogger(cu.timings);
   return result;
 }
 
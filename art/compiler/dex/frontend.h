@@ -18,6 +18,7 @@
 #define ART_COMPILER_DEX_FRONTEND_H_
 
 #include "dex_file.h"
+#include "instruction_set.h"
 #include "invoke_type.h"
 
 namespace llvm {
@@ -81,7 +82,7 @@ enum debugControlVector {
 
 class LLVMInfo {
   public:
-    LLVMInfo();
+    explicit LLVMInfo(InstructionSet instruction_set);
     ~LLVMInfo();
 
     ::llvm::LLVMContext* GetLLVMContext() {
@@ -47,14 +47,15 @@ namespace llvm {
 ::llvm::Module* makeLLVMModuleContents(::llvm::Module* module);
 }
 
-LLVMInfo::LLVMInfo() {
+LLVMInfo::LLVMInfo(InstructionSet instruction_set) {
   // Create context, module, intrinsic helper & ir builder
   llvm_context_.reset(new ::llvm::LLVMContext());
   llvm_module_ = new ::llvm::Module("art", *llvm_context_);
   ::llvm::StructType::create(*llvm_context_, "JavaObject");
   art::llvm::makeLLVMModuleContents(llvm_module_);
   intrinsic_helper_.reset(new art::llvm::IntrinsicHelper(*llvm_context_, *llvm_module_));
-  ir_builder_.reset(new art::llvm::IRBuilder(*llvm_context_, *llvm_module_, *intrinsic_helper_));
+  ir_builder_.reset(new art::llvm::IRBuilder(*llvm_context_, *llvm_module_, *intrinsic_helper_,
+                                             instruction_set));
 }
 
 LLVMInfo::~LLVMInfo() {
@@ -125,7 +126,7 @@ void MirConverter::InitIR() {
     CHECK(tls != NULL);
     llvm_info_ = static_cast<LLVMInfo*>(tls->GetLLVMInfo());
     if (llvm_info_ == NULL) {
-      llvm_info_ = new LLVMInfo();
+      llvm_info_ = new LLVMInfo(cu_->instruction_set);
       tls->SetLLVMInfo(llvm_info_);
     }
   }
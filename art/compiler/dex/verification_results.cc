@@ -19,8 +19,11 @@
 #include "base/stl_util.h"
 #include "base/mutex.h"
 #include "base/mutex-inl.h"
+#include "base/unix_file/fd_file.h"
+#include "dex_file-inl.h"
 #include "driver/compiler_driver.h"
 #include "driver/compiler_options.h"
+#include "os.h"
 #include "thread.h"
 #include "thread-inl.h"
 #include "verified_method.h"
@@ -33,7 +36,9 @@ VerificationResults::VerificationResults(const CompilerOptions* compiler_options
     : verified_methods_lock_("compiler verified methods lock"),
       verified_methods_(),
       rejected_classes_lock_("compiler rejected classes lock"),
-      rejected_classes_() {
+      rejected_classes_(),
+      cached_classes_lock_("compiler cached classes lock"),
+      cached_classes_() {
   UNUSED(compiler_options);
 }
 
@@ -113,4 +118,374 @@ bool VerificationResults::IsCandidateForCompilation(MethodReference& method_ref,
   return true;
 }
 
+bool VerificationResults::GetCachedClassVerification(ClassReference ref, bool* soft_failures) {
+  ReaderMutexLock mu(Thread::Current(), cached_classes_lock_);
+  auto it = cached_classes_.find(ref);
+  if (it == cached_classes_.end()) {
+    return false;
+  }
+  *soft_failures = it->second;
+  return true;
+}
+
+// Layout of the verification results file, all values are native endian uint32_t:
+//   magic and version
+//   image checksum, key dex file count, (checksum, location) of each key dex file
+//   referenced dex file count, (checksum, location) of each dex file referenced below
+//   class count, (dex file, class def index, soft failures) of each class
+//   method count, for each method its (dex file, method index), the dex GC map, the
+//   devirtualization map as (dex pc, dex file, method index) and the safe cast set.
+// Strings and byte arrays are stored as their length followed by the data padded to 4 bytes.
+static const uint8_t kVerificationResultsMagic[] = { 'v', 'r', 'f', '\n', '0', '0', '1', '\0' };
+
+namespace {
+
+class ResultsWriter {
+ public:
+  void Write32(uint32_t value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    data_.insert(data_.end(), bytes, bytes + sizeof(value));
+  }
+
+  void WriteBytes(const uint8_t* bytes, size_t size) {
+    Write32(size);
+    data_.insert(data_.end(), bytes, bytes + size);
+    data_.resize(RoundUp(data_.size(), sizeof(uint32_t)), 0);
+  }
+
+  void WriteDexFile(const DexFile* dex_file) {
+    Write32(dex_file->GetLocationChecksum());
+    const std::string& location = dex_file->GetLocation();
+    WriteBytes(reinterpret_cast<const uint8_t*>(location.data()), location.size());
+  }
+
+  std::vector<uint8_t>& GetData() {
+    return data_;
+  }
+
+ private:
+  std::vector<uint8_t> data_;
+};
+
+class ResultsReader {
+ public:
+  explicit ResultsReader(const std::vector<uint8_t>& data) : data_(data), pos_(0) {}
+
+  bool Read32(uint32_t* value) {
+    if (data_.size() - pos_ < sizeof(*value)) {
+      return false;
+    }
+    memcpy(value, &data_[pos_], sizeof(*value));
+    pos_ += sizeof(*value);
+    return true;
+  }
+
+  bool ReadBytes(std::vector<uint8_t>* bytes) {
+    uint32_t size;
+    if (!Read32(&size) || data_.size() - pos_ < size) {
+      return false;
+    }
+    bytes->assign(data_.begin() + pos_, data_.begin() + pos_ + size);
+    pos_ = std::min(RoundUp(pos_ + size, sizeof(uint32_t)), data_.size());
+    return true;
+  }
+
+  bool ReadDexFile(uint32_t* checksum, std::string* location) {
+    std::vector<uint8_t> bytes;
+    if (!Read32(checksum) || !ReadBytes(&bytes)) {
+      return false;
+    }
+    location->assign(bytes.begin(), bytes.end());
+    return true;
+  }
+
+  bool AtEnd() const {
+    return pos_ == data_.size();
+  }
+
+ private:
+  const std::vector<uint8_t>& data_;
+  size_t pos_;
+};
+
+// Assigns indices to the dex files referenced by the saved results.
+class DexFileTable {
+ public:
+  uint32_t IndexOf(const DexFile* dex_file) {
+    auto it = indices_.find(dex_file);
+    if (it != indices_.end()) {
+      return it->second;
+    }
+    uint32_t index = dex_files_.size();
+    indices_.Put(dex_file, index);
+    dex_files_.push_back(dex_file);
+    return index;
+  }
+
+  const std::vector<const DexFile*>& GetDexFiles() const {
+    return dex_files_;
+  }
+
+ private:
+  SafeMap<const DexFile*, uint32_t> indices_;
+  std::vector<const DexFile*> dex_files_;
+};
+
+}  // anonymous namespace
+
+bool VerificationResults::Save(const std::string& filename,
+                               const std::vector<const DexFile*>& key_dex_files,
+                               uint32_t image_checksum,
+                               const std::vector<std::pair<ClassReference, bool> >& verified_classes,
+                               std::string* error_msg) {
+  // Encode the classes and methods first, this collects the referenced dex files.
+  DexFileTable dex_file_table;
+  ResultsWriter body;
+  body.Write32(verified_classes.size());
+  for (const std::pair<ClassReference, bool>& verified_class : verified_classes) {
+    body.Write32(dex_file_table.IndexOf(verified_class.first.first));
+    body.Write32(verified_class.first.second);
+    body.Write32(verified_class.second ? 1U : 0U);
+  }
+  std::vector<std::pair<MethodReference, const VerifiedMethod*> > methods;
+  {
+    ReaderMutexLock mu(Thread::Current(), verified_methods_lock_);
+    for (const std::pair<ClassReference, bool>& verified_class : verified_classes) {
+      const DexFile& dex_file = *verified_class.first.first;
+      const byte* class_data =
+          dex_file.GetClassData(dex_file.GetClassDef(verified_class.first.second));
+      if (class_data == nullptr) {
+        continue;
+      }
+      ClassDataItemIterator it(dex_file, class_data);
+      while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+        it.Next();
+      }
+      for (; it.HasNextDirectMethod() || it.HasNextVirtualMethod(); it.Next()) {
+        MethodReference ref(&dex_file, it.GetMemberIndex());
+        auto method = verified_methods_.find(ref);
+        if (method != verified_methods_.end()) {
+          methods.push_back(std::make_pair(ref, method->second));
+        }
+      }
+    }
+  }
+  body.Write32(methods.size());
+  for (const std::pair<MethodReference, const VerifiedMethod*>& method : methods) {
+    body.Write32(dex_file_table.IndexOf(method.first.dex_file));
+    body.Write32(method.first.dex_method_index);
+    const std::vector<uint8_t>& dex_gc_map = method.second->GetDexGcMap();
+    body.WriteBytes(dex_gc_map.empty() ? nullptr : &dex_gc_map[0], dex_gc_map.size());
+    const VerifiedMethod::DevirtualizationMap& devirt_map = method.second->GetDevirtMap();
+    body.Write32(devirt_map.size());
+    for (const auto& entry : devirt_map) {
+      body.Write32(entry.first);
+      body.Write32(dex_file_table.IndexOf(entry.second.dex_file));
+      body.Write32(entry.second.dex_method_index);
+    }
+    const VerifiedMethod::SafeCastSet& safe_cast_set = method.second->GetSafeCastSet();
+    body.Write32(safe_cast_set.size());
+    for (uint32_t dex_pc : safe_cast_set) {
+      body.Write32(dex_pc);
+    }
+  }
+
+  ResultsWriter header;
+  std::vector<uint8_t>& data = header.GetData();
+  data.insert(data.end(), kVerificationResultsMagic,
+              kVerificationResultsMagic + sizeof(kVerificationResultsMagic));
+  header.Write32(image_checksum);
+  header.Write32(key_dex_files.size());
+  for (const DexFile* dex_file : key_dex_files) {
+    header.WriteDexFile(dex_file);
+  }
+  header.Write32(dex_file_table.GetDexFiles().size());
+  for (const DexFile* dex_file : dex_file_table.GetDexFiles()) {
+    header.WriteDexFile(dex_file);
+  }
+  data.insert(data.end(), body.GetData().begin(), body.GetData().end());
+
+  UniquePtr<File> file(OS::CreateEmptyFile(filename.c_str()));
+  if (file.get() == nullptr) {
+    *error_msg = StringPrintf("Failed to create verification results file '%s'",
+                              filename.c_str());
+    return false;
+  }
+  if (!file->WriteFully(&data[0], data.size())) {
+    *error_msg = StringPrintf("Failed to write verification results file '%s'",
+                              filename.c_str());
+    return false;
+  }
+  VLOG(compiler) << "Saved verification results of " << verified_classes.size() << " classes and "
+                 << methods.size() << " methods to " << filename;
+  return true;
+}
+
+bool VerificationResults::Load(const std::string& filename,
+                               const std::vector<const DexFile*>& key_dex_files,
+                               const std::vector<const DexFile*>& known_dex_files,
+                               uint32_t image_checksum, std::string* error_msg) {
+  UniquePtr<File> file(OS::OpenFileForReading(filename.c_str()));
+  if (file.get() == nullptr) {
+    *error_msg = StringPrintf("Failed to open verification results file '%s'", filename.c_str());
+    return false;
+  }
+  int64_t length = file->GetLength();
+  if (length < static_cast<int64_t>(sizeof(kVerificationResultsMagic))) {
+    *error_msg = StringPrintf("Verification results file '%s' is truncated", filename.c_str());
+    return false;
+  }
+  std::vector<uint8_t> data(length);
+  if (!file->ReadFully(&data[0], data.size())) {
+    *error_msg = StringPrintf("Failed to read verification results file '%s'", filename.c_str());
+    return false;
+  }
+  if (memcmp(&data[0], kVerificationResultsMagic, sizeof(kVerificationResultsMagic)) != 0) {
+    *error_msg = StringPrintf("Verification results file '%s' has an unknown format",
+                              filename.c_str());
+    return false;
+  }
+  std::vector<uint8_t> contents(data.begin() + sizeof(kVerificationResultsMagic), data.end());
+  ResultsReader reader(contents);
+  std::string malformed = StringPrintf("Verification results file '%s' is malformed",
+                                       filename.c_str());
+
+  // Check that the file was written for the same inputs.
+  uint32_t saved_image_checksum;
+  uint32_t num_key_dex_files;
+  if (!reader.Read32(&saved_image_checksum) || !reader.Read32(&num_key_dex_files)) {
+    *error_msg = malformed;
+    return false;
+  }
+  if (saved_image_checksum != image_checksum || num_key_dex_files != key_dex_files.size()) {
+    *error_msg = StringPrintf("Verification results file '%s' is out of date", filename.c_str());
+    return false;
+  }
+  for (const DexFile* dex_file : key_dex_files) {
+    uint32_t checksum;
+    std::string location;
+    if (!reader.ReadDexFile(&checksum, &location)) {
+      *error_msg = malformed;
+      return false;
+    }
+    if (checksum != dex_file->GetLocationChecksum() || location != dex_file->GetLocation()) {
+      *error_msg = StringPrintf("Verification results file '%s' is out of date for '%s'",
+                                filename.c_str(), dex_file->GetLocation().c_str());
+      return false;
+    }
+  }
+
+  // Resolve the referenced dex files.
+  uint32_t num_dex_files;
+  if (!reader.Read32(&num_dex_files)) {
+    *error_msg = malformed;
+    return false;
+  }
+  std::vector<const DexFile*> dex_files;
+  for (uint32_t i = 0; i != num_dex_files; ++i) {
+    uint32_t checksum;
+    std::string location;
+    if (!reader.ReadDexFile(&checksum, &location)) {
+      *error_msg = malformed;
+      return false;
+    }
+    const DexFile* found = nullptr;
+    for (const DexFile* dex_file : known_dex_files) {
+      if (dex_file->GetLocationChecksum() == checksum && dex_file->GetLocation() == location) {
+        found = dex_file;
+        break;
+      }
+    }
+    if (found == nullptr) {
+      *error_msg = StringPrintf("Verification results file '%s' refers to unknown dex file '%s'",
+                                filename.c_str(), location.c_str());
+      return false;
+    }
+    dex_files.push_back(found);
+  }
+
+  // Decode everything before publishing anything, so a malformed file leaves no partial results.
+  SafeMap<ClassReference, bool> classes;
+  uint32_t num_classes;
+  if (!reader.Read32(&num_classes)) {
+    *error_msg = malformed;
+    return false;
+  }
+  for (uint32_t i = 0; i != num_classes; ++i) {
+    uint32_t dex_file_index;
+    uint32_t class_def_index;
+    uint32_t soft_failures;
+    if (!reader.Read32(&dex_file_index) || !reader.Read32(&class_def_index) ||
+        !reader.Read32(&soft_failures) || dex_file_index >= dex_files.size() ||
+        class_def_index >= dex_files[dex_file_index]->NumClassDefs()) {
+      *error_msg = malformed;
+      return false;
+    }
+    classes.Put(ClassReference(dex_files[dex_file_index], class_def_index), soft_failures != 0);
+  }
+  VerifiedMethodMap methods;
+  uint32_t num_methods;
+  bool ok = reader.Read32(&num_methods);
+  for (uint32_t i = 0; ok && i != num_methods; ++i) {
+    uint32_t dex_file_index;
+    uint32_t method_idx;
+    std::vector<uint8_t> dex_gc_map;
+    uint32_t devirt_map_size;
+    ok = reader.Read32(&dex_file_index) && dex_file_index < dex_files.size() &&
+        reader.Read32(&method_idx) && reader.ReadBytes(&dex_gc_map) &&
+        reader.Read32(&devirt_map_size);
+    VerifiedMethod::DevirtualizationMap devirt_map;
+    for (uint32_t j = 0; ok && j != devirt_map_size; ++j) {
+      uint32_t dex_pc;
+      uint32_t target_dex_file_index;
+      uint32_t target_method_idx;
+      ok = reader.Read32(&dex_pc) && reader.Read32(&target_dex_file_index) &&
+          target_dex_file_index < dex_files.size() && reader.Read32(&target_method_idx);
+      if (ok) {
+        devirt_map.Put(dex_pc, MethodReference(dex_files[target_dex_file_index],
+                                               target_method_idx));
+      }
+    }
+    uint32_t safe_cast_set_size;
+    ok = ok && reader.Read32(&safe_cast_set_size);
+    VerifiedMethod::SafeCastSet safe_cast_set;
+    for (uint32_t j = 0; ok && j != safe_cast_set_size; ++j) {
+      uint32_t dex_pc;
+      ok = reader.Read32(&dex_pc);
+      safe_cast_set.push_back(dex_pc);
+    }
+    if (ok) {
+      methods.Put(MethodReference(dex_files[dex_file_index], method_idx),
+                  VerifiedMethod::Create(dex_gc_map, devirt_map, safe_cast_set));
+    }
+  }
+  if (!ok || !reader.AtEnd()) {
+    STLDeleteValues(&methods);
+    *error_msg = malformed;
+    return false;
+  }
+
+  Thread* self = Thread::Current();
+  {
+    WriterMutexLock mu(self, verified_methods_lock_);
+    for (const auto& method : methods) {
+      auto it = verified_methods_.find(method.first);
+      if (it != verified_methods_.end()) {
+        delete it->second;
+        verified_methods_.erase(it);
+      }
+      verified_methods_.Put(method.first, method.second);
+    }
+  }
+  {
+    WriterMutexLock mu(self, cached_classes_lock_);
+    for (const auto& cached_class : classes) {
+      cached_classes_.Overwrite(cached_class.first, cached_class.second);
+    }
+  }
+  VLOG(compiler) << "Loaded verification results of " << classes.size() << " classes and "
+                 << methods.size() << " methods from " << filename;
+  return true;
+}
+
 }  // namespace art
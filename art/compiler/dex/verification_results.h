@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "base/macros.h"
@@ -34,6 +36,7 @@ class MethodVerifier;
 }  // namespace verifier
 
 class CompilerOptions;
+class DexFile;
 class VerifiedMethod;
 
 // Used by CompilerCallbacks to track verification information from the Runtime.
@@ -55,6 +58,28 @@ class VerificationResults {
     bool IsCandidateForCompilation(MethodReference& method_ref,
                                    const uint32_t access_flags);
 
+    // Returns true if the class was verified by an earlier compilation whose results were loaded
+    // by Load. soft_failures tells whether the class has to be verified again at runtime.
+    bool GetCachedClassVerification(ClassReference ref, bool* soft_failures)
+        LOCKS_EXCLUDED(cached_classes_lock_);
+
+    // Loads the results of an earlier compilation. The file is only used if it was written for
+    // the same key_dex_files and image_checksum, that is the same dex files and the same classes
+    // they were verified against. References to other dex files are resolved from
+    // known_dex_files. Returns false and sets error_msg if the file can't be used.
+    bool Load(const std::string& filename, const std::vector<const DexFile*>& key_dex_files,
+              const std::vector<const DexFile*>& known_dex_files, uint32_t image_checksum,
+              std::string* error_msg)
+        LOCKS_EXCLUDED(verified_methods_lock_, cached_classes_lock_);
+
+    // Saves the results for the given classes, each paired with whether it had soft failures,
+    // together with the verified methods of these classes.
+    bool Save(const std::string& filename, const std::vector<const DexFile*>& key_dex_files,
+              uint32_t image_checksum,
+              const std::vector<std::pair<ClassReference, bool> >& verified_classes,
+              std::string* error_msg)
+        LOCKS_EXCLUDED(verified_methods_lock_);
+
   private:
     // Verified methods.
     typedef SafeMap<MethodReference, const VerifiedMethod*,
@@ -65,6 +90,10 @@ class VerificationResults {
     // Rejected classes.
     ReaderWriterMutex rejected_classes_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
     std::set<ClassReference> rejected_classes_ GUARDED_BY(rejected_classes_lock_);
+
+    // Classes verified by an earlier compilation, mapped to whether they had soft failures.
+    ReaderWriterMutex cached_classes_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+    SafeMap<ClassReference, bool> cached_classes_ GUARDED_BY(cached_classes_lock_);
 };
 
 }  // namespace art
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dex/verification_results.h"
+
+#include "UniquePtr.h"
+#include "base/unix_file/fd_file.h"
+#include "common_compiler_test.h"
+#include "dex_file.h"
+#include "dex/verified_method.h"
+#include "mirror/class-inl.h"
+#include "verifier/method_verifier.h"
+
+namespace art {
+
+class VerificationResultsTest : public CommonCompilerTest {
+ protected:
+  void SaveTwoClasses(const std::string& filename, uint32_t image_checksum) {
+    std::vector<const DexFile*> key_dex_files;
+    key_dex_files.push_back(java_lang_dex_file_);
+    std::vector<std::pair<ClassReference, bool> > verified_classes;
+    verified_classes.push_back(std::make_pair(ClassReference(java_lang_dex_file_, 0), false));
+    verified_classes.push_back(std::make_pair(ClassReference(java_lang_dex_file_, 1), true));
+    std::string error_msg;
+    ASSERT_TRUE(verification_results_->Save(filename, key_dex_files, image_checksum,
+                                            verified_classes, &error_msg)) << error_msg;
+  }
+
+  bool Load(VerificationResults* results, const std::string& filename, uint32_t image_checksum) {
+    std::vector<const DexFile*> key_dex_files;
+    key_dex_files.push_back(java_lang_dex_file_);
+    std::string error_msg;
+    return results->Load(filename, key_dex_files, key_dex_files, image_checksum, &error_msg);
+  }
+};
+
+TEST_F(VerificationResultsTest, SaveAndLoad) {
+  ScratchFile tmp;
+  SaveTwoClasses(tmp.GetFilename(), 1234);
+
+  VerificationResults results(compiler_options_.get());
+  ASSERT_TRUE(Load(&results, tmp.GetFilename(), 1234));
+  bool soft_failures;
+  ASSERT_TRUE(results.GetCachedClassVerification(ClassReference(java_lang_dex_file_, 0),
+                                                 &soft_failures));
+  EXPECT_FALSE(soft_failures);
+  ASSERT_TRUE(results.GetCachedClassVerification(ClassReference(java_lang_dex_file_, 1),
+                                                 &soft_failures));
+  EXPECT_TRUE(soft_failures);
+  EXPECT_FALSE(results.GetCachedClassVerification(ClassReference(java_lang_dex_file_, 2),
+                                                  &soft_failures));
+}
+
+TEST_F(VerificationResultsTest, VerifiedMethodsRoundTrip) {
+  // Classes whose methods have GC maps, devirtualization targets and safe casts between them.
+  const char* const kDescriptors[] = {
+    "Ljava/lang/String;", "Ljava/util/ArrayList;", "Ljava/util/HashMap;", "Ljava/util/Arrays;",
+  };
+  std::vector<std::pair<ClassReference, bool> > verified_classes;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    for (const char* descriptor : kDescriptors) {
+      mirror::Class* klass = class_linker_->FindSystemClass(soa.Self(), descriptor);
+      ASSERT_TRUE(klass != nullptr) << descriptor;
+      std::string error_msg;
+      // The verifier hands each method to verification_results_ through the compiler callbacks.
+      ASSERT_NE(verifier::MethodVerifier::kHardFailure,
+                verifier::MethodVerifier::VerifyClass(klass, true, &error_msg)) << error_msg;
+      verified_classes.push_back(
+          std::make_pair(ClassReference(java_lang_dex_file_, klass->GetDexClassDefIndex()),
+                         false));
+    }
+  }
+  std::vector<const DexFile*> key_dex_files;
+  key_dex_files.push_back(java_lang_dex_file_);
+  ScratchFile tmp;
+  std::string error_msg;
+  ASSERT_TRUE(verification_results_->Save(tmp.GetFilename(), key_dex_files, 1234,
+                                          verified_classes, &error_msg)) << error_msg;
+
+  VerificationResults results(compiler_options_.get());
+  ASSERT_TRUE(Load(&results, tmp.GetFilename(), 1234));
+
+  size_t num_methods = 0;
+  size_t num_gc_maps = 0;
+  size_t num_devirt_maps = 0;
+  size_t num_safe_cast_sets = 0;
+  for (const std::pair<ClassReference, bool>& verified_class : verified_classes) {
+    const DexFile& dex_file = *verified_class.first.first;
+    const byte* class_data =
+        dex_file.GetClassData(dex_file.GetClassDef(verified_class.first.second));
+    ASSERT_TRUE(class_data != nullptr);
+    ClassDataItemIterator it(dex_file, class_data);
+    while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+      it.Next();
+    }
+    for (; it.HasNextDirectMethod() || it.HasNextVirtualMethod(); it.Next()) {
+      MethodReference ref(&dex_file, it.GetMemberIndex());
+      const VerifiedMethod* saved = verification_results_->GetVerifiedMethod(ref);
+      const VerifiedMethod* loaded = results.GetVerifiedMethod(ref);
+      if (saved == nullptr) {
+        EXPECT_TRUE(loaded == nullptr) << PrettyMethod(ref.dex_method_index, dex_file);
+        continue;
+      }
+      ASSERT_TRUE(loaded != nullptr) << PrettyMethod(ref.dex_method_index, dex_file);
+      ++num_methods;
+
+      EXPECT_TRUE(saved->GetDexGcMap() == loaded->GetDexGcMap())
+          << PrettyMethod(ref.dex_method_index, dex_file);
+      num_gc_maps += saved->GetDexGcMap().empty() ? 0U : 1U;
+
+      const VerifiedMethod::DevirtualizationMap& saved_devirt_map = saved->GetDevirtMap();
+      const VerifiedMethod::DevirtualizationMap& loaded_devirt_map = loaded->GetDevirtMap();
+      ASSERT_EQ(saved_devirt_map.size(), loaded_devirt_map.size())
+          << PrettyMethod(ref.dex_method_index, dex_file);
+      for (const auto& entry : saved_devirt_map) {
+        const MethodReference* target = loaded->GetDevirtTarget(entry.first);
+        ASSERT_TRUE(target != nullptr) << PrettyMethod(ref.dex_method_index, dex_file)
+                                       << " at " << entry.first;
+        EXPECT_EQ(entry.second.dex_file, target->dex_file);
+        EXPECT_EQ(entry.second.dex_method_index, target->dex_method_index);
+      }
+      num_devirt_maps += saved_devirt_map.empty() ? 0U : 1U;
+
+      EXPECT_TRUE(saved->GetSafeCastSet() == loaded->GetSafeCastSet())
+          << PrettyMethod(ref.dex_method_index, dex_file);
+      num_safe_cast_sets += saved->GetSafeCastSet().empty() ? 0U : 1U;
+    }
+  }
+  // Otherwise the classes above no longer exercise every part of the format.
+  EXPECT_NE(0U, num_methods);
+  EXPECT_NE(0U, num_gc_maps);
+  EXPECT_NE(0U, num_devirt_maps);
+  EXPECT_NE(0U, num_safe_cast_sets);
+}
+
+TEST_F(VerificationResultsTest, OutOfDate) {
+  ScratchFile tmp;
+  SaveTwoClasses(tmp.GetFilename(), 1234);
+
+  // A different boot image invalidates the results.
+  VerificationResults results(compiler_options_.get());
+  EXPECT_FALSE(Load(&results, tmp.GetFilename(), 4321));
+  bool soft_failures;
+  EXPECT_FALSE(results.GetCachedClassVerification(ClassReference(java_lang_dex_file_, 0),
+                                                  &soft_failures));
+
+  // So do different dex files.
+  std::vector<const DexFile*> no_dex_files;
+  std::string error_msg;
+  EXPECT_FALSE(results.Load(tmp.GetFilename(), no_dex_files, no_dex_files, 1234, &error_msg));
+}
+
+TEST_F(VerificationResultsTest, Truncated) {
+  ScratchFile tmp;
+  SaveTwoClasses(tmp.GetFilename(), 1234);
+  ASSERT_TRUE(tmp.GetFile()->SetLength(tmp.GetFile()->GetLength() - 4) == 0);
+
+  VerificationResults results(compiler_options_.get());
+  EXPECT_FALSE(Load(&results, tmp.GetFilename(), 1234));
+  bool soft_failures;
+  EXPECT_FALSE(results.GetCachedClassVerification(ClassReference(java_lang_dex_file_, 0),
+                                                  &soft_failures));
+}
+
+}  // namespace art
@@ -68,6 +68,16 @@ const VerifiedMethod* VerifiedMethod::Create(verifier::MethodVerifier* method_ve
   return verified_method.release();
 }
 
+const VerifiedMethod* VerifiedMethod::Create(const std::vector<uint8_t>& dex_gc_map,
+                                             const DevirtualizationMap& devirt_map,
+                                             const SafeCastSet& safe_cast_set) {
+  VerifiedMethod* verified_method = new VerifiedMethod;
+  verified_method->dex_gc_map_ = dex_gc_map;
+  verified_method->devirt_map_ = devirt_map;
+  verified_method->safe_cast_set_ = safe_cast_set;
+  return verified_method;
+}
+
 const MethodReference* VerifiedMethod::GetDevirtTarget(uint32_t dex_pc) const {
   auto it = devirt_map_.find(dex_pc);
   return (it != devirt_map_.end()) ? &it->second : nullptr;
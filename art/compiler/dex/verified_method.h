@@ -41,6 +41,11 @@ class VerifiedMethod {
 
   static const VerifiedMethod* Create(verifier::MethodVerifier* method_verifier, bool compile)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Recreates a verified method from data saved by an earlier compilation.
+  static const VerifiedMethod* Create(const std::vector<uint8_t>& dex_gc_map,
+                                      const DevirtualizationMap& devirt_map,
+                                      const SafeCastSet& safe_cast_set);
   ~VerifiedMethod() = default;
 
   const std::vector<uint8_t>& GetDexGcMap() const {
@@ -40,6 +40,9 @@ class CompilerCallbacksImpl FINAL : public CompilerCallbacks {
     void ClassRejected(ClassReference ref) OVERRIDE {
       verification_results_->AddRejectedClass(ref);
     }
+    bool IsClassVerificationCached(ClassReference ref, bool* soft_failures) OVERRIDE {
+      return verification_results_->GetCachedClassVerification(ref, soft_failures);
+    }
 
   private:
     VerificationResults* const verification_results_;
@@ -38,6 +38,7 @@
 #include "runtime.h"
 #include "gc/accounting/card_table-inl.h"
 #include "gc/accounting/heap_bitmap.h"
+#include "gc/space/image_space.h"
 #include "gc/space/space.h"
 #include "mirror/art_field-inl.h"
 #include "mirror/art_method-inl.h"
@@ -324,6 +325,81 @@ extern "C" art::CompiledMethod* ArtCompileDEX(art::CompilerDriver& compiler,
                                               jobject class_loader,
                                               const art::DexFile& dex_file);
 
+class CompilerDriver::DexFileTables {
+ public:
+  DexFileTables(const DexFile* dex_file, DexFileTables* next)
+      : dex_file_(dex_file), next_(next),
+        num_method_ids_(dex_file->NumMethodIds()), num_class_defs_(dex_file->NumClassDefs()),
+        compiled_methods_(new CompiledMethod* volatile[num_method_ids_]()),
+        compiled_classes_(new CompiledClass* volatile[num_class_defs_]()) {
+  }
+
+  // The dex file may already be closed.
+  ~DexFileTables() {
+    for (size_t i = 0; i < num_method_ids_; ++i) {
+      delete compiled_methods_[i];
+    }
+    for (size_t i = 0; i < num_class_defs_; ++i) {
+      delete compiled_classes_[i];
+    }
+  }
+
+  const DexFile* GetDexFile() const {
+    return dex_file_;
+  }
+
+  DexFileTables* GetNext() const {
+    return next_;
+  }
+
+  uint32_t NumMethodIds() const {
+    return num_method_ids_;
+  }
+
+  CompiledMethod* GetCompiledMethod(uint32_t method_idx) const {
+    DCHECK_LT(method_idx, num_method_ids_);
+    CompiledMethod* compiled_method = compiled_methods_[method_idx];
+    QuasiAtomic::MembarLoadLoad();
+    return compiled_method;
+  }
+
+  // Every method is compiled once.
+  void PutCompiledMethod(uint32_t method_idx, CompiledMethod* compiled_method) {
+    DCHECK_LT(method_idx, num_method_ids_);
+    QuasiAtomic::MembarStoreStore();
+    bool success = __sync_bool_compare_and_swap(&compiled_methods_[method_idx],
+                                                static_cast<CompiledMethod*>(NULL),
+                                                compiled_method);
+    CHECK(success) << PrettyMethod(method_idx, *dex_file_) << " compiled twice";
+  }
+
+  CompiledClass* GetCompiledClass(uint16_t class_def_idx) const {
+    DCHECK_LT(class_def_idx, num_class_defs_);
+    CompiledClass* compiled_class = compiled_classes_[class_def_idx];
+    QuasiAtomic::MembarLoadLoad();
+    return compiled_class;
+  }
+
+  // Returns the replaced entry. Updates are serialized by the compiled classes lock.
+  CompiledClass* SetCompiledClass(uint16_t class_def_idx, CompiledClass* compiled_class) {
+    DCHECK_LT(class_def_idx, num_class_defs_);
+    CompiledClass* old_compiled_class = compiled_classes_[class_def_idx];
+    QuasiAtomic::MembarStoreStore();
+    compiled_classes_[class_def_idx] = compiled_class;
+    return old_compiled_class;
+  }
+
+ private:
+  const DexFile* const dex_file_;
+  DexFileTables* const next_;
+  const uint32_t num_method_ids_;
+  const uint32_t num_class_defs_;
+  UniquePtr<CompiledMethod* volatile[]> compiled_methods_;
+  UniquePtr<CompiledClass* volatile[]> compiled_classes_;
+
+  DISALLOW_COPY_AND_ASSIGN(DexFileTables);
+};
+
 CompilerDriver::CompilerDriver(const CompilerOptions* compiler_options,
                                VerificationResults* verification_results,
                                DexFileToMethodInlinerMap* method_inliner_map,
@@ -340,6 +416,8 @@ CompilerDriver::CompilerDriver(const CompilerOptions* compiler_options,
       instruction_set_(instruction_set),
       instruction_set_features_(instruction_set_features),
       freezing_constructor_lock_("freezing constructor lock"),
+      dex_file_tables_(NULL),
+      spilled_code_lost_(false),
       compiled_classes_lock_("compiled classes lock"),
       compiled_methods_lock_("compiled method lock"),
       image_(image),
@@ -352,6 +430,8 @@ CompilerDriver::CompilerDriver(const CompilerOptions* compiler_options,
       timings_logger_(timer),
       compiler_library_(NULL),
       compiler_context_(NULL),
+      tls_lock_("compiler tls lock"),
+      arena_pool_(true),
       compiler_enable_auto_elf_loading_(NULL),
       compiler_get_method_code_addr_(NULL),
       support_boot_image_fixup_(instruction_set != kMips),
@@ -389,6 +469,19 @@ CompilerDriver::CompilerDriver(const CompilerOptions* compiler_options,
   }
 }
 
+void CompilerDriver::DumpDedupeStats(std::ostream& os) const {
+  os << "Deduplication:\n"
+     << dedupe_code_.DumpStats() << "\n"
+     << dedupe_mapping_table_.DumpStats() << "\n"
+     << dedupe_vmap_table_.DumpStats() << "\n"
+     << dedupe_gc_map_.DumpStats() << "\n"
+     << dedupe_cfi_info_.DumpStats() << "\n";
+}
+
+void CompilerDriver::DumpArenaStats(std::ostream& os) const {
+  arena_pool_.DumpStats(os);
+}
+
 std::vector<uint8_t>* CompilerDriver::DeduplicateCode(const std::vector<uint8_t>& code) {
   return dedupe_code_.Add(Thread::Current(), code);
 }
@@ -416,11 +509,12 @@ CompilerDriver::~CompilerDriver() {
   Thread* self = Thread::Current();
   {
     MutexLock mu(self, compiled_classes_lock_);
-    STLDeleteValues(&compiled_classes_);
+    STLDeleteElements(&replaced_compiled_classes_);
   }
-  {
-    MutexLock mu(self, compiled_methods_lock_);
-    STLDeleteValues(&compiled_methods_);
+  while (dex_file_tables_ != NULL) {
+    DexFileTables* tables = dex_file_tables_;
+    dex_file_tables_ = tables->GetNext();
+    delete tables;
   }
   {
     MutexLock mu(self, compiled_methods_lock_);
@@ -435,6 +529,10 @@ CompilerDriver::~CompilerDriver() {
     STLDeleteElements(&classes_to_patch_);
   }
   CHECK_PTHREAD_CALL(pthread_key_delete, (tls_key_), "delete tls key");
+  {
+    MutexLock mu(self, tls_lock_);
+    STLDeleteElements(&all_tls_);
+  }
   compiler_->UnInit();
 }
 
@@ -444,10 +542,28 @@ CompilerTls* CompilerDriver::GetTls() {
   if (res == NULL) {
     res = new CompilerTls();
     CHECK_PTHREAD_CALL(pthread_setspecific, (tls_key_, res), "compiler tls");
+    MutexLock mu(Thread::Current(), tls_lock_);
+    all_tls_.push_back(res);
   }
   return res;
 }
 
+void CompilerDriver::MergeThreadTimings() {
+  // The logger's lock is at the same level as tls_lock_, so merge outside of tls_lock_. The
+  // workers are idle, their accumulators are only read here.
+  std::vector<CompilerTls*> all_tls;
+  {
+    MutexLock mu(Thread::Current(), tls_lock_);
+    all_tls = all_tls_;
+  }
+  for (CompilerTls* tls : all_tls) {
+    if (timings_logger_ != NULL && tls->GetTimings()->GetIterations() != 0) {
+      timings_logger_->AddAccumulator(*tls->GetTimings());
+    }
+    tls->GetTimings()->Reset();
+  }
+}
+
 #define CREATE_TRAMPOLINE(type, abi, offset) \
     if (Is64BitInstructionSet(instruction_set_)) { \
       return CreateTrampoline64(instruction_set_, abi, \
@@ -505,6 +621,7 @@ void CompilerDriver::CompileAll(jobject class_loader,
   UniquePtr<ThreadPool> thread_pool(new ThreadPool("Compiler driver thread pool", thread_count_ - 1));
   PreCompile(class_loader, dex_files, thread_pool.get(), timings);
   Compile(class_loader, dex_files, thread_pool.get(), timings);
+  MergeThreadTimings();
   if (dump_stats_) {
     stats_->Dump();
   }
@@ -584,6 +701,7 @@ void CompilerDriver::CompileOne(mirror::ArtMethod* method, TimingLogger* timings
   }
   CompileMethod(code_item, access_flags, invoke_type, class_def_idx, method_idx, jclass_loader,
                 *dex_file, dex_to_dex_compilation_level);
+  MergeThreadTimings();
 
   self->GetJniEnv()->DeleteGlobalRef(jclass_loader);
 
@@ -610,8 +728,15 @@ void CompilerDriver::PreCompile(jobject class_loader, const std::vector<const De
 
   Resolve(class_loader, dex_files, thread_pool, timings);
 
+  bool results_loaded = !verification_results_file_.empty() &&
+      LoadVerificationResults(class_loader, dex_files, timings);
+
   Verify(class_loader, dex_files, thread_pool, timings);
 
+  if (!verification_results_file_.empty() && !results_loaded) {
+    SaveVerificationResults(class_loader, dex_files, timings);
+  }
+
   InitializeClasses(class_loader, dex_files, thread_pool, timings);
 
   UpdateImageClasses(timings);
@@ -1612,11 +1737,107 @@ void CompilerDriver::ResolveDexFile(jobject class_loader, const DexFile& dex_fil
 
 void CompilerDriver::Verify(jobject class_loader, const std::vector<const DexFile*>& dex_files,
                             ThreadPool* thread_pool, TimingLogger* timings) {
+  // Classes are verified in parallel by the workers of thread_pool. Those with many methods, such
+  // as generated ones, also have their methods verified in parallel by a second pool, whose
+  // workers are idle unless such a class is being verified.
+  UniquePtr<ThreadPool> method_thread_pool;
+  if (thread_count_ > 1) {
+    Thread* self = Thread::Current();
+    method_thread_pool.reset(new ThreadPool("Compiler method verification thread pool",
+                                            thread_count_ - 1));
+    method_thread_pool->StartWorkers(self);
+    verifier::MethodVerifier::SetMethodThreadPool(method_thread_pool.get());
+  }
   for (size_t i = 0; i != dex_files.size(); ++i) {
     const DexFile* dex_file = dex_files[i];
     CHECK(dex_file != NULL);
     VerifyDexFile(class_loader, *dex_file, thread_pool, timings);
   }
+  if (method_thread_pool.get() != nullptr) {
+    // Helpers that were scheduled after all methods of their class were taken may still be queued.
+    method_thread_pool->Wait(Thread::Current(), true, false);
+    verifier::MethodVerifier::SetMethodThreadPool(nullptr);
+  }
+}
+
+void CompilerDriver::GetVerificationResultsKey(jobject class_loader,
+                                               const std::vector<const DexFile*>& dex_files,
+                                               std::vector<const DexFile*>* key_dex_files,
+                                               uint32_t* image_checksum) {
+  // The classes were verified against the boot image and the class path, so the results are only
+  // valid as long as neither changed.
+  Runtime* runtime = Runtime::Current();
+  key_dex_files->assign(dex_files.begin(), dex_files.end());
+  if (class_loader != nullptr) {
+    const std::vector<const DexFile*>& class_path = runtime->GetCompileTimeClassPath(class_loader);
+    for (const DexFile* dex_file : class_path) {
+      if (std::find(dex_files.begin(), dex_files.end(), dex_file) == dex_files.end()) {
+        key_dex_files->push_back(dex_file);
+      }
+    }
+  }
+  gc::space::ImageSpace* image_space = runtime->GetHeap()->GetImageSpace();
+  *image_checksum = (image_space != nullptr) ? image_space->GetImageHeader().GetOatChecksum() : 0;
+}
+
+bool CompilerDriver::LoadVerificationResults(jobject class_loader,
+                                             const std::vector<const DexFile*>& dex_files,
+                                             TimingLogger* timings) {
+  TimingLogger::ScopedSplit split("Load Verification Results", timings);
+  std::vector<const DexFile*> key_dex_files;
+  uint32_t image_checksum;
+  GetVerificationResultsKey(class_loader, dex_files, &key_dex_files, &image_checksum);
+  std::vector<const DexFile*> known_dex_files(key_dex_files);
+  const std::vector<const DexFile*>& boot_class_path =
+      Runtime::Current()->GetClassLinker()->GetBootClassPath();
+  known_dex_files.insert(known_dex_files.end(), boot_class_path.begin(), boot_class_path.end());
+  std::string error_msg;
+  if (!verification_results_->Load(verification_results_file_, key_dex_files, known_dex_files,
+                                   image_checksum, &error_msg)) {
+    VLOG(compiler) << "Not using verification results: " << error_msg;
+    return false;
+  }
+  return true;
+}
+
+void CompilerDriver::SaveVerificationResults(jobject class_loader,
+                                             const std::vector<const DexFile*>& dex_files,
+                                             TimingLogger* timings) {
+  TimingLogger::ScopedSplit split("Save Verification Results", timings);
+  std::vector<const DexFile*> key_dex_files;
+  uint32_t image_checksum;
+  GetVerificationResultsKey(class_loader, dex_files, &key_dex_files, &image_checksum);
+
+  // Only verified classes are saved, rejected classes and classes that could not be resolved are
+  // verified again by the next compilation.
+  std::vector<std::pair<ClassReference, bool> > verified_classes;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+    mirror::ClassLoader* loader = soa.Decode<mirror::ClassLoader*>(class_loader);
+    for (const DexFile* dex_file : dex_files) {
+      for (size_t i = 0; i < dex_file->NumClassDefs(); ++i) {
+        const char* descriptor = dex_file->GetClassDescriptor(dex_file->GetClassDef(i));
+        mirror::Class* klass = class_linker->LookupClass(descriptor, loader);
+        if (klass == nullptr || klass->GetDexCache()->GetDexFile() != dex_file ||
+            klass->GetDexClassDefIndex() != i) {
+          continue;
+        }
+        mirror::Class::Status status = klass->GetStatus();
+        if (status >= mirror::Class::kStatusVerified) {
+          verified_classes.push_back(std::make_pair(ClassReference(dex_file, i), false));
+        } else if (status == mirror::Class::kStatusRetryVerificationAtRuntime) {
+          verified_classes.push_back(std::make_pair(ClassReference(dex_file, i), true));
+        }
+      }
+    }
+  }
+
+  std::string error_msg;
+  if (!verification_results_->Save(verification_results_file_, key_dex_files, image_checksum,
+                                   verified_classes, &error_msg)) {
+    LOG(WARNING) << error_msg;
+  }
 }
 
 static void VerifyClass(const ParallelCompilationManager* manager, size_t class_def_index)
@@ -1790,11 +2011,89 @@ void CompilerDriver::InitializeClasses(jobject class_loader,
 
 void CompilerDriver::Compile(jobject class_loader, const std::vector<const DexFile*>& dex_files,
                              ThreadPool* thread_pool, TimingLogger* timings) {
+  if (!spill_filename_.empty()) {
+    std::string error_msg;
+    spill_file_.reset(SpillFile::Create(spill_filename_, &error_msg));
+    if (spill_file_.get() == NULL) {
+      LOG(WARNING) << "Keeping compiled code in memory: " << error_msg;
+    }
+  }
+  // After a failure, the code of the remaining dex files stays in memory.
+  bool spilling = spill_file_.get() != NULL;
   for (size_t i = 0; i != dex_files.size(); ++i) {
     const DexFile* dex_file = dex_files[i];
     CHECK(dex_file != NULL);
     CompileDexFile(class_loader, *dex_file, thread_pool, timings);
+    // The workers keep their cached arenas for the next dex file, the rest is given back.
+    size_t trimmed_bytes = arena_pool_.TrimFreeArenas();
+    VLOG(compiler) << "Trimmed " << PrettySize(trimmed_bytes) << " of arenas after "
+                   << dex_file->GetLocation();
+    if (spilling && !SpillCompiledCode(*dex_file, timings)) {
+      LOG(WARNING) << "Keeping compiled code in memory after failing to spill "
+                   << dex_file->GetLocation();
+      spilling = false;
+    }
+  }
+  if (spill_file_.get() != NULL) {
+    std::string error_msg;
+    if (!spill_file_->MapForReading(&error_msg)) {
+      LOG(WARNING) << "Reading spilled code back into memory: " << error_msg;
+      if (UnspillCompiledCode(dex_files, timings)) {
+        spill_file_.reset();
+      } else {
+        spilled_code_lost_ = true;
+      }
+    }
+  }
+}
+
+bool CompilerDriver::SpillCompiledCode(const DexFile& dex_file, TimingLogger* timings) {
+  timings->NewSplit("Spill compiled code");
+  DexFileTables* tables = FindDexFileTables(&dex_file);
+  if (tables == NULL) {
+    return true;
   }
+  size_t spilled_bytes = 0;
+  bool success = true;
+  for (uint32_t method_idx = 0; method_idx < tables->NumMethodIds(); ++method_idx) {
+    CompiledMethod* compiled_method = tables->GetCompiledMethod(method_idx);
+    if (compiled_method == NULL || compiled_method->GetPortableCode() == NULL) {
+      continue;
+    }
+    size_t code_size = compiled_method->GetPortableCodeSize();
+    if (!compiled_method->SpillPortableCode(spill_file_.get())) {
+      // The code that could not be spilled stays in memory.
+      success = false;
+      break;
+    }
+    spilled_bytes += code_size;
+  }
+  VLOG(compiler) << "Spilled " << PrettySize(spilled_bytes) << " of compiled code of "
+                 << dex_file.GetLocation();
+  return success;
+}
+
+bool CompilerDriver::UnspillCompiledCode(const std::vector<const DexFile*>& dex_files,
+                                         TimingLogger* timings) {
+  timings->NewSplit("Unspill compiled code");
+  for (size_t i = 0; i != dex_files.size(); ++i) {
+    DexFileTables* tables = FindDexFileTables(dex_files[i]);
+    if (tables == NULL) {
+      continue;
+    }
+    for (uint32_t method_idx = 0; method_idx < tables->NumMethodIds(); ++method_idx) {
+      CompiledMethod* compiled_method = tables->GetCompiledMethod(method_idx);
+      if (compiled_method == NULL || !compiled_method->IsPortableCodeSpilled()) {
+        continue;
+      }
+      if (!compiled_method->UnspillPortableCode(spill_file_.get())) {
+        LOG(ERROR) << "Failed to read back the spilled code of "
+                   << PrettyMethod(method_idx, *dex_files[i]);
+        return false;
+      }
+    }
+  }
+  return true;
 }
 
 void CompilerDriver::CompileClass(const ParallelCompilationManager* manager, size_t class_def_index) {
@@ -1923,10 +2222,7 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
   if (compiled_method != NULL) {
     MethodReference ref(&dex_file, method_idx);
     DCHECK(GetCompiledMethod(ref) == NULL) << PrettyMethod(method_idx, dex_file);
-    {
-      MutexLock mu(self, compiled_methods_lock_);
-      compiled_methods_.Put(ref, compiled_method);
-    }
+    FindOrCreateDexFileTables(&dex_file)->PutCompiledMethod(method_idx, compiled_method);
     DCHECK(GetCompiledMethod(ref) != NULL) << PrettyMethod(method_idx, dex_file);
   }
 
@@ -1937,24 +2233,54 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
   }
 }
 
+CompilerDriver::DexFileTables* CompilerDriver::FindDexFileTables(const DexFile* dex_file) const {
+  DexFileTables* tables = dex_file_tables_;
+  QuasiAtomic::MembarLoadLoad();
+  for (; tables != NULL; tables = tables->GetNext()) {
+    if (tables->GetDexFile() == dex_file) {
+      return tables;
+    }
+  }
+  return NULL;
+}
+
+CompilerDriver::DexFileTables* CompilerDriver::FindOrCreateDexFileTables(const DexFile* dex_file) {
+  DexFileTables* new_tables = NULL;
+  while (true) {
+    DexFileTables* head = dex_file_tables_;
+    QuasiAtomic::MembarLoadLoad();
+    for (DexFileTables* tables = head; tables != NULL; tables = tables->GetNext()) {
+      if (tables->GetDexFile() == dex_file) {
+        // Another thread added the tables first.
+        delete new_tables;
+        return tables;
+      }
+    }
+    delete new_tables;
+    new_tables = new DexFileTables(dex_file, head);
+    QuasiAtomic::MembarStoreStore();
+    if (__sync_bool_compare_and_swap(&dex_file_tables_, head, new_tables)) {
+      return new_tables;
+    }
+  }
+}
+
 CompiledClass* CompilerDriver::GetCompiledClass(ClassReference ref) const {
-  MutexLock mu(Thread::Current(), compiled_classes_lock_);
-  ClassTable::const_iterator it = compiled_classes_.find(ref);
-  if (it == compiled_classes_.end()) {
+  DexFileTables* tables = FindDexFileTables(ref.first);
+  if (tables == NULL) {
     return NULL;
   }
-  CHECK(it->second != NULL);
-  return it->second;
+  return tables->GetCompiledClass(ref.second);
 }
 
 void CompilerDriver::RecordClassStatus(ClassReference ref, mirror::Class::Status status) {
+  DexFileTables* tables = FindOrCreateDexFileTables(ref.first);
   MutexLock mu(Thread::Current(), compiled_classes_lock_);
-  auto it = compiled_classes_.find(ref);
-  if (it == compiled_classes_.end() || it->second->GetStatus() != status) {
+  CompiledClass* compiled_class = tables->GetCompiledClass(ref.second);
+  if (compiled_class == NULL || compiled_class->GetStatus() != status) {
     // An entry doesn't exist or the status is lower than the new status.
-    if (it != compiled_classes_.end()) {
-      CHECK_GT(status, it->second->GetStatus());
-      delete it->second;
+    if (compiled_class != NULL) {
+      CHECK_GT(status, compiled_class->GetStatus());
     }
     switch (status) {
       case mirror::Class::kStatusNotReady:
@@ -1968,19 +2294,19 @@ void CompilerDriver::RecordClassStatus(ClassReference ref, mirror::Class::Status
             << PrettyDescriptor(ref.first->GetClassDescriptor(ref.first->GetClassDef(ref.second)))
             << " of " << status;
     }
-    CompiledClass* compiled_class = new CompiledClass(status);
-    compiled_classes_.Overwrite(ref, compiled_class);
+    CompiledClass* replaced = tables->SetCompiledClass(ref.second, new CompiledClass(status));
+    if (replaced != NULL) {
+      replaced_compiled_classes_.push_back(replaced);
+    }
   }
 }
 
 CompiledMethod* CompilerDriver::GetCompiledMethod(MethodReference ref) const {
-  MutexLock mu(Thread::Current(), compiled_methods_lock_);
-  MethodTable::const_iterator it = compiled_methods_.find(ref);
-  if (it == compiled_methods_.end()) {
+  DexFileTables* tables = FindDexFileTables(ref.dex_file);
+  if (tables == NULL) {
     return NULL;
   }
-  CHECK(it->second != NULL);
-  return it->second;
+  return tables->GetCompiledMethod(ref.dex_method_index);
 }
 
 void CompilerDriver::AddRequiresConstructorBarrier(Thread* self, const DexFile* dex_file,
@@ -2001,6 +2327,10 @@ bool CompilerDriver::WriteElf(const std::string& android_root,
                               OatWriter* oat_writer,
                               art::File* file)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (spilled_code_lost_) {
+    LOG(ERROR) << "Cannot write " << file->GetPath() << ", spilled compiled code was lost";
+    return false;
+  }
   return compiler_->WriteElf(file, oat_writer, dex_files, android_root, is_host);
 }
 void CompilerDriver::InstructionSetToLLVMTarget(InstructionSet instruction_set,
@@ -2022,6 +2352,13 @@ void CompilerDriver::InstructionSetToLLVMTarget(InstructionSet instruction_set,
       *target_attr = "+v7,+neon,+neonfp,+vfp3,+db";
       break;
 
+    case kArm64:
+      *target_triple = "aarch64-linux-gnu";
+      *target_cpu = "generic";
+      // x18 holds the current Thread*, keep LLVM from allocating it.
+      *target_attr = "+neon,+reserve-x18";
+      break;
+
     case kX86:
       *target_triple = "i386-pc-linux-gnu";
       *target_attr = "";
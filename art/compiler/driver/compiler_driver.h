@@ -38,6 +38,7 @@
 #include "thread_pool.h"
 #include "utils/arena_allocator.h"
 #include "utils/dedupe_set.h"
+#include "utils/spill_file.h"
 
 namespace art {
 
@@ -84,8 +85,13 @@ class CompilerTls {
 
     void SetLLVMInfo(void* llvm_info) { llvm_info_ = llvm_info; }
 
+    // The pass timings of the methods compiled by this thread, merged by the driver once the
+    // compilation is done.
+    TimingAccumulator* GetTimings() { return &timings_; }
+
   private:
     void* llvm_info_;
+    TimingAccumulator timings_;
 };
 
 class CompilerDriver {
@@ -122,6 +128,23 @@ class CompilerDriver {
     return verification_results_;
   }
 
+  // Verification results are loaded from this file when it matches the dex files being compiled,
+  // otherwise they are saved to it once the classes are verified.
+  void SetVerificationResultsFile(const std::string& filename) {
+    verification_results_file_ = filename;
+  }
+
+  // Once a dex file is compiled, the ELF objects of its portable methods are moved to this file
+  // instead of staying in memory until the oat file is written.
+  void SetSpillFile(const std::string& filename) {
+    spill_filename_ = filename;
+  }
+
+  // Returns NULL unless compiled code was spilled.
+  SpillFile* GetSpillFile() const {
+    return spill_file_.get();
+  }
+
   DexFileToMethodInlinerMap* GetMethodInlinerMap() const {
     return method_inliner_map_;
   }
@@ -155,7 +178,7 @@ class CompilerDriver {
     return image_classes_.get();
   }
 
-  CompilerTls* GetTls();
+  CompilerTls* GetTls() LOCKS_EXCLUDED(tls_lock_);
 
   // Generate the trampolines that are invoked by unresolved direct methods.
   const std::vector<uint8_t>* CreateInterpreterToInterpreterBridge() const
@@ -179,11 +202,11 @@ class CompilerDriver {
   const std::vector<uint8_t>* CreateQuickToInterpreterBridge() const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  CompiledClass* GetCompiledClass(ClassReference ref) const
-      LOCKS_EXCLUDED(compiled_classes_lock_);
+  // Lock-free.
+  CompiledClass* GetCompiledClass(ClassReference ref) const;
 
-  CompiledMethod* GetCompiledMethod(MethodReference ref) const
-      LOCKS_EXCLUDED(compiled_methods_lock_);
+  // Lock-free.
+  CompiledMethod* GetCompiledMethod(MethodReference ref) const;
 
   void AddRequiresConstructorBarrier(Thread* self, const DexFile* dex_file,
                                      uint16_t class_def_index);
@@ -398,6 +421,12 @@ class CompilerDriver {
     return timings_logger_;
   }
 
+  // Dumps the hit ratio and the bytes saved of the code and metadata deduplication.
+  void DumpDedupeStats(std::ostream& os) const;
+
+  // Dumps the reuse of the arenas of the compiler threads.
+  void DumpArenaStats(std::ostream& os) const;
+
   class PatchInformation {
    public:
     const DexFile& GetDexFile() const {
@@ -598,6 +627,8 @@ class CompilerDriver {
   ProfileMap profile_map_;
   bool profile_ok_;
 
+  std::string verification_results_file_;
+
   // Should the compiler run on this method given profile information?
   bool SkipCompilation(const std::string& method_name);
 
@@ -651,6 +682,18 @@ class CompilerDriver {
 
   void Verify(jobject class_loader, const std::vector<const DexFile*>& dex_files,
               ThreadPool* thread_pool, TimingLogger* timings);
+  // Returns the dex files whose verification results can be reused and the checksum of the image
+  // they were verified against.
+  void GetVerificationResultsKey(jobject class_loader,
+                                 const std::vector<const DexFile*>& dex_files,
+                                 std::vector<const DexFile*>* key_dex_files,
+                                 uint32_t* image_checksum);
+  bool LoadVerificationResults(jobject class_loader, const std::vector<const DexFile*>& dex_files,
+                               TimingLogger* timings)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+  void SaveVerificationResults(jobject class_loader, const std::vector<const DexFile*>& dex_files,
+                               TimingLogger* timings)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
   void VerifyDexFile(jobject class_loader, const DexFile& dex_file,
                      ThreadPool* thread_pool, TimingLogger* timings)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
@@ -671,6 +714,8 @@ class CompilerDriver {
   void CompileDexFile(jobject class_loader, const DexFile& dex_file,
                       ThreadPool* thread_pool, TimingLogger* timings)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
+  bool SpillCompiledCode(const DexFile& dex_file, TimingLogger* timings);
+  bool UnspillCompiledCode(const std::vector<const DexFile*>& dex_files, TimingLogger* timings);
   void CompileMethod(const DexFile::CodeItem* code_item, uint32_t access_flags,
                      InvokeType invoke_type, uint16_t class_def_idx, uint32_t method_idx,
                      jobject class_loader, const DexFile& dex_file,
@@ -697,15 +742,31 @@ class CompilerDriver {
   mutable ReaderWriterMutex freezing_constructor_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   std::set<ClassReference> freezing_constructor_classes_ GUARDED_BY(freezing_constructor_lock_);
 
-  typedef SafeMap<const ClassReference, CompiledClass*> ClassTable;
-  // All class references that this compiler has compiled.
+  // The compiled methods and classes of one dex file, in arrays indexed by method index and by
+  // class def index.
+  class DexFileTables;
+
+  // Returns the tables of dex_file, or NULL if nothing was recorded for it yet. Lock-free.
+  DexFileTables* FindDexFileTables(const DexFile* dex_file) const;
+
+  DexFileTables* FindOrCreateDexFileTables(const DexFile* dex_file);
+
+  // The tables of all dex files that this compiler has compiled methods or classes of. The list
+  // is only prepended to, with a compare and swap of its head, so it can be walked without a lock.
+  DexFileTables* volatile dex_file_tables_;
+
+  std::string spill_filename_;
+  UniquePtr<SpillFile> spill_file_;
+  // Set when the spill file could neither be mapped nor read back, the oat file cannot be written.
+  bool spilled_code_lost_;
+
+  // Serializes the status updates of the compiled classes. The CompiledClass objects replaced by
+  // an update are kept until the driver is destroyed, since readers do not take the lock.
   mutable Mutex compiled_classes_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
-  ClassTable compiled_classes_ GUARDED_BY(compiled_classes_lock_);
+  std::vector<CompiledClass*> replaced_compiled_classes_ GUARDED_BY(compiled_classes_lock_);
 
-  typedef SafeMap<const MethodReference, CompiledMethod*, MethodReferenceComparator> MethodTable;
-  // All method references that this compiler has compiled.
+  // Guards the patch information.
   mutable Mutex compiled_methods_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
-  MethodTable compiled_methods_ GUARDED_BY(compiled_methods_lock_);
 
   const bool image_;
 
@@ -742,7 +803,14 @@ class CompilerDriver {
 
   pthread_key_t tls_key_;
 
-  // Arena pool used by the compiler.
+  // Merges the pass timings of all threads into timings_logger_.
+  void MergeThreadTimings() LOCKS_EXCLUDED(tls_lock_);
+
+  // The thread-local storage of all threads, owned by the driver.
+  Mutex tls_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  std::vector<CompilerTls*> all_tls_ GUARDED_BY(tls_lock_);
+
+  // Arena pool used by the compiler, with a cache of arenas for every compiler thread.
   ArenaPool arena_pool_;
 
   typedef void (*CompilerEnableAutoElfLoadingFn)(CompilerDriver& driver);
@@ -177,6 +177,45 @@ TEST_F(CompilerDriverTest, AbstractMethodErrorStub) {
   Thread::Current()->ClearException();
 }
 
+TEST_F(CompilerDriverTest, CompiledMethodsAndClassesByDexFile) {
+  jobject class_loader;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    class_loader = LoadDex("AbstractMethod");
+  }
+  ASSERT_TRUE(class_loader != NULL);
+  CompileAll(class_loader);
+
+  const std::vector<const DexFile*>& class_path =
+      Runtime::Current()->GetCompileTimeClassPath(class_loader);
+  ASSERT_EQ(1U, class_path.size());
+  const DexFile* dex_file = class_path[0];
+  size_t num_compiled_methods = 0;
+  for (size_t i = 0; i < dex_file->NumClassDefs(); ++i) {
+    EXPECT_TRUE(compiler_driver_->GetCompiledClass(ClassReference(dex_file, i)) != NULL);
+    const byte* class_data = dex_file->GetClassData(dex_file->GetClassDef(i));
+    if (class_data == NULL) {
+      continue;
+    }
+    ClassDataItemIterator it(*dex_file, class_data);
+    while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+      it.Next();
+    }
+    for (; it.HasNext(); it.Next()) {
+      if (it.GetMethodCodeItem() == NULL) {
+        continue;
+      }
+      CompiledMethod* compiled_method =
+          compiler_driver_->GetCompiledMethod(MethodReference(dex_file, it.GetMemberIndex()));
+      EXPECT_TRUE(compiled_method != NULL) << PrettyMethod(it.GetMemberIndex(), *dex_file);
+      ++num_compiled_methods;
+    }
+  }
+  EXPECT_NE(0U, num_compiled_methods);
+  // Nothing was recorded for a dex file that was not compiled.
+  EXPECT_TRUE(compiler_driver_->GetCompiledClass(ClassReference(java_lang_dex_file_, 0)) == NULL);
+}
+
 // TODO: need check-cast test (when stub complete & we can throw/catch
 
 }  // namespace art
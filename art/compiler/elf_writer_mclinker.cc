@@ -16,6 +16,10 @@
 
 #include "elf_writer_mclinker.h"
 
+#include <sys/mman.h>
+
+#include <set>
+
 #include <llvm/Support/ELF.h>
 #include <llvm/Support/TargetSelect.h>
 
@@ -31,16 +35,20 @@
 
 #include "base/unix_file/fd_file.h"
 #include "class_linker.h"
+#include "compiler.h"
 #include "dex_method_iterator.h"
 #include "driver/compiler_driver.h"
 #include "elf_file.h"
 #include "globals.h"
+#include "handle_scope-inl.h"
+#include "mem_map.h"
 #include "mirror/art_method.h"
 #include "mirror/art_method-inl.h"
+#include "mirror/dex_cache.h"
 #include "mirror/object-inl.h"
 #include "oat_writer.h"
 #include "scoped_thread_state_change.h"
-#include "vector_output_stream.h"
+#include "thread_pool.h"
 
 namespace art {
 
@@ -65,14 +73,17 @@ bool ElfWriterMclinker::Write(OatWriter* oat_writer,
                               const std::vector<const DexFile*>& dex_files,
                               const std::string& android_root,
                               bool is_host) {
-  std::vector<uint8_t> oat_contents;
-  oat_contents.reserve(oat_writer->GetSize());
-  VectorOutputStream output_stream("oat contents", oat_contents);
-  CHECK(oat_writer->Write(&output_stream));
-  CHECK_EQ(oat_writer->GetSize(), oat_contents.size());
+  // The linker only needs the size and the layout of the oat contents, so it is given a read-only
+  // anonymous mapping of that size. Its untouched pages all share the zero page. The real contents
+  // are streamed into the output file once the linked layout is known.
+  std::string error_msg;
+  UniquePtr<MemMap> oat_placeholder(MemMap::MapAnonymous("oat contents placeholder", NULL,
+                                                         oat_writer->GetSize(), PROT_READ, false,
+                                                         &error_msg));
+  CHECK(oat_placeholder.get() != NULL) << error_msg;
 
   Init();
-  AddOatInput(oat_contents);
+  AddOatInput(*oat_writer, oat_placeholder->Begin());
   if (kUsePortableCompiler) {
     AddMethodInputs(dex_files);
     AddRuntimeInputs(android_root, is_host);
@@ -80,7 +91,10 @@ bool ElfWriterMclinker::Write(OatWriter* oat_writer,
   if (!Link()) {
     return false;
   }
-  oat_contents.clear();
+  oat_placeholder.reset();
+  if (!WriteOatContents(oat_writer)) {
+    return false;
+  }
   if (kUsePortableCompiler) {
     FixupOatMethodOffsets(dex_files);
   }
@@ -156,16 +170,12 @@ void ElfWriterMclinker::Init() {
   linker_->emulate(*linker_script_.get(), *linker_config_.get());
 }
 
-void ElfWriterMclinker::AddOatInput(std::vector<uint8_t>& oat_contents) {
+void ElfWriterMclinker::AddOatInput(const OatWriter& oat_writer, byte* oat_placeholder) {
   // Add an artificial memory input. Based on LinkerTest.
-  std::string error_msg;
-  UniquePtr<OatFile> oat_file(OatFile::OpenMemory(oat_contents, elf_file_->GetPath(), &error_msg));
-  CHECK(oat_file.get() != NULL) << elf_file_->GetPath() << ": " << error_msg;
-
-  const char* oat_data_start = reinterpret_cast<const char*>(&oat_file->GetOatHeader());
-  const size_t oat_data_length = oat_file->GetOatHeader().GetExecutableOffset();
-  const char* oat_code_start = oat_data_start + oat_data_length;
-  const size_t oat_code_length = oat_file->Size() - oat_data_length;
+  const size_t oat_size = oat_writer.GetSize();
+  const size_t oat_data_length = oat_writer.GetOatHeader().GetExecutableOffset();
+  const size_t oat_code_length = oat_size - oat_data_length;
+  CHECK_LT(oat_data_length, oat_size);
 
   // TODO: ownership of oat_input?
   oat_input_ = ir_builder_->CreateInput("oat contents",
@@ -186,7 +196,6 @@ void ElfWriterMclinker::AddOatInput(std::vector<uint8_t>& oat_contents) {
   // linker script like functionality to guarantee references
   // between sections maintain relative position which isn't
   // possible right now with the mclinker APIs.
-  CHECK(oat_code_start != NULL);
 
   // we need to ensure that oatdata is page aligned so when we
   // fixup the segment load addresses, they remain page aligned.
@@ -203,9 +212,7 @@ void ElfWriterMclinker::AddOatInput(std::vector<uint8_t>& oat_contents) {
   mcld::SectionData* text_sectiondata = ir_builder_->CreateSectionData(*text_section);
   CHECK(text_sectiondata != NULL);
 
-  // TODO: why does IRBuilder::CreateRegion take a non-const pointer?
-  mcld::Fragment* text_fragment = ir_builder_->CreateRegion(const_cast<char*>(oat_data_start),
-                                                            oat_file->Size());
+  mcld::Fragment* text_fragment = ir_builder_->CreateRegion(oat_placeholder, oat_size);
   CHECK(text_fragment != NULL);
   ir_builder_->AppendFragment(*text_fragment, *text_sectiondata);
 
@@ -241,13 +248,28 @@ void ElfWriterMclinker::AddOatInput(std::vector<uint8_t>& oat_contents) {
 void ElfWriterMclinker::AddMethodInputs(const std::vector<const DexFile*>& dex_files) {
   DCHECK(oat_input_ != NULL);
 
+  // With a whole program module, the code of the methods it holds comes from the objects of its
+  // partitions. Their symbols are found in the linked file like those of the method objects.
+  std::vector<std::string> whole_program_objects;
+  std::set<std::string> whole_program_symbols;
+  if (compiler_driver_->GetCompiler()->GetWholeProgramObjects(*compiler_driver_,
+                                                              &whole_program_objects,
+                                                              &whole_program_symbols)) {
+    for (const std::string& object : whole_program_objects) {
+      // TODO: ownership of object_input?
+      mcld::Input* object_input = ir_builder_->ReadInput(object, object);
+      CHECK(object_input != NULL) << object;
+    }
+  }
+
   DexMethodIterator it(dex_files);
   while (it.HasNext()) {
     const DexFile& dex_file = it.GetDexFile();
     uint32_t method_idx = it.GetMemberIndex();
     const CompiledMethod* compiled_method =
       compiler_driver_->GetCompiledMethod(MethodReference(&dex_file, method_idx));
-    if (compiled_method != NULL) {
+    if (compiled_method != NULL &&
+        whole_program_symbols.find(compiled_method->GetSymbol()) == whole_program_symbols.end()) {
       AddCompiledCodeInput(*compiled_method);
     }
     it.Next();
@@ -266,12 +288,12 @@ void ElfWriterMclinker::AddCompiledCodeInput(const CompiledCode& compiled_code)
   added_symbols_.Put(&symbol, &symbol);
 
   // Add input to supply code for symbol
-  const std::vector<uint8_t>* code = compiled_code.GetPortableCode();
+  // The code may be in the spill file of the driver, mclinker reads it from there.
   // TODO: ownership of code_input?
   // TODO: why does IRBuilder::ReadInput take a non-const pointer?
-  mcld::Input* code_input = ir_builder_->ReadInput(symbol,
-                                                   const_cast<uint8_t*>(&(*code)[0]),
-                                                   code->size());
+  mcld::Input* code_input =
+      ir_builder_->ReadInput(symbol, const_cast<uint8_t*>(compiled_code.GetPortableCodeData()),
+                             compiled_code.GetPortableCodeSize());
   CHECK(code_input != NULL);
 }
 
@@ -345,69 +367,241 @@ bool ElfWriterMclinker::Link() {
   return true;
 }
 
-void ElfWriterMclinker::FixupOatMethodOffsets(const std::vector<const DexFile*>& dex_files) {
-  std::string error_msg;
-  UniquePtr<ElfFile> elf_file(ElfFile::Open(elf_file_, true, false, &error_msg));
-  CHECK(elf_file.get() != NULL) << elf_file_->GetPath() << ": " << error_msg;
+// Returns the file offset of the loaded address, or -1 if no segment contains it.
+static off_t GetFileOffsetOfAddress(const ElfFile& elf_file, Elf32_Addr address) {
+  for (Elf32_Word i = 0; i < elf_file.GetProgramHeaderNum(); i++) {
+    const Elf32_Phdr& program_header = elf_file.GetProgramHeader(i);
+    if (program_header.p_type == PT_LOAD &&
+        program_header.p_vaddr <= address &&
+        address - program_header.p_vaddr < program_header.p_filesz) {
+      return program_header.p_offset + (address - program_header.p_vaddr);
+    }
+  }
+  return -1;
+}
 
-  uint32_t oatdata_address = GetOatDataAddress(elf_file.get());
-  DexMethodIterator it(dex_files);
-  while (it.HasNext()) {
-    const DexFile& dex_file = it.GetDexFile();
-    uint32_t method_idx = it.GetMemberIndex();
-    InvokeType invoke_type = it.GetInvokeType();
-    mirror::ArtMethod* method = NULL;
-    if (compiler_driver_->IsImage()) {
-      ClassLinker* linker = Runtime::Current()->GetClassLinker();
-      // Unchecked as we hold mutator_lock_ on entry.
-      ScopedObjectAccessUnchecked soa(Thread::Current());
-      StackHandleScope<2> hs(soa.Self());
-      Handle<mirror::DexCache> dex_cache(hs.NewHandle(linker->FindDexCache(dex_file)));
-      auto class_loader(hs.NewHandle<mirror::ClassLoader>(nullptr));
-      method = linker->ResolveMethod(dex_file, method_idx, dex_cache, class_loader, NULL, invoke_type);
-      CHECK(method != NULL);
+bool ElfWriterMclinker::WriteOatContents(OatWriter* oat_writer) {
+  off_t oat_data_offset;
+  {
+    std::string error_msg;
+    UniquePtr<ElfFile> elf_file(ElfFile::Open(elf_file_, false, false, &error_msg));
+    if (elf_file.get() == NULL) {
+      LOG(ERROR) << "Failed to reopen " << elf_file_->GetPath() << ": " << error_msg;
+      return false;
     }
-    const CompiledMethod* compiled_method =
-      compiler_driver_->GetCompiledMethod(MethodReference(&dex_file, method_idx));
-    if (compiled_method != NULL) {
-      uint32_t offset = FixupCompiledCodeOffset(*elf_file.get(), oatdata_address, *compiled_method);
+    oat_data_offset = GetFileOffsetOfAddress(*elf_file.get(), GetOatDataAddress(elf_file.get()));
+    if (oat_data_offset == -1 ||
+        static_cast<size_t>(oat_data_offset) + oat_writer->GetSize() > elf_file->Size()) {
+      LOG(ERROR) << "No room for oatdata in " << elf_file_->GetPath();
+      return false;
+    }
+  }
+
+  // Overwrite the placeholder that mclinker emitted with the oat contents.
+  if (oat_data_offset != lseek(elf_file_->Fd(), oat_data_offset, SEEK_SET)) {
+    PLOG(ERROR) << "Failed to seek to oatdata offset " << oat_data_offset
+                << " for " << elf_file_->GetPath();
+    return false;
+  }
+  if (!oat_writer->Write(elf_file_)) {
+    LOG(ERROR) << "Failed to write oatdata for " << elf_file_->GetPath();
+    return false;
+  }
+  return true;
+}
+
+// A method of the dex files and the index of its compiled code, if it has any.
+struct PortableMethod {
+  static constexpr size_t kNoCode = static_cast<size_t>(-1);
+
+  const DexFile* dex_file;
+  uint32_t method_idx;
+  InvokeType invoke_type;
+  size_t code_index;
+};
+
+// Open addressing index of the symbols of the compiled code. The symbol table of the linked file is
+// walked once and each of its names is probed here, instead of copying all names into a map and
+// looking up every method.
+class CompiledCodeSymbolIndex {
+ public:
+  explicit CompiledCodeSymbolIndex(const std::vector<const CompiledCode*>& compiled_code)
+      : compiled_code_(compiled_code),
+        slots_(RoundUpToPowerOfTwo(2 * compiled_code.size() + 1), 0u) {
+    for (size_t i = 0; i != compiled_code_.size(); ++i) {
+      size_t slot = Hash(compiled_code_[i]->GetSymbol().c_str());
+      while (slots_[slot & Mask()] != 0u) {
+        ++slot;
+      }
+      slots_[slot & Mask()] = i + 1;
+    }
+  }
+
+  // Returns the index of the compiled code with the symbol name or PortableMethod::kNoCode.
+  size_t Find(const char* name) const {
+    for (size_t slot = Hash(name); slots_[slot & Mask()] != 0u; ++slot) {
+      size_t index = slots_[slot & Mask()] - 1;
+      if (compiled_code_[index]->GetSymbol() == name) {
+        return index;
+      }
+    }
+    return PortableMethod::kNoCode;
+  }
+
+ private:
+  size_t Mask() const {
+    return slots_.size() - 1;
+  }
+
+  // FNV-1a.
+  static size_t Hash(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (const char* c = name; *c != '\0'; ++c) {
+      hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+    }
+    return hash;
+  }
+
+  const std::vector<const CompiledCode*>& compiled_code_;
+  // Index + 1 of the compiled code, 0 for an empty slot.
+  std::vector<size_t> slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompiledCodeSymbolIndex);
+};
+
+// Resolves a range of the methods of an image and sets their portable code offsets.
+class ResolvePortableMethodsTask : public Task {
+ public:
+  ResolvePortableMethodsTask(const std::vector<PortableMethod>* methods,
+                             const std::vector<uint32_t>* code_offsets, size_t begin, size_t end)
+      : methods_(methods), code_offsets_(code_offsets), begin_(begin), end_(end) {
+  }
+
+  void Run(Thread* self) {
+    ScopedObjectAccess soa(self);
+    ClassLinker* linker = Runtime::Current()->GetClassLinker();
+    StackHandleScope<2> hs(soa.Self());
+    Handle<mirror::DexCache> dex_cache(hs.NewHandle<mirror::DexCache>(nullptr));
+    Handle<mirror::ClassLoader> class_loader(hs.NewHandle<mirror::ClassLoader>(nullptr));
+    const DexFile* dex_file = nullptr;
+    for (size_t i = begin_; i != end_; ++i) {
+      const PortableMethod& portable_method = (*methods_)[i];
+      // The methods are in dex file order, so a range rarely needs more than one dex cache.
+      if (portable_method.dex_file != dex_file) {
+        dex_file = portable_method.dex_file;
+        dex_cache.Assign(linker->FindDexCache(*dex_file));
+      }
+      mirror::ArtMethod* method = linker->ResolveMethod(*dex_file, portable_method.method_idx,
+                                                        dex_cache, class_loader, NULL,
+                                                        portable_method.invoke_type);
+      CHECK(method != NULL);
       // Don't overwrite static method trampoline
-      if (method != NULL &&
+      if (portable_method.code_index != PortableMethod::kNoCode &&
           (!method->IsStatic() ||
            method->IsConstructor() ||
            method->GetDeclaringClass()->IsInitialized())) {
-        method->SetPortableOatCodeOffset(offset);
+        method->SetPortableOatCodeOffset((*code_offsets_)[portable_method.code_index]);
       }
     }
-    it.Next();
   }
-  symbol_to_compiled_code_offset_.clear();
-}
 
-uint32_t ElfWriterMclinker::FixupCompiledCodeOffset(ElfFile& elf_file,
-                                                    Elf32_Addr oatdata_address,
-                                                    const CompiledCode& compiled_code) {
-  const std::string& symbol = compiled_code.GetSymbol();
-  SafeMap<const std::string*, uint32_t>::iterator it = symbol_to_compiled_code_offset_.find(&symbol);
-  if (it != symbol_to_compiled_code_offset_.end()) {
-    return it->second;
-  }
-
-  Elf32_Addr compiled_code_address = elf_file.FindSymbolAddress(SHT_SYMTAB,
-                                                                symbol,
-                                                                true);
-  CHECK_NE(0U, compiled_code_address) << symbol;
-  CHECK_LT(oatdata_address, compiled_code_address) << symbol;
-  uint32_t compiled_code_offset = compiled_code_address - oatdata_address;
-  symbol_to_compiled_code_offset_.Put(&symbol, compiled_code_offset);
-
-  const std::vector<uint32_t>& offsets = compiled_code.GetOatdataOffsetsToCompliledCodeOffset();
-  for (uint32_t i = 0; i < offsets.size(); i++) {
-    uint32_t oatdata_offset = oatdata_address + offsets[i];
-    uint32_t* addr = reinterpret_cast<uint32_t*>(elf_file.Begin() + oatdata_offset);
-    *addr = compiled_code_offset;
-  }
-  return compiled_code_offset;
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  const std::vector<PortableMethod>* const methods_;
+  const std::vector<uint32_t>* const code_offsets_;
+  const size_t begin_;
+  const size_t end_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResolvePortableMethodsTask);
+};
+
+void ElfWriterMclinker::FixupOatMethodOffsets(const std::vector<const DexFile*>& dex_files) {
+  std::string error_msg;
+  UniquePtr<ElfFile> elf_file(ElfFile::Open(elf_file_, true, false, &error_msg));
+  CHECK(elf_file.get() != NULL) << elf_file_->GetPath() << ": " << error_msg;
+
+  // Collect the methods, and the compiled code once per symbol since code can be shared.
+  std::vector<PortableMethod> methods;
+  std::vector<const CompiledCode*> compiled_code;
+  SafeMap<const std::string*, size_t> symbol_to_code_index;
+  for (DexMethodIterator it(dex_files); it.HasNext(); it.Next()) {
+    PortableMethod portable_method = { &it.GetDexFile(), it.GetMemberIndex(), it.GetInvokeType(),
+                                       PortableMethod::kNoCode };
+    const CompiledMethod* compiled_method = compiler_driver_->GetCompiledMethod(
+        MethodReference(portable_method.dex_file, portable_method.method_idx));
+    if (compiled_method != NULL) {
+      const std::string* symbol = &compiled_method->GetSymbol();
+      SafeMap<const std::string*, size_t>::iterator code_it = symbol_to_code_index.find(symbol);
+      if (code_it == symbol_to_code_index.end()) {
+        code_it = symbol_to_code_index.Put(symbol, compiled_code.size());
+        compiled_code.push_back(compiled_method);
+      }
+      portable_method.code_index = code_it->second;
+    }
+    if (compiler_driver_->IsImage() || compiled_method != NULL) {
+      methods.push_back(portable_method);
+    }
+  }
+
+  // Find the offsets of the code from oatdata in one pass over the symbol table.
+  uint32_t oatdata_address = GetOatDataAddress(elf_file.get());
+  std::vector<uint32_t> code_offsets(compiled_code.size(), 0u);
+  {
+    CompiledCodeSymbolIndex index(compiled_code);
+    Elf32_Shdr* symbol_section = elf_file->FindSectionByType(SHT_SYMTAB);
+    CHECK(symbol_section != NULL) << elf_file_->GetPath();
+    Elf32_Shdr& string_section = elf_file->GetSectionHeader(symbol_section->sh_link);
+    for (uint32_t i = 0; i < elf_file->GetSymbolNum(*symbol_section); i++) {
+      Elf32_Sym& symbol = elf_file->GetSymbol(SHT_SYMTAB, i);
+      if (ELF32_ST_TYPE(symbol.st_info) == STT_NOTYPE) {
+        continue;
+      }
+      const char* name = elf_file->GetString(string_section, symbol.st_name);
+      size_t code_index = (name != NULL) ? index.Find(name) : PortableMethod::kNoCode;
+      if (code_index == PortableMethod::kNoCode) {
+        continue;
+      }
+      CHECK_LT(oatdata_address, symbol.st_value) << name;
+      uint32_t code_offset = symbol.st_value - oatdata_address;
+      // Duplicates have the same value.
+      CHECK(code_offsets[code_index] == 0u || code_offsets[code_index] == code_offset) << name;
+      code_offsets[code_index] = code_offset;
+    }
+  }
+
+  // Patch the code offsets into the oat contents.
+  off_t oat_data_offset = GetFileOffsetOfAddress(*elf_file.get(), oatdata_address);
+  CHECK_NE(oat_data_offset, -1) << elf_file_->GetPath();
+  for (size_t i = 0; i != compiled_code.size(); ++i) {
+    CHECK_NE(0U, code_offsets[i]) << compiled_code[i]->GetSymbol();
+    const std::vector<uint32_t>& offsets =
+        compiled_code[i]->GetOatdataOffsetsToCompliledCodeOffset();
+    for (uint32_t offset : offsets) {
+      uint32_t* addr = reinterpret_cast<uint32_t*>(elf_file->Begin() + oat_data_offset + offset);
+      *addr = code_offsets[i];
+    }
+  }
+
+  if (!compiler_driver_->IsImage()) {
+    return;
+  }
+  // Resolve the methods of the image and set their code offsets in parallel. The mutator lock is
+  // released while the workers attach, each task takes it again.
+  Thread* self = Thread::Current();
+  ScopedThreadStateChange tsc(self, kNative);
+  const size_t thread_count = std::max<size_t>(compiler_driver_->GetThreadCount(), 1U);
+  const size_t num_tasks = std::min(methods.size(), thread_count * 4);
+  ThreadPool thread_pool("Portable method fixup thread pool", thread_count - 1);
+  for (size_t task = 0; task != num_tasks; ++task) {
+    size_t begin = methods.size() * task / num_tasks;
+    size_t end = methods.size() * (task + 1) / num_tasks;
+    thread_pool.AddTask(self, new ResolvePortableMethodsTask(&methods, &code_offsets, begin, end));
+  }
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, true, false);
 }
 
 }  // namespace art
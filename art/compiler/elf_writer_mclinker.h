@@ -20,6 +20,7 @@
 #include "elf_writer.h"
 
 #include "UniquePtr.h"
+#include "globals.h"
 #include "safe_map.h"
 
 namespace mcld {
@@ -61,16 +62,17 @@ class ElfWriterMclinker FINAL : public ElfWriter {
   ~ElfWriterMclinker();
 
   void Init();
-  void AddOatInput(std::vector<uint8_t>& oat_contents);
+  void AddOatInput(const OatWriter& oat_writer, byte* oat_placeholder);
   void AddMethodInputs(const std::vector<const DexFile*>& dex_files);
   void AddCompiledCodeInput(const CompiledCode& compiled_code);
   void AddRuntimeInputs(const std::string& android_root, bool is_host);
   bool Link();
+  // Writes the oat contents over the placeholder at oatdata in the linked output file.
+  bool WriteOatContents(OatWriter* oat_writer);
+  // Patches the offsets of the linked code into the oat contents, and for images into the
+  // resolved methods.
   void FixupOatMethodOffsets(const std::vector<const DexFile*>& dex_files)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  uint32_t FixupCompiledCodeOffset(ElfFile& elf_file,
-                                   uint32_t oatdata_address,
-                                   const CompiledCode& compiled_code);
 
   // Setup by Init()
   UniquePtr<mcld::LinkerConfig> linker_config_;
@@ -87,10 +89,6 @@ class ElfWriterMclinker FINAL : public ElfWriter {
   // set of symbols for already added mcld::Inputs
   SafeMap<const std::string*, const std::string*> added_symbols_;
 
-  // Setup by FixupCompiledCodeOffset
-  // map of symbol names to oatdata offset
-  SafeMap<const std::string*, uint32_t> symbol_to_compiled_code_offset_;
-
   DISALLOW_IMPLICIT_CONSTRUCTORS(ElfWriterMclinker);
 };
 
@@ -18,10 +18,8 @@
 
 #include "base/logging.h"
 #include "base/unix_file/fd_file.h"
-#include "buffered_output_stream.h"
 #include "driver/compiler_driver.h"
 #include "elf_utils.h"
-#include "file_output_stream.h"
 #include "globals.h"
 #include "oat.h"
 #include "oat_writer.h"
@@ -742,9 +740,8 @@ bool ElfWriterQuick::Write(OatWriter* oat_writer,
                 << " for " << elf_file_->GetPath();
     return false;
   }
-  BufferedOutputStream output_stream(new FileOutputStream(elf_file_));
-  if (!oat_writer->Write(&output_stream)) {
-    PLOG(ERROR) << "Failed to write .rodata and .text for " << elf_file_->GetPath();
+  if (!oat_writer->Write(elf_file_)) {
+    LOG(ERROR) << "Failed to write .rodata and .text for " << elf_file_->GetPath();
     return false;
   }
 
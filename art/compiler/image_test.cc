@@ -16,6 +16,10 @@
 
 #include "image.h"
 
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <set>
 #include <string>
 #include <vector>
 
@@ -25,7 +29,12 @@
 #include "compiler/oat_writer.h"
 #include "gc/space/image_space.h"
 #include "lock_word.h"
+#include "mirror/art_field-inl.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/dex_cache.h"
 #include "mirror/object-inl.h"
+#include "mirror/object_array-inl.h"
 #include "signal_catcher.h"
 #include "UniquePtr.h"
 #include "utils.h"
@@ -39,54 +48,119 @@ class ImageTest : public CommonCompilerTest {
     ReserveImageSpace();
     CommonCompilerTest::SetUp();
   }
+
+  // Compiles the boot class path to tmp_elf and writes its image to tmp_image.
+  void WriteImage(ScratchFile* tmp_elf, ScratchFile* tmp_image, bool compress_image,
+                  size_t thread_count,
+                  const std::vector<std::string>& startup_classes = std::vector<std::string>());
+
+  void ReadImage(const ScratchFile& tmp_image, std::vector<uint8_t>* contents);
+
+  // Replaces the runtime with a fresh one, writing an image leaves the heap unfit for another.
+  void ResetRuntime();
+
+  // Replaces the compiler's runtime with one booted from tmp_image.
+  void BootFromImage(const ScratchFile& tmp_image);
+
+  void TestWriteRead(bool compress_image);
 };
 
-TEST_F(ImageTest, WriteRead) {
-  // Create a root tmp file, to be the base of the .art and .oat temporary files.
-  ScratchFile tmp;
-  ScratchFile tmp_elf(tmp, "oat");
+void ImageTest::WriteImage(ScratchFile* tmp_elf, ScratchFile* tmp_image, bool compress_image,
+                           size_t thread_count,
+                           const std::vector<std::string>& startup_classes) {
   {
-    {
-      jobject class_loader = NULL;
-      ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
-      TimingLogger timings("ImageTest::WriteRead", false, false);
-      timings.StartSplit("CompileAll");
-      if (kUsePortableCompiler) {
-        // TODO: we disable this for portable so the test executes in a reasonable amount of time.
-        //       We shouldn't need to do this.
-        compiler_options_->SetCompilerFilter(CompilerOptions::kInterpretOnly);
-      }
-      for (const DexFile* dex_file : class_linker->GetBootClassPath()) {
-        dex_file->EnableWrite();
-      }
-      compiler_driver_->CompileAll(class_loader, class_linker->GetBootClassPath(), &timings);
-
-      ScopedObjectAccess soa(Thread::Current());
-      OatWriter oat_writer(class_linker->GetBootClassPath(),
-                           0, 0, "", compiler_driver_.get(), &timings);
-      bool success = compiler_driver_->WriteElf(GetTestAndroidRoot(),
-                                                !kIsTargetBuild,
-                                                class_linker->GetBootClassPath(),
-                                                &oat_writer,
-                                                tmp_elf.GetFile());
-      ASSERT_TRUE(success);
-      timings.EndSplit();
+    jobject class_loader = NULL;
+    ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+    TimingLogger timings("ImageTest::WriteImage", false, false);
+    timings.StartSplit("CompileAll");
+    if (kUsePortableCompiler) {
+      // TODO: we disable this for portable so the test executes in a reasonable amount of time.
+      //       We shouldn't need to do this.
+      compiler_options_->SetCompilerFilter(CompilerOptions::kInterpretOnly);
+    }
+    for (const DexFile* dex_file : class_linker->GetBootClassPath()) {
+      dex_file->EnableWrite();
     }
+    compiler_driver_->CompileAll(class_loader, class_linker->GetBootClassPath(), &timings);
+
+    ScopedObjectAccess soa(Thread::Current());
+    OatWriter oat_writer(class_linker->GetBootClassPath(),
+                         0, 0, "", compiler_driver_.get(), &timings);
+    bool success = compiler_driver_->WriteElf(GetTestAndroidRoot(),
+                                              !kIsTargetBuild,
+                                              class_linker->GetBootClassPath(),
+                                              &oat_writer,
+                                              tmp_elf->GetFile());
+    ASSERT_TRUE(success);
+    timings.EndSplit();
   }
   // Workound bug that mcld::Linker::emit closes tmp_elf by reopening as tmp_oat.
-  UniquePtr<File> tmp_oat(OS::OpenFileReadWrite(tmp_elf.GetFilename().c_str()));
+  UniquePtr<File> tmp_oat(OS::OpenFileReadWrite(tmp_elf->GetFilename().c_str()));
   ASSERT_TRUE(tmp_oat.get() != NULL);
 
+  ImageWriter writer(*compiler_driver_.get());
+  writer.SetCompressImage(compress_image);
+  writer.SetThreadCount(thread_count);
+  writer.SetStartupClasses(startup_classes);
+  bool success_image = writer.Write(tmp_image->GetFilename(), ART_BASE_ADDRESS,
+                                    tmp_oat->GetPath(), tmp_oat->GetPath());
+  ASSERT_TRUE(success_image);
+  bool success_fixup = ElfFixup::Fixup(tmp_oat.get(), writer.GetOatDataBegin());
+  ASSERT_TRUE(success_fixup);
+}
+
+void ImageTest::ReadImage(const ScratchFile& tmp_image, std::vector<uint8_t>* contents) {
+  UniquePtr<File> file(OS::OpenFileForReading(tmp_image.GetFilename().c_str()));
+  ASSERT_TRUE(file.get() != NULL);
+  contents->resize(file->GetLength());
+  ASSERT_TRUE(file->ReadFully(&(*contents)[0], contents->size()));
+}
+
+void ImageTest::ResetRuntime() {
+  ASSERT_NO_FATAL_FAILURE(CommonCompilerTest::TearDown());
+  runtime_.reset();
+  java_lang_dex_file_ = NULL;
+  // SetUp appends to these.
+  dalvik_cache_.clear();
+  boot_class_path_.clear();
+  CommonCompilerTest::SetUp();
+}
+
+void ImageTest::BootFromImage(const ScratchFile& tmp_image) {
+  // Need to delete the compiler since it has worker threads which are attached to runtime.
+  compiler_driver_.reset();
+
+  // Tear down old runtime before making a new one, clearing out misc state.
+  runtime_.reset();
+  java_lang_dex_file_ = NULL;
+
+  // Remove the reservation of the memory for use to load the image.
+  UnreserveImageSpace();
+
+  Runtime::Options options;
+  std::string image("-Ximage:");
+  image.append(tmp_image.GetFilename());
+  options.push_back(std::make_pair(image.c_str(), reinterpret_cast<void*>(NULL)));
+
+  if (!Runtime::Create(options, false)) {
+    LOG(FATAL) << "Failed to create runtime";
+    return;
+  }
+  runtime_.reset(Runtime::Current());
+  // Runtime::Create acquired the mutator_lock_ that is normally given away when we Runtime::Start,
+  // give it away now so that callers can switch to a more managable ScopedObjectAccess.
+  Thread::Current()->TransitionFromRunnableToSuspended(kNative);
+  class_linker_ = runtime_->GetClassLinker();
+}
+
+void ImageTest::TestWriteRead(bool compress_image) {
+  // Create a root tmp file, to be the base of the .art and .oat temporary files.
+  ScratchFile tmp;
+  ScratchFile tmp_elf(tmp, "oat");
   ScratchFile tmp_image(tmp, "art");
   const uintptr_t requested_image_base = ART_BASE_ADDRESS;
-  {
-    ImageWriter writer(*compiler_driver_.get());
-    bool success_image = writer.Write(tmp_image.GetFilename(), requested_image_base,
-                                      tmp_oat->GetPath(), tmp_oat->GetPath());
-    ASSERT_TRUE(success_image);
-    bool success_fixup = ElfFixup::Fixup(tmp_oat.get(), writer.GetOatDataBegin());
-    ASSERT_TRUE(success_fixup);
-  }
+  ASSERT_NO_FATAL_FAILURE(WriteImage(&tmp_elf, &tmp_image, compress_image,
+                                     compiler_driver_->GetThreadCount()));
 
   {
     UniquePtr<File> file(OS::OpenFileForReading(tmp_image.GetFilename().c_str()));
@@ -94,7 +168,11 @@ TEST_F(ImageTest, WriteRead) {
     ImageHeader image_header;
     file->ReadFully(&image_header, sizeof(image_header));
     ASSERT_TRUE(image_header.IsValid());
+    ASSERT_EQ(compress_image, image_header.IsCompressed());
     ASSERT_GE(image_header.GetImageBitmapOffset(), sizeof(image_header));
+    if (compress_image) {
+      ASSERT_LT(static_cast<size_t>(file->GetLength()), image_header.GetImageSize());
+    }
     ASSERT_NE(0U, image_header.GetImageBitmapSize());
 
     gc::Heap* heap = Runtime::Current()->GetHeap();
@@ -109,38 +187,15 @@ TEST_F(ImageTest, WriteRead) {
   ASSERT_TRUE(compiler_driver_->GetImageClasses() != NULL);
   CompilerDriver::DescriptorSet image_classes(*compiler_driver_->GetImageClasses());
 
-  // Need to delete the compiler since it has worker threads which are attached to runtime.
-  compiler_driver_.reset();
-
-  // Tear down old runtime before making a new one, clearing out misc state.
-  runtime_.reset();
-  java_lang_dex_file_ = NULL;
-
   std::string error_msg;
   UniquePtr<const DexFile> dex(DexFile::Open(GetLibCoreDexFileName().c_str(),
                                              GetLibCoreDexFileName().c_str(),
                                              &error_msg));
   ASSERT_TRUE(dex.get() != nullptr) << error_msg;
 
-  // Remove the reservation of the memory for use to load the image.
-  UnreserveImageSpace();
-
-  Runtime::Options options;
-  std::string image("-Ximage:");
-  image.append(tmp_image.GetFilename());
-  options.push_back(std::make_pair(image.c_str(), reinterpret_cast<void*>(NULL)));
-
-  if (!Runtime::Create(options, false)) {
-    LOG(FATAL) << "Failed to create runtime";
-    return;
-  }
-  runtime_.reset(Runtime::Current());
-  // Runtime::Create acquired the mutator_lock_ that is normally given away when we Runtime::Start,
-  // give it away now and then switch to a more managable ScopedObjectAccess.
-  Thread::Current()->TransitionFromRunnableToSuspended(kNative);
+  BootFromImage(tmp_image);
   ScopedObjectAccess soa(Thread::Current());
   ASSERT_TRUE(runtime_.get() != NULL);
-  class_linker_ = runtime_->GetClassLinker();
 
   gc::Heap* heap = Runtime::Current()->GetHeap();
   ASSERT_TRUE(heap->HasImageSpace());
@@ -168,6 +223,313 @@ TEST_F(ImageTest, WriteRead) {
   }
 }
 
+TEST_F(ImageTest, WriteRead) {
+  TestWriteRead(false);
+}
+
+TEST_F(ImageTest, WriteReadCompressed) {
+  TestWriteRead(true);
+}
+
+// Adds the size of the object to *size, as ImageWriter lays it out, unless it is already counted.
+static void CountObject(mirror::Object* object, std::set<mirror::Object*>* counted, size_t* size)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (object != nullptr && counted->insert(object).second) {
+    *size += RoundUp(object->SizeOf(), 8);
+  }
+}
+
+// Counts the referents of obj as ImageWriter::WalkStartupReferents places them after it.
+static void CountStartupReferents(mirror::Object* obj,
+                                  const std::set<mirror::Object*>& dirty_objects,
+                                  std::set<mirror::Object*>* counted, size_t* size)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  std::vector<mirror::Object*> referents;
+  for (mirror::Class* klass = obj->GetClass(); klass != nullptr; klass = klass->GetSuperClass()) {
+    for (size_t i = 0; i < klass->NumReferenceInstanceFields(); ++i) {
+      referents.push_back(
+          obj->GetFieldObject<mirror::Object>(klass->GetInstanceField(i)->GetOffset()));
+    }
+  }
+  if (obj->IsObjectArray()) {
+    mirror::ObjectArray<mirror::Object>* elements = obj->AsObjectArray<mirror::Object>();
+    for (int32_t i = 0; i < elements->GetLength(); ++i) {
+      referents.push_back(elements->Get(i));
+    }
+  }
+  for (mirror::Object* referent : referents) {
+    if (referent == nullptr || referent->IsClass() ||
+        dirty_objects.find(referent) != dirty_objects.end() ||
+        counted->find(referent) != counted->end()) {
+      continue;
+    }
+    CountObject(referent, counted, size);
+    CountStartupReferents(referent, dirty_objects, counted, size);
+  }
+}
+
+static bool IsDirtyClass(mirror::Class* klass) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  return !klass->IsInitialized() || klass->NumReferenceStaticFields() != 0;
+}
+
+TEST_F(ImageTest, StartupClassesLeadTheImage) {
+  std::vector<std::string> startup_classes;
+  startup_classes.push_back("Ljava/lang/Object;");
+  startup_classes.push_back("Ljava/lang/String;");
+  startup_classes.push_back("Ljava/lang/Class;");
+  startup_classes.push_back("Ljava/lang/Throwable;");
+  // Classes that the image does not have are skipped.
+  startup_classes.push_back("Lno/such/Class;");
+
+  ScratchFile tmp;
+  ScratchFile tmp_elf(tmp, "oat");
+  ScratchFile tmp_image(tmp, "art");
+  ASSERT_NO_FATAL_FAILURE(WriteImage(&tmp_elf, &tmp_image, false,
+                                     compiler_driver_->GetThreadCount(), startup_classes));
+  BootFromImage(tmp_image);
+  ScopedObjectAccess soa(Thread::Current());
+  ASSERT_TRUE(runtime_.get() != NULL);
+
+  gc::space::ImageSpace* image_space = runtime_->GetHeap()->GetImageSpace();
+  ASSERT_TRUE(image_space != nullptr);
+  byte* image_begin = image_space->Begin();
+
+  std::vector<mirror::Class*> clean_classes;
+  std::vector<mirror::Class*> dirty_classes;
+  for (const std::string& descriptor : startup_classes) {
+    mirror::Class* klass = class_linker_->LookupClass(descriptor.c_str(), NULL);
+    if (descriptor == "Lno/such/Class;") {
+      EXPECT_TRUE(klass == nullptr);
+      continue;
+    }
+    ASSERT_TRUE(klass != nullptr) << descriptor;
+    ASSERT_TRUE(image_space->Contains(klass)) << descriptor;
+    (IsDirtyClass(klass) ? dirty_classes : clean_classes).push_back(klass);
+  }
+  std::vector<mirror::DexCache*> dex_caches;
+  for (const DexFile* dex_file : class_linker_->GetBootClassPath()) {
+    dex_caches.push_back(class_linker_->FindDexCache(*dex_file));
+  }
+  ASSERT_FALSE(dex_caches.empty());
+
+  std::set<mirror::Object*> dirty_objects;
+  for (mirror::DexCache* dex_cache : dex_caches) {
+    dirty_objects.insert(dex_cache);
+    dirty_objects.insert(dex_cache->GetStrings());
+    dirty_objects.insert(dex_cache->GetResolvedTypes());
+    dirty_objects.insert(dex_cache->GetResolvedMethods());
+    dirty_objects.insert(dex_cache->GetResolvedFields());
+  }
+
+  // Bound the leading pages by the objects the startup pass lays out: the clean startup classes
+  // and what the startup classes refer to, other than classes and the dex caches, then, from the
+  // next page, the dex caches with their arrays and the dirty startup classes.
+  std::set<mirror::Object*> counted;
+  size_t clean_size = RoundUp(sizeof(ImageHeader), 8);
+  for (mirror::Class* klass : clean_classes) {
+    CountObject(klass, &counted, &clean_size);
+  }
+  for (mirror::Class* klass : clean_classes) {
+    CountStartupReferents(klass, dirty_objects, &counted, &clean_size);
+  }
+  for (mirror::Class* klass : dirty_classes) {
+    CountStartupReferents(klass, dirty_objects, &counted, &clean_size);
+  }
+  size_t dirty_size = 0;
+  for (mirror::DexCache* dex_cache : dex_caches) {
+    CountObject(dex_cache, &counted, &dirty_size);
+    CountObject(dex_cache->GetStrings(), &counted, &dirty_size);
+    CountObject(dex_cache->GetResolvedTypes(), &counted, &dirty_size);
+    CountObject(dex_cache->GetResolvedMethods(), &counted, &dirty_size);
+    CountObject(dex_cache->GetResolvedFields(), &counted, &dirty_size);
+  }
+  for (mirror::Class* klass : dirty_classes) {
+    CountObject(klass, &counted, &dirty_size);
+  }
+  const size_t dirty_begin = RoundUp(clean_size, kPageSize);
+  const size_t leading_size = dirty_begin + dirty_size;
+  ASSERT_LT(leading_size, image_space->Size());
+
+  // The clean startup classes come first, in the order of the list, each followed by its name and
+  // its methods.
+  size_t previous_offset = 0;
+  for (size_t i = 0; i < clean_classes.size(); ++i) {
+    mirror::Class* klass = clean_classes[i];
+    size_t offset = reinterpret_cast<byte*>(klass) - image_begin;
+    EXPECT_LT(previous_offset, offset) << PrettyClass(klass);
+    EXPECT_LT(offset, clean_size) << PrettyClass(klass);
+    previous_offset = offset;
+    size_t next_offset = (i + 1 < clean_classes.size())
+        ? reinterpret_cast<byte*>(clean_classes[i + 1]) - image_begin
+        : clean_size;
+    std::vector<mirror::Object*> referents;
+    referents.push_back(klass->GetName());
+    referents.push_back(klass->GetDirectMethods());
+    referents.push_back(klass->GetVirtualMethods());
+    for (mirror::Object* referent : referents) {
+      if (referent == nullptr) {
+        continue;
+      }
+      size_t referent_offset = reinterpret_cast<byte*>(referent) - image_begin;
+      EXPECT_LT(offset, referent_offset) << PrettyClass(klass);
+      EXPECT_LT(referent_offset, next_offset) << PrettyClass(klass);
+    }
+  }
+  // The dex caches start a page of their own, after the clean objects.
+  size_t first_dex_cache_offset = reinterpret_cast<byte*>(dex_caches[0]) - image_begin;
+  EXPECT_TRUE(IsAligned<kPageSize>(first_dex_cache_offset));
+  EXPECT_LE(first_dex_cache_offset, dirty_begin);
+  for (mirror::DexCache* dex_cache : dex_caches) {
+    size_t offset = reinterpret_cast<byte*>(dex_cache) - image_begin;
+    EXPECT_LT(previous_offset, offset);
+    EXPECT_LT(offset, leading_size);
+  }
+  // Then the dirty startup classes.
+  for (mirror::Class* klass : dirty_classes) {
+    size_t offset = reinterpret_cast<byte*>(klass) - image_begin;
+    EXPECT_LT(first_dex_cache_offset, offset) << PrettyClass(klass);
+    EXPECT_LT(offset, leading_size) << PrettyClass(klass);
+  }
+}
+
+// Reads the names, methods and fields of the classes, as a runtime starting up uses them.
+static void TouchClasses(ClassLinker* class_linker, const std::vector<std::string>& descriptors)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  for (const std::string& descriptor : descriptors) {
+    mirror::Class* klass = class_linker->LookupClass(descriptor.c_str(), NULL);
+    ASSERT_TRUE(klass != nullptr) << descriptor;
+    if (klass->GetName() != nullptr) {
+      klass->GetName()->GetLength();
+    }
+    for (size_t i = 0; i < klass->NumDirectMethods(); ++i) {
+      klass->GetDirectMethod(i)->GetAccessFlags();
+    }
+    for (size_t i = 0; i < klass->NumVirtualMethods(); ++i) {
+      klass->GetVirtualMethod(i)->GetAccessFlags();
+    }
+    for (size_t i = 0; i < klass->NumStaticFields(); ++i) {
+      klass->GetStaticField(i)->GetAccessFlags();
+    }
+    for (size_t i = 0; i < klass->NumInstanceFields(); ++i) {
+      klass->GetInstanceField(i)->GetAccessFlags();
+    }
+  }
+}
+
+static uint64_t CountPageFaults() {
+  struct rusage usage;
+  CHECK_EQ(0, getrusage(RUSAGE_SELF, &usage));
+  return usage.ru_minflt + usage.ru_majflt;
+}
+
+// Not a correctness test, reports the page faults taken when a runtime booted from the image first
+// uses the startup classes, with the default layout and with the startup layout.
+TEST_F(ImageTest, StartupPageFaults) {
+  std::vector<std::string> startup_classes;
+  startup_classes.push_back("Ljava/lang/Object;");
+  startup_classes.push_back("Ljava/lang/String;");
+  startup_classes.push_back("Ljava/lang/Class;");
+  startup_classes.push_back("Ljava/lang/Thread;");
+  startup_classes.push_back("Ljava/lang/ThreadGroup;");
+  startup_classes.push_back("Ljava/lang/Throwable;");
+  startup_classes.push_back("Ljava/lang/StringBuilder;");
+  startup_classes.push_back("Ljava/util/ArrayList;");
+  startup_classes.push_back("Ljava/util/HashMap;");
+
+  ScratchFile default_tmp;
+  ScratchFile default_elf(default_tmp, "oat");
+  ScratchFile default_image(default_tmp, "art");
+  ASSERT_NO_FATAL_FAILURE(WriteImage(&default_elf, &default_image, false,
+                                     compiler_driver_->GetThreadCount()));
+  ASSERT_NO_FATAL_FAILURE(ResetRuntime());
+  ScratchFile startup_tmp;
+  ScratchFile startup_elf(startup_tmp, "oat");
+  ScratchFile startup_image(startup_tmp, "art");
+  ASSERT_NO_FATAL_FAILURE(WriteImage(&startup_elf, &startup_image, false,
+                                     compiler_driver_->GetThreadCount(), startup_classes));
+
+  const ScratchFile* images[] = { &default_image, &startup_image };
+  const char* layouts[] = { "default", "startup" };
+  for (size_t i = 0; i < arraysize(images); ++i) {
+    BootFromImage(*images[i]);
+    ScopedObjectAccess soa(Thread::Current());
+    ASSERT_TRUE(runtime_.get() != NULL);
+    uint64_t faults_before = CountPageFaults();
+    ASSERT_NO_FATAL_FAILURE(TouchClasses(class_linker_, startup_classes));
+    LOG(INFO) << "Image with the " << layouts[i] << " layout: "
+              << CountPageFaults() - faults_before << " page faults using "
+              << startup_classes.size() << " startup classes";
+  }
+}
+
+// Resident set size of the process, from the second field of /proc/self/statm.
+static size_t GetResidentBytes() {
+  std::string statm;
+  CHECK(ReadFileToString("/proc/self/statm", &statm));
+  std::vector<std::string> fields;
+  Split(statm, ' ', fields);
+  CHECK_GE(fields.size(), 2U);
+  return strtoull(fields[1].c_str(), nullptr, 10) * kPageSize;
+}
+
+// Not a correctness test, reports the file size, the time to boot a runtime from the image and
+// the resident memory once booted, for an uncompressed and a compressed image. The uncompressed
+// image is mapped from the file and only its touched pages are resident, while the compressed
+// image is decompressed into anonymous memory that stays resident.
+TEST_F(ImageTest, CompressedImageLoadTimeAndMemory) {
+  ScratchFile uncompressed_tmp;
+  ScratchFile uncompressed_elf(uncompressed_tmp, "oat");
+  ScratchFile uncompressed_image(uncompressed_tmp, "art");
+  ASSERT_NO_FATAL_FAILURE(WriteImage(&uncompressed_elf, &uncompressed_image, false,
+                                     compiler_driver_->GetThreadCount()));
+  ASSERT_NO_FATAL_FAILURE(ResetRuntime());
+  ScratchFile compressed_tmp;
+  ScratchFile compressed_elf(compressed_tmp, "oat");
+  ScratchFile compressed_image(compressed_tmp, "art");
+  ASSERT_NO_FATAL_FAILURE(WriteImage(&compressed_elf, &compressed_image, true,
+                                     compiler_driver_->GetThreadCount()));
+
+  const ScratchFile* images[] = { &uncompressed_image, &compressed_image };
+  const char* modes[] = { "uncompressed", "compressed" };
+  for (size_t i = 0; i < arraysize(images); ++i) {
+    uint64_t start_ns = NanoTime();
+    BootFromImage(*images[i]);
+    uint64_t boot_ns = NanoTime() - start_ns;
+    ASSERT_TRUE(runtime_.get() != NULL);
+    size_t image_size = runtime_->GetHeap()->GetImageSpace()->Size();
+    LOG(INFO) << "Image " << modes[i] << ": " << PrettySize(images[i]->GetFile()->GetLength())
+              << " file for " << PrettySize(image_size) << " of objects, boot in "
+              << PrettyDuration(boot_ns) << ", " << PrettySize(GetResidentBytes())
+              << " resident after boot";
+  }
+}
+
+TEST_F(ImageTest, WriteIsIndependentOfThreadCount) {
+  std::vector<uint8_t> serial_image;
+  {
+    ScratchFile tmp;
+    ScratchFile tmp_elf(tmp, "oat");
+    ScratchFile tmp_image(tmp, "art");
+    ASSERT_NO_FATAL_FAILURE(WriteImage(&tmp_elf, &tmp_image, false, 1U));
+    ASSERT_NO_FATAL_FAILURE(ReadImage(tmp_image, &serial_image));
+  }
+
+  ASSERT_NO_FATAL_FAILURE(ResetRuntime());
+
+  std::vector<uint8_t> parallel_image;
+  {
+    ScratchFile tmp;
+    ScratchFile tmp_elf(tmp, "oat");
+    ScratchFile tmp_image(tmp, "art");
+    ASSERT_NO_FATAL_FAILURE(WriteImage(&tmp_elf, &tmp_image, false, 4U));
+    ASSERT_NO_FATAL_FAILURE(ReadImage(tmp_image, &parallel_image));
+  }
+
+  ASSERT_EQ(serial_image.size(), parallel_image.size());
+  ASSERT_NE(0U, serial_image.size());
+  EXPECT_EQ(0, memcmp(&serial_image[0], &parallel_image[0], serial_image.size()));
+}
+
 TEST_F(ImageTest, ImageHeaderIsValid) {
     uint32_t image_begin = ART_BASE_ADDRESS;
     uint32_t image_size_ = 16 * KB;
@@ -188,7 +550,20 @@ TEST_F(ImageTest, ImageHeaderIsValid) {
                              oat_file_begin,
                              oat_data_begin,
                              oat_data_end,
-                             oat_file_end);
+                             oat_file_end,
+                             ImageHeader::kStorageModeUncompressed);
+    ASSERT_TRUE(image_header.IsValid());
+    ASSERT_FALSE(image_header.IsCompressed());
+
+    // The storage mode is the last field of the header.
+    uint32_t* storage_mode = reinterpret_cast<uint32_t*>(&image_header + 1) - 1;
+    *storage_mode = ImageHeader::kStorageModeZlib;
+    ASSERT_TRUE(image_header.IsValid());
+    ASSERT_TRUE(image_header.IsCompressed());
+    *storage_mode = ImageHeader::kStorageModeCount;  // unknown storage mode
+    ASSERT_FALSE(image_header.IsValid());
+    ASSERT_FALSE(image_header.IsCompressed());
+    *storage_mode = ImageHeader::kStorageModeUncompressed;
     ASSERT_TRUE(image_header.IsValid());
 
     char* magic = const_cast<char*>(image_header.GetMagic());
@@ -17,6 +17,7 @@
 #include "image_writer.h"
 
 #include <sys/stat.h>
+#include <zlib.h>
 
 #include <vector>
 
@@ -113,6 +114,10 @@ bool ImageWriter::Write(const std::string& image_filename,
       oat_file_->GetOatHeader().GetQuickResolutionTrampolineOffset();
   quick_to_interpreter_bridge_offset_ =
       oat_file_->GetOatHeader().GetQuickToInterpreterBridgeOffset();
+
+  // The workers are attached while this thread is still suspended.
+  thread_pool_.reset(new ThreadPool("Image writer thread pool", thread_count_ - 1));
+  thread_pool_->StartWorkers(Thread::Current());
   {
     Thread::Current()->TransitionFromSuspendedToRunnable();
     PruneNonImageClasses();  // Remove junk
@@ -139,7 +144,11 @@ bool ImageWriter::Write(const std::string& image_filename,
   CalculateNewObjectOffsets(oat_loaded_size, oat_data_offset);
   CopyAndFixupObjects();
   PatchOatCodeAndMethods();
+  if (compress_image_) {
+    CompressImage();
+  }
   Thread::Current()->TransitionFromRunnableToSuspended(kNative);
+  thread_pool_.reset();
 
   UniquePtr<File> image_file(OS::CreateEmptyFile(image_filename.c_str()));
   ImageHeader* image_header = reinterpret_cast<ImageHeader*>(image_->Begin());
@@ -152,8 +161,16 @@ bool ImageWriter::Write(const std::string& image_filename,
     return EXIT_FAILURE;
   }
 
-  // Write out the image.
   CHECK_EQ(image_end_, image_header->GetImageSize());
+  if (compress_image_) {
+    if (!WriteCompressedImage(image_file.get())) {
+      PLOG(ERROR) << "Failed to write image file " << image_filename;
+      return false;
+    }
+    return true;
+  }
+
+  // Write out the image.
   if (!image_file->WriteFully(image_->Begin(), image_end_)) {
     PLOG(ERROR) << "Failed to write image file " << image_filename;
     return false;
@@ -171,6 +188,123 @@ bool ImageWriter::Write(const std::string& image_filename,
   return true;
 }
 
+void ImageWriter::CompressBlocksCallback(ImageWriter* image_writer, void* arg, size_t range,
+                                         size_t begin, size_t end) {
+  UNUSED(arg);
+  UNUSED(range);
+  for (size_t block = begin; block != end; ++block) {
+    const size_t block_begin = block * ImageHeader::kBlockSize;
+    const size_t size = std::min(ImageHeader::kBlockSize, image_writer->image_end_ - block_begin);
+    const byte* data = image_writer->image_->Begin() + block_begin;
+    std::vector<uint8_t>& compressed = image_writer->compressed_blocks_[block];
+    uLongf compressed_size = compressBound(size);
+    compressed.resize(compressed_size);
+    CHECK_EQ(compress2(&compressed[0], &compressed_size, data, size, Z_BEST_COMPRESSION), Z_OK);
+    if (compressed_size < size) {
+      compressed.resize(compressed_size);
+    } else {
+      // The loader copies blocks of the uncompressed size as they are.
+      compressed.assign(data, data + size);
+    }
+  }
+}
+
+void ImageWriter::CompressImage() {
+  const ImageHeader* image_header = reinterpret_cast<ImageHeader*>(image_->Begin());
+  CHECK(image_header->IsCompressed());
+  compressed_blocks_.resize(image_header->GetNumBlocks());
+  ForAllRanges(compressed_blocks_.size(), CompressBlocksCallback, nullptr);
+}
+
+bool ImageWriter::WriteCompressedImage(File* image_file) {
+  const ImageHeader* image_header = reinterpret_cast<ImageHeader*>(image_->Begin());
+  if (image_file->Write(reinterpret_cast<const char*>(image_header), sizeof(ImageHeader), 0) !=
+      static_cast<int64_t>(sizeof(ImageHeader))) {
+    return false;
+  }
+  CHECK_ALIGNED(image_header->GetImageBitmapOffset(), kPageSize);
+  const int64_t bitmap_size = image_header->GetImageBitmapSize();
+  if (image_file->Write(reinterpret_cast<const char*>(image_bitmap_->Begin()), bitmap_size,
+                        image_header->GetImageBitmapOffset()) != bitmap_size) {
+    return false;
+  }
+
+  std::vector<uint32_t> block_offsets;
+  const size_t index_offset = image_header->GetBlockIndexOffset();
+  size_t offset = index_offset + (compressed_blocks_.size() + 1) * sizeof(uint32_t);
+  for (const std::vector<uint8_t>& compressed : compressed_blocks_) {
+    block_offsets.push_back(offset);
+    offset += compressed.size();
+  }
+  block_offsets.push_back(offset);
+  const int64_t index_size = block_offsets.size() * sizeof(block_offsets[0]);
+  if (image_file->Write(reinterpret_cast<const char*>(&block_offsets[0]), index_size,
+                        index_offset) != index_size) {
+    return false;
+  }
+  for (size_t i = 0; i != compressed_blocks_.size(); ++i) {
+    const int64_t size = compressed_blocks_[i].size();
+    if (image_file->Write(reinterpret_cast<const char*>(&compressed_blocks_[i][0]), size,
+                          block_offsets[i]) != size) {
+      return false;
+    }
+  }
+  VLOG(compiler) << "Compressed image from " << PrettySize(image_end_) << " to "
+                 << PrettySize(offset - block_offsets[0]) << " in " << compressed_blocks_.size()
+                 << " blocks";
+  compressed_blocks_.clear();
+  return true;
+}
+
+class ImageWriter::RangeTask : public Task {
+ public:
+  RangeTask(ImageWriter* image_writer, RangeCallback* callback, void* arg, size_t range,
+            size_t begin, size_t end)
+      : image_writer_(image_writer), callback_(callback), arg_(arg), range_(range), begin_(begin),
+        end_(end) {
+  }
+
+  void Run(Thread* self) {
+    // The calling thread is already runnable, the workers need to become runnable.
+    ScopedObjectAccess soa(self);
+    callback_(image_writer_, arg_, range_, begin_, end_);
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  ImageWriter* const image_writer_;
+  RangeCallback* const callback_;
+  void* const arg_;
+  const size_t range_;
+  const size_t begin_;
+  const size_t end_;
+
+  DISALLOW_COPY_AND_ASSIGN(RangeTask);
+};
+
+// Several ranges per thread balance ranges of objects of different sizes.
+static constexpr size_t kRangesPerThread = 4;
+
+size_t ImageWriter::NumRanges(size_t count) const {
+  return std::min(count, thread_count_ * kRangesPerThread);
+}
+
+void ImageWriter::ForAllRanges(size_t count, RangeCallback* callback, void* arg) {
+  Thread* self = Thread::Current();
+  const size_t num_ranges = NumRanges(count);
+  for (size_t range = 0; range < num_ranges; ++range) {
+    size_t begin = count * range / num_ranges;
+    size_t end = count * (range + 1) / num_ranges;
+    thread_pool_->AddTask(self, new RangeTask(this, callback, arg, range, begin, end));
+  }
+  // The calling thread holds the mutator lock and may hold the heap bitmap lock, which the
+  // workers do not need.
+  thread_pool_->Wait(self, true, true);
+}
+
 void ImageWriter::SetImageOffset(mirror::Object* object, size_t offset) {
   DCHECK(object != nullptr);
   DCHECK_NE(offset, 0U);
@@ -207,6 +341,7 @@ void ImageWriter::SetImageOffset(mirror::Object* object, size_t offset) {
 void ImageWriter::AssignImageOffset(mirror::Object* object) {
   DCHECK(object != nullptr);
   SetImageOffset(object, image_end_);
+  image_objects_.push_back(object);
   image_end_ += RoundUp(object->SizeOf(), 8);  // 64-bit alignment
   DCHECK_LT(image_end_, image_->Size());
 }
@@ -255,33 +390,71 @@ bool ImageWriter::ComputeLazyFieldsForClassesVisitor(Class* c, void* /*arg*/) {
   return true;
 }
 
-void ImageWriter::ComputeEagerResolvedStringsCallback(Object* obj, void* arg) {
-  if (!obj->GetClass()->IsStringClass()) {
-    return;
+void ImageWriter::CollectStringsCallback(Object* obj, void* arg) {
+  if (obj->GetClass()->IsStringClass()) {
+    reinterpret_cast<std::vector<mirror::String*>*>(arg)->push_back(obj->AsString());
   }
-  mirror::String* string = obj->AsString();
-  const uint16_t* utf16_string = string->GetCharArray()->GetData() + string->GetOffset();
-  for (DexCache* dex_cache : Runtime::Current()->GetClassLinker()->GetDexCaches()) {
-    const DexFile& dex_file = *dex_cache->GetDexFile();
-    const DexFile::StringId* string_id;
-    if (UNLIKELY(string->GetLength() == 0)) {
-      string_id = dex_file.FindStringId("");
-    } else {
-      string_id = dex_file.FindStringId(utf16_string);
-    }
-    if (string_id != nullptr) {
-      // This string occurs in this dex file, assign the dex cache entry.
-      uint32_t string_idx = dex_file.GetIndexForStringId(*string_id);
-      if (dex_cache->GetResolvedString(string_idx) == NULL) {
-        dex_cache->SetResolvedString(string_idx, string);
+}
+
+struct EagerResolvedString {
+  DexCache* dex_cache;
+  uint32_t string_idx;
+  mirror::String* string;
+};
+
+struct EagerResolvedStrings {
+  const std::vector<DexCache*>* dex_caches;
+  const std::vector<mirror::String*>* strings;
+  // The dex cache entries found by each range, in the order of the strings.
+  std::vector<std::vector<EagerResolvedString> >* found;
+};
+
+void ImageWriter::FindEagerResolvedStrings(ImageWriter* /*image_writer*/, void* arg, size_t range,
+                                           size_t begin, size_t end) {
+  EagerResolvedStrings* context = reinterpret_cast<EagerResolvedStrings*>(arg);
+  std::vector<EagerResolvedString>& found = (*context->found)[range];
+  for (size_t i = begin; i != end; ++i) {
+    mirror::String* string = (*context->strings)[i];
+    const uint16_t* utf16_string = string->GetCharArray()->GetData() + string->GetOffset();
+    for (DexCache* dex_cache : *context->dex_caches) {
+      const DexFile& dex_file = *dex_cache->GetDexFile();
+      const DexFile::StringId* string_id;
+      if (UNLIKELY(string->GetLength() == 0)) {
+        string_id = dex_file.FindStringId("");
+      } else {
+        string_id = dex_file.FindStringId(utf16_string);
+      }
+      if (string_id != nullptr) {
+        // This string occurs in this dex file, the dex cache entry is assigned below.
+        EagerResolvedString entry = { dex_cache, dex_file.GetIndexForStringId(*string_id), string };
+        found.push_back(entry);
       }
     }
   }
 }
 
 void ImageWriter::ComputeEagerResolvedStrings() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-  ReaderMutexLock mu(Thread::Current(), *Locks::heap_bitmap_lock_);
-  Runtime::Current()->GetHeap()->VisitObjects(ComputeEagerResolvedStringsCallback, this);
+  Thread* self = Thread::Current();
+  std::vector<mirror::String*> strings;
+  {
+    ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    Runtime::Current()->GetHeap()->VisitObjects(CollectStringsCallback, &strings);
+  }
+  std::vector<DexCache*> dex_caches(Runtime::Current()->GetClassLinker()->GetDexCaches());
+  std::vector<std::vector<EagerResolvedString> > found(NumRanges(strings.size()));
+  EagerResolvedStrings context = { &dex_caches, &strings, &found };
+  const char* old_cause = self->StartAssertNoThreadSuspension("ImageWriter");
+  ForAllRanges(strings.size(), FindEagerResolvedStrings, &context);
+  self->EndAssertNoThreadSuspension(old_cause);
+
+  // The first string in heap order wins, as if the strings were visited one by one.
+  for (const std::vector<EagerResolvedString>& range_found : found) {
+    for (const EagerResolvedString& entry : range_found) {
+      if (entry.dex_cache->GetResolvedString(entry.string_idx) == NULL) {
+        entry.dex_cache->SetResolvedString(entry.string_idx, entry.string);
+      }
+    }
+  }
 }
 
 bool ImageWriter::IsImageClass(Class* klass) {
@@ -498,6 +671,125 @@ void ImageWriter::WalkFieldsCallback(mirror::Object* obj, void* arg) {
   writer->WalkFieldsInOrder(obj);
 }
 
+void ImageWriter::AssignImageOffsetIfUnassigned(mirror::Object* object) {
+  if (object != nullptr && !IsImageOffsetAssigned(object)) {
+    CalculateObjectOffsets(object);
+  }
+}
+
+// Appends the non-null referents of the instance fields of obj, those of the super classes first.
+static void GetInstanceFieldReferents(mirror::Object* obj, mirror::Class* klass,
+                                      std::vector<mirror::Object*>* referents)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  mirror::Class* super = klass->GetSuperClass();
+  if (super != nullptr) {
+    GetInstanceFieldReferents(obj, super, referents);
+  }
+  size_t num_reference_fields = klass->NumReferenceInstanceFields();
+  for (size_t i = 0; i < num_reference_fields; ++i) {
+    mirror::Object* value =
+        obj->GetFieldObject<mirror::Object>(klass->GetInstanceField(i)->GetOffset());
+    if (value != nullptr) {
+      referents->push_back(value);
+    }
+  }
+}
+
+void ImageWriter::WalkStartupReferents(mirror::Object* obj,
+                                       const std::set<mirror::Object*>& dirty_objects) {
+  std::vector<mirror::Object*> referents;
+  GetInstanceFieldReferents(obj, obj->GetClass(), &referents);
+  // The static fields of a class are left out, they are only set for dirty classes.
+  if (obj->IsObjectArray()) {
+    ObjectArray<Object>* elements = obj->AsObjectArray<Object>();
+    for (int32_t i = 0; i < elements->GetLength(); ++i) {
+      if (elements->Get(i) != nullptr) {
+        referents.push_back(elements->Get(i));
+      }
+    }
+  }
+  for (mirror::Object* referent : referents) {
+    if (referent->GetClass()->IsStringClass()) {
+      // The image refers to the interned string, see CalculateObjectOffsets.
+      referent = referent->AsString()->Intern();
+    }
+    // Classes are placed in the order of the startup list or by the heap walk.
+    if (IsImageOffsetAssigned(referent) || referent->IsClass() ||
+        dirty_objects.find(referent) != dirty_objects.end()) {
+      continue;
+    }
+    CalculateObjectOffsets(referent);
+    WalkStartupReferents(referent, dirty_objects);
+  }
+}
+
+bool ImageWriter::IsDirtyClass(Class* klass) {
+  // Initialization writes the status and the static fields, reference statics are likely to be
+  // written again later.
+  return !klass->IsInitialized() || klass->NumReferenceStaticFields() != 0;
+}
+
+void ImageWriter::CollectDirtyClassesCallback(Object* obj, void* arg) {
+  if (obj->IsClass() && IsDirtyClass(obj->AsClass())) {
+    reinterpret_cast<std::vector<Class*>*>(arg)->push_back(obj->AsClass());
+  }
+}
+
+void ImageWriter::CalculateStartupObjectOffsets(const std::vector<Class*>& startup_classes) {
+  // The dex caches and their arrays are written by the runtime, the methods refer to the arrays.
+  std::set<Object*> dirty_objects;
+  const std::vector<DexCache*>& dex_caches = Runtime::Current()->GetClassLinker()->GetDexCaches();
+  for (DexCache* dex_cache : dex_caches) {
+    dirty_objects.insert(dex_cache);
+    dirty_objects.insert(dex_cache->GetStrings());
+    dirty_objects.insert(dex_cache->GetResolvedTypes());
+    dirty_objects.insert(dex_cache->GetResolvedMethods());
+    dirty_objects.insert(dex_cache->GetResolvedFields());
+  }
+
+  // The clean objects of the startup classes come first, in the order they are used. Each class is
+  // followed by what it refers to, such as its name, methods, fields and tables, depth-first in
+  // field order as the heap walk would place them.
+  const size_t startup_begin = image_end_;
+  for (Class* klass : startup_classes) {
+    if (!IsDirtyClass(klass)) {
+      AssignImageOffsetIfUnassigned(klass);
+    }
+    WalkStartupReferents(klass, dirty_objects);
+  }
+  const size_t startup_end = image_end_;
+
+  // The objects that the runtime writes to follow on pages of their own: the dex caches with their
+  // arrays, then the dirty classes, those used at startup first.
+  image_end_ = RoundUp(image_end_, kPageSize);
+  const size_t dirty_begin = image_end_;
+  for (DexCache* dex_cache : dex_caches) {
+    AssignImageOffsetIfUnassigned(dex_cache);
+    AssignImageOffsetIfUnassigned(dex_cache->GetStrings());
+    AssignImageOffsetIfUnassigned(dex_cache->GetResolvedTypes());
+    AssignImageOffsetIfUnassigned(dex_cache->GetResolvedMethods());
+    AssignImageOffsetIfUnassigned(dex_cache->GetResolvedFields());
+  }
+  for (Class* klass : startup_classes) {
+    if (IsDirtyClass(klass)) {
+      AssignImageOffsetIfUnassigned(klass);
+    }
+  }
+  std::vector<Class*> dirty_classes;
+  Runtime::Current()->GetHeap()->VisitObjects(CollectDirtyClassesCallback, &dirty_classes);
+  for (Class* klass : dirty_classes) {
+    AssignImageOffsetIfUnassigned(klass);
+  }
+  const size_t dirty_end = image_end_;
+  image_end_ = RoundUp(image_end_, kPageSize);
+  CHECK_LT(image_end_, image_->Size());
+
+  VLOG(compiler) << "Image startup objects: " << PrettySize(startup_end - startup_begin)
+                 << " for " << startup_classes.size() << " classes, dirty objects: "
+                 << PrettySize(dirty_end - dirty_begin) << " in "
+                 << (RoundUp(dirty_end, kPageSize) - dirty_begin) / kPageSize << " pages";
+}
+
 void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_data_offset) {
   CHECK_NE(0U, oat_loaded_size);
   Thread* self = Thread::Current();
@@ -511,11 +803,24 @@ void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_d
   // know where image_roots is going to end up
   image_end_ += RoundUp(sizeof(ImageHeader), 8);  // 64-bit-alignment
 
+  // Classes the image does not have are skipped, the list may come from a different build.
+  std::vector<Class*> startup_classes;
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  for (const std::string& descriptor : startup_classes_) {
+    Class* klass = class_linker->LookupClass(descriptor.c_str(), NULL);
+    if (klass != NULL) {
+      startup_classes.push_back(klass);
+    }
+  }
+
   {
     WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
     // TODO: Image spaces only?
     const char* old = self->StartAssertNoThreadSuspension("ImageWriter");
     DCHECK_LT(image_end_, image_->Size());
+    if (!startup_classes_.empty()) {
+      CalculateStartupObjectOffsets(startup_classes);
+    }
     // Clear any pre-existing monitors which may have been in the monitor words.
     heap->VisitObjects(WalkFieldsCallback, this);
     self->EndAssertNoThreadSuspension(old);
@@ -531,16 +836,19 @@ void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_d
   const size_t heap_bytes_per_bitmap_byte = kBitsPerByte * kObjectAlignment;
   const size_t bitmap_bytes = RoundUp(image_end_, heap_bytes_per_bitmap_byte) /
       heap_bytes_per_bitmap_byte;
+  // A compressed image keeps only its header uncompressed, the bitmap follows on the next page.
   ImageHeader image_header(PointerToLowMemUInt32(image_begin_),
                            static_cast<uint32_t>(image_end_),
-                           RoundUp(image_end_, kPageSize),
+                           compress_image_ ? kPageSize : RoundUp(image_end_, kPageSize),
                            RoundUp(bitmap_bytes, kPageSize),
                            PointerToLowMemUInt32(GetImageAddress(image_roots.Get())),
                            oat_file_->GetOatHeader().GetChecksum(),
                            PointerToLowMemUInt32(oat_file_begin),
                            PointerToLowMemUInt32(oat_data_begin_),
                            PointerToLowMemUInt32(oat_data_end),
-                           PointerToLowMemUInt32(oat_file_end));
+                           PointerToLowMemUInt32(oat_file_end),
+                           compress_image_ ? ImageHeader::kStorageModeZlib
+                                           : ImageHeader::kStorageModeUncompressed);
   memcpy(image_->Begin(), &image_header, sizeof(image_header));
 
   // Note that image_end_ is left at end of used space
@@ -555,7 +863,9 @@ void ImageWriter::CopyAndFixupObjects()
   heap->DisableObjectValidation();
   // TODO: Image spaces only?
   WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
-  heap->VisitObjects(CopyAndFixupObjectsCallback, this);
+  // Every range of objects is copied to its own part of the image.
+  ForAllRanges(image_objects_.size(), CopyAndFixupObjectsCallback, NULL);
+  image_objects_.clear();
   // Fix up the object previously had hash codes.
   for (const std::pair<mirror::Object*, uint32_t>& hash_pair : saved_hashes_) {
     hash_pair.first->SetLockWord(LockWord::FromHashCode(hash_pair.second), false);
@@ -564,22 +874,25 @@ void ImageWriter::CopyAndFixupObjects()
   self->EndAssertNoThreadSuspension(old_cause);
 }
 
-void ImageWriter::CopyAndFixupObjectsCallback(Object* obj, void* arg) {
-  DCHECK(obj != nullptr);
-  DCHECK(arg != nullptr);
-  ImageWriter* image_writer = reinterpret_cast<ImageWriter*>(arg);
-  // see GetLocalAddress for similar computation
-  size_t offset = image_writer->GetImageOffset(obj);
-  byte* dst = image_writer->image_->Begin() + offset;
-  const byte* src = reinterpret_cast<const byte*>(obj);
-  size_t n = obj->SizeOf();
-  DCHECK_LT(offset + n, image_writer->image_->Size());
-  memcpy(dst, src, n);
-  Object* copy = reinterpret_cast<Object*>(dst);
-  // Write in a hash code of objects which have inflated monitors or a hash code in their monitor
-  // word.
-  copy->SetLockWord(LockWord(), false);
-  image_writer->FixupObject(obj, copy);
+void ImageWriter::CopyAndFixupObjectsCallback(ImageWriter* image_writer, void* /*arg*/,
+                                              size_t /*range*/, size_t begin, size_t end) {
+  DCHECK(image_writer != nullptr);
+  for (size_t i = begin; i != end; ++i) {
+    Object* obj = image_writer->image_objects_[i];
+    DCHECK(obj != nullptr);
+    // see GetLocalAddress for similar computation
+    size_t offset = image_writer->GetImageOffset(obj);
+    byte* dst = image_writer->image_->Begin() + offset;
+    const byte* src = reinterpret_cast<const byte*>(obj);
+    size_t n = obj->SizeOf();
+    DCHECK_LT(offset + n, image_writer->image_->Size());
+    memcpy(dst, src, n);
+    Object* copy = reinterpret_cast<Object*>(dst);
+    // Write in a hash code of objects which have inflated monitors or a hash code in their monitor
+    // word.
+    copy->SetLockWord(LockWord(), false);
+    image_writer->FixupObject(obj, copy);
+  }
 }
 
 class FixupVisitor {
@@ -733,55 +1046,94 @@ static Class* GetTargetType(const CompilerDriver::TypePatchInformation* patch)
   return klass;
 }
 
-void ImageWriter::PatchOatCodeAndMethods() {
-  Thread* self = Thread::Current();
+uint32_t ImageWriter::ComputeCallPatchValue(const CompilerDriver::CallPatchInformation* patch) {
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
-  const char* old_cause = self->StartAssertNoThreadSuspension("ImageWriter");
-
-  typedef std::vector<const CompilerDriver::CallPatchInformation*> CallPatches;
-  const CallPatches& code_to_patch = compiler_driver_.GetCodeToPatch();
-  for (size_t i = 0; i < code_to_patch.size(); i++) {
-    const CompilerDriver::CallPatchInformation* patch = code_to_patch[i];
-    ArtMethod* target = GetTargetMethod(patch);
-    uintptr_t quick_code = reinterpret_cast<uintptr_t>(class_linker->GetQuickOatCodeFor(target));
-    uintptr_t code_base = reinterpret_cast<uintptr_t>(&oat_file_->GetOatHeader());
-    uintptr_t code_offset = quick_code - code_base;
-    if (patch->IsRelative()) {
-      // value to patch is relative to the location being patched
-      const void* quick_oat_code =
-        class_linker->GetQuickOatCodeFor(patch->GetDexFile(),
-                                         patch->GetReferrerClassDefIdx(),
-                                         patch->GetReferrerMethodIdx());
-      uintptr_t base = reinterpret_cast<uintptr_t>(quick_oat_code);
-      uintptr_t patch_location = base + patch->GetLiteralOffset();
-      uintptr_t value = quick_code - patch_location + patch->RelativeOffset();
-      SetPatchLocation(patch, value);
+  ArtMethod* target = GetTargetMethod(patch);
+  uintptr_t quick_code = reinterpret_cast<uintptr_t>(class_linker->GetQuickOatCodeFor(target));
+  uintptr_t code_base = reinterpret_cast<uintptr_t>(&oat_file_->GetOatHeader());
+  uintptr_t code_offset = quick_code - code_base;
+  if (patch->IsRelative()) {
+    // value to patch is relative to the location being patched
+    const void* quick_oat_code =
+      class_linker->GetQuickOatCodeFor(patch->GetDexFile(),
+                                       patch->GetReferrerClassDefIdx(),
+                                       patch->GetReferrerMethodIdx());
+    uintptr_t base = reinterpret_cast<uintptr_t>(quick_oat_code);
+    uintptr_t patch_location = base + patch->GetLiteralOffset();
+    return quick_code - patch_location + patch->RelativeOffset();
+  }
+  if (quick_code == reinterpret_cast<uintptr_t>(GetQuickToInterpreterBridge())) {
+    if (target->IsNative()) {
+      // generic JNI, not interpreter bridge from GetQuickOatCodeFor().
+      code_offset = quick_generic_jni_trampoline_offset_;
     } else {
-      if (quick_code == reinterpret_cast<uintptr_t>(GetQuickToInterpreterBridge())) {
-        if (target->IsNative()) {
-          // generic JNI, not interpreter bridge from GetQuickOatCodeFor().
-          code_offset = quick_generic_jni_trampoline_offset_;
-        } else {
-          code_offset = quick_to_interpreter_bridge_offset_;
-        }
-      }
-      SetPatchLocation(patch, PointerToLowMemUInt32(GetOatAddress(code_offset)));
+      code_offset = quick_to_interpreter_bridge_offset_;
     }
   }
+  return PointerToLowMemUInt32(GetOatAddress(code_offset));
+}
 
-  const CallPatches& methods_to_patch = compiler_driver_.GetMethodsToPatch();
-  for (size_t i = 0; i < methods_to_patch.size(); i++) {
-    const CompilerDriver::CallPatchInformation* patch = methods_to_patch[i];
-    ArtMethod* target = GetTargetMethod(patch);
-    SetPatchLocation(patch, PointerToLowMemUInt32(GetImageAddress(target)));
+// The patches of code, methods and classes in this order, and the values computed for them.
+struct ComputedPatches {
+  const std::vector<const CompilerDriver::CallPatchInformation*>* code_to_patch;
+  const std::vector<const CompilerDriver::CallPatchInformation*>* methods_to_patch;
+  const std::vector<const CompilerDriver::TypePatchInformation*>* classes_to_patch;
+  std::vector<uint32_t*>* locations;
+  std::vector<uint32_t>* values;
+
+  const CompilerDriver::PatchInformation* Get(size_t i) const {
+    if (i < code_to_patch->size()) {
+      return (*code_to_patch)[i];
+    }
+    i -= code_to_patch->size();
+    if (i < methods_to_patch->size()) {
+      return (*methods_to_patch)[i];
+    }
+    return (*classes_to_patch)[i - methods_to_patch->size()];
+  }
+};
+
+void ImageWriter::ComputePatchesCallback(ImageWriter* image_writer, void* arg, size_t /*range*/,
+                                         size_t begin, size_t end) {
+  ComputedPatches* patches = reinterpret_cast<ComputedPatches*>(arg);
+  const size_t num_code_patches = patches->code_to_patch->size();
+  const size_t num_call_patches = num_code_patches + patches->methods_to_patch->size();
+  for (size_t i = begin; i != end; ++i) {
+    const CompilerDriver::PatchInformation* patch = patches->Get(i);
+    uint32_t value;
+    if (i < num_code_patches) {
+      value = image_writer->ComputeCallPatchValue(patch->AsCall());
+    } else if (i < num_call_patches) {
+      ArtMethod* target = GetTargetMethod(patch->AsCall());
+      value = PointerToLowMemUInt32(image_writer->GetImageAddress(target));
+    } else {
+      Class* target = GetTargetType(patch->AsType());
+      value = PointerToLowMemUInt32(image_writer->GetImageAddress(target));
+    }
+    (*patches->locations)[i] = image_writer->GetPatchLocation(patch);
+    (*patches->values)[i] = value;
   }
+}
 
-  const std::vector<const CompilerDriver::TypePatchInformation*>& classes_to_patch =
-      compiler_driver_.GetClassesToPatch();
-  for (size_t i = 0; i < classes_to_patch.size(); i++) {
-    const CompilerDriver::TypePatchInformation* patch = classes_to_patch[i];
-    Class* target = GetTargetType(patch);
-    SetPatchLocation(patch, PointerToLowMemUInt32(GetImageAddress(target)));
+void ImageWriter::PatchOatCodeAndMethods() {
+  Thread* self = Thread::Current();
+  const char* old_cause = self->StartAssertNoThreadSuspension("ImageWriter");
+
+  // Resolving the targets and finding the patched code is done in parallel. The patches are then
+  // applied in order, since the oat checksum depends on the order of its updates.
+  ComputedPatches patches;
+  patches.code_to_patch = &compiler_driver_.GetCodeToPatch();
+  patches.methods_to_patch = &compiler_driver_.GetMethodsToPatch();
+  patches.classes_to_patch = &compiler_driver_.GetClassesToPatch();
+  const size_t num_patches = patches.code_to_patch->size() + patches.methods_to_patch->size() +
+      patches.classes_to_patch->size();
+  std::vector<uint32_t*> locations(num_patches);
+  std::vector<uint32_t> values(num_patches);
+  patches.locations = &locations;
+  patches.values = &values;
+  ForAllRanges(num_patches, ComputePatchesCallback, &patches);
+  for (size_t i = 0; i < num_patches; ++i) {
+    SetPatchLocation(patches.Get(i), locations[i], values[i]);
   }
 
   // Update the image header with the new checksum after patching
@@ -790,15 +1142,19 @@ void ImageWriter::PatchOatCodeAndMethods() {
   self->EndAssertNoThreadSuspension(old_cause);
 }
 
-void ImageWriter::SetPatchLocation(const CompilerDriver::PatchInformation* patch, uint32_t value) {
+uint32_t* ImageWriter::GetPatchLocation(const CompilerDriver::PatchInformation* patch) {
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
   const void* quick_oat_code = class_linker->GetQuickOatCodeFor(patch->GetDexFile(),
                                                                 patch->GetReferrerClassDefIdx(),
                                                                 patch->GetReferrerMethodIdx());
-  OatHeader& oat_header = const_cast<OatHeader&>(oat_file_->GetOatHeader());
   // TODO: make this Thumb2 specific
   uint8_t* base = reinterpret_cast<uint8_t*>(reinterpret_cast<uintptr_t>(quick_oat_code) & ~0x1);
-  uint32_t* patch_location = reinterpret_cast<uint32_t*>(base + patch->GetLiteralOffset());
+  return reinterpret_cast<uint32_t*>(base + patch->GetLiteralOffset());
+}
+
+void ImageWriter::SetPatchLocation(const CompilerDriver::PatchInformation* patch,
+                                   uint32_t* patch_location, uint32_t value) {
+  OatHeader& oat_header = const_cast<OatHeader&>(oat_file_->GetOatHeader());
   if (kIsDebugBuild) {
     if (patch->IsCall()) {
       const CompilerDriver::CallPatchInformation* cpatch = patch->AsCall();
@@ -19,9 +19,11 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "driver/compiler_driver.h"
 #include "mem_map.h"
@@ -30,6 +32,7 @@
 #include "os.h"
 #include "safe_map.h"
 #include "gc/space/space.h"
+#include "thread_pool.h"
 #include "UniquePtr.h"
 
 namespace art {
@@ -42,7 +45,9 @@ class ImageWriter {
         oat_data_begin_(NULL), interpreter_to_interpreter_bridge_offset_(0),
         interpreter_to_compiled_code_bridge_offset_(0), portable_imt_conflict_trampoline_offset_(0),
         portable_resolution_trampoline_offset_(0), quick_generic_jni_trampoline_offset_(0),
-        quick_imt_conflict_trampoline_offset_(0), quick_resolution_trampoline_offset_(0) {}
+        quick_imt_conflict_trampoline_offset_(0), quick_resolution_trampoline_offset_(0),
+        thread_count_(std::max<size_t>(compiler_driver.GetThreadCount(), 1U)),
+        compress_image_(false) {}
 
   ~ImageWriter() {}
 
@@ -56,9 +61,42 @@ class ImageWriter {
     return reinterpret_cast<uintptr_t>(oat_data_begin_);
   }
 
+  // Classes in the order the runtime first uses them at startup, as descriptors. The clean objects
+  // of these classes are laid out first, so that startup touches as few image pages as possible.
+  // The objects the runtime writes to, dex caches and classes that still need to be initialized or
+  // have reference statics, follow on pages of their own so that fewer pages get dirtied.
+  void SetStartupClasses(const std::vector<std::string>& startup_classes) {
+    startup_classes_ = startup_classes;
+  }
+
+  // Writes the image in independently compressed blocks that the runtime decompresses in parallel
+  // when it loads the image, see ImageHeader::kStorageModeZlib. This trades a smaller file for
+  // decompression at startup and for image pages that are not backed by the file.
+  void SetCompressImage(bool compress_image) {
+    compress_image_ = compress_image;
+  }
+
+  // The number of threads that lay out, copy and patch the image, by default that of the compiler
+  // driver. The image written does not depend on it.
+  void SetThreadCount(size_t thread_count) {
+    DCHECK_GT(thread_count, 0U);
+    thread_count_ = thread_count;
+  }
+
  private:
   bool AllocMemory();
 
+  // The work of the passes over all image objects and patches is split into ranges of indices that
+  // are processed on the thread pool, the calling thread helps. A range writes only to its own
+  // part of the image or of a result array, and the results are combined in index order, so the
+  // output does not depend on the number of threads or on scheduling.
+  typedef void RangeCallback(ImageWriter* image_writer, void* arg, size_t range, size_t begin,
+                             size_t end);
+  size_t NumRanges(size_t count) const;
+  void ForAllRanges(size_t count, RangeCallback* callback, void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  class RangeTask;
+
   // Mark the objects defined in this space in the given live bitmap.
   void RecordImageAllocations() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
@@ -112,7 +150,10 @@ class ImageWriter {
 
   // Wire dex cache resolved strings to strings in the image to avoid runtime resolution.
   void ComputeEagerResolvedStrings() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  static void ComputeEagerResolvedStringsCallback(mirror::Object* obj, void* arg)
+  static void CollectStringsCallback(mirror::Object* obj, void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  static void FindEagerResolvedStrings(ImageWriter* image_writer, void* arg, size_t range,
+                                       size_t begin, size_t end)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   // Remove unwanted classes from various roots.
@@ -133,6 +174,19 @@ class ImageWriter {
   void CalculateObjectOffsets(mirror::Object* obj)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Lays out the startup classes and the dirty objects, see SetStartupClasses.
+  void CalculateStartupObjectOffsets(const std::vector<mirror::Class*>& startup_classes)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void AssignImageOffsetIfUnassigned(mirror::Object* object)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Places the unplaced referents of a startup object after it, depth-first in field order like
+  // WalkFieldsInOrder, except for classes and dirty_objects.
+  void WalkStartupReferents(mirror::Object* obj, const std::set<mirror::Object*>& dirty_objects)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  static bool IsDirtyClass(mirror::Class* klass) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  static void CollectDirtyClassesCallback(mirror::Object* obj, void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   void WalkInstanceFields(mirror::Object* obj, mirror::Class* klass)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void WalkFieldsInOrder(mirror::Object* obj)
@@ -142,7 +196,8 @@ class ImageWriter {
 
   // Creates the contiguous image in memory and adjusts pointers.
   void CopyAndFixupObjects();
-  static void CopyAndFixupObjectsCallback(mirror::Object* obj, void* arg)
+  static void CopyAndFixupObjectsCallback(ImageWriter* image_writer, void* arg, size_t range,
+                                          size_t begin, size_t end)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void FixupMethod(mirror::ArtMethod* orig, mirror::ArtMethod* copy)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -152,8 +207,25 @@ class ImageWriter {
   // Patches references in OatFile to expect runtime addresses.
   void PatchOatCodeAndMethods()
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  void SetPatchLocation(const CompilerDriver::PatchInformation* patch, uint32_t value)
+  static void ComputePatchesCallback(ImageWriter* image_writer, void* arg, size_t range,
+                                     size_t begin, size_t end)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  uint32_t ComputeCallPatchValue(const CompilerDriver::CallPatchInformation* patch)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  uint32_t* GetPatchLocation(const CompilerDriver::PatchInformation* patch)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void SetPatchLocation(const CompilerDriver::PatchInformation* patch, uint32_t* patch_location,
+                        uint32_t value)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Compresses the blocks of the image into compressed_blocks_.
+  void CompressImage()
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  static void CompressBlocksCallback(ImageWriter* image_writer, void* arg, size_t range,
+                                     size_t begin, size_t end)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Writes the header, the bitmap, the block index and the compressed blocks.
+  bool WriteCompressedImage(File* image_file);
 
   const CompilerDriver& compiler_driver_;
 
@@ -166,6 +238,10 @@ class ImageWriter {
   // Offset to the free space in image_.
   size_t image_end_;
 
+  // The objects that own an image offset, in the order of their offsets. Interned duplicates of
+  // strings share the offset of the interned string and are not in here.
+  std::vector<mirror::Object*> image_objects_;
+
   // Beginning target image address for the output image.
   byte* image_begin_;
 
@@ -190,6 +266,16 @@ class ImageWriter {
   uint32_t quick_resolution_trampoline_offset_;
   uint32_t quick_to_interpreter_bridge_offset_;
 
+  size_t thread_count_;
+  UniquePtr<ThreadPool> thread_pool_;
+
+  // Descriptors of the classes used at startup, in order of first use.
+  std::vector<std::string> startup_classes_;
+
+  bool compress_image_;
+  // The compressed blocks of the image, a block that does not compress is kept as is.
+  std::vector<std::vector<uint8_t> > compressed_blocks_;
+
   friend class FixupVisitor;
   DISALLOW_COPY_AND_ASSIGN(ImageWriter);
 };
@@ -89,10 +89,9 @@ CompiledMethod* JniCompiler::Compile() {
   } else {
     // Load class object
     this_object_or_class_object =
-        irb_.LoadFromObjectOffset(method_object_addr,
-                                  mirror::ArtMethod::DeclaringClassOffset().Int32Value(),
-                                  irb_.getJObjectTy(),
-                                  kTBAAConstJObject);
+        irb_.LoadHeapReferenceFromObjectOffset(
+            method_object_addr, mirror::ArtMethod::DeclaringClassOffset().Int32Value(),
+            kTBAAConstJObject);
   }
   // Actual argument (ignore method and this object)
   arg_begin = arg_iter;
@@ -127,7 +126,7 @@ CompiledMethod* JniCompiler::Compile() {
 
   // Get JNIEnv
   ::llvm::Value* jni_env_object_addr =
-      irb_.Runtime().EmitLoadFromThreadOffset(Thread::JniEnvOffset<8>().Int32Value(),
+      irb_.Runtime().EmitLoadFromThreadOffset(PORTABLE_THREAD_OFFSET(irb_, JniEnvOffset),
                                               irb_.getJObjectTy(),
                                               kTBAARuntimeInfo);
 
@@ -31,6 +31,7 @@
 #include "thread-inl.h"
 #include "utils_llvm.h"
 #include "verifier/method_verifier.h"
+#include "whole_program_module.h"
 
 #include <llvm/LinkAllPasses.h>
 #include <llvm/Support/ManagedStatic.h>
@@ -122,6 +123,17 @@ CompilerLLVM::~CompilerLLVM() {
 }
 
 
+void CompilerLLVM::SetWholeProgramModule(const std::string& filename, size_t num_partitions) {
+  whole_program_module_.reset(new WholeProgramModule(insn_set_, filename, num_partitions));
+}
+
+
+bool CompilerLLVM::WriteWholeProgramModule(size_t thread_count) {
+  CHECK(whole_program_module_.get() != NULL);
+  return whole_program_module_->Write(thread_count);
+}
+
+
 LlvmCompilationUnit* CompilerLLVM::AllocateCompilationUnit() {
   MutexLock GUARD(Thread::Current(), next_cunit_id_lock_);
   LlvmCompilationUnit* cunit = new LlvmCompilationUnit(this, next_cunit_id_++);
@@ -140,6 +152,7 @@ CompileDexMethod(DexCompilationUnit* dex_compilation_unit, InvokeType invoke_typ
 
   cunit->SetDexCompilationUnit(dex_compilation_unit);
   cunit->SetCompilerDriver(compiler_driver_);
+  cunit->SetWholeProgramModule(whole_program_module_.get());
   // TODO: consolidate ArtCompileMethods
   CompileOneMethod(*compiler_driver_,
                    compiler_driver_->GetCompiler(),
@@ -237,3 +250,27 @@ extern "C" void compilerLLVMSetBitcodeFileName(const art::CompilerDriver& driver
                                                const std::string& filename) {
   ContextOf(driver)->SetBitcodeFileName(filename);
 }
+
+extern "C" void compilerLLVMSetWholeProgramModule(const art::CompilerDriver& driver,
+                                                  const std::string& filename,
+                                                  size_t num_partitions) {
+  ContextOf(driver)->SetWholeProgramModule(filename, num_partitions);
+}
+
+extern "C" bool compilerLLVMWriteWholeProgramModule(const art::CompilerDriver& driver,
+                                                    size_t thread_count) {
+  return ContextOf(driver)->WriteWholeProgramModule(thread_count);
+}
+
+extern "C" bool compilerLLVMGetWholeProgramObjects(const art::CompilerDriver& driver,
+                                                   std::vector<std::string>* object_filenames,
+                                                   std::set<std::string>* method_symbols) {
+  const art::llvm::WholeProgramModule* whole_program_module =
+      ContextOf(driver)->GetWholeProgramModule();
+  if (whole_program_module == NULL || whole_program_module->GetObjectFilenames().empty()) {
+    return false;
+  }
+  *object_filenames = whole_program_module->GetObjectFilenames();
+  *method_symbols = whole_program_module->GetMethodSymbols();
+  return true;
+}
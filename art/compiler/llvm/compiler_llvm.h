@@ -55,6 +55,7 @@ namespace llvm {
 
 class LlvmCompilationUnit;
 class IRBuilder;
+class WholeProgramModule;
 
 class CompilerLLVM {
  public:
@@ -74,6 +75,16 @@ class CompilerLLVM {
     bitcode_filename_ = filename;
   }
 
+  // Also emits all compiled methods as one module, see WholeProgramModule.
+  void SetWholeProgramModule(const std::string& filename, size_t num_partitions);
+
+  bool WriteWholeProgramModule(size_t thread_count);
+
+  // The whole program module, or NULL when methods are only compiled one by one.
+  const WholeProgramModule* GetWholeProgramModule() const {
+    return whole_program_module_.get();
+  }
+
   CompiledMethod* CompileDexMethod(DexCompilationUnit* dex_compilation_unit,
                                    InvokeType invoke_type);
 
@@ -93,6 +104,8 @@ class CompilerLLVM {
 
   std::string bitcode_filename_;
 
+  UniquePtr<WholeProgramModule> whole_program_module_;
+
   DISALLOW_COPY_AND_ASSIGN(CompilerLLVM);
 };
 
@@ -674,7 +674,7 @@ GBCExpanderPass::EmitStackOverflowCheck(llvm::Instruction* first_non_alloca) {
 
   // Get thread.stack_end_
   llvm::Value* stack_end =
-    irb_.Runtime().EmitLoadFromThreadOffset(art::Thread::StackEndOffset<8>().Int32Value(),
+    irb_.Runtime().EmitLoadFromThreadOffset(PORTABLE_THREAD_OFFSET(irb_, StackEndOffset),
                                             irb_.getPtrEquivIntTy(),
                                             kTBAARuntimeInfo);
 
@@ -710,10 +710,9 @@ GBCExpanderPass::EmitStackOverflowCheck(llvm::Instruction* first_non_alloca) {
 llvm::Value* GBCExpanderPass::EmitLoadDexCacheAddr(art::MemberOffset offset) {
   llvm::Value* method_object_addr = EmitLoadMethodObjectAddr();
 
-  return irb_.LoadFromObjectOffset(method_object_addr,
-                                   offset.Int32Value(),
-                                   irb_.getJObjectTy(),
-                                   kTBAAConstJObject);
+  return irb_.LoadHeapReferenceFromObjectOffset(method_object_addr,
+                                                offset.Int32Value(),
+                                                kTBAAConstJObject);
 }
 
 llvm::Value*
@@ -764,24 +763,22 @@ GBCExpanderPass::EmitLoadSDCalleeMethodObjectAddr(uint32_t callee_method_idx) {
   llvm::Value* callee_method_object_field_addr =
     EmitLoadDexCacheResolvedMethodFieldAddr(callee_method_idx);
 
-  return irb_.CreateLoad(callee_method_object_field_addr, kTBAARuntimeInfo);
+  return irb_.CreateHeapReferenceLoad(callee_method_object_field_addr, kTBAARuntimeInfo);
 }
 
 llvm::Value* GBCExpanderPass::
 EmitLoadVirtualCalleeMethodObjectAddr(int vtable_idx, llvm::Value* this_addr) {
   // Load class object of *this* pointer
   llvm::Value* class_object_addr =
-    irb_.LoadFromObjectOffset(this_addr,
-                              art::mirror::Object::ClassOffset().Int32Value(),
-                              irb_.getJObjectTy(),
-                              kTBAAConstJObject);
+    irb_.LoadHeapReferenceFromObjectOffset(this_addr,
+                                           art::mirror::Object::ClassOffset().Int32Value(),
+                                           kTBAAConstJObject);
 
   // Load vtable address
   llvm::Value* vtable_addr =
-    irb_.LoadFromObjectOffset(class_object_addr,
-                              art::mirror::Class::VTableOffset().Int32Value(),
-                              irb_.getJObjectTy(),
-                              kTBAAConstJObject);
+    irb_.LoadHeapReferenceFromObjectOffset(class_object_addr,
+                                           art::mirror::Class::VTableOffset().Int32Value(),
+                                           kTBAAConstJObject);
 
   // Load callee method object
   llvm::Value* vtable_idx_value =
@@ -790,16 +787,16 @@ EmitLoadVirtualCalleeMethodObjectAddr(int vtable_idx, llvm::Value* this_addr) {
   llvm::Value* method_field_addr =
     EmitArrayGEP(vtable_addr, vtable_idx_value, kObject);
 
-  return irb_.CreateLoad(method_field_addr, kTBAAConstJObject);
+  return irb_.CreateHeapReferenceLoad(method_field_addr, kTBAAConstJObject);
 }
 
 // Emit Array GetElementPtr
 llvm::Value* GBCExpanderPass::EmitArrayGEP(llvm::Value* array_addr,
                                            llvm::Value* index_value,
                                            JType elem_jty) {
+  // Object array elements are heap references, which are 32-bit on every target.
   int data_offset;
-  if (elem_jty == kLong || elem_jty == kDouble ||
-      (elem_jty == kObject && sizeof(uint64_t) == sizeof(art::mirror::Object*))) {
+  if (elem_jty == kLong || elem_jty == kDouble) {
     data_offset = art::mirror::Array::DataOffset(sizeof(int64_t)).Int32Value();
   } else {
     data_offset = art::mirror::Array::DataOffset(sizeof(int32_t)).Int32Value();
@@ -808,7 +805,8 @@ llvm::Value* GBCExpanderPass::EmitArrayGEP(llvm::Value* array_addr,
   llvm::Constant* data_offset_value =
     irb_.getPtrEquivInt(data_offset);
 
-  llvm::Type* elem_type = irb_.getJType(elem_jty);
+  llvm::Type* elem_type =
+      (elem_jty == kObject) ? irb_.getHeapReferenceTy() : irb_.getJType(elem_jty);
 
   llvm::Value* array_data_addr =
     irb_.CreatePtrDisp(array_addr, data_offset_value,
@@ -963,9 +961,8 @@ void GBCExpanderPass::Expand_TestSuspend(llvm::CallInst& call_inst) {
   uint32_t dex_pc = LV2UInt(call_inst.getMetadata("DexOff")->getOperand(0));
 
   llvm::Value* suspend_count =
-      irb_.Runtime().EmitLoadFromThreadOffset(art::Thread::ThreadFlagsOffset<8>().Int32Value(),
-                                              irb_.getInt16Ty(),
-                                              kTBAARuntimeInfo);
+      irb_.Runtime().EmitLoadFromThreadOffset(PORTABLE_THREAD_OFFSET(irb_, ThreadFlagsOffset),
+                                              irb_.getInt16Ty(), kTBAARuntimeInfo);
   llvm::Value* is_suspend = irb_.CreateICmpNE(suspend_count, irb_.getInt16(0));
 
   llvm::BasicBlock* basic_block_suspend = CreateBasicBlockWithDexPC(dex_pc, "suspend");
@@ -1008,7 +1005,7 @@ GBCExpanderPass::Expand_LoadStringFromDexCache(llvm::Value* string_idx_value) {
 
   llvm::Value* string_field_addr = EmitLoadDexCacheStringFieldAddr(string_idx);
 
-  return irb_.CreateLoad(string_field_addr, kTBAARuntimeInfo);
+  return irb_.CreateHeapReferenceLoad(string_field_addr, kTBAARuntimeInfo);
 }
 
 llvm::Value*
@@ -1019,7 +1016,7 @@ GBCExpanderPass::Expand_LoadTypeFromDexCache(llvm::Value* type_idx_value) {
   llvm::Value* type_field_addr =
     EmitLoadDexCacheResolvedTypeFieldAddr(type_idx);
 
-  return irb_.CreateLoad(type_field_addr, kTBAARuntimeInfo);
+  return irb_.CreateHeapReferenceLoad(type_field_addr, kTBAARuntimeInfo);
 }
 
 void GBCExpanderPass::Expand_LockObject(llvm::Value* obj) {
@@ -1072,14 +1069,13 @@ void GBCExpanderPass::Expand_FilledNewArray(llvm::CallInst& call_inst) {
   // NOTE: Currently filled-new-array only supports 'L', '[', and 'I'
   // as the element, thus we are only checking 2 cases: primitive int and
   // non-primitive type.
+  // Both kinds of element are 32-bit: heap references are compressed on 64-bit targets.
+  alignment = sizeof(int32_t);
+  elem_size = irb_.getPtrEquivInt(sizeof(int32_t));
   if (is_elem_int_ty) {
-    alignment = sizeof(int32_t);
-    elem_size = irb_.getPtrEquivInt(sizeof(int32_t));
     field_type = irb_.getJIntTy()->getPointerTo();
   } else {
-    alignment = irb_.getSizeOfPtrEquivInt();
-    elem_size = irb_.getSizeOfPtrEquivIntValue();
-    field_type = irb_.getJObjectTy()->getPointerTo();
+    field_type = irb_.getHeapReferenceTy()->getPointerTo();
   }
 
   llvm::Value* data_field_offset =
@@ -1092,7 +1088,11 @@ void GBCExpanderPass::Expand_FilledNewArray(llvm::CallInst& call_inst) {
     // Values to fill the array begin at the 3rd argument
     llvm::Value* reg_value = call_inst.getArgOperand(2 + i);
 
-    irb_.CreateStore(reg_value, data_field_addr, kTBAAHeapArray);
+    if (is_elem_int_ty) {
+      irb_.CreateStore(reg_value, data_field_addr, kTBAAHeapArray);
+    } else {
+      irb_.CreateHeapReferenceStore(reg_value, data_field_addr, kTBAAHeapArray);
+    }
 
     data_field_addr =
       irb_.CreatePtrDisp(data_field_addr, elem_size, field_type);
@@ -1193,10 +1193,9 @@ void GBCExpanderPass::Expand_SPutFast(llvm::Value* static_storage_addr,
 
 llvm::Value*
 GBCExpanderPass::Expand_LoadDeclaringClassSSB(llvm::Value* method_object_addr) {
-  return irb_.LoadFromObjectOffset(method_object_addr,
-                                   art::mirror::ArtMethod::DeclaringClassOffset().Int32Value(),
-                                   irb_.getJObjectTy(),
-                                   kTBAAConstJObject);
+  return irb_.LoadHeapReferenceFromObjectOffset(
+      method_object_addr, art::mirror::ArtMethod::DeclaringClassOffset().Int32Value(),
+      kTBAAConstJObject);
 }
 
 llvm::Value*
@@ -1754,7 +1753,7 @@ llvm::Value* GBCExpanderPass::EmitLoadConstantClass(uint32_t dex_pc,
     llvm::Value* type_field_addr =
       EmitLoadDexCacheResolvedTypeFieldAddr(type_idx);
 
-    llvm::Value* type_object_addr = irb_.CreateLoad(type_field_addr, kTBAARuntimeInfo);
+    llvm::Value* type_object_addr = irb_.CreateHeapReferenceLoad(type_field_addr, kTBAARuntimeInfo);
 
     if (driver_->CanAssumeTypeIsPresentInDexCache(*dex_compilation_unit_->GetDexFile(), type_idx)) {
       return type_object_addr;
@@ -1819,7 +1818,8 @@ llvm::Value* GBCExpanderPass::EmitLoadStaticStorage(uint32_t dex_pc,
   // Load static storage from dex cache
   llvm::Value* storage_field_addr = EmitLoadDexCacheResolvedTypeFieldAddr(type_idx);
 
-  llvm::Value* storage_object_addr = irb_.CreateLoad(storage_field_addr, kTBAARuntimeInfo);
+  llvm::Value* storage_object_addr =
+      irb_.CreateHeapReferenceLoad(storage_field_addr, kTBAARuntimeInfo);
 
   // Test: Is the class resolved?
   llvm::Value* equal_null = irb_.CreateICmpEQ(storage_object_addr, irb_.getJNull());
@@ -1923,10 +1923,9 @@ llvm::Value* GBCExpanderPass::Expand_HLSget(llvm::CallInst& call_inst,
       llvm::Value* method_object_addr = EmitLoadMethodObjectAddr();
 
       static_storage_addr =
-        irb_.LoadFromObjectOffset(method_object_addr,
-                                  art::mirror::ArtMethod::DeclaringClassOffset().Int32Value(),
-                                  irb_.getJObjectTy(),
-                                  kTBAAConstJObject);
+        irb_.LoadHeapReferenceFromObjectOffset(
+            method_object_addr, art::mirror::ArtMethod::DeclaringClassOffset().Int32Value(),
+            kTBAAConstJObject);
     } else {
       // Medium path, static storage base in a different class which
       // requires checks that the other class is initialized
@@ -2009,10 +2008,9 @@ void GBCExpanderPass::Expand_HLSput(llvm::CallInst& call_inst,
       llvm::Value* method_object_addr = EmitLoadMethodObjectAddr();
 
       static_storage_addr =
-        irb_.LoadFromObjectOffset(method_object_addr,
-                                  art::mirror::ArtMethod::DeclaringClassOffset().Int32Value(),
-                                  irb_.getJObjectTy(),
-                                  kTBAAConstJObject);
+        irb_.LoadHeapReferenceFromObjectOffset(
+            method_object_addr, art::mirror::ArtMethod::DeclaringClassOffset().Int32Value(),
+            kTBAAConstJObject);
     } else {
       // Medium path, static storage base in a different class which
       // requires checks that the other class is initialized
@@ -2051,7 +2049,7 @@ llvm::Value* GBCExpanderPass::Expand_ConstString(llvm::CallInst& call_inst) {
 
   llvm::Value* string_field_addr = EmitLoadDexCacheStringFieldAddr(string_idx);
 
-  llvm::Value* string_addr = irb_.CreateLoad(string_field_addr, kTBAARuntimeInfo);
+  llvm::Value* string_addr = irb_.CreateHeapReferenceLoad(string_field_addr, kTBAARuntimeInfo);
 
   if (!driver_->CanAssumeStringIsPresentInDexCache(*dex_compilation_unit_->GetDexFile(),
                                                    string_idx)) {
@@ -2170,13 +2168,11 @@ void GBCExpanderPass::Expand_HLCheckCast(llvm::CallInst& call_inst) {
   llvm::Value* type_object_addr = EmitLoadConstantClass(dex_pc, type_idx);
   DCHECK_EQ(art::mirror::Object::ClassOffset().Int32Value(), 0);
 
-  llvm::PointerType* jobject_ptr_ty = irb_.getJObjectTy();
-
   llvm::Value* object_type_field_addr =
-    irb_.CreateBitCast(object_addr, jobject_ptr_ty->getPointerTo());
+    irb_.CreateBitCast(object_addr, irb_.getHeapReferenceTy()->getPointerTo());
 
   llvm::Value* object_type_object_addr =
-    irb_.CreateLoad(object_type_field_addr, kTBAAConstJObject);
+    irb_.CreateHeapReferenceLoad(object_type_field_addr, kTBAAConstJObject);
 
   llvm::Value* equal_class =
     irb_.CreateICmpEQ(type_object_addr, object_type_object_addr);
@@ -2237,13 +2233,11 @@ llvm::Value* GBCExpanderPass::Expand_InstanceOf(llvm::CallInst& call_inst) {
   llvm::Value* type_object_addr = EmitLoadConstantClass(dex_pc, type_idx);
   DCHECK_EQ(art::mirror::Object::ClassOffset().Int32Value(), 0);
 
-  llvm::PointerType* jobject_ptr_ty = irb_.getJObjectTy();
-
   llvm::Value* object_type_field_addr =
-    irb_.CreateBitCast(object_addr, jobject_ptr_ty->getPointerTo());
+    irb_.CreateBitCast(object_addr, irb_.getHeapReferenceTy()->getPointerTo());
 
   llvm::Value* object_type_object_addr =
-    irb_.CreateLoad(object_type_field_addr, kTBAAConstJObject);
+    irb_.CreateHeapReferenceLoad(object_type_field_addr, kTBAAConstJObject);
 
   llvm::Value* equal_class =
     irb_.CreateICmpEQ(type_object_addr, object_type_object_addr);
@@ -2366,14 +2360,13 @@ llvm::Value* GBCExpanderPass::Expand_HLFilledNewArray(llvm::CallInst& call_inst)
     // NOTE: Currently filled-new-array only supports 'L', '[', and 'I'
     // as the element, thus we are only checking 2 cases: primitive int and
     // non-primitive type.
+    // Both kinds of element are 32-bit: heap references are compressed on 64-bit targets.
+    alignment = sizeof(int32_t);
+    elem_size = irb_.getPtrEquivInt(sizeof(int32_t));
     if (is_elem_int_ty) {
-      alignment = sizeof(int32_t);
-      elem_size = irb_.getPtrEquivInt(sizeof(int32_t));
       field_type = irb_.getJIntTy()->getPointerTo();
     } else {
-      alignment = irb_.getSizeOfPtrEquivInt();
-      elem_size = irb_.getSizeOfPtrEquivIntValue();
-      field_type = irb_.getJObjectTy()->getPointerTo();
+      field_type = irb_.getHeapReferenceTy()->getPointerTo();
     }
 
     llvm::Value* data_field_offset =
@@ -2389,7 +2382,11 @@ llvm::Value* GBCExpanderPass::Expand_HLFilledNewArray(llvm::CallInst& call_inst)
     for (uint32_t i = 0; i < length; ++i) {
       llvm::Value* reg_value = call_inst.getArgOperand(i+3);
 
-      irb_.CreateStore(reg_value, data_field_addr, kTBAAHeapArray);
+      if (is_elem_int_ty) {
+        irb_.CreateStore(reg_value, data_field_addr, kTBAAHeapArray);
+      } else {
+        irb_.CreateHeapReferenceStore(reg_value, data_field_addr, kTBAAHeapArray);
+      }
 
       data_field_addr =
         irb_.CreatePtrDisp(data_field_addr, elem_size, field_type);
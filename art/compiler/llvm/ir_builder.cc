@@ -29,8 +29,10 @@ namespace llvm {
 //----------------------------------------------------------------------------
 
 IRBuilder::IRBuilder(::llvm::LLVMContext& context, ::llvm::Module& module,
-                     IntrinsicHelper& intrinsic_helper)
-    : LLVMIRBuilder(context), module_(&module), mdb_(context), java_object_type_(NULL),
+                     IntrinsicHelper& intrinsic_helper, InstructionSet instruction_set)
+    : LLVMIRBuilder(context), module_(&module),
+      pointer_size_(GetInstructionSetPointerSize(instruction_set)), mdb_(context),
+      java_object_type_(NULL),
       java_method_type_(NULL), java_thread_type_(NULL), intrinsic_helper_(intrinsic_helper) {
   // Get java object type from module
   ::llvm::Type* jobject_struct_type = module.getTypeByName("JavaObject");
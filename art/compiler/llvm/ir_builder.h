@@ -19,6 +19,7 @@
 
 #include "backend_types.h"
 #include "dex/compiler_enums.h"
+#include "instruction_set.h"
 #include "intrinsic_helper.h"
 #include "md_builder.h"
 #include "runtime_support_builder.h"
@@ -69,7 +70,7 @@ class IRBuilder : public LLVMIRBuilder {
   //--------------------------------------------------------------------------
 
   IRBuilder(::llvm::LLVMContext& context, ::llvm::Module& module,
-            IntrinsicHelper& intrinsic_helper);
+            IntrinsicHelper& intrinsic_helper, InstructionSet instruction_set);
 
 
   //--------------------------------------------------------------------------
@@ -121,13 +122,19 @@ class IRBuilder : public LLVMIRBuilder {
     return CreateStore(val, ptr, mdb_.GetTBAASpecialType(special_ty));
   }
 
-  ::llvm::LoadInst* CreateLoad(::llvm::Value* ptr, TBAASpecialType special_ty, JType j_ty) {
+  ::llvm::Value* CreateLoad(::llvm::Value* ptr, TBAASpecialType special_ty, JType j_ty) {
+    if (j_ty == kObject) {
+      return CreateHeapReferenceLoad(ptr, mdb_.GetTBAAMemoryJType(special_ty, j_ty));
+    }
     return CreateLoad(ptr, mdb_.GetTBAAMemoryJType(special_ty, j_ty));
   }
 
   ::llvm::StoreInst* CreateStore(::llvm::Value* val, ::llvm::Value* ptr,
                                TBAASpecialType special_ty, JType j_ty) {
     DCHECK_NE(special_ty, kTBAAConstJObject) << "ConstJObject is read only!";
+    if (j_ty == kObject) {
+      return CreateHeapReferenceStore(val, ptr, mdb_.GetTBAAMemoryJType(special_ty, j_ty));
+    }
     return CreateStore(val, ptr, mdb_.GetTBAAMemoryJType(special_ty, j_ty));
   }
 
@@ -138,6 +145,13 @@ class IRBuilder : public LLVMIRBuilder {
     return LoadFromObjectOffset(object_addr, offset, type, mdb_.GetTBAASpecialType(special_ty));
   }
 
+  ::llvm::Value* LoadHeapReferenceFromObjectOffset(::llvm::Value* object_addr,
+                                                   int64_t offset,
+                                                   TBAASpecialType special_ty) {
+    return LoadHeapReferenceFromObjectOffset(object_addr, offset,
+                                             mdb_.GetTBAASpecialType(special_ty));
+  }
+
   void StoreToObjectOffset(::llvm::Value* object_addr,
                            int64_t offset,
                            ::llvm::Value* new_value,
@@ -176,6 +190,16 @@ class IRBuilder : public LLVMIRBuilder {
     inst->setMetadata(::llvm::LLVMContext::MD_tbaa, mdb_.GetTBAASpecialType(special_ty));
   }
 
+  ::llvm::Value* CreateHeapReferenceLoad(::llvm::Value* ref_addr, TBAASpecialType special_ty) {
+    return CreateHeapReferenceLoad(ref_addr, mdb_.GetTBAASpecialType(special_ty));
+  }
+
+  ::llvm::StoreInst* CreateHeapReferenceStore(::llvm::Value* ref, ::llvm::Value* ref_addr,
+                                              TBAASpecialType special_ty) {
+    DCHECK_NE(special_ty, kTBAAConstJObject) << "ConstJObject is read only!";
+    return CreateHeapReferenceStore(ref, ref_addr, mdb_.GetTBAASpecialType(special_ty));
+  }
+
 
   //--------------------------------------------------------------------------
   // Static Branch Prediction
@@ -201,11 +225,11 @@ class IRBuilder : public LLVMIRBuilder {
   //--------------------------------------------------------------------------
 
   ::llvm::IntegerType* getPtrEquivIntTy() {
-    return getInt32Ty();
+    return ::llvm::IntegerType::get(getContext(), pointer_size_ * 8);
   }
 
   size_t getSizeOfPtrEquivInt() {
-    return 4;
+    return pointer_size_;
   }
 
   ::llvm::ConstantInt* getSizeOfPtrEquivIntValue() {
@@ -279,6 +303,52 @@ class IRBuilder : public LLVMIRBuilder {
   }
 
 
+  //--------------------------------------------------------------------------
+  // Heap Reference Helper Function
+  //--------------------------------------------------------------------------
+
+  // References stored in the managed heap are always 32-bit, while a JavaObject* value has the
+  // width of a target pointer. On 64-bit targets a heap reference is zero-extended when loaded
+  // and truncated when stored.
+  bool IsHeapReferenceNarrowerThanPointer() {
+    return pointer_size_ != kHeapReferenceSize;
+  }
+
+  ::llvm::Type* getHeapReferenceTy() {
+    if (IsHeapReferenceNarrowerThanPointer()) {
+      return getInt32Ty();
+    }
+    return getJObjectTy();
+  }
+
+  ::llvm::Value* CreateHeapReferenceLoad(::llvm::Value* ref_addr, ::llvm::MDNode* tbaa_info) {
+    ::llvm::Value* slot_addr = CreateBitCast(ref_addr, getHeapReferenceTy()->getPointerTo());
+    ::llvm::Value* ref = CreateLoad(slot_addr, tbaa_info);
+    if (IsHeapReferenceNarrowerThanPointer()) {
+      ref = CreateIntToPtr(CreateZExt(ref, getPtrEquivIntTy()), getJObjectTy());
+    }
+    return ref;
+  }
+
+  ::llvm::StoreInst* CreateHeapReferenceStore(::llvm::Value* ref, ::llvm::Value* ref_addr,
+                                              ::llvm::MDNode* tbaa_info) {
+    if (IsHeapReferenceNarrowerThanPointer()) {
+      ref = CreateTrunc(CreatePtrToInt(ref, getPtrEquivIntTy()), getInt32Ty());
+    }
+    ::llvm::Value* slot_addr = CreateBitCast(ref_addr, getHeapReferenceTy()->getPointerTo());
+    return CreateStore(ref, slot_addr, tbaa_info);
+  }
+
+  ::llvm::Value* LoadHeapReferenceFromObjectOffset(::llvm::Value* object_addr,
+                                                   int64_t offset,
+                                                   ::llvm::MDNode* tbaa_info) {
+    ::llvm::Value* llvm_offset = getPtrEquivInt(offset);
+    ::llvm::Value* ref_addr = CreatePtrDisp(object_addr, llvm_offset,
+                                            getHeapReferenceTy()->getPointerTo());
+    return CreateHeapReferenceLoad(ref_addr, tbaa_info);
+  }
+
+
   //--------------------------------------------------------------------------
   // Runtime Helper Function
   //--------------------------------------------------------------------------
@@ -464,8 +534,13 @@ class IRBuilder : public LLVMIRBuilder {
 
 
  private:
+  // Size of a reference slot in the managed heap, see mirror::HeapReference.
+  static constexpr size_t kHeapReferenceSize = 4;
+
   ::llvm::Module* module_;
 
+  const size_t pointer_size_;
+
   MDBuilder mdb_;
 
   ::llvm::PointerType* java_object_type_;
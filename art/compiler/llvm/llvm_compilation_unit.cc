@@ -82,8 +82,11 @@
 #include "ir_builder.h"
 #include "os.h"
 #include "runtime_support_builder_arm.h"
+#include "runtime_support_builder_arm64.h"
 #include "runtime_support_builder_x86.h"
+#include "runtime_support_builder_x86_64.h"
 #include "utils_llvm.h"
+#include "whole_program_module.h"
 
 namespace art {
 namespace llvm {
@@ -99,7 +102,8 @@ LlvmCompilationUnit::LlvmCompilationUnit(const CompilerLLVM* compiler_llvm, size
     : compiler_llvm_(compiler_llvm), cunit_id_(cunit_id) {
   driver_ = NULL;
   dex_compilation_unit_ = NULL;
-  llvm_info_.reset(new LLVMInfo());
+  whole_program_module_ = NULL;
+  llvm_info_.reset(new LLVMInfo(GetInstructionSet()));
   context_.reset(llvm_info_->GetLLVMContext());
   module_ = llvm_info_->GetLLVMModule();
 
@@ -110,7 +114,7 @@ LlvmCompilationUnit::LlvmCompilationUnit(const CompilerLLVM* compiler_llvm, size
   intrinsic_helper_.reset(new IntrinsicHelper(*context_, *module_));
 
   // Create IRBuilder
-  irb_.reset(new IRBuilder(*context_, *module_, *intrinsic_helper_));
+  irb_.reset(new IRBuilder(*context_, *module_, *intrinsic_helper_, GetInstructionSet()));
 
   // We always need a switch case, so just use a normal function.
   switch (GetInstructionSet()) {
@@ -121,9 +125,15 @@ LlvmCompilationUnit::LlvmCompilationUnit(const CompilerLLVM* compiler_llvm, size
   case kArm:
     runtime_support_.reset(new RuntimeSupportBuilderARM(*context_, *module_, *irb_));
     break;
+  case kArm64:
+    runtime_support_.reset(new RuntimeSupportBuilderARM64(*context_, *module_, *irb_));
+    break;
   case kX86:
     runtime_support_.reset(new RuntimeSupportBuilderX86(*context_, *module_, *irb_));
     break;
+  case kX86_64:
+    runtime_support_.reset(new RuntimeSupportBuilderX86_64(*context_, *module_, *irb_));
+    break;
   }
 
   irb_->SetRuntimeSupport(runtime_support_.get());
@@ -194,12 +204,12 @@ bool LlvmCompilationUnit::MaterializeToString(std::string& str_buffer) {
 }
 
 
-bool LlvmCompilationUnit::MaterializeToRawOStream(::llvm::raw_ostream& out_stream) {
+::llvm::TargetMachine* LlvmCompilationUnit::CreateTargetMachine(InstructionSet insn_set) {
   // Lookup the LLVM target
   std::string target_triple;
   std::string target_cpu;
   std::string target_attr;
-  CompilerDriver::InstructionSetToLLVMTarget(GetInstructionSet(), &target_triple, &target_cpu,
+  CompilerDriver::InstructionSetToLLVMTarget(insn_set, &target_triple, &target_cpu,
                                              &target_attr);
 
   std::string errmsg;
@@ -214,14 +224,26 @@ bool LlvmCompilationUnit::MaterializeToRawOStream(::llvm::raw_ostream& out_strea
   target_options.NoFramePointerElim = true;
   target_options.UseSoftFloat = false;
   target_options.EnableFastISel = false;
+  if (insn_set == kArm64) {
+    // There is no soft-float variant of the AArch64 procedure call standard: floating point
+    // arguments and results live in v0-v7, which is what the arm64 portable stubs expect.
+    target_options.FloatABIType = ::llvm::FloatABI::Hard;
+  }
 
   // Create the ::llvm::TargetMachine
-  ::llvm::OwningPtr< ::llvm::TargetMachine> target_machine(
+  ::llvm::TargetMachine* target_machine =
     target->createTargetMachine(target_triple, target_cpu, target_attr, target_options,
                                 ::llvm::Reloc::Static, ::llvm::CodeModel::Small,
-                                ::llvm::CodeGenOpt::Aggressive));
+                                ::llvm::CodeGenOpt::Aggressive);
+
+  CHECK(target_machine != NULL) << "Failed to create target machine";
+  return target_machine;
+}
 
-  CHECK(target_machine.get() != NULL) << "Failed to create target machine";
+
+bool LlvmCompilationUnit::MaterializeToRawOStream(::llvm::raw_ostream& out_stream) {
+  ::llvm::OwningPtr< ::llvm::TargetMachine> target_machine(
+      CreateTargetMachine(GetInstructionSet()));
 
   // Add target data
   const ::llvm::DataLayout* data_layout = target_machine->getDataLayout();
@@ -234,7 +256,7 @@ bool LlvmCompilationUnit::MaterializeToRawOStream(::llvm::raw_ostream& out_strea
   ::llvm::FunctionPassManager fpm(module_);
   fpm.add(new ::llvm::DataLayout(*data_layout));
 
-  if (bitcode_filename_.empty()) {
+  if (bitcode_filename_.empty() && whole_program_module_ == NULL) {
     // If we don't need write the bitcode to file, add the AddSuspendCheckToLoopLatchPass to the
     // regular FunctionPass.
     fpm.add(CreateGBCExpanderPass(*llvm_info_->GetIntrinsicHelper(), *irb_.get(),
@@ -250,21 +272,30 @@ bool LlvmCompilationUnit::MaterializeToRawOStream(::llvm::raw_ostream& out_strea
     }
     fpm2.doFinalization();
 
-    // Write bitcode to file
-    std::string errmsg;
+    if (whole_program_module_ != NULL) {
+      // Hand the expanded, still unoptimized, method to the whole program module.
+      std::string bitcode;
+      DumpBitcodeToString(bitcode);
+      whole_program_module_->AddMethod(dex_compilation_unit_->GetSymbol(), bitcode);
+    }
 
-    ::llvm::OwningPtr< ::llvm::tool_output_file> out_file(
-      new ::llvm::tool_output_file(bitcode_filename_.c_str(), errmsg,
-                                 ::llvm::sys::fs::F_Binary));
+    if (!bitcode_filename_.empty()) {
+      // Write bitcode to file
+      std::string errmsg;
 
+      ::llvm::OwningPtr< ::llvm::tool_output_file> out_file(
+        new ::llvm::tool_output_file(bitcode_filename_.c_str(), errmsg,
+                                   ::llvm::sys::fs::F_Binary));
 
-    if (!errmsg.empty()) {
-      LOG(ERROR) << "Failed to create bitcode output file: " << errmsg;
-      return false;
-    }
 
-    ::llvm::WriteBitcodeToFile(module_, out_file->os());
-    out_file->keep();
+      if (!errmsg.empty()) {
+        LOG(ERROR) << "Failed to create bitcode output file: " << errmsg;
+        return false;
+      }
+
+      ::llvm::WriteBitcodeToFile(module_, out_file->os());
+      out_file->keep();
+    }
   }
 
   // Add optimization pass
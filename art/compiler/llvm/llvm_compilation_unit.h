@@ -41,6 +41,7 @@ namespace llvm {
   class LLVMContext;
   class Module;
   class raw_ostream;
+  class TargetMachine;
 }
 
 namespace art {
@@ -48,6 +49,7 @@ namespace llvm {
 
 class CompilerLLVM;
 class IRBuilder;
+class WholeProgramModule;
 
 class LlvmCompilationUnit {
  public:
@@ -87,6 +89,13 @@ class LlvmCompilationUnit {
   void SetDexCompilationUnit(DexCompilationUnit* dex_compilation_unit) {
     dex_compilation_unit_ = dex_compilation_unit;
   }
+  // The expanded bitcode of the method is also added to this module, see WholeProgramModule.
+  void SetWholeProgramModule(WholeProgramModule* whole_program_module) {
+    whole_program_module_ = whole_program_module;
+  }
+
+  // Creates the target machine used to generate code for the instruction set.
+  static ::llvm::TargetMachine* CreateTargetMachine(InstructionSet insn_set);
 
   bool Materialize();
 
@@ -114,6 +123,7 @@ class LlvmCompilationUnit {
   UniquePtr<LLVMInfo> llvm_info_;
   CompilerDriver* driver_;
   DexCompilationUnit* dex_compilation_unit_;
+  WholeProgramModule* whole_program_module_;
 
   std::string bitcode_filename_;
 
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "llvm_jit.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "base/stringprintf.h"
+#include "compiled_method.h"
+#include "dex/verification_results.h"
+#include "handle_scope-inl.h"
+#include "jni_internal.h"
+#include "mem_map.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/class_loader.h"
+#include "mirror/dex_cache.h"
+#include "object_utils.h"
+#include "ScopedLocalRef.h"
+#include "scoped_thread_state_change.h"
+#include "thread.h"
+#include "utils.h"
+#include "verifier/method_verifier-inl.h"
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ExecutionEngine/ObjectBuffer.h>
+#include <llvm/ExecutionEngine/RTDyldMemoryManager.h>
+#include <llvm/ExecutionEngine/RuntimeDyld.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace art {
+namespace llvm {
+
+// Sizes of the regions the JIT allocates loaded sections from. Code is never freed.
+static constexpr size_t kJitCodeCapacity = 16 * MB;
+static constexpr size_t kJitDataCapacity = 4 * MB;
+
+// Bump allocates the sections of the loaded objects from two mappings, one for code and one for
+// data. Code pages are writable until finalizeMemory makes them read-only and executable, which
+// the JIT does once per batch of methods, so the methods of a batch are packed on the same pages
+// and only the code of the next batch starts on a fresh page. Only used from the JIT compiler
+// thread.
+class JitMemoryManager : public ::llvm::RTDyldMemoryManager {
+ public:
+  static JitMemoryManager* Create(std::string* error_msg) {
+    UniquePtr<MemMap> code_map(MemMap::MapAnonymous("portable jit code", nullptr, kJitCodeCapacity,
+                                                    PROT_READ | PROT_WRITE, false,
+                                                    error_msg));
+    if (code_map.get() == nullptr) {
+      return nullptr;
+    }
+    UniquePtr<MemMap> data_map(MemMap::MapAnonymous("portable jit data", nullptr, kJitDataCapacity,
+                                                    PROT_READ | PROT_WRITE, false, error_msg));
+    if (data_map.get() == nullptr) {
+      return nullptr;
+    }
+    return new JitMemoryManager(code_map.release(), data_map.release());
+  }
+
+  uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment, unsigned section_id) OVERRIDE {
+    UNUSED(section_id);
+    return Allocate(code_map_.get(), &code_end_, size, alignment);
+  }
+
+  uint8_t* allocateDataSection(uintptr_t size, unsigned alignment, unsigned section_id,
+                               bool is_read_only) OVERRIDE {
+    UNUSED(section_id);
+    UNUSED(is_read_only);
+    return Allocate(data_map_.get(), &data_end_, size, alignment);
+  }
+
+  // Returns true on error, like the rest of the RuntimeDyld interfaces.
+  bool finalizeMemory(std::string* error_msg) OVERRIDE {
+    byte* end = AlignUp(code_end_, kPageSize);
+    if (end == code_finalized_end_) {
+      return false;
+    }
+    // The code was written through the data cache, make it visible to instruction fetch.
+    __builtin___clear_cache(reinterpret_cast<char*>(code_finalized_end_),
+                            reinterpret_cast<char*>(code_end_));
+    if (mprotect(code_finalized_end_, end - code_finalized_end_, PROT_READ | PROT_EXEC) != 0) {
+      if (error_msg != nullptr) {
+        *error_msg = StringPrintf("Failed to make JIT code executable: %s", strerror(errno));
+      }
+      return true;
+    }
+    code_end_ = end;
+    code_finalized_end_ = end;
+    return false;
+  }
+
+  size_t CodeSize() const {
+    return code_end_ - code_map_->Begin();
+  }
+
+  // Whether an allocation failed for lack of space. Code is never freed, so later allocations
+  // would fail as well.
+  bool IsExhausted() const {
+    return exhausted_;
+  }
+
+ private:
+  JitMemoryManager(MemMap* code_map, MemMap* data_map)
+      : code_map_(code_map), data_map_(data_map),
+        code_end_(code_map->Begin()), code_finalized_end_(code_map->Begin()),
+        data_end_(data_map->Begin()), exhausted_(false) {
+  }
+
+  uint8_t* Allocate(MemMap* map, byte** end, uintptr_t size, unsigned alignment) {
+    if (alignment == 0) {
+      alignment = 16;
+    }
+    byte* begin = reinterpret_cast<byte*>(RoundUp(reinterpret_cast<uintptr_t>(*end), alignment));
+    if (begin + size > map->End()) {
+      // RuntimeDyld reports the failed allocation and the method is left to the interpreter.
+      LOG(WARNING) << "Portable JIT out of memory in " << map->GetName();
+      exhausted_ = true;
+      return nullptr;
+    }
+    *end = begin + size;
+    return begin;
+  }
+
+  UniquePtr<MemMap> code_map_;
+  UniquePtr<MemMap> data_map_;
+  byte* code_end_;
+  byte* code_finalized_end_;
+  byte* data_end_;
+  bool exhausted_;
+
+  DISALLOW_COPY_AND_ASSIGN(JitMemoryManager);
+};
+
+LlvmJitCompiler* LlvmJitCompiler::Create(VerificationResults* verification_results,
+                                         DexFileToMethodInlinerMap* method_inliner_map,
+                                         std::string* error_msg) {
+  JitMemoryManager* memory_manager = JitMemoryManager::Create(error_msg);
+  if (memory_manager == nullptr) {
+    return nullptr;
+  }
+  return new LlvmJitCompiler(verification_results, method_inliner_map, memory_manager);
+}
+
+LlvmJitCompiler::LlvmJitCompiler(VerificationResults* verification_results,
+                                 DexFileToMethodInlinerMap* method_inliner_map,
+                                 JitMemoryManager* memory_manager)
+    : verification_results_(verification_results),
+      method_inliner_map_(method_inliner_map),
+      memory_manager_(memory_manager) {
+  CHECK(verification_results_ != nullptr);
+  CHECK(method_inliner_map_ != nullptr);
+}
+
+LlvmJitCompiler::~LlvmJitCompiler() {
+  VLOG(compiler) << "Portable JIT code size " << PrettySize(memory_manager_->CodeSize());
+}
+
+bool LlvmJitCompiler::Init(std::string* error_msg) {
+  UNUSED(error_msg);
+  driver_.reset(new CompilerDriver(&compiler_options_,
+                                   verification_results_,
+                                   method_inliner_map_,
+                                   Compiler::kPortable,
+                                   kRuntimeISA,
+                                   InstructionSetFeatures::GuessInstructionSetFeatures(),
+                                   false,
+                                   nullptr,
+                                   1U,
+                                   false,
+                                   false,
+                                   nullptr));
+  return true;
+}
+
+const void* LlvmJitCompiler::CompileMethod(Thread* self, mirror::ArtMethod* method) {
+  CHECK(driver_.get() != nullptr) << "JIT compiler used before Runtime::Start";
+  const DexFile* dex_file;
+  const DexFile::CodeItem* code_item;
+  uint16_t class_def_idx;
+  uint32_t method_idx;
+  uint32_t access_flags;
+  InvokeType invoke_type;
+  jobject jclass_loader;
+  {
+    ScopedObjectAccess soa(self);
+    MethodHelper mh(method);
+    dex_file = &mh.GetDexFile();
+    code_item = mh.GetCodeItem();
+    class_def_idx = mh.GetClassDefIndex();
+    method_idx = method->GetDexMethodIndex();
+    access_flags = method->GetAccessFlags();
+    invoke_type = method->GetInvokeType();
+
+    // The backend needs the verified method for its GC map and devirtualization. Classes are not
+    // loaded from the compiler thread, unresolved types are left to soft failures.
+    StackHandleScope<2> hs(soa.Self());
+    Handle<mirror::DexCache> dex_cache(hs.NewHandle(mh.GetDexCache()));
+    Handle<mirror::ClassLoader> class_loader(
+        hs.NewHandle(method->GetDeclaringClass()->GetClassLoader()));
+    verifier::MethodVerifier verifier(dex_file, &dex_cache, &class_loader, &mh.GetClassDef(),
+                                      code_item, method_idx, method, access_flags, false, true);
+    if (!verifier.Verify() || !verification_results_->ProcessVerifiedMethod(&verifier)) {
+      VLOG(compiler) << "JIT not compiling unverified " << PrettyMethod(method);
+      return nullptr;
+    }
+    ScopedLocalRef<jobject> local_class_loader(soa.Env(),
+                                               soa.AddLocalReference<jobject>(class_loader.Get()));
+    jclass_loader = soa.Env()->NewGlobalRef(local_class_loader.get());
+  }
+
+  UniquePtr<CompiledMethod> compiled_method(
+      driver_->GetCompiler()->Compile(code_item, access_flags, invoke_type, class_def_idx,
+                                      method_idx, jclass_loader, *dex_file));
+  self->GetJniEnv()->DeleteGlobalRef(jclass_loader);
+  if (compiled_method.get() == nullptr) {
+    return nullptr;
+  }
+  return LoadCode(*compiled_method);
+}
+
+const void* LlvmJitCompiler::LoadCode(const CompiledMethod& compiled_method) {
+  const std::vector<uint8_t>* elf_object = compiled_method.GetPortableCode();
+  CHECK(elf_object != nullptr);
+  ::llvm::StringRef elf_data(reinterpret_cast<const char*>(&(*elf_object)[0]),
+                             elf_object->size());
+  ::llvm::ObjectBuffer object_buffer(
+      ::llvm::MemoryBuffer::getMemBuffer(elf_data, compiled_method.GetSymbol(), false));
+
+  // The sections are owned by the memory manager, the dynamic linker is only needed to load and
+  // relocate them.
+  ::llvm::RuntimeDyld dyld(memory_manager_.get());
+  if (dyld.loadObject(&object_buffer) == nullptr) {
+    LOG(WARNING) << "JIT failed to load " << compiled_method.GetSymbol() << ": "
+                 << dyld.getErrorString().str();
+    return nullptr;
+  }
+  dyld.resolveRelocations();
+  // The code stays writable until CommitCode.
+  return dyld.getSymbolAddress(compiled_method.GetSymbol());
+}
+
+bool LlvmJitCompiler::CommitCode() {
+  std::string error_msg;
+  if (memory_manager_->finalizeMemory(&error_msg)) {
+    LOG(WARNING) << "JIT failed to commit code: " << error_msg;
+    return false;
+  }
+  return true;
+}
+
+bool LlvmJitCompiler::HasCodeSpace() const {
+  return !memory_manager_->IsExhausted();
+}
+
+}  // namespace llvm
+}  // namespace art
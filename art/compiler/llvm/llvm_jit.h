@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_LLVM_LLVM_JIT_H_
+#define ART_COMPILER_LLVM_LLVM_JIT_H_
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "driver/compiler_driver.h"
+#include "driver/compiler_options.h"
+#include "jit/portable_jit.h"
+
+#include <UniquePtr.h>
+
+#include <string>
+
+namespace art {
+
+class CompiledMethod;
+class DexFileToMethodInlinerMap;
+class VerificationResults;
+
+namespace llvm {
+
+class JitMemoryManager;
+
+// Compiles single methods with the Portable backend for the PortableJit. The relocatable ELF
+// object produced for a method is loaded in process with the LLVM runtime dynamic linker, the
+// same way MCJIT loads its objects, instead of being linked into an oat file.
+class LlvmJitCompiler : public JitCompiler {
+ public:
+  // The compiler is handed to Runtime::Create with the "jitcompiler" option.
+  static LlvmJitCompiler* Create(VerificationResults* verification_results,
+                                 DexFileToMethodInlinerMap* method_inliner_map,
+                                 std::string* error_msg);
+
+  ~LlvmJitCompiler();
+
+  // Creates the CompilerDriver, which needs a runtime that is not started yet.
+  bool Init(std::string* error_msg) OVERRIDE;
+
+  const void* CompileMethod(Thread* self, mirror::ArtMethod* method) OVERRIDE
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
+  bool CommitCode() OVERRIDE;
+
+  bool HasCodeSpace() const OVERRIDE;
+
+ private:
+  LlvmJitCompiler(VerificationResults* verification_results,
+                  DexFileToMethodInlinerMap* method_inliner_map,
+                  JitMemoryManager* memory_manager);
+
+  // Loads the ELF object of the compiled method and returns the address of its code, which is not
+  // executable before CommitCode.
+  const void* LoadCode(const CompiledMethod& compiled_method);
+
+  VerificationResults* const verification_results_;
+  DexFileToMethodInlinerMap* const method_inliner_map_;
+  CompilerOptions compiler_options_;
+  UniquePtr<CompilerDriver> driver_;
+  UniquePtr<JitMemoryManager> memory_manager_;
+
+  DISALLOW_COPY_AND_ASSIGN(LlvmJitCompiler);
+};
+
+}  // namespace llvm
+}  // namespace art
+
+#endif  // ART_COMPILER_LLVM_LLVM_JIT_H_
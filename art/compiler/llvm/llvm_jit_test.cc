@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "llvm_jit.h"
+
+#include <limits.h>
+#include <unistd.h>
+
+#include "common_compiler_test.h"
+#include "entrypoints/entrypoint_utils.h"
+#include "jit/portable_jit.h"
+#include "mirror/art_method-inl.h"
+#include "runtime.h"
+#include "ScopedLocalRef.h"
+#include "scoped_thread_state_change.h"
+#include "thread.h"
+#include "UniquePtr.h"
+#include "utils.h"
+
+namespace art {
+namespace llvm {
+
+class LlvmJitTest : public CommonCompilerTest {
+ protected:
+  void SetUpRuntimeOptions(Runtime::Options* options) OVERRIDE {
+    CommonCompilerTest::SetUpRuntimeOptions(options);
+    std::string error_msg;
+    jit_compiler_.reset(LlvmJitCompiler::Create(verification_results_.get(),
+                                                method_inliner_map_.get(), &error_msg));
+    ASSERT_TRUE(jit_compiler_.get() != nullptr) << error_msg;
+    options->push_back(std::make_pair("jitcompiler", jit_compiler_.get()));
+    options->push_back(std::make_pair("-Xjitthreshold:1", reinterpret_cast<void*>(NULL)));
+  }
+
+  void TearDown() OVERRIDE {
+    // The JIT thread must be gone before the compiler it uses.
+    PortableJit* jit = Runtime::Current()->GetPortableJit();
+    if (jit != nullptr) {
+      jit->Stop();
+    }
+    CommonCompilerTest::TearDown();
+  }
+
+  UniquePtr<LlvmJitCompiler> jit_compiler_;
+};
+
+TEST_F(LlvmJitTest, CompilesHotMethod) {
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    LoadDex("StaticLeafMethods");
+  }
+  Thread::Current()->TransitionFromSuspendedToRunnable();
+  ASSERT_TRUE(runtime_->Start());
+  PortableJit* jit = runtime_->GetPortableJit();
+  ASSERT_TRUE(jit != nullptr);
+
+  JNIEnv* env = Thread::Current()->GetJniEnv();
+  ScopedLocalRef<jclass> klass(env, env->FindClass("StaticLeafMethods"));
+  ASSERT_TRUE(klass.get() != nullptr);
+  jmethodID sum = env->GetStaticMethodID(klass.get(), "sum", "(II)I");
+  ASSERT_TRUE(sum != nullptr);
+
+  // The first call initializes the class and leaves the method to the interpreter.
+  EXPECT_EQ(3, env->CallStaticIntMethod(klass.get(), sum, 1, 2));
+  mirror::ArtMethod* method;
+  {
+    ScopedObjectAccess soa(env);
+    method = soa.DecodeMethod(sum);
+    ASSERT_EQ(GetPortableToInterpreterBridge(), method->GetEntryPointFromPortableCompiledCode());
+    // Stand in for the profiler, with a threshold of one sample the method is queued at once.
+    jit->AddSample(method);
+  }
+  uint64_t sample_ns = NanoTime();
+
+  // Wait for the JIT thread to install the code.
+  bool compiled = false;
+  for (size_t i = 0; i < 1000 && !compiled; ++i) {
+    {
+      ScopedObjectAccess soa(env);
+      compiled = method->IsPortableCompiled();
+    }
+    if (!compiled) {
+      usleep(10 * 1000);
+    }
+  }
+  ASSERT_TRUE(compiled);
+  LOG(INFO) << "JIT code installed " << PrettyDuration(NanoTime() - sample_ns)
+            << " after the method turned hot";
+
+  // Calls now run the JIT'd code.
+  EXPECT_EQ(3, env->CallStaticIntMethod(klass.get(), sum, -2, 5));
+  EXPECT_EQ(-1, env->CallStaticIntMethod(klass.get(), sum, INT_MAX, INT_MIN));
+  EXPECT_EQ(-2, env->CallStaticIntMethod(klass.get(), sum, INT_MAX, INT_MAX));
+}
+
+}  // namespace llvm
+}  // namespace art
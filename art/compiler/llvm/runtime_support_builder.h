@@ -31,6 +31,12 @@ namespace llvm {
   class Value;
 }
 
+// Thread offsets are templated on the pointer size, which here is the one of the target being
+// compiled for rather than the one of the host.
+#define PORTABLE_THREAD_OFFSET(irb, offset_func) \
+  ((irb).getSizeOfPtrEquivInt() == 8 ? ::art::Thread::offset_func<8>().Int32Value() \
+                                     : ::art::Thread::offset_func<4>().Int32Value())
+
 namespace art {
 namespace llvm {
 
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "whole_program_module.h"
+
+#include <algorithm>
+
+#include <llvm/ADT/OwningPtr.h>
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Linker.h>
+#include <llvm/PassManager.h>
+#include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+
+#include "base/logging.h"
+#include "llvm_compilation_unit.h"
+#include "safe_map.h"
+#include "thread.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace art {
+namespace llvm {
+
+::llvm::Module* makeLLVMModuleContents(::llvm::Module* module);
+
+static ::llvm::Module* ParseBitcode(const std::string& bitcode, const std::string& name,
+                                    ::llvm::LLVMContext* context) {
+  ::llvm::OwningPtr< ::llvm::MemoryBuffer> buffer(
+      ::llvm::MemoryBuffer::getMemBuffer(bitcode, name, false));
+  std::string errmsg;
+  ::llvm::Module* module = ::llvm::ParseBitcodeFile(buffer.get(), *context, &errmsg);
+  if (module == NULL) {
+    LOG(ERROR) << "Failed to parse bitcode of " << name << ": " << errmsg;
+  }
+  return module;
+}
+
+static bool WriteObject(::llvm::TargetMachine* target_machine, ::llvm::Module* module,
+                        const std::string& filename) {
+  std::string errmsg;
+  ::llvm::OwningPtr< ::llvm::tool_output_file> out_file(
+      new ::llvm::tool_output_file(filename.c_str(), errmsg, ::llvm::sys::fs::F_Binary));
+  if (!errmsg.empty()) {
+    LOG(ERROR) << "Failed to create object output file: " << errmsg;
+    return false;
+  }
+
+  ::llvm::PassManager pm;
+  pm.add(new ::llvm::DataLayout(*target_machine->getDataLayout()));
+  // Drop the definitions that the partition does not need any more.
+  pm.add(::llvm::createGlobalDCEPass());
+  {
+    ::llvm::formatted_raw_ostream formatted_os(out_file->os(), false);
+    if (target_machine->addPassesToEmitFile(pm,
+                                            formatted_os,
+                                            ::llvm::TargetMachine::CGFT_ObjectFile,
+                                            true)) {
+      LOG(ERROR) << "Unable to generate ELF for this target";
+      return false;
+    }
+    pm.run(*module);
+  }
+  out_file->keep();
+  return true;
+}
+
+// Generates the code of one partition. Every partition parses its own copy of the optimized
+// module into a private context, since LLVM contexts cannot be shared between threads, and turns
+// the functions owned by other partitions into declarations.
+class PartitionCodegenTask : public Task {
+ public:
+  PartitionCodegenTask(InstructionSet insn_set, const std::string* bitcode,
+                       const SafeMap<std::string, size_t>* function_partitions, size_t partition,
+                       const std::string& filename, uint8_t* success)
+      : insn_set_(insn_set), bitcode_(bitcode), function_partitions_(function_partitions),
+        partition_(partition), filename_(filename), success_(success) {
+  }
+
+  void Run(Thread* self) {
+    UNUSED(self);
+    ::llvm::LLVMContext context;
+    ::llvm::OwningPtr< ::llvm::Module> module(ParseBitcode(*bitcode_, filename_, &context));
+    if (module.get() == NULL) {
+      return;
+    }
+    for (::llvm::Module::iterator F = module->begin(), E = module->end(); F != E; ++F) {
+      if (F->isDeclaration()) {
+        continue;
+      }
+      SafeMap<std::string, size_t>::const_iterator it = function_partitions_->find(F->getName());
+      DCHECK(it != function_partitions_->end());
+      if (it->second != partition_) {
+        F->deleteBody();
+      }
+    }
+    if (partition_ != 0) {
+      // Mutable data is only defined by the first partition, constants are duplicated.
+      for (::llvm::Module::global_iterator G = module->global_begin(), E = module->global_end();
+           G != E; ++G) {
+        if (!G->isDeclaration() && !G->isConstant()) {
+          G->setInitializer(NULL);
+          G->setLinkage(::llvm::GlobalValue::ExternalLinkage);
+        }
+      }
+    }
+    ::llvm::OwningPtr< ::llvm::TargetMachine> target_machine(
+        LlvmCompilationUnit::CreateTargetMachine(insn_set_));
+    *success_ = WriteObject(target_machine.get(), module.get(), filename_) ? 1 : 0;
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  const InstructionSet insn_set_;
+  const std::string* const bitcode_;
+  const SafeMap<std::string, size_t>* const function_partitions_;
+  const size_t partition_;
+  const std::string filename_;
+  uint8_t* const success_;
+
+  DISALLOW_COPY_AND_ASSIGN(PartitionCodegenTask);
+};
+
+WholeProgramModule::WholeProgramModule(InstructionSet insn_set, const std::string& filename,
+                                       size_t num_partitions)
+    : insn_set_(insn_set), filename_(filename), num_partitions_(num_partitions),
+      lock_("whole program module lock") {
+  CHECK(!filename_.empty());
+  CHECK_GT(num_partitions_, 0U);
+}
+
+void WholeProgramModule::AddMethod(const std::string& symbol, const std::string& bitcode) {
+  MutexLock mu(Thread::Current(), lock_);
+  methods_.push_back(std::make_pair(symbol, bitcode));
+}
+
+bool WholeProgramModule::Write(size_t thread_count) {
+  Thread* self = Thread::Current();
+  std::vector<std::pair<std::string, std::string> > methods;
+  {
+    MutexLock mu(self, lock_);
+    methods.swap(methods_);
+  }
+  // Methods arrive in the order the compiler threads finish them, sort them so that the output
+  // does not depend on scheduling.
+  std::sort(methods.begin(), methods.end());
+
+  // Link all methods into one module.
+  uint64_t start_ns = NanoTime();
+  ::llvm::LLVMContext context;
+  ::llvm::OwningPtr< ::llvm::Module> module(new ::llvm::Module("art_whole_program", context));
+  makeLLVMModuleContents(module.get());
+  std::vector<const char*> exported_symbols;
+  for (size_t i = 0; i < methods.size(); ++i) {
+    const std::string& symbol = methods[i].first;
+    ::llvm::Module* method_module = ParseBitcode(methods[i].second, symbol, &context);
+    if (method_module == NULL) {
+      return false;
+    }
+    std::string errmsg;
+    bool failed = ::llvm::Linker::LinkModules(module.get(), method_module,
+                                              ::llvm::Linker::DestroySource, &errmsg);
+    delete method_module;
+    if (failed) {
+      LOG(ERROR) << "Failed to link " << symbol << ": " << errmsg;
+      return false;
+    }
+    exported_symbols.push_back(symbol.c_str());
+  }
+  uint64_t link_ns = NanoTime() - start_ns;
+
+  // The method symbols are the only entry points, everything else may be inlined, specialized or
+  // removed.
+  start_ns = NanoTime();
+  ::llvm::OwningPtr< ::llvm::TargetMachine> target_machine(
+      LlvmCompilationUnit::CreateTargetMachine(insn_set_));
+  {
+    ::llvm::PassManager pm;
+    pm.add(new ::llvm::DataLayout(*target_machine->getDataLayout()));
+    pm.add(::llvm::createInternalizePass(exported_symbols));
+    ::llvm::PassManagerBuilder pm_builder;
+    pm_builder.OptLevel = 3;
+    pm_builder.Inliner = ::llvm::createFunctionInliningPass();
+    pm_builder.populateModulePassManager(pm);
+    pm.run(*module);
+  }
+  uint64_t optimize_ns = NanoTime() - start_ns;
+
+  std::string errmsg;
+  ::llvm::OwningPtr< ::llvm::tool_output_file> out_file(
+      new ::llvm::tool_output_file(filename_.c_str(), errmsg, ::llvm::sys::fs::F_Binary));
+  if (!errmsg.empty()) {
+    LOG(ERROR) << "Failed to create bitcode output file: " << errmsg;
+    return false;
+  }
+  ::llvm::WriteBitcodeToFile(module.get(), out_file->os());
+  out_file->keep();
+
+  // Assign the functions to the partitions, largest first to the least loaded partition. Internal
+  // functions may now be called from another partition so they are made visible to the linker.
+  start_ns = NanoTime();
+  std::vector<std::pair<size_t, std::string> > function_sizes;
+  for (::llvm::Module::iterator F = module->begin(), E = module->end(); F != E; ++F) {
+    if (F->isDeclaration()) {
+      continue;
+    }
+    if (F->hasLocalLinkage()) {
+      F->setLinkage(::llvm::GlobalValue::ExternalLinkage);
+      F->setVisibility(::llvm::GlobalValue::HiddenVisibility);
+    }
+    size_t size = 0;
+    for (::llvm::Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB) {
+      size += BB->size();
+    }
+    function_sizes.push_back(std::make_pair(size, F->getName().str()));
+  }
+  for (::llvm::Module::global_iterator G = module->global_begin(), E = module->global_end();
+       G != E; ++G) {
+    if (!G->isDeclaration() && !G->isConstant() && G->hasLocalLinkage()) {
+      G->setLinkage(::llvm::GlobalValue::ExternalLinkage);
+      G->setVisibility(::llvm::GlobalValue::HiddenVisibility);
+    }
+  }
+  std::sort(function_sizes.rbegin(), function_sizes.rend());
+  size_t num_partitions = std::min(num_partitions_, std::max<size_t>(function_sizes.size(), 1U));
+  std::vector<size_t> partition_sizes(num_partitions, 0);
+  SafeMap<std::string, size_t> function_partitions;
+  for (const std::pair<size_t, std::string>& function : function_sizes) {
+    size_t partition = std::min_element(partition_sizes.begin(), partition_sizes.end()) -
+        partition_sizes.begin();
+    partition_sizes[partition] += function.first;
+    function_partitions.Put(function.second, partition);
+  }
+  std::string bitcode;
+  {
+    ::llvm::raw_string_ostream str_os(bitcode);
+    ::llvm::WriteBitcodeToFile(module.get(), str_os);
+  }
+  module.reset();
+
+  std::vector<std::string> object_filenames;
+  for (size_t i = 0; i < num_partitions; ++i) {
+    object_filenames.push_back(StringPrintf("%s.%zu.o", filename_.c_str(), i));
+  }
+  std::vector<uint8_t> success(num_partitions, 0);
+  {
+    ThreadPool thread_pool("Whole program codegen thread pool",
+                           std::max<size_t>(std::min(thread_count, num_partitions), 1U) - 1);
+    for (size_t i = 0; i < num_partitions; ++i) {
+      thread_pool.AddTask(self, new PartitionCodegenTask(insn_set_, &bitcode, &function_partitions,
+                                                         i, object_filenames[i], &success[i]));
+    }
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, true, false);
+  }
+  uint64_t codegen_ns = NanoTime() - start_ns;
+
+  LOG(INFO) << "Whole program module " << filename_ << ": " << methods.size() << " methods, "
+            << num_partitions << " partitions, link " << PrettyDuration(link_ns)
+            << ", optimize " << PrettyDuration(optimize_ns)
+            << ", codegen " << PrettyDuration(codegen_ns);
+  if (std::find(success.begin(), success.end(), 0) != success.end()) {
+    return false;
+  }
+  object_filenames_.swap(object_filenames);
+  for (const std::pair<std::string, std::string>& method : methods) {
+    method_symbols_.insert(method.first);
+  }
+  return true;
+}
+
+}  // namespace llvm
+}  // namespace art
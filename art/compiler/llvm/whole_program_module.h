@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_LLVM_WHOLE_PROGRAM_MODULE_H_
+#define ART_COMPILER_LLVM_WHOLE_PROGRAM_MODULE_H_
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "instruction_set.h"
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace art {
+namespace llvm {
+
+// Collects the expanded bitcode of every compiled method so that all of them can be emitted as a
+// single module together with the runtime declarations of art_module.ll. The module is optimized
+// across methods and its code is then generated in partitions on a pool of worker threads.
+//
+// Methods are added concurrently by the compiler threads while the oat file is compiled as usual,
+// the whole program output is written afterwards by Write. The oat file is then linked from the
+// objects of the partitions instead of the objects of the individual methods.
+class WholeProgramModule {
+ public:
+  // The module is written to "filename", the objects of the partitions to "filename.<n>.o".
+  WholeProgramModule(InstructionSet insn_set, const std::string& filename,
+                     size_t num_partitions);
+
+  void AddMethod(const std::string& symbol, const std::string& bitcode) LOCKS_EXCLUDED(lock_);
+
+  // Links the methods, runs the interprocedural optimizations and generates code for the
+  // partitions with thread_count workers. Returns false on failure.
+  bool Write(size_t thread_count) LOCKS_EXCLUDED(lock_);
+
+  // The objects of the partitions, set by a successful Write.
+  const std::vector<std::string>& GetObjectFilenames() const {
+    return object_filenames_;
+  }
+
+  // The symbols of the methods defined by the objects of the partitions.
+  const std::set<std::string>& GetMethodSymbols() const {
+    return method_symbols_;
+  }
+
+ private:
+  const InstructionSet insn_set_;
+  const std::string filename_;
+  const size_t num_partitions_;
+
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  // Pairs of method symbol and bitcode.
+  std::vector<std::pair<std::string, std::string> > methods_ GUARDED_BY(lock_);
+
+  std::vector<std::string> object_filenames_;
+  std::set<std::string> method_symbols_;
+
+  DISALLOW_COPY_AND_ASSIGN(WholeProgramModule);
+};
+
+}  // namespace llvm
+}  // namespace art
+
+#endif  // ART_COMPILER_LLVM_WHOLE_PROGRAM_MODULE_H_
@@ -14,9 +14,13 @@
  * limitations under the License.
  */
 
+#include <limits.h>
+#include <zlib.h>
+
 #include "common_compiler_test.h"
 #include "compiler/compiler.h"
 #include "compiler/oat_writer.h"
+#include "elf_file.h"
 #include "entrypoints/quick/quick_entrypoints.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/class-inl.h"
@@ -78,8 +82,37 @@ class OatTest : public CommonCompilerTest {
       }
     }
   }
+
+  // Compiles the named test dex file and writes it to file as a portable oat file.
+  void WritePortableOatFile(const char* dex_name, File* file, jobject* class_loader)
+      LOCKS_EXCLUDED(Locks::mutator_lock_) {
+    {
+      ScopedObjectAccess soa(Thread::Current());
+      *class_loader = LoadDex(dex_name);
+    }
+    const std::vector<const DexFile*>& dex_files =
+        Runtime::Current()->GetCompileTimeClassPath(*class_loader);
+    TimingLogger timings("OatTest::WritePortableOatFile", false, false);
+    compiler_driver_->CompileAll(*class_loader, dex_files, &timings);
+    ScopedObjectAccess soa(Thread::Current());
+    OatWriter oat_writer(dex_files, 42U, 4096U, "lue.art", compiler_driver_.get(), &timings);
+    ASSERT_TRUE(compiler_driver_->WriteElf(GetTestAndroidRoot(), !kIsTargetBuild, dex_files,
+                                           &oat_writer, file));
+  }
+
+  // Loads the oat file the way OatFile::Open does for portable executables and applies its
+  // relocations, returning the error of the first step that fails.
+  static bool LoadAndRelocate(File* file, std::string* error_msg) {
+    UniquePtr<ElfFile> elf_file(ElfFile::Open(file, false, true, error_msg));
+    return elf_file.get() != nullptr && elf_file->Load(true, error_msg) &&
+        elf_file->Relocate(error_msg);
+  }
 };
 
+// ElfFile::Relocate handles the 32-bit ARM and x86 oat files produced by the portable compiler.
+static constexpr bool kCanRelocatePortableOatFile = kUsePortableCompiler &&
+    (kRuntimeISA == kArm || kRuntimeISA == kThumb2 || kRuntimeISA == kX86);
+
 TEST_F(OatTest, WriteRead) {
   TimingLogger timings("OatTest::WriteRead", false, false);
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
@@ -172,6 +205,97 @@ TEST_F(OatTest, WriteRead) {
   }
 }
 
+TEST_F(OatTest, OpenPortableExecutable) {
+  if (!kCanRelocatePortableOatFile) {
+    return;
+  }
+  ScratchFile tmp;
+  jobject class_loader;
+  ASSERT_NO_FATAL_FAILURE(WritePortableOatFile("StaticLeafMethods", tmp.GetFile(), &class_loader));
+
+  std::string error_msg;
+  ASSERT_TRUE(LoadAndRelocate(tmp.GetFile(), &error_msg)) << error_msg;
+  UniquePtr<OatFile> oat_file(OatFile::Open(tmp.GetFilename(), tmp.GetFilename(), NULL, true,
+                                            &error_msg));
+  ASSERT_TRUE(oat_file.get() != nullptr) << error_msg;
+  // The file must not have fallen back to dlopen.
+  EXPECT_FALSE(oat_file->IsDlopened());
+
+  ScopedObjectAccess soa(Thread::Current());
+  StackHandleScope<1> hs(soa.Self());
+  Handle<mirror::ClassLoader> loader(
+      hs.NewHandle(soa.Decode<mirror::ClassLoader*>(class_loader)));
+  mirror::Class* klass =
+      class_linker_->FindClass(soa.Self(), "LStaticLeafMethods;", loader);
+  ASSERT_TRUE(klass != nullptr);
+  mirror::ArtMethod* method = klass->FindDirectMethod("sum", "(II)I");
+  ASSERT_TRUE(method != nullptr);
+  size_t method_index = 0;
+  while (klass->GetDirectMethod(method_index) != method) {
+    method_index++;
+  }
+
+  const DexFile& dex_file = *klass->GetDexCache()->GetDexFile();
+  uint32_t dex_file_checksum = dex_file.GetLocationChecksum();
+  const OatFile::OatDexFile* oat_dex_file =
+      oat_file->GetOatDexFile(dex_file.GetLocation().c_str(), &dex_file_checksum);
+  ASSERT_TRUE(oat_dex_file != nullptr);
+  const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(klass->GetDexClassDefIndex());
+  const void* code = oat_class.GetOatMethod(method_index).GetPortableCode();
+  ASSERT_TRUE(code != nullptr);
+
+  // Portable code takes the called method ahead of the arguments.
+  typedef int32_t (*SumFn)(mirror::ArtMethod*, int32_t, int32_t);
+  SumFn sum = reinterpret_cast<SumFn>(const_cast<void*>(code));
+  EXPECT_EQ(3, sum(method, 1, 2));
+  EXPECT_EQ(3, sum(method, -2, 5));
+  EXPECT_EQ(-1, sum(method, INT_MAX, INT_MIN));
+}
+
+TEST_F(OatTest, RelocateRejectsTextRel) {
+  if (!kCanRelocatePortableOatFile) {
+    return;
+  }
+  ScratchFile tmp;
+  jobject class_loader;
+  ASSERT_NO_FATAL_FAILURE(WritePortableOatFile("StaticLeafMethods", tmp.GetFile(), &class_loader));
+
+  std::string error_msg;
+  {
+    // Turn the terminating DT_NULL into DT_TEXTREL.
+    UniquePtr<ElfFile> elf_file(ElfFile::Open(tmp.GetFile(), true, false, &error_msg));
+    ASSERT_TRUE(elf_file.get() != nullptr) << error_msg;
+    Elf32_Dyn& last = elf_file->GetDynamic(elf_file->GetDynamicNum() - 1);
+    ASSERT_EQ(DT_NULL, last.d_tag);
+    last.d_tag = DT_TEXTREL;
+  }
+  EXPECT_FALSE(LoadAndRelocate(tmp.GetFile(), &error_msg));
+  EXPECT_NE(std::string::npos, error_msg.find("Unsupported dynamic entry")) << error_msg;
+}
+
+TEST_F(OatTest, RelocateRejectsUnsupportedRelocation) {
+  if (!kCanRelocatePortableOatFile) {
+    return;
+  }
+  ScratchFile tmp;
+  jobject class_loader;
+  ASSERT_NO_FATAL_FAILURE(WritePortableOatFile("StaticLeafMethods", tmp.GetFile(), &class_loader));
+
+  std::string error_msg;
+  {
+    // Give the first dynamic relocation a type that ElfFile::Relocate does not handle.
+    UniquePtr<ElfFile> elf_file(ElfFile::Open(tmp.GetFile(), true, false, &error_msg));
+    ASSERT_TRUE(elf_file.get() != nullptr) << error_msg;
+    Elf32_Shdr* rel_section = elf_file->FindSectionByType(SHT_REL);
+    ASSERT_TRUE(rel_section != nullptr);
+    ASSERT_NE(0U, elf_file->GetRelNum(*rel_section));
+    Elf32_Rel& rel = elf_file->GetRel(*rel_section, 0);
+    rel.r_info |= 0xff;  // The type is the low byte.
+  }
+  EXPECT_FALSE(LoadAndRelocate(tmp.GetFile(), &error_msg));
+  EXPECT_NE(std::string::npos, error_msg.find("Unsupported relocation type")) << error_msg;
+}
+
 TEST_F(OatTest, OatHeaderSizeCheck) {
   // If this test is failing and you have to update these constants,
   // it is time to update OatHeader::kOatVersion
@@ -203,4 +327,18 @@ TEST_F(OatTest, OatHeaderIsValid) {
     ASSERT_FALSE(oat_header.IsValid());
 }
 
+TEST_F(OatTest, OatHeaderChecksumWithDataChecksum) {
+  std::vector<const DexFile*> dex_files;
+  OatHeader oat_header(kX86, InstructionSetFeatures(), &dex_files, 0, 0, "");
+  OatHeader combined_oat_header(kX86, InstructionSetFeatures(), &dex_files, 0, 0, "");
+  std::vector<uint8_t> data(3 * KB);
+  for (size_t i = 0; i != data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 31);
+  }
+  oat_header.UpdateChecksum(&data[0], data.size());
+  uint32_t data_checksum = adler32(adler32(0L, Z_NULL, 0), &data[0], data.size());
+  combined_oat_header.UpdateChecksumWithDataChecksum(data_checksum, data.size());
+  EXPECT_EQ(oat_header.GetChecksum(), combined_oat_header.GetChecksum());
+}
+
 }  // namespace art
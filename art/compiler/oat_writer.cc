@@ -18,9 +18,12 @@
 
 #include <zlib.h>
 
+#include <algorithm>
+
 #include "base/bit_vector.h"
 #include "base/stl_util.h"
 #include "base/unix_file/fd_file.h"
+#include "chunked_file_output_stream.h"
 #include "class_linker.h"
 #include "dex_file-inl.h"
 #include "dex/verification_results.h"
@@ -34,6 +37,7 @@
 #include "safe_map.h"
 #include "scoped_thread_state_change.h"
 #include "handle_scope-inl.h"
+#include "thread_pool.h"
 #include "verifier/method_verifier.h"
 
 namespace art {
@@ -106,8 +110,13 @@ OatWriter::OatWriter(const std::vector<const DexFile*>& dex_files,
     TimingLogger::ScopedSplit split("InitOatClasses", timings);
     offset = InitOatClasses(offset);
   }
+  {
+    TimingLogger::ScopedSplit split("ComputeDataChecksums", timings);
+    ComputeDataChecksums();
+  }
   {
     TimingLogger::ScopedSplit split("InitOatMaps", timings);
+    maps_offset_ = offset;
     offset = InitOatMaps(offset);
   }
   {
@@ -119,6 +128,7 @@ OatWriter::OatWriter(const std::vector<const DexFile*>& dex_files,
     offset = InitOatCodeDexFiles(offset);
   }
   size_ = offset;
+  data_checksums_.clear();
 
   CHECK_EQ(dex_files_->size(), oat_dex_files_.size());
   CHECK(image_file_location.empty() == compiler->IsImage());
@@ -332,9 +342,8 @@ class OatWriter::InitCodeMethodVisitor : public OatDexMethodVisitor {
       // Derived from CompiledMethod.
       uint32_t quick_code_offset = 0;
 
-      const std::vector<uint8_t>* portable_code = compiled_method->GetPortableCode();
       const std::vector<uint8_t>* quick_code = compiled_method->GetQuickCode();
-      if (portable_code != nullptr) {
+      if (compiled_method->HasPortableCode()) {
         CHECK(quick_code == nullptr);
         size_t oat_method_offsets_offset =
             oat_class->GetOatMethodOffsetsOffsetFromOatHeader(class_def_method_index);
@@ -406,7 +415,7 @@ class OatWriter::InitCodeMethodVisitor : public OatDexMethodVisitor {
         if (code_iter == dedupe_map_.end()) {
           writer_->oat_header_->UpdateChecksum(method_header, sizeof(*method_header));
           offset_ += sizeof(*method_header);  // Method header is prepended before code.
-          writer_->oat_header_->UpdateChecksum(&(*quick_code)[0], code_size);
+          writer_->UpdateChecksumWithData(*quick_code);
           offset_ += code_size;
         }
       }
@@ -474,7 +483,7 @@ class OatWriter::InitMapMethodVisitor : public OatDexMethodVisitor {
           DataAccess::SetOffset(oat_class, method_offsets_index_, offset_);
           dedupe_map_.Put(map, offset_);
           offset_ += map_size;
-          writer_->oat_header_->UpdateChecksum(&(*map)[0], map_size);
+          writer_->UpdateChecksumWithData(*map);
         }
       }
       ++method_offsets_index_;
@@ -544,7 +553,7 @@ class OatWriter::WriteCodeMethodVisitor : public OatDexMethodVisitor {
 
       const std::vector<uint8_t>* quick_code = compiled_method->GetQuickCode();
       if (quick_code != nullptr) {
-        CHECK(compiled_method->GetPortableCode() == nullptr);
+        CHECK(!compiled_method->HasPortableCode());
         uint32_t aligned_offset = compiled_method->AlignCode(offset_);
         uint32_t aligned_code_delta = aligned_offset - offset_;
         if (aligned_code_delta != 0) {
@@ -760,6 +769,86 @@ size_t OatWriter::InitOatClasses(size_t offset) {
   return offset;
 }
 
+// Computes the adler32 checksums of a range of the code and map arrays.
+class OatWriter::ComputeDataChecksumsTask : public Task {
+ public:
+  ComputeDataChecksumsTask(const std::vector<const std::vector<uint8_t>*>* data,
+                           std::vector<uint32_t>* checksums, size_t begin, size_t end)
+      : data_(data), checksums_(checksums), begin_(begin), end_(end) {
+  }
+
+  void Run(Thread* self) {
+    UNUSED(self);
+    for (size_t i = begin_; i != end_; ++i) {
+      const std::vector<uint8_t>& data = *(*data_)[i];
+      uint32_t checksum = adler32(0L, Z_NULL, 0);
+      if (!data.empty()) {
+        checksum = adler32(checksum, &data[0], data.size());
+      }
+      (*checksums_)[i] = checksum;
+    }
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  const std::vector<const std::vector<uint8_t>*>* const data_;
+  std::vector<uint32_t>* const checksums_;
+  const size_t begin_;
+  const size_t end_;
+
+  DISALLOW_COPY_AND_ASSIGN(ComputeDataChecksumsTask);
+};
+
+void OatWriter::ComputeDataChecksums() {
+  // The code and maps are deduplicated by the compiler driver, so each array is checksummed once.
+  std::vector<const std::vector<uint8_t>*> data;
+  for (OatClass* oat_class : oat_classes_) {
+    for (CompiledMethod* compiled_method : oat_class->compiled_methods_) {
+      if (compiled_method == nullptr) {
+        continue;
+      }
+      if (compiled_method->GetQuickCode() != nullptr) {
+        data.push_back(compiled_method->GetQuickCode());
+      }
+      data.push_back(GcMapDataAccess::GetData(compiled_method));
+      data.push_back(MappingTableDataAccess::GetData(compiled_method));
+      data.push_back(VmapTableDataAccess::GetData(compiled_method));
+    }
+  }
+  std::sort(data.begin(), data.end());
+  data.erase(std::unique(data.begin(), data.end()), data.end());
+
+  std::vector<uint32_t> checksums(data.size());
+  {
+    // The tasks only read compiler data, the mutator lock is released while the workers attach
+    // and run.
+    Thread* self = Thread::Current();
+    ScopedThreadStateChange tsc(self, kNative);
+    const size_t thread_count = std::max<size_t>(compiler_driver_->GetThreadCount(), 1U);
+    // Several tasks per thread balance arrays of different sizes.
+    const size_t num_tasks = std::min(data.size(), thread_count * 4);
+    ThreadPool thread_pool("Oat checksum thread pool", thread_count - 1);
+    for (size_t task = 0; task != num_tasks; ++task) {
+      thread_pool.AddTask(self, new ComputeDataChecksumsTask(&data, &checksums,
+                                                             data.size() * task / num_tasks,
+                                                             data.size() * (task + 1) / num_tasks));
+    }
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, true, false);
+  }
+
+  for (size_t i = 0; i != data.size(); ++i) {
+    data_checksums_.Put(data[i], checksums[i]);
+  }
+}
+
+void OatWriter::UpdateChecksumWithData(const std::vector<uint8_t>& data) {
+  oat_header_->UpdateChecksumWithDataChecksum(data_checksums_.Get(&data), data.size());
+}
+
 size_t OatWriter::InitOatMaps(size_t offset) {
   #define VISIT(VisitorType)                          \
     do {                                              \
@@ -843,24 +932,11 @@ size_t OatWriter::InitOatCodeDexFiles(size_t offset) {
 bool OatWriter::Write(OutputStream* out) {
   const size_t file_offset = out->Seek(0, kSeekCurrent);
 
-  if (!out->WriteFully(oat_header_, sizeof(*oat_header_))) {
-    PLOG(ERROR) << "Failed to write oat header to " << out->GetLocation();
-    return false;
-  }
-  size_oat_header_ += sizeof(*oat_header_);
-
-  if (!out->WriteFully(image_file_location_.data(), image_file_location_.size())) {
-    PLOG(ERROR) << "Failed to write oat header image file location to " << out->GetLocation();
-    return false;
-  }
-  size_oat_header_image_file_location_ += image_file_location_.size();
-
-  if (!WriteTables(out, file_offset)) {
-    LOG(ERROR) << "Failed to write oat tables to " << out->GetLocation();
+  size_t relative_offset = WriteHeaderAndTables(out, file_offset);
+  if (relative_offset == 0) {
     return false;
   }
 
-  size_t relative_offset = out->Seek(0, kSeekCurrent) - file_offset;
   relative_offset = WriteMaps(out, file_offset, relative_offset);
   if (relative_offset == 0) {
     LOG(ERROR) << "Failed to write oat code to " << out->GetLocation();
@@ -879,6 +955,113 @@ bool OatWriter::Write(OutputStream* out) {
     return false;
   }
 
+  CheckSizeStats(relative_offset);
+  CHECK_EQ(file_offset + size_, static_cast<uint32_t>(out->Seek(0, kSeekCurrent)));
+
+  return true;
+}
+
+// Writes the tables, the maps or the code through a stream that starts at the section.
+class OatWriter::WriteSectionTask : public Task {
+ public:
+  enum Section {
+    kTables,
+    kMaps,
+    kCode,
+  };
+
+  WriteSectionTask(OatWriter* writer, Section section, File* file, size_t file_offset,
+                   size_t relative_offset, size_t* end_offset)
+      : writer_(writer), section_(section), file_(file), file_offset_(file_offset),
+        relative_offset_(relative_offset), end_offset_(end_offset) {
+  }
+
+  void Run(Thread* self) {
+    UNUSED(self);
+    ChunkedFileOutputStream out(file_, file_offset_ + relative_offset_);
+    size_t end_offset = 0;
+    switch (section_) {
+      case kTables:
+        end_offset = writer_->WriteHeaderAndTables(&out, file_offset_);
+        break;
+      case kMaps:
+        end_offset = writer_->WriteMaps(&out, file_offset_, relative_offset_);
+        break;
+      case kCode:
+        end_offset = writer_->WriteCode(&out, file_offset_, relative_offset_);
+        if (end_offset != 0) {
+          end_offset = writer_->WriteCodeDexFiles(&out, file_offset_, end_offset);
+        }
+        break;
+    }
+    if (end_offset != 0 && !out.Flush()) {
+      PLOG(ERROR) << "Failed to write oat data to " << out.GetLocation();
+      end_offset = 0;
+    }
+    *end_offset_ = end_offset;
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  OatWriter* const writer_;
+  const Section section_;
+  File* const file_;
+  const size_t file_offset_;
+  const size_t relative_offset_;
+  size_t* const end_offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteSectionTask);
+};
+
+bool OatWriter::Write(File* file) {
+  const off_t file_offset = lseek(file->Fd(), 0, SEEK_CUR);
+  if (file_offset == -1) {
+    PLOG(ERROR) << "Failed to get the oat data offset in " << file->GetPath();
+    return false;
+  }
+
+  // The maps end where the padding to the executable offset starts, the code section skips it.
+  const size_t code_offset = oat_header_->GetExecutableOffset() - size_executable_offset_alignment_;
+  size_t tables_end = 0;
+  size_t maps_end = 0;
+  size_t code_end = 0;
+  {
+    // The sections only read compiler data and write disjoint ranges of the file with pwrite.
+    Thread* self = Thread::Current();
+    ScopedThreadStateChange tsc(self, kNative);
+    const size_t thread_count = std::min<size_t>(compiler_driver_->GetThreadCount(), 3U);
+    ThreadPool thread_pool("Oat writer thread pool", std::max<size_t>(thread_count, 1U) - 1);
+    // The code is usually the largest section, start it first.
+    thread_pool.AddTask(self, new WriteSectionTask(this, WriteSectionTask::kCode, file,
+                                                   file_offset, code_offset, &code_end));
+    thread_pool.AddTask(self, new WriteSectionTask(this, WriteSectionTask::kMaps, file,
+                                                   file_offset, maps_offset_, &maps_end));
+    thread_pool.AddTask(self, new WriteSectionTask(this, WriteSectionTask::kTables, file,
+                                                   file_offset, 0, &tables_end));
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, true, false);
+  }
+  if (tables_end == 0 || maps_end == 0 || code_end == 0) {
+    LOG(ERROR) << "Failed to write oat data to " << file->GetPath();
+    return false;
+  }
+  CHECK_EQ(maps_offset_, tables_end);
+  CHECK_EQ(code_offset, maps_end);
+
+  CheckSizeStats(code_end);
+
+  const off_t end = file_offset + size_;
+  if (lseek(file->Fd(), end, SEEK_SET) != end) {
+    PLOG(ERROR) << "Failed to seek to the end of the oat data in " << file->GetPath();
+    return false;
+  }
+  return true;
+}
+
+void OatWriter::CheckSizeStats(size_t relative_offset) {
   if (kIsDebugBuild) {
     uint32_t size_total = 0;
     #define DO_STAT(x) \
@@ -919,14 +1102,31 @@ bool OatWriter::Write(OutputStream* out) {
     #undef DO_STAT
 
     VLOG(compiler) << "size_total=" << PrettySize(size_total) << " (" << size_total << "B)"; \
-    CHECK_EQ(file_offset + size_total, static_cast<uint32_t>(out->Seek(0, kSeekCurrent)));
     CHECK_EQ(size_, size_total);
   }
 
-  CHECK_EQ(file_offset + size_, static_cast<uint32_t>(out->Seek(0, kSeekCurrent)));
   CHECK_EQ(size_, relative_offset);
+}
 
-  return true;
+size_t OatWriter::WriteHeaderAndTables(OutputStream* out, const size_t file_offset) {
+  if (!out->WriteFully(oat_header_, sizeof(*oat_header_))) {
+    PLOG(ERROR) << "Failed to write oat header to " << out->GetLocation();
+    return 0;
+  }
+  size_oat_header_ += sizeof(*oat_header_);
+
+  if (!out->WriteFully(image_file_location_.data(), image_file_location_.size())) {
+    PLOG(ERROR) << "Failed to write oat header image file location to " << out->GetLocation();
+    return 0;
+  }
+  size_oat_header_image_file_location_ += image_file_location_.size();
+
+  if (!WriteTables(out, file_offset)) {
+    LOG(ERROR) << "Failed to write oat tables to " << out->GetLocation();
+    return 0;
+  }
+
+  return out->Seek(0, kSeekCurrent) - file_offset;
 }
 
 bool OatWriter::WriteTables(OutputStream* out, const size_t file_offset) {
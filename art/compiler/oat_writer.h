@@ -24,6 +24,7 @@
 #include "driver/compiler_driver.h"
 #include "mem_map.h"
 #include "oat.h"
+#include "os.h"
 #include "mirror/class.h"
 #include "safe_map.h"
 #include "UniquePtr.h"
@@ -94,6 +95,11 @@ class OatWriter {
 
   bool Write(OutputStream* out);
 
+  // Writes the oat data at the current position of the file and leaves the position at its end.
+  // The tables, the maps and the code start at offsets that are known once the writer is
+  // constructed, so each section is written by its own task through its own stream.
+  bool Write(File* file);
+
   ~OatWriter();
 
   struct DebugInfo {
@@ -141,16 +147,26 @@ class OatWriter {
   size_t InitOatDexFiles(size_t offset);
   size_t InitDexFiles(size_t offset);
   size_t InitOatClasses(size_t offset);
+  // The checksums of the code and maps are computed in parallel before their offsets are assigned
+  // and added to the oat header checksum in the order of the file. The result is the same as
+  // checksumming the data serially.
+  class ComputeDataChecksumsTask;
+  void ComputeDataChecksums();
+  void UpdateChecksumWithData(const std::vector<uint8_t>& data);
+
   size_t InitOatMaps(size_t offset);
   size_t InitOatCode(size_t offset)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   size_t InitOatCodeDexFiles(size_t offset)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  class WriteSectionTask;
+  size_t WriteHeaderAndTables(OutputStream* out, const size_t file_offset);
   bool WriteTables(OutputStream* out, const size_t file_offset);
   size_t WriteMaps(OutputStream* out, const size_t file_offset, size_t relative_offset);
   size_t WriteCode(OutputStream* out, const size_t file_offset, size_t relative_offset);
   size_t WriteCodeDexFiles(OutputStream* out, const size_t file_offset, size_t relative_offset);
+  void CheckSizeStats(size_t relative_offset);
 
   class OatDexFile {
    public:
@@ -247,6 +263,9 @@ class OatWriter {
   // Size required for Oat data structures.
   size_t size_;
 
+  // Offset of the maps, where the tables and the dex files end.
+  size_t maps_offset_;
+
   // dependencies on the image.
   uint32_t image_file_location_oat_checksum_;
   uintptr_t image_file_location_oat_begin_;
@@ -256,6 +275,8 @@ class OatWriter {
   OatHeader* oat_header_;
   std::vector<OatDexFile*> oat_dex_files_;
   std::vector<OatClass*> oat_classes_;
+  // The adler32 of each code and map array, only used while the offsets are assigned.
+  SafeMap<const std::vector<uint8_t>*, uint32_t> data_checksums_;
   UniquePtr<const std::vector<uint8_t> > interpreter_to_interpreter_bridge_;
   UniquePtr<const std::vector<uint8_t> > interpreter_to_compiled_code_bridge_;
   UniquePtr<const std::vector<uint8_t> > jni_dlsym_lookup_;
@@ -45,6 +45,11 @@ class OutputStream {
 
   virtual off_t Seek(off_t offset, Whence whence) = 0;
 
+  // Writes out the data buffered by the stream. Returns false on failure.
+  virtual bool Flush() {
+    return true;
+  }
+
  private:
   const std::string location_;
 
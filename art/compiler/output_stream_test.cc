@@ -17,9 +17,14 @@
 #include "file_output_stream.h"
 #include "vector_output_stream.h"
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "buffered_output_stream.h"
+#include "chunked_file_output_stream.h"
 #include "common_runtime_test.h"
+#include "thread_pool.h"
+#include "utils.h"
 
 namespace art {
 
@@ -87,6 +92,167 @@ TEST_F(OutputStreamTest, Buffered) {
   CheckTestOutput(actual);
 }
 
+TEST_F(OutputStreamTest, Chunked) {
+  ScratchFile tmp;
+  ChunkedFileOutputStream output_stream(tmp.GetFile());
+  SetOutputStream(output_stream);
+  GenerateTestOutput();
+  EXPECT_TRUE(output_stream.Flush());
+  UniquePtr<File> in(OS::OpenFileForReading(tmp.GetFilename().c_str()));
+  EXPECT_TRUE(in.get() != NULL);
+  std::vector<uint8_t> actual(in->GetLength());
+  bool readSuccess = in->ReadFully(&actual[0], actual.size());
+  EXPECT_TRUE(readSuccess);
+  CheckTestOutput(actual);
+}
+
+TEST_F(OutputStreamTest, ChunkedWritesWholeChunks) {
+  ScratchFile tmp;
+  ChunkedFileOutputStream output_stream(tmp.GetFile());
+  const size_t kSize = 3 * ChunkedFileOutputStream::kChunkSize + 100;
+  std::vector<uint8_t> expected(kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    expected[i] = static_cast<uint8_t>(i * 7);
+  }
+  // Small writes are gathered, one large write fills up the chunk and bypasses the buffer.
+  for (size_t i = 0; i < 1000 * 1000; i += 1000) {
+    ASSERT_TRUE(output_stream.WriteFully(&expected[i], 1000));
+  }
+  ASSERT_TRUE(output_stream.WriteFully(&expected[1000 * 1000], kSize - 1000 * 1000));
+  EXPECT_EQ(static_cast<off_t>(kSize), output_stream.Seek(0, kSeekCurrent));
+  ASSERT_TRUE(output_stream.Flush());
+  EXPECT_EQ(static_cast<off_t>(kSize), lseek(tmp.GetFd(), 0, SEEK_CUR));
+  // The first chunk is completed from the large write, the next two chunks are written directly
+  // with one call and the tail is flushed.
+  EXPECT_EQ(3U, output_stream.GetWriteCount());
+
+  std::vector<uint8_t> actual(kSize);
+  UniquePtr<File> in(OS::OpenFileForReading(tmp.GetFilename().c_str()));
+  ASSERT_TRUE(in.get() != NULL);
+  ASSERT_TRUE(in->ReadFully(&actual[0], actual.size()));
+  EXPECT_TRUE(expected == actual);
+}
+
+// Writes a range of the data at its offset in the file, in pieces of the given size.
+class WriteRangeTask : public Task {
+ public:
+  WriteRangeTask(File* file, const std::vector<uint8_t>* data, size_t begin, size_t end,
+                 size_t piece_size, bool* success)
+      : file_(file), data_(data), begin_(begin), end_(end), piece_size_(piece_size),
+        success_(success) {
+  }
+
+  void Run(Thread* self) {
+    UNUSED(self);
+    ChunkedFileOutputStream output_stream(file_, begin_);
+    bool success = true;
+    for (size_t i = begin_; success && i < end_; i += piece_size_) {
+      success = output_stream.WriteFully(&(*data_)[i], std::min(piece_size_, end_ - i));
+    }
+    *success_ = success && output_stream.Flush();
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  File* const file_;
+  const std::vector<uint8_t>* const data_;
+  const size_t begin_;
+  const size_t end_;
+  const size_t piece_size_;
+  bool* const success_;
+};
+
+// Writes the data with num_sections streams, one per thread. Returns the wall time in
+// nanoseconds including the fdatasync, or 0 on failure.
+static uint64_t TimeSectionWrites(File* file, const std::vector<uint8_t>& data,
+                                  size_t num_sections, size_t piece_size) {
+  Thread* self = Thread::Current();
+  ThreadPool thread_pool("Output stream test thread pool", num_sections - 1);
+  UniquePtr<bool[]> success(new bool[num_sections]);
+  for (size_t i = 0; i != num_sections; ++i) {
+    success[i] = false;
+    thread_pool.AddTask(self, new WriteRangeTask(file, &data, data.size() * i / num_sections,
+                                                 data.size() * (i + 1) / num_sections,
+                                                 piece_size, &success[i]));
+  }
+  uint64_t start_ns = NanoTime();
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, true, false);
+  if (fdatasync(file->Fd()) != 0) {
+    return 0;
+  }
+  uint64_t time_ns = std::max<uint64_t>(NanoTime() - start_ns, 1);
+  for (size_t i = 0; i != num_sections; ++i) {
+    if (!success[i]) {
+      return 0;
+    }
+  }
+  return time_ns;
+}
+
+TEST_F(OutputStreamTest, ChunkedSectionsFromThreads) {
+  ScratchFile tmp;
+  const size_t kSize = 5 * ChunkedFileOutputStream::kChunkSize + 12345;
+  std::vector<uint8_t> expected(kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    expected[i] = static_cast<uint8_t>(i * 13);
+  }
+  ASSERT_NE(0U, TimeSectionWrites(tmp.GetFile(), expected, 3, 1000));
+  // The streams at an offset leave the file position alone.
+  EXPECT_EQ(0, lseek(tmp.GetFd(), 0, SEEK_CUR));
+
+  std::vector<uint8_t> actual(kSize);
+  UniquePtr<File> in(OS::OpenFileForReading(tmp.GetFilename().c_str()));
+  ASSERT_TRUE(in.get() != NULL);
+  ASSERT_TRUE(in->ReadFully(&actual[0], actual.size()));
+  EXPECT_TRUE(expected == actual);
+}
+
+// Not a correctness test, reports the write throughput of the file streams for the small writes
+// of the oat writer, and of the chunked stream with the sections written from several threads.
+TEST_F(OutputStreamTest, WriteThroughput) {
+  const size_t kSize = 64 * MB;
+  // About the size of a map or of the code of a small method.
+  const size_t kPieceSize = 200;
+  std::vector<uint8_t> data(kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    data[i] = static_cast<uint8_t>(i);
+  }
+  for (size_t kind = 0; kind != 3; ++kind) {
+    ScratchFile tmp;
+    UniquePtr<OutputStream> output_stream;
+    const char* name;
+    if (kind == 0) {
+      output_stream.reset(new FileOutputStream(tmp.GetFile()));
+      name = "file";
+    } else if (kind == 1) {
+      output_stream.reset(new BufferedOutputStream(new FileOutputStream(tmp.GetFile())));
+      name = "buffered";
+    } else {
+      output_stream.reset(new ChunkedFileOutputStream(tmp.GetFile()));
+      name = "chunked";
+    }
+    uint64_t start_ns = NanoTime();
+    for (size_t i = 0; i < kSize; i += kPieceSize) {
+      ASSERT_TRUE(output_stream->WriteFully(&data[i], std::min(kPieceSize, kSize - i)));
+    }
+    ASSERT_TRUE(output_stream->Flush());
+    ASSERT_EQ(0, fdatasync(tmp.GetFd()));
+    uint64_t time_ns = std::max<uint64_t>(NanoTime() - start_ns, 1);
+    LOG(INFO) << name << ": " << kSize * 1000000000ULL / time_ns / MB << " MB/s";
+  }
+  for (size_t num_sections = 1; num_sections <= 4; num_sections *= 2) {
+    ScratchFile tmp;
+    uint64_t time_ns = TimeSectionWrites(tmp.GetFile(), data, num_sections, kPieceSize);
+    ASSERT_NE(0U, time_ns);
+    LOG(INFO) << "chunked, " << num_sections << " sections in parallel: "
+              << kSize * 1000000000ULL / time_ns / MB << " MB/s";
+  }
+}
+
 TEST_F(OutputStreamTest, Vector) {
   std::vector<uint8_t> output;
   VectorOutputStream output_stream("test vector output", output);
@@ -17,9 +17,13 @@
 #include <algorithm>
 #include <numeric>
 
+#include <sys/mman.h>
+
 #include "arena_allocator.h"
 #include "base/logging.h"
 #include "base/mutex.h"
+#include "base/stl_util.h"
+#include "base/stringprintf.h"
 #include "thread-inl.h"
 #include <memcheck/memcheck.h>
 #include <iomanip>
@@ -30,6 +34,14 @@ namespace art {
 static constexpr bool kUseMemMap = false;
 static constexpr bool kUseMemSet = true && kUseMemMap;
 static constexpr size_t kValgrindRedZoneBytes = 8;
+// Arenas of at least this size, such as the ones holding the bit vectors of large methods, are
+// mapped so that their pages can be released.
+static constexpr size_t kLargeArenaSize = 1 * MB;
+// Large arenas are rounded up to whole transparent huge pages and advised to use them.
+static constexpr bool kUseHugePages = true;
+static constexpr size_t kHugePageSize = 2 * MB;
+// The bytes of freed arenas a thread keeps for itself with thread caching.
+static constexpr size_t kThreadCacheBytes = 2 * MB;
 constexpr size_t Arena::kDefaultSize;
 
 template <bool kCount>
@@ -114,13 +126,22 @@ Arena::Arena(size_t size)
     : bytes_allocated_(0),
       map_(nullptr),
       next_(nullptr) {
-  if (kUseMemMap) {
+  if (kUseMemMap || size >= kLargeArenaSize) {
+    if (kUseHugePages && size >= kHugePageSize) {
+      size = RoundUp(size, kHugePageSize);
+    }
     std::string error_msg;
     map_ = MemMap::MapAnonymous("dalvik-arena", NULL, size, PROT_READ | PROT_WRITE, false,
                                 &error_msg);
     CHECK(map_ != nullptr) << error_msg;
     memory_ = map_->Begin();
     size_ = map_->Size();
+#ifdef MADV_HUGEPAGE
+    if (kUseHugePages && size_ >= kHugePageSize) {
+      // Only a hint, the kernel may not support transparent huge pages.
+      madvise(memory_, size_, MADV_HUGEPAGE);
+    }
+#endif
   } else {
     memory_ = reinterpret_cast<uint8_t*>(calloc(1, size));
     size_ = size;
@@ -128,7 +149,7 @@ Arena::Arena(size_t size)
 }
 
 Arena::~Arena() {
-  if (kUseMemMap) {
+  if (map_ != nullptr) {
     delete map_;
   } else {
     free(reinterpret_cast<void*>(memory_));
@@ -137,21 +158,38 @@ Arena::~Arena() {
 
 void Arena::Reset() {
   if (bytes_allocated_) {
-    if (kUseMemSet || !kUseMemMap) {
+    if (kUseMemSet || map_ == nullptr) {
       memset(Begin(), 0, bytes_allocated_);
     } else {
+      // Gives the pages back to the OS, they read as zero when they are touched again.
       madvise(Begin(), bytes_allocated_, MADV_DONTNEED);
     }
     bytes_allocated_ = 0;
   }
 }
 
-ArenaPool::ArenaPool()
-    : lock_("Arena pool lock"),
+ArenaPool::ArenaPool(bool thread_caching)
+    : thread_caching_(thread_caching),
+      lock_("Arena pool lock"),
       free_arenas_(nullptr) {
+  if (thread_caching_) {
+    CHECK_PTHREAD_CALL(pthread_key_create, (&thread_cache_key_, ReleaseThreadCache),
+                       "arena pool cache key");
+  }
 }
 
 ArenaPool::~ArenaPool() {
+  if (thread_caching_) {
+    CHECK_PTHREAD_CALL(pthread_key_delete, (thread_cache_key_), "delete arena pool cache key");
+    for (ThreadCache* cache : thread_caches_) {
+      while (cache->arenas != nullptr) {
+        auto* arena = cache->arenas;
+        cache->arenas = arena->next_;
+        delete arena;
+      }
+    }
+    STLDeleteElements(&thread_caches_);
+  }
   while (free_arenas_ != nullptr) {
     auto* arena = free_arenas_;
     free_arenas_ = free_arenas_->next_;
@@ -159,18 +197,67 @@ ArenaPool::~ArenaPool() {
   }
 }
 
+ArenaPool::ThreadCache* ArenaPool::GetThreadCache() {
+  // Lazily create the cache of the thread.
+  ThreadCache* cache = static_cast<ThreadCache*>(pthread_getspecific(thread_cache_key_));
+  if (cache == nullptr) {
+    cache = new ThreadCache(this);
+    CHECK_PTHREAD_CALL(pthread_setspecific, (thread_cache_key_, cache), "arena pool cache");
+    MutexLock lock(Thread::Current(), lock_);
+    thread_caches_.push_back(cache);
+  }
+  return cache;
+}
+
+void ArenaPool::ReleaseThreadCache(void* arg) {
+  ThreadCache* cache = reinterpret_cast<ThreadCache*>(arg);
+  ArenaPool* pool = cache->pool;
+  Arena* last = cache->arenas;
+  while (last != nullptr && last->next_ != nullptr) {
+    last = last->next_;
+  }
+  {
+    // The runtime thread may already be detached, the lock is then taken without it.
+    MutexLock lock(Thread::Current(), pool->lock_);
+    if (last != nullptr) {
+      last->next_ = pool->free_arenas_;
+      pool->free_arenas_ = cache->arenas;
+    }
+    pool->thread_caches_.erase(std::find(pool->thread_caches_.begin(),
+                                         pool->thread_caches_.end(), cache));
+    pool->released_cache_hits_.FetchAndAdd(cache->hits.Load());
+  }
+  delete cache;
+}
+
 Arena* ArenaPool::AllocArena(size_t size) {
-  Thread* self = Thread::Current();
   Arena* ret = nullptr;
-  {
+  if (thread_caching_) {
+    ThreadCache* cache = GetThreadCache();
+    for (Arena** link = &cache->arenas; *link != nullptr; link = &(*link)->next_) {
+      if ((*link)->Size() >= size) {
+        ret = *link;
+        *link = ret->next_;
+        // Only this thread writes the counters, they need no atomic update.
+        cache->bytes = cache->bytes.Load() - ret->Size();
+        cache->hits = cache->hits.Load() + 1;
+        break;
+      }
+    }
+  }
+  if (ret == nullptr) {
+    Thread* self = Thread::Current();
     MutexLock lock(self, lock_);
     if (free_arenas_ != nullptr && LIKELY(free_arenas_->Size() >= size)) {
       ret = free_arenas_;
       free_arenas_ = free_arenas_->next_;
+      shared_hits_.FetchAndAdd(1);
     }
   }
   if (ret == nullptr) {
     ret = new Arena(size);
+    arenas_created_.FetchAndAdd(1);
+    arena_bytes_.FetchAndAdd(ret->Size());
   }
   ret->Reset();
   return ret;
@@ -182,6 +269,16 @@ void ArenaPool::FreeArenaChain(Arena* first) {
       VALGRIND_MAKE_MEM_UNDEFINED(arena->memory_, arena->bytes_allocated_);
     }
   }
+  if (thread_caching_ && first != nullptr) {
+    ThreadCache* cache = GetThreadCache();
+    while (first != nullptr && cache->bytes.Load() + first->Size() <= kThreadCacheBytes) {
+      Arena* arena = first;
+      first = first->next_;
+      arena->next_ = cache->arenas;
+      cache->arenas = arena;
+      cache->bytes = cache->bytes.Load() + arena->Size();
+    }
+  }
   if (first != nullptr) {
     Arena* last = first;
     while (last->next_ != nullptr) {
@@ -194,6 +291,47 @@ void ArenaPool::FreeArenaChain(Arena* first) {
   }
 }
 
+size_t ArenaPool::TrimFreeArenas() {
+  Arena* arenas;
+  {
+    MutexLock lock(Thread::Current(), lock_);
+    arenas = free_arenas_;
+    free_arenas_ = nullptr;
+  }
+  size_t released = 0;
+  while (arenas != nullptr) {
+    Arena* arena = arenas;
+    arenas = arenas->next_;
+    released += arena->Size();
+    delete arena;
+  }
+  arena_bytes_.FetchAndSub(released);
+  trimmed_bytes_.FetchAndAdd(released);
+  return released;
+}
+
+void ArenaPool::DumpStats(std::ostream& os) const {
+  size_t cache_hits;
+  size_t cached_bytes = 0;
+  size_t num_caches;
+  {
+    // The threads may still be updating the counters of their caches, the lock only keeps the
+    // caches of exiting threads from being released.
+    MutexLock lock(Thread::Current(), lock_);
+    cache_hits = released_cache_hits_.Load();
+    num_caches = thread_caches_.size();
+    for (const ThreadCache* cache : thread_caches_) {
+      cache_hits += cache->hits.Load();
+      cached_bytes += cache->bytes.Load();
+    }
+  }
+  os << StringPrintf("Arena pool: %zu arenas created, %zu reused from %zu thread caches, "
+                     "%zu reused from the free list, %s held, %s in thread caches, %s trimmed\n",
+                     arenas_created_.Load(), cache_hits, num_caches, shared_hits_.Load(),
+                     PrettySize(arena_bytes_.Load()).c_str(), PrettySize(cached_bytes).c_str(),
+                     PrettySize(trimmed_bytes_.Load()).c_str());
+}
+
 size_t ArenaAllocator::BytesAllocated() const {
   return ArenaAllocatorStats::BytesAllocated();
 }
@@ -17,9 +17,14 @@
 #ifndef ART_COMPILER_UTILS_ARENA_ALLOCATOR_H_
 #define ART_COMPILER_UTILS_ARENA_ALLOCATOR_H_
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stddef.h>
 
+#include <iosfwd>
+#include <vector>
+
+#include "atomic.h"
 #include "base/macros.h"
 #include "base/mutex.h"
 #include "mem_map.h"
@@ -133,16 +138,54 @@ class Arena {
   DISALLOW_COPY_AND_ASSIGN(Arena);
 };
 
+// Recycles arenas. With thread_caching, every thread keeps a small cache of the arenas it freed
+// so that a pool shared by the compiler threads is mostly used without taking its lock. Arenas
+// that do not fit in the cache go to the shared free list.
 class ArenaPool {
  public:
-  ArenaPool();
+  explicit ArenaPool(bool thread_caching = false);
   ~ArenaPool();
-  Arena* AllocArena(size_t size);
-  void FreeArenaChain(Arena* first);
+  Arena* AllocArena(size_t size) LOCKS_EXCLUDED(lock_);
+  void FreeArenaChain(Arena* first) LOCKS_EXCLUDED(lock_);
+
+  // Releases the arenas on the shared free list to the OS and returns the number of bytes
+  // released. The arenas cached by running threads are kept, the caches of exited threads were
+  // already moved to the free list.
+  size_t TrimFreeArenas() LOCKS_EXCLUDED(lock_);
+
+  // Dumps the number of arenas created and reused and the bytes held and trimmed.
+  void DumpStats(std::ostream& os) const LOCKS_EXCLUDED(lock_);
 
  private:
-  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  // The arenas freed by one thread, only accessed by that thread while it allocates. The counters
+  // are only written by that thread but are read by DumpStats.
+  struct ThreadCache {
+    explicit ThreadCache(ArenaPool* pool) : pool(pool), arenas(nullptr), bytes(0), hits(0) {}
+    ArenaPool* const pool;
+    Arena* arenas;
+    Atomic<size_t> bytes;
+    Atomic<size_t> hits;
+  };
+
+  ThreadCache* GetThreadCache() LOCKS_EXCLUDED(lock_);
+
+  // Destructor of the cache key, moves the arenas of an exiting thread to the shared free list.
+  static void ReleaseThreadCache(void* arg);
+
+  const bool thread_caching_;
+  pthread_key_t thread_cache_key_;
+
+  mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   Arena* free_arenas_ GUARDED_BY(lock_);
+  std::vector<ThreadCache*> thread_caches_ GUARDED_BY(lock_);
+
+  Atomic<size_t> arenas_created_;
+  Atomic<size_t> arena_bytes_;
+  Atomic<size_t> shared_hits_;
+  // The hits of the caches of the threads that exited.
+  Atomic<size_t> released_cache_hits_;
+  Atomic<size_t> trimmed_bytes_;
+
   DISALLOW_COPY_AND_ASSIGN(ArenaPool);
 };
 
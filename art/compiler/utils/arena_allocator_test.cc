@@ -30,4 +30,59 @@ TEST(ArenaAllocator, Test) {
   EXPECT_EQ(2U, bv.GetStorageSize());
 }
 
+TEST(ArenaAllocator, ThreadCache) {
+  ArenaPool pool(true);
+  Arena* arena = pool.AllocArena(Arena::kDefaultSize);
+  pool.FreeArenaChain(arena);
+  // The arena is reused from the cache of the thread, so there is nothing to trim.
+  EXPECT_EQ(arena, pool.AllocArena(Arena::kDefaultSize));
+  pool.FreeArenaChain(arena);
+  EXPECT_EQ(0U, pool.TrimFreeArenas());
+}
+
+static void* AllocAndFreeArena(void* arg) {
+  ArenaPool* pool = reinterpret_cast<ArenaPool*>(arg);
+  pool->FreeArenaChain(pool->AllocArena(Arena::kDefaultSize));
+  return nullptr;
+}
+
+TEST(ArenaAllocator, ThreadCacheReleasedOnThreadExit) {
+  ArenaPool pool(true);
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, nullptr, AllocAndFreeArena, &pool));
+  ASSERT_EQ(0, pthread_join(thread, nullptr));
+  // The arena cached by the exited thread was moved to the free list.
+  EXPECT_LE(Arena::kDefaultSize, pool.TrimFreeArenas());
+}
+
+TEST(ArenaAllocator, TrimFreeArenas) {
+  ArenaPool pool;
+  {
+    ArenaAllocator arena(&pool);
+    for (size_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(arena.Alloc(Arena::kDefaultSize, kArenaAllocMisc) != nullptr);
+    }
+  }
+  EXPECT_LE(3 * Arena::kDefaultSize, pool.TrimFreeArenas());
+  EXPECT_EQ(0U, pool.TrimFreeArenas());
+}
+
+TEST(ArenaAllocator, LargeArenaIsZeroedOnReuse) {
+  static constexpr size_t kSize = 3 * MB;
+  ArenaPool pool;
+  {
+    ArenaAllocator arena(&pool);
+    uint8_t* memory = reinterpret_cast<uint8_t*>(arena.Alloc(kSize, kArenaAllocMisc));
+    ASSERT_TRUE(memory != nullptr);
+    memset(memory, 0xff, kSize);
+  }
+  ArenaAllocator arena(&pool);
+  uint8_t* memory = reinterpret_cast<uint8_t*>(arena.Alloc(kSize, kArenaAllocMisc));
+  ASSERT_TRUE(memory != nullptr);
+  for (size_t i = 0; i < kSize; i += kPageSize) {
+    ASSERT_EQ(0U, memory[i]);
+  }
+  EXPECT_EQ(0U, memory[kSize - 1]);
+}
+
 }  // namespace art
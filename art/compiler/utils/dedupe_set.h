@@ -17,68 +17,197 @@
 #ifndef ART_COMPILER_UTILS_DEDUPE_SET_H_
 #define ART_COMPILER_UTILS_DEDUPE_SET_H_
 
-#include <set>
+#include <new>
 #include <string>
 
+#include "atomic.h"
 #include "base/mutex.h"
-#include "base/stl_util.h"
 #include "base/stringprintf.h"
+#include "utils.h"
+#include "utils/arena_allocator.h"
 
 namespace art {
 
 // A set of Keys that support a HashFunc returning HashType. Used to find duplicates of Key in the
-// Add method. The data-structure is thread-safe through the use of internal locks, it also
-// supports the lock being sharded.
+// Add method. Key is a container such as std::vector<uint8_t>, its size is used for the stats.
+//
+// Each shard is an open addressing table of hashes and key pointers. Lookups are lock-free, the
+// lock of a shard is only taken to add a new key. The copied keys and the tables are allocated in
+// arenas and live as long as the set, so a table that was replaced by a larger one can still be
+// probed by concurrent lookups. A lookup that misses in a stale table retries under the lock.
 template <typename Key, typename HashType, typename HashFunc, HashType kShard = 1>
 class DedupeSet {
-  typedef std::pair<HashType, Key*> HashedKey;
+  // The key is published after the hash, an empty slot has a null key.
+  struct Slot {
+    volatile HashType hash;
+    Key* volatile key;
+  };
+
+  struct Table {
+    size_t mask;
+    Slot* slots;
+  };
 
-  class Comparator {
+  class Shard {
    public:
-    bool operator()(const HashedKey& a, const HashedKey& b) const {
-      if (a.first != b.first) {
-        return a.first < b.first;
-      } else {
-        return *a.second < *b.second;
+    Shard(ArenaPool* pool, const char* lock_name)
+        : lock_(lock_name), allocator_(pool), table_(NewTable(kInitialCapacity)), size_(0) {
+    }
+
+    ~Shard() {
+      // Every key is in the current table exactly once.
+      const Table* table = table_;
+      for (size_t i = 0; i <= table->mask; ++i) {
+        if (table->slots[i].key != nullptr) {
+          table->slots[i].key->~Key();
+        }
+      }
+    }
+
+    Key* Find(HashType hash, const Key& key) const {
+      const Table* table = table_;
+      QuasiAtomic::MembarLoadLoad();
+      return Probe(table, hash, key);
+    }
+
+    // Returns the key equal to key, copying it into the shard if there is none yet.
+    Key* FindOrAdd(Thread* self, HashType hash, const Key& key, bool* added)
+        LOCKS_EXCLUDED(lock_) {
+      MutexLock mu(self, lock_);
+      Key* existing = Probe(table_, hash, key);
+      if (existing != nullptr) {
+        *added = false;
+        return existing;
+      }
+      if (2 * (size_ + 1) > table_->mask + 1) {
+        Grow();
+      }
+      Key* new_key = new (allocator_.Alloc(sizeof(Key), kArenaAllocMisc)) Key(key);
+      Insert(table_, hash, new_key);
+      ++size_;
+      *added = true;
+      return new_key;
+    }
+
+   private:
+    static constexpr size_t kInitialCapacity = 256;
+
+    static Key* Probe(const Table* table, HashType hash, const Key& key) {
+      for (size_t i = Index(hash) & table->mask; ; i = (i + 1) & table->mask) {
+        Key* slot_key = table->slots[i].key;
+        if (slot_key == nullptr) {
+          return nullptr;
+        }
+        QuasiAtomic::MembarLoadLoad();
+        if (table->slots[i].hash == hash && *slot_key == key) {
+          return slot_key;
+        }
       }
     }
+
+    static void Insert(Table* table, HashType hash, Key* key) {
+      size_t i = Index(hash) & table->mask;
+      while (table->slots[i].key != nullptr) {
+        i = (i + 1) & table->mask;
+      }
+      table->slots[i].hash = hash;
+      QuasiAtomic::MembarStoreStore();
+      table->slots[i].key = key;
+    }
+
+    // The low bits of the hash select the shard.
+    static size_t Index(HashType hash) {
+      return static_cast<size_t>(hash / kShard);
+    }
+
+    Table* NewTable(size_t capacity) {
+      DCHECK(IsPowerOfTwo(capacity));
+      // Arena allocations are zeroed, which leaves all slots empty.
+      Table* table = new (allocator_.Alloc(sizeof(Table), kArenaAllocMisc)) Table;
+      table->mask = capacity - 1;
+      table->slots = reinterpret_cast<Slot*>(allocator_.Alloc(capacity * sizeof(Slot),
+                                                              kArenaAllocMisc));
+      return table;
+    }
+
+    void Grow() EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+      Table* old_table = table_;
+      Table* new_table = NewTable(2 * (old_table->mask + 1));
+      for (size_t i = 0; i <= old_table->mask; ++i) {
+        if (old_table->slots[i].key != nullptr) {
+          Insert(new_table, old_table->slots[i].hash, old_table->slots[i].key);
+        }
+      }
+      // Publish the new table only once it is filled, the old one stays valid for lookups.
+      QuasiAtomic::MembarStoreStore();
+      table_ = new_table;
+    }
+
+    Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+    ArenaAllocator allocator_ GUARDED_BY(lock_);
+    Table* volatile table_;
+    size_t size_ GUARDED_BY(lock_);
+
+    DISALLOW_COPY_AND_ASSIGN(Shard);
   };
 
  public:
   Key* Add(Thread* self, const Key& key) {
-    HashType raw_hash = HashFunc()(key);
-    HashType shard_hash = raw_hash / kShard;
-    HashType shard_bin = raw_hash % kShard;
-    HashedKey hashed_key(shard_hash, const_cast<Key*>(&key));
-    MutexLock lock(self, *lock_[shard_bin]);
-    auto it = keys_[shard_bin].find(hashed_key);
-    if (it != keys_[shard_bin].end()) {
-      return it->second;
+    const HashType raw_hash = HashFunc()(key);
+    Shard* shard = shards_[raw_hash % kShard].get();
+    const size_t key_bytes = key.size() * sizeof(key[0]);
+    adds_.FetchAndAdd(1);
+    Key* result = shard->Find(raw_hash, key);
+    bool added = false;
+    if (result == nullptr) {
+      result = shard->FindOrAdd(self, raw_hash, key, &added);
+    }
+    if (added) {
+      bytes_stored_.FetchAndAdd(key_bytes);
+    } else {
+      hits_.FetchAndAdd(1);
+      bytes_saved_.FetchAndAdd(key_bytes);
     }
-    hashed_key.second = new Key(key);
-    keys_[shard_bin].insert(hashed_key);
-    return hashed_key.second;
+    return result;
   }
 
-  explicit DedupeSet(const char* set_name) {
+  explicit DedupeSet(const char* set_name) : name_(set_name) {
     for (HashType i = 0; i < kShard; ++i) {
       std::ostringstream oss;
       oss << set_name << " lock " << i;
       lock_name_[i] = oss.str();
-      lock_[i].reset(new Mutex(lock_name_[i].c_str()));
+      shards_[i].reset(new Shard(&pool_, lock_name_[i].c_str()));
     }
   }
 
   ~DedupeSet() {
+    // The shards use the pool.
     for (HashType i = 0; i < kShard; ++i) {
-      STLDeleteValues(&keys_[i]);
+      shards_[i].reset();
     }
   }
 
+  // Returns the number of adds, the hit ratio and the bytes stored and saved by deduplication.
+  std::string DumpStats() const {
+    const size_t adds = adds_.Load();
+    const size_t hits = hits_.Load();
+    return StringPrintf("%s: %zu adds, %zu unique, %.1f%% hits, %s stored, %s saved",
+                        name_.c_str(), adds, adds - hits,
+                        (adds == 0) ? 0.0 : (100.0 * hits) / adds,
+                        PrettySize(bytes_stored_.Load()).c_str(),
+                        PrettySize(bytes_saved_.Load()).c_str());
+  }
+
  private:
+  const std::string name_;
   std::string lock_name_[kShard];
-  UniquePtr<Mutex> lock_[kShard];
-  std::set<HashedKey, Comparator> keys_[kShard];
+  ArenaPool pool_;
+  UniquePtr<Shard> shards_[kShard];
+
+  Atomic<size_t> adds_;
+  Atomic<size_t> hits_;
+  Atomic<size_t> bytes_stored_;
+  Atomic<size_t> bytes_saved_;
 
   DISALLOW_COPY_AND_ASSIGN(DedupeSet);
 };
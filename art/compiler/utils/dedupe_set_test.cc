@@ -15,6 +15,9 @@
  */
 
 #include "dedupe_set.h"
+
+#include <pthread.h>
+
 #include "gtest/gtest.h"
 #include "thread-inl.h"
 
@@ -72,4 +75,69 @@ TEST(DedupeSetTest, Test) {
   }
 }
 
+static std::vector<uint8_t> MakeArray(size_t i) {
+  std::vector<uint8_t> array;
+  for (size_t value = i; ; value >>= 8) {
+    array.push_back(value & 0xff);
+    if (value < 0x100) {
+      break;
+    }
+  }
+  return array;
+}
+
+TEST(DedupeSetTest, Grow) {
+  Thread* self = Thread::Current();
+  typedef std::vector<uint8_t> ByteArray;
+  DedupeSet<ByteArray, size_t, DedupeHashFunc, 4> deduplicator("test");
+  const size_t kCount = 10000;
+  std::vector<ByteArray*> added;
+  for (size_t i = 0; i < kCount; ++i) {
+    added.push_back(deduplicator.Add(self, MakeArray(i)));
+    ASSERT_EQ(MakeArray(i), *added.back());
+  }
+  for (size_t i = 0; i < kCount; ++i) {
+    ASSERT_EQ(added[i], deduplicator.Add(self, MakeArray(i)));
+  }
+  std::string stats = deduplicator.DumpStats();
+  EXPECT_NE(std::string::npos, stats.find("20000 adds, 10000 unique, 50.0% hits")) << stats;
+}
+
+struct ConcurrentAddArgs {
+  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc, 4>* deduplicator;
+  size_t count;
+  std::vector<std::vector<uint8_t>*> added;
+};
+
+static void* ConcurrentAdd(void* arg) {
+  ConcurrentAddArgs* args = reinterpret_cast<ConcurrentAddArgs*>(arg);
+  for (size_t i = 0; i < args->count; ++i) {
+    args->added.push_back(args->deduplicator->Add(nullptr, MakeArray(i)));
+  }
+  return nullptr;
+}
+
+TEST(DedupeSetTest, ConcurrentAdd) {
+  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc, 4> deduplicator("test");
+  const size_t kThreads = 4;
+  const size_t kCount = 20000;
+  ConcurrentAddArgs args[kThreads];
+  pthread_t threads[kThreads];
+  for (size_t i = 0; i < kThreads; ++i) {
+    args[i].deduplicator = &deduplicator;
+    args[i].count = kCount;
+    ASSERT_EQ(0, pthread_create(&threads[i], nullptr, ConcurrentAdd, &args[i]));
+  }
+  for (size_t i = 0; i < kThreads; ++i) {
+    ASSERT_EQ(0, pthread_join(threads[i], nullptr));
+  }
+  // Every thread got the same copy of every key.
+  for (size_t i = 0; i < kCount; ++i) {
+    ASSERT_EQ(MakeArray(i), *args[0].added[i]);
+    for (size_t j = 1; j < kThreads; ++j) {
+      ASSERT_EQ(args[0].added[i], args[j].added[i]);
+    }
+  }
+}
+
 }  // namespace art
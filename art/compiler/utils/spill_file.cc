@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spill_file.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "base/stringprintf.h"
+#include "base/unix_file/fd_file.h"
+
+namespace art {
+
+SpillFile::SpillFile(File* file) : file_(file), size_(0), mapped_(false) {
+}
+
+SpillFile::~SpillFile() {
+}
+
+SpillFile* SpillFile::Create(const std::string& filename, std::string* error_msg) {
+  UniquePtr<File> file(OS::CreateEmptyFile(filename.c_str()));
+  if (file.get() == NULL) {
+    *error_msg = StringPrintf("Failed to create spill file '%s': %s", filename.c_str(),
+                              strerror(errno));
+    return NULL;
+  }
+  if (unlink(filename.c_str()) != 0) {
+    *error_msg = StringPrintf("Failed to unlink spill file '%s': %s", filename.c_str(),
+                              strerror(errno));
+    return NULL;
+  }
+  return new SpillFile(file.release());
+}
+
+off_t SpillFile::Append(const void* data, size_t size) {
+  CHECK(!mapped_) << file_->GetPath();
+  const char* bytes = reinterpret_cast<const char*>(data);
+  size_t written = 0;
+  while (written < size) {
+    ssize_t rc = TEMP_FAILURE_RETRY(pwrite(file_->Fd(), bytes + written, size - written,
+                                           size_ + written));
+    if (rc <= 0) {
+      PLOG(ERROR) << "Failed to write " << size << " bytes to spill file " << file_->GetPath();
+      return -1;
+    }
+    written += rc;
+  }
+  off_t offset = size_;
+  size_ += size;
+  return offset;
+}
+
+bool SpillFile::Read(off_t offset, size_t size, void* data) const {
+  DCHECK_LE(offset + size, size_);
+  char* bytes = reinterpret_cast<char*>(data);
+  size_t read = 0;
+  while (read < size) {
+    ssize_t rc = TEMP_FAILURE_RETRY(pread(file_->Fd(), bytes + read, size - read, offset + read));
+    if (rc <= 0) {
+      PLOG(ERROR) << "Failed to read " << size << " bytes from spill file " << file_->GetPath();
+      return false;
+    }
+    read += rc;
+  }
+  return true;
+}
+
+bool SpillFile::MapForReading(std::string* error_msg) {
+  CHECK(!mapped_) << file_->GetPath();
+  if (size_ != 0) {
+    map_.reset(MemMap::MapFile(size_, PROT_READ, MAP_SHARED, file_->Fd(), 0,
+                               file_->GetPath().c_str(), error_msg));
+    if (map_.get() == NULL) {
+      return false;
+    }
+  }
+  mapped_ = true;
+  return true;
+}
+
+}  // namespace art
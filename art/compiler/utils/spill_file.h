@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_UTILS_SPILL_FILE_H_
+#define ART_COMPILER_UTILS_SPILL_FILE_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include "UniquePtr.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "mem_map.h"
+#include "os.h"
+
+namespace art {
+
+// An append-only temporary file that compiled payloads are moved to once they are complete, so
+// that they do not stay in the anonymous memory of the compiler until the output is written. The
+// payloads are read back through a read-only shared mapping, whose clean pages the kernel can drop
+// under memory pressure.
+//
+// Not thread-safe, payloads are appended between the compilation of dex files.
+class SpillFile {
+ public:
+  // Creates the file and unlinks it, so that it does not outlive the compiler. Returns NULL on
+  // failure.
+  static SpillFile* Create(const std::string& filename, std::string* error_msg);
+
+  ~SpillFile();
+
+  // Appends size bytes of data and returns their offset, or -1 on failure. The data is written at
+  // the end of the appended payloads rather than at the file position, so that a failed or
+  // partial write does not move the offsets of the payloads appended after it.
+  off_t Append(const void* data, size_t size);
+
+  // Copies size bytes at offset into data, for reading back payloads without a mapping.
+  bool Read(off_t offset, size_t size, void* data) const;
+
+  // Maps the file for reading, no data can be appended afterwards.
+  bool MapForReading(std::string* error_msg);
+
+  bool IsMapped() const {
+    return mapped_;
+  }
+
+  const uint8_t* GetData(off_t offset) const {
+    DCHECK(IsMapped());
+    DCHECK_LT(static_cast<size_t>(offset), size_);
+    return map_->Begin() + offset;
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+ private:
+  explicit SpillFile(File* file);
+
+  UniquePtr<File> file_;
+  size_t size_;
+  bool mapped_;
+  // NULL while appending, and when nothing was appended.
+  UniquePtr<MemMap> map_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpillFile);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_UTILS_SPILL_FILE_H_
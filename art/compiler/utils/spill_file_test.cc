@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spill_file.h"
+
+#include <vector>
+
+#include "common_runtime_test.h"
+
+namespace art {
+
+class SpillFileTest : public CommonRuntimeTest {};
+
+TEST_F(SpillFileTest, AppendAndRead) {
+  ScratchFile tmp;
+  std::string error_msg;
+  std::string filename(tmp.GetFilename() + ".spill");
+  UniquePtr<SpillFile> spill_file(SpillFile::Create(filename, &error_msg));
+  ASSERT_TRUE(spill_file.get() != NULL) << error_msg;
+  // The file is gone once it is open.
+  EXPECT_FALSE(OS::FileExists(filename.c_str()));
+
+  std::vector<uint8_t> first(100, 1);
+  std::vector<uint8_t> second(5000, 2);
+  EXPECT_EQ(0, spill_file->Append(&first[0], first.size()));
+  EXPECT_EQ(100, spill_file->Append(&second[0], second.size()));
+  EXPECT_EQ(5100U, spill_file->Size());
+
+  ASSERT_TRUE(spill_file->MapForReading(&error_msg)) << error_msg;
+  EXPECT_TRUE(spill_file->IsMapped());
+  EXPECT_EQ(0, memcmp(&first[0], spill_file->GetData(0), first.size()));
+  EXPECT_EQ(0, memcmp(&second[0], spill_file->GetData(100), second.size()));
+}
+
+TEST_F(SpillFileTest, ReadWithoutMapping) {
+  ScratchFile tmp;
+  std::string error_msg;
+  UniquePtr<SpillFile> spill_file(SpillFile::Create(tmp.GetFilename() + ".spill", &error_msg));
+  ASSERT_TRUE(spill_file.get() != NULL) << error_msg;
+
+  std::vector<uint8_t> first(100, 1);
+  std::vector<uint8_t> second(5000, 2);
+  EXPECT_EQ(0, spill_file->Append(&first[0], first.size()));
+  EXPECT_EQ(100, spill_file->Append(&second[0], second.size()));
+
+  std::vector<uint8_t> data(second.size());
+  ASSERT_TRUE(spill_file->Read(100, data.size(), &data[0]));
+  EXPECT_TRUE(data == second);
+  data.resize(first.size());
+  ASSERT_TRUE(spill_file->Read(0, data.size(), &data[0]));
+  EXPECT_TRUE(data == first);
+  EXPECT_FALSE(spill_file->IsMapped());
+}
+
+TEST_F(SpillFileTest, MapEmpty) {
+  ScratchFile tmp;
+  std::string error_msg;
+  UniquePtr<SpillFile> spill_file(SpillFile::Create(tmp.GetFilename() + ".spill", &error_msg));
+  ASSERT_TRUE(spill_file.get() != NULL) << error_msg;
+  ASSERT_TRUE(spill_file->MapForReading(&error_msg)) << error_msg;
+  EXPECT_TRUE(spill_file->IsMapped());
+  EXPECT_EQ(0U, spill_file->Size());
+}
+
+}  // namespace art
@@ -87,6 +87,7 @@ LIBART_COMMON_SRC_FILES := \
 	jdwp/jdwp_request.cc \
 	jdwp/jdwp_socket.cc \
 	jdwp/object_registry.cc \
+	jit/portable_jit.cc \
 	jni_internal.cc \
 	jobject_comparator.cc \
 	mem_map.cc \
@@ -361,6 +362,8 @@ define build-libart
     LOCAL_SRC_FILES := $(LIBART_TARGET_SRC_FILES)
     $(foreach arch,$(ART_SUPPORTED_ARCH),
       LOCAL_SRC_FILES_$(arch) := $$(LIBART_TARGET_SRC_FILES_$(arch)))
+    $(foreach arch,$(ART_SUPPORTED_ARCH),
+      LOCAL_CFLAGS_$(arch) := $$(ART_TARGET_CFLAGS_$(arch)))
   else # host
     LOCAL_SRC_FILES := $(LIBART_HOST_SRC_FILES)
     LOCAL_IS_HOST_MODULE := true
@@ -17,6 +17,7 @@
 
 #define ATRACE_TAG ATRACE_TAG_DALVIK
 #include <stdio.h>
+#include <string.h>
 #include <cutils/trace.h>
 
 #include "timing_logger.h"
@@ -25,7 +26,9 @@
 #include "thread-inl.h"
 #include "base/stl_util.h"
 #include "base/histogram-inl.h"
+#include "utils.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 
@@ -62,6 +65,7 @@ void CumulativeLogger::Reset() {
   iterations_ = 0;
   total_time_ = 0;
   STLDeleteElements(&histograms_);
+  accumulated_splits_.clear();
 }
 
 void CumulativeLogger::AddLogger(const TimingLogger &logger) {
@@ -74,6 +78,15 @@ void CumulativeLogger::AddLogger(const TimingLogger &logger) {
   ++iterations_;
 }
 
+void CumulativeLogger::AddAccumulator(const TimingAccumulator& accumulator) {
+  MutexLock mu(Thread::Current(), lock_);
+  for (const std::pair<const char*, TimingAccumulator::SplitStats>& split : accumulator.splits_) {
+    accumulated_splits_[split.first].Merge(split.second);
+    total_time_ += split.second.total_us;
+  }
+  iterations_ += accumulator.iterations_;
+}
+
 size_t CumulativeLogger::GetIterations() const {
   MutexLock mu(Thread::Current(), lock_);
   return iterations_;
@@ -82,6 +95,9 @@ size_t CumulativeLogger::GetIterations() const {
 void CumulativeLogger::Dump(std::ostream &os) const {
   MutexLock mu(Thread::Current(), lock_);
   DumpHistogram(os);
+  if (!accumulated_splits_.empty()) {
+    DumpAccumulatedSplits(os);
+  }
 }
 
 void CumulativeLogger::AddPair(const std::string& label, uint64_t delta_time) {
@@ -123,6 +139,78 @@ void CumulativeLogger::DumpHistogram(std::ostream &os) const {
   os << "Done Dumping histograms \n";
 }
 
+void CumulativeLogger::DumpAccumulatedSplits(std::ostream &os) const {
+  std::vector<std::pair<uint64_t, const std::string*> > sorted_splits;
+  for (const auto& split : accumulated_splits_) {
+    sorted_splits.push_back(std::make_pair(split.second.total_us, &split.first));
+  }
+  std::sort(sorted_splits.rbegin(), sorted_splits.rend());
+  os << "Accumulated splits for " << name_ << "\n";
+  for (const auto& sorted_split : sorted_splits) {
+    const TimingAccumulator::SplitStats& stats =
+        accumulated_splits_.find(*sorted_split.second)->second;
+    os << *sorted_split.second << ":\tSum: " << PrettyDuration(stats.total_us * kAdjust)
+       << " Count: " << stats.count
+       << " Avg: " << PrettyDuration(stats.total_us * kAdjust / std::max<uint64_t>(stats.count, 1))
+       << " 50% < " << PrettyDuration(stats.PercentileUpperBound(0.5) * kAdjust)
+       << " 99% < " << PrettyDuration(stats.PercentileUpperBound(0.99) * kAdjust)
+       << " Max: " << PrettyDuration(stats.max_us * kAdjust) << "\n";
+  }
+}
+
+void TimingAccumulator::SplitStats::Add(uint64_t time_us) {
+  ++count;
+  total_us += time_us;
+  max_us = std::max(max_us, time_us);
+  size_t bucket = (time_us == 0) ? 0 : 64 - CLZ(time_us);
+  ++buckets[std::min(bucket, kBucketCount - 1)];
+}
+
+void TimingAccumulator::SplitStats::Merge(const SplitStats& other) {
+  count += other.count;
+  total_us += other.total_us;
+  max_us = std::max(max_us, other.max_us);
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    buckets[i] += other.buckets[i];
+  }
+}
+
+uint64_t TimingAccumulator::SplitStats::PercentileUpperBound(double percentile) const {
+  const uint64_t target = static_cast<uint64_t>(std::ceil(percentile * count));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    seen += buckets[i];
+    if (seen >= target) {
+      return std::min(UINT64_C(1) << i, max_us);
+    }
+  }
+  return max_us;
+}
+
+void TimingAccumulator::AddLogger(const TimingLogger& logger) {
+  for (const TimingLogger::SplitTiming& split : logger.GetSplits()) {
+    const char* split_name = split.second;
+    SplitStats* stats = nullptr;
+    for (std::pair<const char*, SplitStats>& entry : splits_) {
+      if (entry.first == split_name || strcmp(entry.first, split_name) == 0) {
+        stats = &entry.second;
+        break;
+      }
+    }
+    if (stats == nullptr) {
+      splits_.push_back(std::make_pair(split_name, SplitStats()));
+      stats = &splits_.back().second;
+    }
+    stats->Add(split.first / 1000);
+  }
+  ++iterations_;
+}
+
+void TimingAccumulator::Reset() {
+  splits_.clear();
+  iterations_ = 0;
+}
+
 TimingLogger::TimingLogger(const char* name, bool precise, bool verbose)
     : name_(name), precise_(precise), verbose_(verbose), current_split_(NULL) {
 }
@@ -21,6 +21,8 @@
 #include "base/macros.h"
 #include "base/mutex.h"
 
+#include <algorithm>
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
@@ -28,6 +30,51 @@
 namespace art {
 class TimingLogger;
 
+// Accumulates the splits of many TimingLoggers for a single thread, without locking. The times of
+// each split are counted in a fixed number of buckets of power of two microseconds. The
+// accumulators of the threads are merged into a CumulativeLogger once their work is done.
+class TimingAccumulator {
+ public:
+  // Bucket 0 counts times below 1us, bucket i times in [2^(i-1), 2^i) us.
+  static constexpr size_t kBucketCount = 32;
+
+  struct SplitStats {
+    SplitStats() : count(0), total_us(0), max_us(0) {
+      std::fill(buckets, buckets + kBucketCount, 0);
+    }
+
+    void Add(uint64_t time_us);
+    void Merge(const SplitStats& other);
+    // Returns the upper bound of the bucket holding the given percentile.
+    uint64_t PercentileUpperBound(double percentile) const;
+
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+    uint64_t buckets[kBucketCount];
+  };
+
+  TimingAccumulator() : iterations_(0) {}
+
+  void AddLogger(const TimingLogger& logger);
+
+  // Clears the accumulated splits and iterations.
+  void Reset();
+
+  size_t GetIterations() const {
+    return iterations_;
+  }
+
+ private:
+  // Split names are usually string literals, so they are compared by address first. There are few
+  // distinct names, a vector is faster than a map.
+  std::vector<std::pair<const char*, SplitStats> > splits_;
+  size_t iterations_;
+
+  friend class CumulativeLogger;
+  DISALLOW_COPY_AND_ASSIGN(TimingAccumulator);
+};
+
 class CumulativeLogger {
  public:
   explicit CumulativeLogger(const std::string& name);
@@ -43,6 +90,8 @@ class CumulativeLogger {
   // parent class that is unable to determine the "name" of a sub-class.
   void SetName(const std::string& name) LOCKS_EXCLUDED(lock_);
   void AddLogger(const TimingLogger& logger) LOCKS_EXCLUDED(lock_);
+  // Merges the splits of a thread's accumulator, taking the lock once.
+  void AddAccumulator(const TimingAccumulator& accumulator) LOCKS_EXCLUDED(lock_);
   size_t GetIterations() const;
 
  private:
@@ -60,11 +109,14 @@ class CumulativeLogger {
   void AddPair(const std::string &label, uint64_t delta_time)
       EXCLUSIVE_LOCKS_REQUIRED(lock_);
   void DumpHistogram(std::ostream &os) const EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void DumpAccumulatedSplits(std::ostream &os) const EXCLUSIVE_LOCKS_REQUIRED(lock_);
   uint64_t GetTotalTime() const {
     return total_time_;
   }
   static const uint64_t kAdjust = 1000;
   std::set<Histogram<uint64_t>*, HistogramComparator> histograms_ GUARDED_BY(lock_);
+  // Splits merged from TimingAccumulators, by name.
+  std::map<std::string, TimingAccumulator::SplitStats> accumulated_splits_ GUARDED_BY(lock_);
   std::string name_;
   const std::string lock_name_;
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
@@ -157,4 +157,42 @@ TEST_F(TimingLoggerTest, ScopedAndExplicit) {
   EXPECT_STREQ(splits[3].second, outersplit);
 }
 
+TEST_F(TimingLoggerTest, Accumulator) {
+  TimingAccumulator accumulator;
+  for (size_t i = 0; i < 3; ++i) {
+    TimingLogger timings("Accumulator", true, false);
+    timings.StartSplit("First Split");
+    timings.NewSplit("Second Split");
+    timings.EndSplit();
+    accumulator.AddLogger(timings);
+  }
+  EXPECT_EQ(3U, accumulator.GetIterations());
+
+  CumulativeLogger cumulative("Accumulator");
+  cumulative.AddAccumulator(accumulator);
+  cumulative.AddAccumulator(accumulator);
+  EXPECT_EQ(6U, cumulative.GetIterations());
+  std::ostringstream os;
+  cumulative.Dump(os);
+  EXPECT_NE(std::string::npos, os.str().find("First Split:")) << os.str();
+  EXPECT_NE(std::string::npos, os.str().find("Second Split:")) << os.str();
+  EXPECT_NE(std::string::npos, os.str().find("Count: 6")) << os.str();
+
+  accumulator.Reset();
+  EXPECT_EQ(0U, accumulator.GetIterations());
+}
+
+TEST_F(TimingLoggerTest, AccumulatorPercentiles) {
+  TimingAccumulator::SplitStats stats;
+  for (uint64_t time_us = 1; time_us <= 1000; ++time_us) {
+    stats.Add(time_us);
+  }
+  EXPECT_EQ(1000U, stats.count);
+  EXPECT_EQ(1000U, stats.max_us);
+  EXPECT_EQ(500500U, stats.total_us);
+  // 500us is in the bucket [256, 512), 990us in [512, 1024) which is capped by the maximum.
+  EXPECT_EQ(512U, stats.PercentileUpperBound(0.5));
+  EXPECT_EQ(1000U, stats.PercentileUpperBound(0.99));
+}
+
 }  // namespace art
@@ -131,6 +131,198 @@ static size_t Hash(const char* s) {
   return hash;
 }
 
+// Marks the slot of a removed class, a lookup has to probe past it.
+static mirror::Class* const kRemovedClass = reinterpret_cast<mirror::Class*>(1);
+
+static constexpr size_t kMinClassTableCapacity = 1024;
+
+static size_t FirstClassTableSlot(size_t hash, size_t mask) {
+  return (hash ^ (hash >> 16)) & mask;
+}
+
+static bool MatchesClass(mirror::Class* klass, const char* descriptor,
+                         const mirror::ClassLoader* class_loader)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (klass->GetClassLoader() != class_loader) {
+    return false;
+  }
+  ClassHelper kh(klass);
+  return strcmp(descriptor, kh.GetDescriptor()) == 0;
+}
+
+ClassLinker::ClassTable::ClassTable()
+    : slot_array_(new SlotArray(kMinClassTableCapacity)), size_(0), num_removed_(0) {
+}
+
+ClassLinker::ClassTable::~ClassTable() {
+  delete slot_array_;
+  STLDeleteElements(&retired_slot_arrays_);
+}
+
+bool ClassLinker::ClassTable::IsLive(const mirror::Class* klass) {
+  return klass != nullptr && klass != kRemovedClass;
+}
+
+mirror::Class* ClassLinker::ClassTable::Find(const char* descriptor,
+                                             const mirror::ClassLoader* class_loader,
+                                             size_t hash) const {
+  const SlotArray* slot_array = slot_array_;
+  // Pairs with the barrier of Resize.
+  QuasiAtomic::MembarLoadLoad();
+  // The table is never more than half full, the probing ends at an unused slot.
+  for (size_t i = FirstClassTableSlot(hash, slot_array->mask); ;
+       i = (i + 1) & slot_array->mask) {
+    const Slot& slot = slot_array->slots[i];
+    mirror::Class* klass = slot.klass;
+    if (klass == nullptr) {
+      return nullptr;
+    }
+    // Pairs with the barrier of Insert.
+    QuasiAtomic::MembarLoadLoad();
+    if (klass != kRemovedClass && slot.hash == hash &&
+        MatchesClass(klass, descriptor, class_loader)) {
+      if (kIsDebugBuild) {
+        // Check for duplicates in the table.
+        for (size_t j = (i + 1) & slot_array->mask; slot_array->slots[j].klass != nullptr;
+             j = (j + 1) & slot_array->mask) {
+          mirror::Class* klass2 = slot_array->slots[j].klass;
+          CHECK(klass2 == kRemovedClass || slot_array->slots[j].hash != hash ||
+                !MatchesClass(klass2, descriptor, class_loader))
+              << PrettyClass(klass) << " " << klass << " " << klass->GetClassLoader() << " "
+              << PrettyClass(klass2) << " " << klass2 << " " << klass2->GetClassLoader();
+        }
+      }
+      return klass;
+    }
+  }
+}
+
+void ClassLinker::ClassTable::FindAll(const char* descriptor, size_t hash,
+                                      std::vector<mirror::Class*>* result) const {
+  const SlotArray* slot_array = slot_array_;
+  QuasiAtomic::MembarLoadLoad();
+  for (size_t i = FirstClassTableSlot(hash, slot_array->mask); ;
+       i = (i + 1) & slot_array->mask) {
+    const Slot& slot = slot_array->slots[i];
+    mirror::Class* klass = slot.klass;
+    if (klass == nullptr) {
+      return;
+    }
+    QuasiAtomic::MembarLoadLoad();
+    if (klass != kRemovedClass && slot.hash == hash) {
+      ClassHelper kh(klass);
+      if (strcmp(descriptor, kh.GetDescriptor()) == 0) {
+        result->push_back(klass);
+      }
+    }
+  }
+}
+
+ClassLinker::ClassTable::Slot* ClassLinker::ClassTable::FindSlot(mirror::Class* klass,
+                                                                 size_t hash) {
+  SlotArray* slot_array = slot_array_;
+  for (size_t i = FirstClassTableSlot(hash, slot_array->mask); ;
+       i = (i + 1) & slot_array->mask) {
+    Slot* slot = &slot_array->slots[i];
+    if (slot->klass == nullptr) {
+      return nullptr;
+    }
+    if (slot->klass == klass) {
+      return slot;
+    }
+  }
+}
+
+void ClassLinker::ClassTable::Insert(mirror::Class* klass, size_t hash) {
+  SlotArray* slot_array = slot_array_;
+  if ((size_ + num_removed_ + 1) * 2 > slot_array->mask + 1) {
+    // Grow once a quarter of the capacity holds classes, otherwise only drop the removed slots.
+    size_t capacity = kMinClassTableCapacity;
+    while (capacity < (size_ + 1) * 4) {
+      capacity *= 2;
+    }
+    Resize(capacity);
+    slot_array = slot_array_;
+  }
+  for (size_t i = FirstClassTableSlot(hash, slot_array->mask); ;
+       i = (i + 1) & slot_array->mask) {
+    Slot& slot = slot_array->slots[i];
+    if (slot.klass == nullptr) {
+      slot.hash = hash;
+      // A concurrent Find must not see the class before its hash.
+      QuasiAtomic::MembarStoreStore();
+      slot.klass = klass;
+      ++size_;
+      return;
+    }
+  }
+}
+
+bool ClassLinker::ClassTable::Remove(const char* descriptor,
+                                     const mirror::ClassLoader* class_loader, size_t hash) {
+  mirror::Class* klass = Find(descriptor, class_loader, hash);
+  if (klass == nullptr) {
+    return false;
+  }
+  FindSlot(klass, hash)->klass = kRemovedClass;
+  --size_;
+  ++num_removed_;
+  return true;
+}
+
+void ClassLinker::ClassTable::Update(mirror::Class* old_ref, mirror::Class* new_ref,
+                                     size_t hash) {
+  Slot* slot = FindSlot(old_ref, hash);
+  if (slot != nullptr) {
+    slot->klass = new_ref;
+  }
+}
+
+void ClassLinker::ClassTable::Resize(size_t capacity) {
+  SlotArray* old_slot_array = slot_array_;
+  SlotArray* new_slot_array = new SlotArray(capacity);
+  for (size_t i = 0; i <= old_slot_array->mask; ++i) {
+    const Slot& slot = old_slot_array->slots[i];
+    if (!IsLive(slot.klass)) {
+      continue;
+    }
+    size_t j = FirstClassTableSlot(slot.hash, new_slot_array->mask);
+    while (new_slot_array->slots[j].klass != nullptr) {
+      j = (j + 1) & new_slot_array->mask;
+    }
+    new_slot_array->slots[j].hash = slot.hash;
+    new_slot_array->slots[j].klass = slot.klass;
+  }
+  // A concurrent Find must see the filled slots of the new array.
+  QuasiAtomic::MembarStoreStore();
+  slot_array_ = new_slot_array;
+  num_removed_ = 0;
+  retired_slot_arrays_.push_back(old_slot_array);
+}
+
+void ClassLinker::ClassTable::VisitRoots(RootCallback* callback, void* arg) {
+  SlotArray* slot_array = slot_array_;
+  for (size_t i = 0; i <= slot_array->mask; ++i) {
+    Slot& slot = slot_array->slots[i];
+    mirror::Object* object = slot.klass;
+    if (!IsLive(slot.klass)) {
+      continue;
+    }
+    callback(&object, arg, 0, kRootStickyClass);
+    slot.klass = down_cast<mirror::Class*>(object);
+  }
+}
+
+void ClassLinker::ClassTable::Visit(ClassVisitor* visitor, void* arg) const {
+  const SlotArray* slot_array = slot_array_;
+  for (size_t i = 0; i <= slot_array->mask; ++i) {
+    mirror::Class* klass = slot_array->slots[i].klass;
+    if (IsLive(klass) && !visitor(klass, arg)) {
+      return;
+    }
+  }
+}
+
 const char* ClassLinker::class_roots_descriptors_[] = {
   "Ljava/lang/Class;",
   "Ljava/lang/Object;",
@@ -774,7 +966,10 @@ const DexFile* ClassLinker::FindOrCreateOatFileForDexLocation(const char* dex_lo
 
   // Generate the output oat file for the dex file
   VLOG(class_linker) << "Generating oat file " << oat_location << " for " << dex_location;
-  if (!GenerateOatFile(dex_location, scoped_flock.GetFile().Fd(), oat_location, &error_msg)) {
+  // dex2oat compiles every dex file of a multidex archive into the oat file of the archive.
+  const std::string base_location(DexFile::GetBaseLocation(dex_location));
+  if (!GenerateOatFile(base_location.c_str(), scoped_flock.GetFile().Fd(), oat_location,
+                       &error_msg)) {
     CHECK(!error_msg.empty());
     error_msgs->push_back(error_msg);
     return nullptr;
@@ -924,9 +1119,12 @@ const DexFile* ClassLinker::FindDexFileInOatFileFromDexLocation(const char* dex_
     return ret;
   }
 
+  // A secondary dex file of a multidex archive is in the oat file of the archive.
+  const std::string base_location(DexFile::GetBaseLocation(dex_location));
+
   // Look for an existing file next to dex. for example, for
   // /foo/bar/baz.jar, look for /foo/bar/baz.odex.
-  std::string odex_filename(OatFile::DexFilenameToOdexFilename(dex_location));
+  std::string odex_filename(OatFile::DexFilenameToOdexFilename(base_location));
   bool open_failed;
   std::string error_msg;
   const DexFile* dex_file = VerifyAndOpenDexFileFromOatFile(odex_filename, dex_location,
@@ -943,7 +1141,7 @@ const DexFile* ClassLinker::FindDexFileInOatFileFromDexLocation(const char* dex_
 
   std::string cache_error_msg;
   const std::string dalvik_cache(GetDalvikCacheOrDie(GetInstructionSetString(kRuntimeISA)));
-  std::string cache_location(GetDalvikCacheFilenameOrDie(dex_location,
+  std::string cache_location(GetDalvikCacheFilenameOrDie(base_location.c_str(),
                                                          dalvik_cache.c_str()));
   dex_file = VerifyAndOpenDexFileFromOatFile(cache_location, dex_location, &cache_error_msg,
                                              &open_failed);
@@ -1129,24 +1327,15 @@ void ClassLinker::VisitRoots(RootCallback* callback, void* arg, VisitRootFlags f
   {
     WriterMutexLock mu(self, *Locks::classlinker_classes_lock_);
     if ((flags & kVisitRootFlagAllRoots) != 0) {
-      for (std::pair<const size_t, mirror::Class*>& it : class_table_) {
-        callback(reinterpret_cast<mirror::Object**>(&it.second), arg, 0, kRootStickyClass);
-      }
+      class_table_.VisitRoots(callback, arg);
     } else if ((flags & kVisitRootFlagNewRoots) != 0) {
       for (auto& pair : new_class_roots_) {
         mirror::Object* old_ref = pair.second;
         callback(reinterpret_cast<mirror::Object**>(&pair.second), arg, 0, kRootStickyClass);
         if (UNLIKELY(pair.second != old_ref)) {
-          // Uh ohes, GC moved a root in the log. Need to search the class_table and update the
-          // corresponding object. This is slow, but luckily for us, this may only happen with a
-          // concurrent moving GC.
-          for (auto it = class_table_.lower_bound(pair.first), end = class_table_.end();
-              it != end && it->first == pair.first; ++it) {
-            // If the class stored matches the old class, update it to the new value.
-            if (old_ref == it->second) {
-              it->second = pair.second;
-            }
-          }
+          // Uh ohes, GC moved a root in the log. Need to update the corresponding object in the
+          // class_table. This may only happen with a concurrent moving GC.
+          class_table_.Update(down_cast<mirror::Class*>(old_ref), pair.second, pair.first);
         }
       }
     }
@@ -1176,11 +1365,7 @@ void ClassLinker::VisitClasses(ClassVisitor* visitor, void* arg) {
     MoveImageClassesToClassTable();
   }
   WriterMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  for (const std::pair<size_t, mirror::Class*>& it : class_table_) {
-    if (!visitor(it.second, arg)) {
-      return;
-    }
-  }
+  class_table_.Visit(visitor, arg);
 }
 
 static bool GetClassesVisitor(mirror::Class* c, void* arg) {
@@ -2370,8 +2555,7 @@ mirror::Class* ClassLinker::InsertClass(const char* descriptor, mirror::Class* k
     LOG(INFO) << "Loaded class " << descriptor << source;
   }
   WriterMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  mirror::Class* existing =
-      LookupClassFromTableLocked(descriptor, klass->GetClassLoader(), hash);
+  mirror::Class* existing = class_table_.Find(descriptor, klass->GetClassLoader(), hash);
   if (existing != NULL) {
     return existing;
   }
@@ -2384,7 +2568,7 @@ mirror::Class* ClassLinker::InsertClass(const char* descriptor, mirror::Class* k
     }
   }
   VerifyObject(klass);
-  class_table_.insert(std::make_pair(hash, klass));
+  class_table_.Insert(klass, hash);
   if (log_new_class_table_roots_) {
     new_class_roots_.push_back(std::make_pair(hash, klass));
   }
@@ -2394,34 +2578,22 @@ mirror::Class* ClassLinker::InsertClass(const char* descriptor, mirror::Class* k
 bool ClassLinker::RemoveClass(const char* descriptor, const mirror::ClassLoader* class_loader) {
   size_t hash = Hash(descriptor);
   WriterMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  for (auto it = class_table_.lower_bound(hash), end = class_table_.end(); it != end && it->first == hash;
-       ++it) {
-    mirror::Class* klass = it->second;
-    ClassHelper kh(klass);
-    if ((klass->GetClassLoader() == class_loader) &&
-        (strcmp(descriptor, kh.GetDescriptor()) == 0)) {
-      class_table_.erase(it);
-      return true;
-    }
-  }
-  return false;
+  return class_table_.Remove(descriptor, class_loader, hash);
 }
 
 mirror::Class* ClassLinker::LookupClass(const char* descriptor,
                                         const mirror::ClassLoader* class_loader) {
   size_t hash = Hash(descriptor);
-  {
-    ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-    mirror::Class* result = LookupClassFromTableLocked(descriptor, class_loader, hash);
-    if (result != NULL) {
-      return result;
-    }
+  // Lookups of loaded classes, the common case during resolution, don't take the lock.
+  mirror::Class* result = class_table_.Find(descriptor, class_loader, hash);
+  if (result != NULL) {
+    return result;
   }
   if (class_loader != NULL || !dex_cache_image_class_lookup_required_) {
     return NULL;
   } else {
     // Lookup failed but need to search dex_caches_.
-    mirror::Class* result = LookupClassFromImage(descriptor);
+    result = LookupClassFromImage(descriptor);
     if (result != NULL) {
       InsertClass(descriptor, result, hash);
     } else {
@@ -2437,32 +2609,6 @@ mirror::Class* ClassLinker::LookupClass(const char* descriptor,
   }
 }
 
-mirror::Class* ClassLinker::LookupClassFromTableLocked(const char* descriptor,
-                                                       const mirror::ClassLoader* class_loader,
-                                                       size_t hash) {
-  auto end = class_table_.end();
-  for (auto it = class_table_.lower_bound(hash); it != end && it->first == hash; ++it) {
-    mirror::Class* klass = it->second;
-    ClassHelper kh(klass);
-    if ((klass->GetClassLoader() == class_loader) &&
-        (strcmp(descriptor, kh.GetDescriptor()) == 0)) {
-      if (kIsDebugBuild) {
-        // Check for duplicates in the table.
-        for (++it; it != end && it->first == hash; ++it) {
-          mirror::Class* klass2 = it->second;
-          ClassHelper kh(klass2);
-          CHECK(!((klass2->GetClassLoader() == class_loader) &&
-                  (strcmp(descriptor, kh.GetDescriptor()) == 0)))
-              << PrettyClass(klass) << " " << klass << " " << klass->GetClassLoader() << " "
-              << PrettyClass(klass2) << " " << klass2 << " " << klass2->GetClassLoader();
-        }
-      }
-      return klass;
-    }
-  }
-  return NULL;
-}
-
 static mirror::ObjectArray<mirror::DexCache>* GetImageDexCaches()
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
   gc::space::ImageSpace* image = Runtime::Current()->GetHeap()->GetImageSpace();
@@ -2490,12 +2636,12 @@ void ClassLinker::MoveImageClassesToClassTable() {
         DCHECK(klass->GetClassLoader() == NULL);
         const char* descriptor = kh.GetDescriptor();
         size_t hash = Hash(descriptor);
-        mirror::Class* existing = LookupClassFromTableLocked(descriptor, NULL, hash);
+        mirror::Class* existing = class_table_.Find(descriptor, NULL, hash);
         if (existing != NULL) {
           CHECK(existing == klass) << PrettyClassAndClassLoader(existing) << " != "
               << PrettyClassAndClassLoader(klass);
         } else {
-          class_table_.insert(std::make_pair(hash, klass));
+          class_table_.Insert(klass, hash);
           if (log_new_class_table_roots_) {
             new_class_roots_.push_back(std::make_pair(hash, klass));
           }
@@ -2541,14 +2687,7 @@ void ClassLinker::LookupClasses(const char* descriptor, std::vector<mirror::Clas
   }
   size_t hash = Hash(descriptor);
   ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  for (auto it = class_table_.lower_bound(hash), end = class_table_.end();
-      it != end && it->first == hash; ++it) {
-    mirror::Class* klass = it->second;
-    ClassHelper kh(klass);
-    if (strcmp(descriptor, kh.GetDescriptor()) == 0) {
-      result.push_back(klass);
-    }
-  }
+  class_table_.FindAll(descriptor, hash, &result);
 }
 
 void ClassLinker::VerifyClass(const Handle<mirror::Class>& klass) {
@@ -2631,7 +2770,16 @@ void ClassLinker::VerifyClass(const Handle<mirror::Class>& klass) {
   }
   verifier::MethodVerifier::FailureKind verifier_failure = verifier::MethodVerifier::kNoFailure;
   std::string error_msg;
-  if (!preverified) {
+  bool cached_soft_failures;
+  if (!preverified && Runtime::Current()->IsCompiler() &&
+      Runtime::Current()->GetCompilerCallbacks()->IsClassVerificationCached(
+          ClassReference(&dex_file, klass->GetDexClassDefIndex()), &cached_soft_failures)) {
+    // Verified by an earlier compilation of the same dex files, the verified methods are already
+    // known to the compiler.
+    if (cached_soft_failures) {
+      verifier_failure = verifier::MethodVerifier::kSoftFailure;
+    }
+  } else if (!preverified) {
     verifier_failure = verifier::MethodVerifier::VerifyClass(klass.Get(),
                                                              Runtime::Current()->IsCompiler(),
                                                              &error_msg);
@@ -4400,6 +4548,11 @@ const char* ClassLinker::MethodShorty(uint32_t method_idx, mirror::ArtMethod* re
   return dex_file.GetMethodShorty(method_id, length);
 }
 
+static bool GetAllClassesVisitor(mirror::Class* c, void* arg) {
+  reinterpret_cast<std::vector<mirror::Class*>*>(arg)->push_back(c);
+  return true;
+}
+
 void ClassLinker::DumpAllClasses(int flags) {
   if (dex_cache_image_class_lookup_required_) {
     MoveImageClassesToClassTable();
@@ -4409,9 +4562,7 @@ void ClassLinker::DumpAllClasses(int flags) {
   std::vector<mirror::Class*> all_classes;
   {
     ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-    for (const std::pair<size_t, mirror::Class*>& it : class_table_) {
-      all_classes.push_back(it.second);
-    }
+    class_table_.Visit(GetAllClassesVisitor, &all_classes);
   }
 
   for (size_t i = 0; i < all_classes.size(); ++i) {
@@ -4424,7 +4575,7 @@ void ClassLinker::DumpForSigQuit(std::ostream& os) {
     MoveImageClassesToClassTable();
   }
   ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  os << "Loaded classes: " << class_table_.size() << " allocated classes\n";
+  os << "Loaded classes: " << class_table_.Size() << " allocated classes\n";
 }
 
 size_t ClassLinker::NumLoadedClasses() {
@@ -4432,7 +4583,7 @@ size_t ClassLinker::NumLoadedClasses() {
     MoveImageClassesToClassTable();
   }
   ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  return class_table_.size();
+  return class_table_.Size();
 }
 
 pid_t ClassLinker::GetClassesLockOwner() {
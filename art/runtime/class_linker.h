@@ -560,11 +560,72 @@ class ClassLinker {
   std::vector<const OatFile*> oat_files_ GUARDED_BY(dex_lock_);
 
 
-  // multimap from a string hash code of a class descriptor to
-  // mirror::Class* instances. Results should be compared for a matching
-  // Class::descriptor_ and Class::class_loader_.
-  typedef std::multimap<size_t, mirror::Class*> Table;
-  Table class_table_ GUARDED_BY(Locks::classlinker_classes_lock_);
+  // Open addressing hash table with linear probing from a string hash code of a class descriptor
+  // to mirror::Class* instances. Modifications need the classlinker_classes_lock_ exclusively
+  // held. Find doesn't need the lock and may run concurrently with them, so the slot arrays
+  // replaced on growth are only freed with the table.
+  class ClassTable {
+   public:
+    ClassTable();
+    ~ClassTable();
+
+    // Returns the class with the descriptor defined by class_loader, or NULL.
+    mirror::Class* Find(const char* descriptor, const mirror::ClassLoader* class_loader,
+                        size_t hash) const
+        SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+    // Adds the classes with the descriptor, whatever their class loader, to result.
+    void FindAll(const char* descriptor, size_t hash, std::vector<mirror::Class*>* result) const
+        SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+    void Insert(mirror::Class* klass, size_t hash)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::classlinker_classes_lock_);
+    bool Remove(const char* descriptor, const mirror::ClassLoader* class_loader, size_t hash)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::classlinker_classes_lock_)
+        SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+    // Replaces old_ref, moved by the GC, with new_ref.
+    void Update(mirror::Class* old_ref, mirror::Class* new_ref, size_t hash)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::classlinker_classes_lock_);
+    void VisitRoots(RootCallback* callback, void* arg)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::classlinker_classes_lock_);
+    // Calls visitor on the classes until it returns false.
+    void Visit(ClassVisitor* visitor, void* arg) const
+        SHARED_LOCKS_REQUIRED(Locks::classlinker_classes_lock_);
+
+    size_t Size() const {
+      return size_;
+    }
+
+   private:
+    struct Slot {
+      volatile size_t hash;
+      // NULL if the slot was never used.
+      mirror::Class* volatile klass;
+    };
+
+    struct SlotArray {
+      explicit SlotArray(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]()) {
+      }
+      ~SlotArray() {
+        delete[] slots;
+      }
+
+      const size_t mask;
+      Slot* const slots;
+    };
+
+    static bool IsLive(const mirror::Class* klass);
+    Slot* FindSlot(mirror::Class* klass, size_t hash)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::classlinker_classes_lock_);
+    void Resize(size_t capacity) EXCLUSIVE_LOCKS_REQUIRED(Locks::classlinker_classes_lock_);
+
+    SlotArray* volatile slot_array_;
+    std::vector<SlotArray*> retired_slot_arrays_;
+    // Number of classes and of removed slots, which are skipped but not reused.
+    size_t size_;
+    size_t num_removed_;
+
+    DISALLOW_COPY_AND_ASSIGN(ClassTable);
+  };
+  ClassTable class_table_;
   std::vector<std::pair<size_t, mirror::Class*> > new_class_roots_;
 
   // Do we need to search dex caches to find image classes?
@@ -573,11 +634,6 @@ class ClassLinker {
   // the classes into the class_table_ to avoid dex cache based searches.
   AtomicInteger failed_dex_cache_class_lookups_;
 
-  mirror::Class* LookupClassFromTableLocked(const char* descriptor,
-                                            const mirror::ClassLoader* class_loader,
-                                            size_t hash)
-      SHARED_LOCKS_REQUIRED(Locks::classlinker_classes_lock_, Locks::mutator_lock_);
-
   void MoveImageClassesToClassTable() LOCKS_EXCLUDED(Locks::classlinker_classes_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   mirror::Class* LookupClassFromImage(const char* descriptor)
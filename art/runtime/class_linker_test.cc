@@ -35,6 +35,8 @@
 #include "mirror/reference.h"
 #include "mirror/stack_trace_element.h"
 #include "handle_scope-inl.h"
+#include "thread_pool.h"
+#include "utils.h"
 
 namespace art {
 
@@ -1113,4 +1115,106 @@ TEST_F(ClassLinkerTest, ClassRootDescriptors) {
   }
 }
 
+class LookupClassesTask : public Task {
+ public:
+  LookupClassesTask(ClassLinker* class_linker, const std::vector<std::string>* descriptors,
+                    std::vector<mirror::Class*>* classes)
+      : class_linker_(class_linker), descriptors_(descriptors), classes_(classes) {
+  }
+
+  void Run(Thread* self) {
+    ScopedObjectAccess soa(self);
+    for (const std::string& descriptor : *descriptors_) {
+      classes_->push_back(class_linker_->LookupClass(descriptor.c_str(), nullptr));
+    }
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  ClassLinker* const class_linker_;
+  const std::vector<std::string>* const descriptors_;
+  std::vector<mirror::Class*>* const classes_;
+};
+
+// Looks up the loaded classes of libcore from several threads at once, as the compiler workers do
+// when resolving types. Every thread finds every class, the same one a serial lookup finds.
+TEST_F(ClassLinkerTest, ParallelLookupClass) {
+  Thread* self = Thread::Current();
+  std::vector<std::string> descriptors;
+  std::vector<mirror::Class*> expected;
+  {
+    ScopedObjectAccess soa(self);
+    for (size_t i = 0; i < java_lang_dex_file_->NumClassDefs(); i++) {
+      const DexFile::ClassDef& class_def = java_lang_dex_file_->GetClassDef(i);
+      const char* descriptor = java_lang_dex_file_->GetClassDescriptor(class_def);
+      if (class_linker_->FindSystemClass(soa.Self(), descriptor) != nullptr) {
+        descriptors.push_back(descriptor);
+      } else {
+        soa.Self()->ClearException();
+      }
+    }
+    for (const std::string& descriptor : descriptors) {
+      mirror::Class* klass = class_linker_->LookupClass(descriptor.c_str(), nullptr);
+      ASSERT_TRUE(klass != nullptr) << descriptor;
+      expected.push_back(klass);
+    }
+  }
+  ASSERT_FALSE(descriptors.empty());
+  for (size_t num_threads = 1; num_threads <= 16; num_threads *= 2) {
+    ThreadPool thread_pool("Class linker test thread pool", num_threads);
+    std::vector<std::vector<mirror::Class*> > classes(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+      thread_pool.AddTask(self, new LookupClassesTask(class_linker_, &descriptors, &classes[i]));
+    }
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, false, false);
+    for (size_t i = 0; i < num_threads; ++i) {
+      ASSERT_EQ(descriptors.size(), classes[i].size());
+      for (size_t j = 0; j < descriptors.size(); ++j) {
+        EXPECT_EQ(expected[j], classes[i][j]) << descriptors[j] << " on thread " << i << " of "
+                                              << num_threads;
+      }
+    }
+  }
+}
+
+// Not a correctness test, reports the lookup throughput of the loaded classes of libcore from 1 to
+// 64 threads. ParallelLookupClass checks the results.
+TEST_F(ClassLinkerTest, ParallelLookupClassThroughput) {
+  Thread* self = Thread::Current();
+  std::vector<std::string> descriptors;
+  {
+    ScopedObjectAccess soa(self);
+    for (size_t i = 0; i < java_lang_dex_file_->NumClassDefs(); i++) {
+      const DexFile::ClassDef& class_def = java_lang_dex_file_->GetClassDef(i);
+      const char* descriptor = java_lang_dex_file_->GetClassDescriptor(class_def);
+      if (class_linker_->FindSystemClass(soa.Self(), descriptor) != nullptr) {
+        descriptors.push_back(descriptor);
+      } else {
+        soa.Self()->ClearException();
+      }
+    }
+  }
+  ASSERT_FALSE(descriptors.empty());
+  for (size_t num_threads = 1; num_threads <= 64; num_threads *= 2) {
+    ThreadPool thread_pool("Class linker test thread pool", num_threads);
+    std::vector<std::vector<mirror::Class*> > classes(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+      classes[i].reserve(descriptors.size());
+      thread_pool.AddTask(self, new LookupClassesTask(class_linker_, &descriptors, &classes[i]));
+    }
+    uint64_t start_ns = NanoTime();
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, false, false);
+    uint64_t duration_ns = NanoTime() - start_ns;
+    size_t num_lookups = num_threads * descriptors.size();
+    LOG(INFO) << num_threads << " threads: " << num_lookups << " lookups in "
+              << PrettyDuration(duration_ns) << ", "
+              << num_lookups * 1000000000ULL / std::max<uint64_t>(duration_ns, 1) << " lookups/s";
+  }
+}
+
 }  // namespace art
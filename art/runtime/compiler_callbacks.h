@@ -36,6 +36,14 @@ class CompilerCallbacks {
         SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) = 0;
     virtual void ClassRejected(ClassReference ref) = 0;
 
+    // Returns true if the class was verified by an earlier compilation, in which case it is not
+    // verified again. soft_failures tells whether it must be verified again at runtime.
+    virtual bool IsClassVerificationCached(ClassReference ref, bool* soft_failures) {
+      UNUSED(ref);
+      UNUSED(soft_failures);
+      return false;
+    }
+
   protected:
     CompilerCallbacks() { }
 };
@@ -16,8 +16,11 @@
 
 #include "dex_file.h"
 
+#include <algorithm>
+
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +28,7 @@
 #include <sys/stat.h>
 
 #include "base/logging.h"
+#include "base/stl_util.h"
 #include "base/stringprintf.h"
 #include "class_linker.h"
 #include "dex_file-inl.h"
@@ -35,10 +39,12 @@
 #include "mirror/art_method-inl.h"
 #include "mirror/string.h"
 #include "os.h"
+#include "runtime.h"
 #include "safe_map.h"
 #include "ScopedFd.h"
 #include "handle_scope-inl.h"
 #include "thread.h"
+#include "thread_pool.h"
 #include "UniquePtr.h"
 #include "utf-inl.h"
 #include "utils.h"
@@ -86,28 +92,35 @@ static int OpenAndReadMagic(const char* filename, uint32_t* magic, std::string*
 
 bool DexFile::GetChecksum(const char* filename, uint32_t* checksum, std::string* error_msg) {
   CHECK(checksum != NULL);
+  // A secondary dex file of a multidex archive has the checksum of its own entry.
+  const bool is_multidex_location = IsMultiDexLocation(filename);
+  const std::string archive_filename(GetBaseLocation(filename));
+  const char* entry_name = is_multidex_location
+      ? strrchr(filename, kMultiDexSeparator) + 1
+      : kClassesDex;
   uint32_t magic;
-  ScopedFd fd(OpenAndReadMagic(filename, &magic, error_msg));
+  ScopedFd fd(OpenAndReadMagic(archive_filename.c_str(), &magic, error_msg));
   if (fd.get() == -1) {
     DCHECK(!error_msg->empty());
     return false;
   }
   if (IsZipMagic(magic)) {
-    UniquePtr<ZipArchive> zip_archive(ZipArchive::OpenFromFd(fd.release(), filename, error_msg));
+    UniquePtr<ZipArchive> zip_archive(ZipArchive::OpenFromFd(fd.release(),
+                                                             archive_filename.c_str(), error_msg));
     if (zip_archive.get() == NULL) {
-      *error_msg = StringPrintf("Failed to open zip archive '%s'", filename);
+      *error_msg = StringPrintf("Failed to open zip archive '%s'", archive_filename.c_str());
       return false;
     }
-    UniquePtr<ZipEntry> zip_entry(zip_archive->Find(kClassesDex, error_msg));
+    UniquePtr<ZipEntry> zip_entry(zip_archive->Find(entry_name, error_msg));
     if (zip_entry.get() == NULL) {
-      *error_msg = StringPrintf("Zip archive '%s' doesn't contain %s (error msg: %s)", filename,
-                                kClassesDex, error_msg->c_str());
+      *error_msg = StringPrintf("Zip archive '%s' doesn't contain %s (error msg: %s)",
+                                archive_filename.c_str(), entry_name, error_msg->c_str());
       return false;
     }
     *checksum = zip_entry->GetCrc32();
     return true;
   }
-  if (IsDexMagic(magic)) {
+  if (IsDexMagic(magic) && !is_multidex_location) {
     UniquePtr<const DexFile> dex_file(DexFile::OpenFile(fd.release(), filename, false, error_msg));
     if (dex_file.get() == NULL) {
       return false;
@@ -245,14 +258,20 @@ const DexFile* DexFile::Open(const ZipArchive& zip_archive, const std::string& l
   if (zip_entry.get() == NULL) {
     return nullptr;
   }
-  UniquePtr<MemMap> map(zip_entry->ExtractToMemMap(kClassesDex, error_msg));
+  // Stored and aligned entries are mapped straight from the archive, which avoids copying the
+  // dex file into private dirty memory.
+  UniquePtr<MemMap> map(zip_entry->MapDirectlyOrExtract(location.c_str(), kClassesDex, error_msg));
   if (map.get() == NULL) {
     *error_msg = StringPrintf("Failed to extract '%s' from '%s': %s", kClassesDex, location.c_str(),
                               error_msg->c_str());
     return nullptr;
   }
-  UniquePtr<const DexFile> dex_file(OpenMemory(location, zip_entry->GetCrc32(), map.release(),
-                                               error_msg));
+  return OpenExtracted(location, zip_entry->GetCrc32(), map.release(), error_msg);
+}
+
+const DexFile* DexFile::OpenExtracted(const std::string& location, uint32_t location_checksum,
+                                      MemMap* mem_map, std::string* error_msg) {
+  UniquePtr<const DexFile> dex_file(OpenMemory(location, location_checksum, mem_map, error_msg));
   if (dex_file.get() == nullptr) {
     *error_msg = StringPrintf("Failed to open dex file '%s' from memory: %s", location.c_str(),
                               error_msg->c_str());
@@ -262,7 +281,7 @@ const DexFile* DexFile::Open(const ZipArchive& zip_archive, const std::string& l
                                location.c_str(), error_msg)) {
     return nullptr;
   }
-  if (!dex_file->DisableWrite()) {
+  if (!dex_file->IsReadOnly() && !dex_file->DisableWrite()) {
     *error_msg = StringPrintf("Failed to make dex file '%s' read only", location.c_str());
     return nullptr;
   }
@@ -270,6 +289,154 @@ const DexFile* DexFile::Open(const ZipArchive& zip_archive, const std::string& l
   return dex_file.release();
 }
 
+std::string DexFile::GetMultiDexClassesDexName(size_t index) {
+  if (index == 0) {
+    return kClassesDex;
+  }
+  return StringPrintf("classes%zu.dex", index + 1);
+}
+
+std::string DexFile::GetMultiDexLocation(size_t index, const std::string& location) {
+  if (index == 0) {
+    return location;
+  }
+  return StringPrintf("%s%c%s", location.c_str(), kMultiDexSeparator,
+                      GetMultiDexClassesDexName(index).c_str());
+}
+
+bool DexFile::IsMultiDexLocation(const char* location) {
+  return strrchr(location, kMultiDexSeparator) != nullptr;
+}
+
+std::string DexFile::GetBaseLocation(const char* location) {
+  const char* separator = strrchr(location, kMultiDexSeparator);
+  if (separator == nullptr) {
+    return location;
+  }
+  return std::string(location, separator - location);
+}
+
+// Opens and verifies one entry of a multidex archive. The entries have already been read from
+// the archive, whose file offset may not be shared between threads.
+class OpenExtractedDexFileTask : public Task {
+ public:
+  OpenExtractedDexFileTask(const std::string& location, uint32_t location_checksum,
+                           MemMap* mem_map, const DexFile** dex_file, std::string* error_msg)
+      : location_(location), location_checksum_(location_checksum), mem_map_(mem_map),
+        dex_file_(dex_file), error_msg_(error_msg) {
+  }
+
+  void Run(Thread* self) {
+    UNUSED(self);
+    *dex_file_ = DexFile::OpenExtracted(location_, location_checksum_, mem_map_.release(),
+                                        error_msg_);
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  const std::string location_;
+  const uint32_t location_checksum_;
+  UniquePtr<MemMap> mem_map_;
+  const DexFile** const dex_file_;
+  std::string* const error_msg_;
+
+  DISALLOW_COPY_AND_ASSIGN(OpenExtractedDexFileTask);
+};
+
+bool DexFile::OpenAll(const char* filename, const char* location, ThreadPool* thread_pool,
+                      std::string* error_msg, std::vector<const DexFile*>* dex_files) {
+  uint32_t magic;
+  ScopedFd fd(OpenAndReadMagic(filename, &magic, error_msg));
+  if (fd.get() == -1) {
+    DCHECK(!error_msg->empty());
+    return false;
+  }
+  if (IsZipMagic(magic)) {
+    UniquePtr<ZipArchive> zip_archive(ZipArchive::OpenFromFd(fd.release(), location, error_msg));
+    if (zip_archive.get() == nullptr) {
+      DCHECK(!error_msg->empty());
+      return false;
+    }
+    return OpenAll(*zip_archive, location, thread_pool, error_msg, dex_files);
+  }
+  if (IsDexMagic(magic)) {
+    const DexFile* dex_file = DexFile::OpenFile(fd.release(), location, true, error_msg);
+    if (dex_file == nullptr) {
+      return false;
+    }
+    dex_files->push_back(dex_file);
+    return true;
+  }
+  *error_msg = StringPrintf("Expected valid zip or dex file: '%s'", filename);
+  return false;
+}
+
+bool DexFile::OpenAll(const ZipArchive& zip_archive, const std::string& location,
+                      ThreadPool* thread_pool, std::string* error_msg,
+                      std::vector<const DexFile*>* dex_files) {
+  CHECK(!location.empty());
+  CHECK(dex_files != nullptr);
+  // Find and read the entries, stopping at the first missing secondary dex file.
+  std::vector<std::string> locations;
+  std::vector<uint32_t> checksums;
+  std::vector<MemMap*> maps;
+  for (size_t i = 0; ; ++i) {
+    std::string entry_name(GetMultiDexClassesDexName(i));
+    std::string find_error_msg;
+    UniquePtr<ZipEntry> zip_entry(zip_archive.Find(entry_name.c_str(), &find_error_msg));
+    if (zip_entry.get() == nullptr) {
+      if (i == 0) {
+        *error_msg = find_error_msg;
+        return false;
+      }
+      break;
+    }
+    MemMap* map = zip_entry->MapDirectlyOrExtract(location.c_str(), entry_name.c_str(), error_msg);
+    if (map == nullptr) {
+      *error_msg = StringPrintf("Failed to extract '%s' from '%s': %s", entry_name.c_str(),
+                                location.c_str(), error_msg->c_str());
+      STLDeleteElements(&maps);
+      return false;
+    }
+    maps.push_back(map);
+    locations.push_back(GetMultiDexLocation(i, location));
+    checksums.push_back(zip_entry->GetCrc32());
+  }
+
+  // Parse and verify them, each dex file reports into its own slot.
+  const size_t count = maps.size();
+  std::vector<const DexFile*> opened(count, nullptr);
+  std::vector<std::string> error_msgs(count);
+  if (thread_pool == nullptr || count == 1) {
+    for (size_t i = 0; i < count; ++i) {
+      opened[i] = OpenExtracted(locations[i], checksums[i], maps[i], &error_msgs[i]);
+      maps[i] = nullptr;
+    }
+  } else {
+    Thread* self = Thread::Current();
+    for (size_t i = 0; i < count; ++i) {
+      thread_pool->AddTask(self, new OpenExtractedDexFileTask(locations[i], checksums[i], maps[i],
+                                                              &opened[i], &error_msgs[i]));
+      maps[i] = nullptr;
+    }
+    thread_pool->StartWorkers(self);
+    thread_pool->Wait(self, true, false);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    if (opened[i] == nullptr) {
+      *error_msg = error_msgs[i];
+      STLDeleteElements(&opened);
+      return false;
+    }
+  }
+  dex_files->insert(dex_files->end(), opened.begin(), opened.end());
+  return true;
+}
+
 const DexFile* DexFile::OpenMemory(const byte* base,
                                    size_t size,
                                    const std::string& location,
@@ -284,6 +451,101 @@ const DexFile* DexFile::OpenMemory(const byte* base,
   }
 }
 
+// Hashes the UTF-16 code units of a modified UTF-8 string, which is the hash of the same string
+// given in UTF-16.
+static uint32_t HashModifiedUtf8(const char* utf8) {
+  uint32_t hash = 0;
+  while (*utf8 != '\0') {
+    hash = hash * 31 + GetUtf16FromUtf8(&utf8);
+  }
+  return hash;
+}
+
+static uint32_t HashUtf16(const uint16_t* utf16) {
+  uint32_t hash = 0;
+  while (*utf16 != 0) {
+    hash = hash * 31 + *utf16++;
+  }
+  return hash;
+}
+
+// An open addressing table of string indices at a load factor of at most 1/2 and a table of the
+// class def index of every type index, about 8 to 16 bytes per string id and 2 per type id. The
+// table only holds indices, the strings are compared in the dex file.
+class DexFile::LookupIndex {
+ public:
+  explicit LookupIndex(const DexFile& dex_file) : dex_file_(dex_file) {
+    const uint32_t num_string_ids = dex_file.NumStringIds();
+    string_slots_.resize(RoundUpToPowerOfTwo(std::max(2 * num_string_ids, 16U)), kEmptySlot);
+    mask_ = string_slots_.size() - 1;
+    for (uint32_t i = 0; i < num_string_ids; ++i) {
+      size_t slot = HashModifiedUtf8(dex_file.GetStringData(dex_file.GetStringId(i))) & mask_;
+      while (string_slots_[slot] != kEmptySlot) {
+        slot = (slot + 1) & mask_;
+      }
+      string_slots_[slot] = i;
+    }
+    // Like the linear scan, the first class def of a type wins.
+    class_def_idxs_.resize(dex_file.NumTypeIds(), DexFile::kDexNoIndex16);
+    const uint32_t num_class_defs = std::min<uint32_t>(dex_file.NumClassDefs(),
+                                                       DexFile::kDexNoIndex16);
+    for (uint32_t i = 0; i < num_class_defs; ++i) {
+      uint16_t class_idx = dex_file.GetClassDef(i).class_idx_;
+      if (class_idx < class_def_idxs_.size() &&
+          class_def_idxs_[class_idx] == DexFile::kDexNoIndex16) {
+        class_def_idxs_[class_idx] = i;
+      }
+    }
+  }
+
+  const StringId* FindStringId(const char* string) const {
+    for (size_t slot = HashModifiedUtf8(string) & mask_; string_slots_[slot] != kEmptySlot;
+         slot = (slot + 1) & mask_) {
+      const StringId& string_id = dex_file_.GetStringId(string_slots_[slot]);
+      if (CompareModifiedUtf8ToModifiedUtf8AsUtf16CodePointValues(
+          string, dex_file_.GetStringData(string_id)) == 0) {
+        return &string_id;
+      }
+    }
+    return NULL;
+  }
+
+  const StringId* FindStringId(const uint16_t* string) const {
+    for (size_t slot = HashUtf16(string) & mask_; string_slots_[slot] != kEmptySlot;
+         slot = (slot + 1) & mask_) {
+      const StringId& string_id = dex_file_.GetStringId(string_slots_[slot]);
+      if (CompareModifiedUtf8ToUtf16AsCodePointValues(dex_file_.GetStringData(string_id),
+                                                      string) == 0) {
+        return &string_id;
+      }
+    }
+    return NULL;
+  }
+
+  const ClassDef* FindClassDef(uint16_t type_idx) const {
+    if (type_idx >= class_def_idxs_.size() ||
+        class_def_idxs_[type_idx] == DexFile::kDexNoIndex16) {
+      return NULL;
+    }
+    return &dex_file_.GetClassDef(class_def_idxs_[type_idx]);
+  }
+
+  size_t Size() const {
+    return sizeof(*this) + string_slots_.size() * sizeof(string_slots_[0]) +
+        class_def_idxs_.size() * sizeof(class_def_idxs_[0]);
+  }
+
+ private:
+  static const uint32_t kEmptySlot = 0xFFFFFFFF;
+
+  const DexFile& dex_file_;
+  size_t mask_;
+  std::vector<uint32_t> string_slots_;
+  std::vector<uint16_t> class_def_idxs_;
+
+  DISALLOW_COPY_AND_ASSIGN(LookupIndex);
+};
+
 DexFile::DexFile(const byte* base, size_t size,
                  const std::string& location,
                  uint32_t location_checksum,
@@ -299,7 +561,11 @@ DexFile::DexFile(const byte* base, size_t size,
       field_ids_(reinterpret_cast<const FieldId*>(base + header_->field_ids_off_)),
       method_ids_(reinterpret_cast<const MethodId*>(base + header_->method_ids_off_)),
       proto_ids_(reinterpret_cast<const ProtoId*>(base + header_->proto_ids_off_)),
-      class_defs_(reinterpret_cast<const ClassDef*>(base + header_->class_defs_off_)) {
+      class_defs_(reinterpret_cast<const ClassDef*>(base + header_->class_defs_off_)),
+      lookup_count_(0),
+      lookup_index_started_(0),
+      lookup_index_thread_created_(false),
+      lookup_index_(NULL) {
   CHECK(begin_ != NULL) << GetLocation();
   CHECK_GT(size_, 0U) << GetLocation();
 }
@@ -309,6 +575,57 @@ DexFile::~DexFile() {
   // that's only called after DetachCurrentThread, which means there's no JNIEnv. We could
   // re-attach, but cleaning up these global references is not obviously useful. It's not as if
   // the global reference table is otherwise empty!
+  if (lookup_index_thread_created_) {
+    CHECK_PTHREAD_CALL(pthread_join, (lookup_index_thread_, NULL), "dex file lookup index");
+  }
+  delete lookup_index_;
+}
+
+void DexFile::StartBuildingLookupIndex() const {
+  if (!lookup_index_started_.CompareAndSwap(0, 1)) {
+    return;
+  }
+  DexFile* dex_file = const_cast<DexFile*>(this);
+  Runtime* runtime = Runtime::Current();
+  if (runtime != NULL && runtime->IsZygote()) {
+    // The zygote cannot fork with other threads running, the index it builds is shared with the
+    // apps instead.
+    BuildLookupIndex(dex_file);
+    return;
+  }
+  CHECK_PTHREAD_CALL(pthread_create, (&lookup_index_thread_, NULL, BuildLookupIndex, dex_file),
+                     "dex file lookup index");
+  lookup_index_thread_created_ = true;
+}
+
+void* DexFile::BuildLookupIndex(void* arg) {
+  DexFile* dex_file = reinterpret_cast<DexFile*>(arg);
+  uint64_t start_ns = NanoTime();
+  const LookupIndex* lookup_index = new LookupIndex(*dex_file);
+  // Publish the index only once it is fully built.
+  QuasiAtomic::MembarStoreStore();
+  dex_file->lookup_index_ = lookup_index;
+  VLOG(class_linker) << "Built lookup index of " << dex_file->GetLocation() << " in "
+                     << PrettyDuration(NanoTime() - start_ns) << ", "
+                     << PrettySize(lookup_index->Size());
+  return NULL;
+}
+
+const DexFile::LookupIndex* DexFile::GetLookupIndex() const {
+  const LookupIndex* lookup_index = lookup_index_;
+  if (lookup_index != NULL) {
+    QuasiAtomic::MembarLoadLoad();
+    return lookup_index;
+  }
+  if (lookup_count_.FetchAndAdd(1) == kLookupsBeforeIndex) {
+    StartBuildingLookupIndex();
+  }
+  return NULL;
+}
+
+size_t DexFile::GetLookupIndexSize() const {
+  const LookupIndex* lookup_index = lookup_index_;
+  return (lookup_index != NULL) ? lookup_index->Size() : 0;
 }
 
 bool DexFile::Init(std::string* error_msg) {
@@ -370,17 +687,14 @@ const DexFile::ClassDef* DexFile::FindClassDef(const char* descriptor) const {
   if (type_id == NULL) {
     return NULL;
   }
-  uint16_t type_idx = GetIndexForTypeId(*type_id);
-  for (size_t i = 0; i < num_class_defs; ++i) {
-    const ClassDef& class_def = GetClassDef(i);
-    if (class_def.class_idx_ == type_idx) {
-      return &class_def;
-    }
-  }
-  return NULL;
+  return FindClassDef(GetIndexForTypeId(*type_id));
 }
 
 const DexFile::ClassDef* DexFile::FindClassDef(uint16_t type_idx) const {
+  const LookupIndex* lookup_index = GetLookupIndex();
+  if (lookup_index != NULL) {
+    return lookup_index->FindClassDef(type_idx);
+  }
   size_t num_class_defs = NumClassDefs();
   for (size_t i = 0; i < num_class_defs; ++i) {
     const ClassDef& class_def = GetClassDef(i);
@@ -462,6 +776,10 @@ const DexFile::MethodId* DexFile::FindMethodId(const DexFile::TypeId& declaring_
 }
 
 const DexFile::StringId* DexFile::FindStringId(const char* string) const {
+  const LookupIndex* lookup_index = GetLookupIndex();
+  if (lookup_index != NULL) {
+    return lookup_index->FindStringId(string);
+  }
   int32_t lo = 0;
   int32_t hi = NumStringIds() - 1;
   while (hi >= lo) {
@@ -481,6 +799,10 @@ const DexFile::StringId* DexFile::FindStringId(const char* string) const {
 }
 
 const DexFile::StringId* DexFile::FindStringId(const uint16_t* string) const {
+  const LookupIndex* lookup_index = GetLookupIndex();
+  if (lookup_index != NULL) {
+    return lookup_index->FindStringId(string);
+  }
   int32_t lo = 0;
   int32_t hi = NumStringIds() - 1;
   while (hi >= lo) {
@@ -17,9 +17,12 @@
 #ifndef ART_RUNTIME_DEX_FILE_H_
 #define ART_RUNTIME_DEX_FILE_H_
 
+#include <pthread.h>
+
 #include <string>
 #include <vector>
 
+#include "atomic.h"
 #include "base/logging.h"
 #include "base/mutex.h"  // For Locks::mutator_lock_.
 #include "globals.h"
@@ -44,6 +47,7 @@ class ClassLinker;
 class Signature;
 template<class T> class Handle;
 class StringPiece;
+class ThreadPool;
 class ZipArchive;
 
 // TODO: move all of the macro functionality into the DexCache class.
@@ -57,6 +61,10 @@ class DexFile {
   // name of the DexFile entry within a zip archive
   static const char* kClassesDex;
 
+  // Separates the location of a multidex archive from the name of a secondary entry, as in
+  // "app.apk:classes2.dex".
+  static const char kMultiDexSeparator = ':';
+
   // The value of an invalid index.
   static const uint32_t kDexNoIndex = 0xFFFFFFFF;
 
@@ -349,6 +357,7 @@ class DexFile {
   // Returns the checksum of a file for comparison with GetLocationChecksum().
   // For .dex files, this is the header checksum.
   // For zip files, this is the classes.dex zip entry CRC32 checksum.
+  // For a multidex location, this is the CRC32 checksum of the named entry of the archive.
   // Return true if the checksum could be found, false otherwise.
   static bool GetChecksum(const char* filename, uint32_t* checksum, std::string* error_msg);
 
@@ -367,6 +376,34 @@ class DexFile {
   static const DexFile* Open(const ZipArchive& zip_archive, const std::string& location,
                              std::string* error_msg);
 
+  // Opens a .dex file or all dex files of a multidex zip archive, see OpenAll below.
+  static bool OpenAll(const char* filename, const char* location, ThreadPool* thread_pool,
+                      std::string* error_msg, std::vector<const DexFile*>* dex_files);
+
+  // Opens classes.dex and the secondary classes2.dex ... classesN.dex of a multidex zip archive.
+  // The entries are read in order, then opened and verified in parallel on thread_pool if it is
+  // not null. The secondary dex files get the locations of GetMultiDexLocation. Returns false and
+  // leaves dex_files unchanged if any entry fails to open.
+  static bool OpenAll(const ZipArchive& zip_archive, const std::string& location,
+                      ThreadPool* thread_pool, std::string* error_msg,
+                      std::vector<const DexFile*>* dex_files);
+
+  // Returns the name of the entry holding the dex file with the given index in a multidex zip
+  // archive: classes.dex for 0, classes<index + 1>.dex otherwise.
+  static std::string GetMultiDexClassesDexName(size_t index);
+
+  // Returns the location of the dex file with the given index in a multidex zip archive. The
+  // primary dex file keeps the location of the archive.
+  static std::string GetMultiDexLocation(size_t index, const std::string& location);
+
+  // Returns true if the location names a secondary dex file of a multidex archive.
+  static bool IsMultiDexLocation(const char* location);
+
+  // Returns the location of the archive holding the dex file, which is the location itself unless
+  // it names a secondary dex file of a multidex archive. The oat file of the archive holds all of
+  // its dex files.
+  static std::string GetBaseLocation(const char* location);
+
   // Closes a .dex file.
   virtual ~DexFile();
 
@@ -811,6 +848,19 @@ class DexFile {
 
   bool DisableWrite() const;
 
+  // Starts building the hash indices used by FindStringId and FindClassDef on a background
+  // thread, unless they are built or being built already. The lookups start it themselves once
+  // the dex file has served kLookupsBeforeIndex of them, and binary search or scan until then.
+  void StartBuildingLookupIndex() const;
+
+  // Returns true once the lookups use the hash indices.
+  bool HasLookupIndex() const {
+    return lookup_index_ != NULL;
+  }
+
+  // Returns the memory used by the hash indices, 0 until they are built.
+  size_t GetLookupIndexSize() const;
+
   const byte* Begin() const {
     return begin_;
   }
@@ -826,6 +876,11 @@ class DexFile {
   // Opens a dex file from within a .jar, .zip, or .apk file
   static const DexFile* OpenZip(int fd, const std::string& location, std::string* error_msg);
 
+  // Opens and verifies a dex file extracted or mapped from a zip archive entry, then makes it
+  // read only.
+  static const DexFile* OpenExtracted(const std::string& location, uint32_t location_checksum,
+                                      MemMap* mem_map, std::string* error_msg);
+
   // Opens a .dex file at the given address backed by a MemMap
   static const DexFile* OpenMemory(const std::string& location,
                                    uint32_t location_checksum,
@@ -892,6 +947,31 @@ class DexFile {
 
   // Points to the base of the class definition list.
   const ClassDef* const class_defs_;
+
+  // Hash indices for the lookups by string and by type index.
+  class LookupIndex;
+
+  static const int32_t kLookupsBeforeIndex = 64;
+
+  // Returns the lookup index if it is built, otherwise counts the lookup and returns NULL.
+  const LookupIndex* GetLookupIndex() const;
+
+  static void* BuildLookupIndex(void* arg);
+
+  // Number of lookups made while the lookup index was not built.
+  mutable AtomicInteger lookup_count_;
+
+  // Set to 1 by the thread that starts building the lookup index.
+  mutable AtomicInteger lookup_index_started_;
+
+  // The thread building the lookup index, joined by the destructor.
+  mutable pthread_t lookup_index_thread_;
+  mutable bool lookup_index_thread_created_;
+
+  // Published once fully built.
+  mutable const LookupIndex* volatile lookup_index_;
+
+  friend class OpenExtractedDexFileTask;
 };
 std::ostream& operator<<(std::ostream& os, const DexFile& dex_file);
 
@@ -16,8 +16,14 @@
 
 #include "dex_file.h"
 
+#include <sched.h>
+
 #include "UniquePtr.h"
+#include "base/stl_util.h"
 #include "common_runtime_test.h"
+#include "thread_pool.h"
+#include "utf.h"
+#include "utils.h"
 
 namespace art {
 
@@ -198,6 +204,109 @@ TEST_F(DexFileTest, GetChecksum) {
   EXPECT_EQ(java_lang_dex_file_->GetLocationChecksum(), checksum);
 }
 
+TEST_F(DexFileTest, LookupIndex) {
+  std::string location(GetLibCoreDexFileName());
+  std::vector<const DexFile*> dex_files;
+  std::string error_msg;
+  ASSERT_TRUE(DexFile::OpenAll(location.c_str(), location.c_str(), nullptr, &error_msg,
+                               &dex_files)) << error_msg;
+  const DexFile* dex_file = dex_files[0];
+  std::vector<std::string> descriptors;
+  for (size_t i = 0; i < dex_file->NumClassDefs(); ++i) {
+    descriptors.push_back(dex_file->GetClassDescriptor(dex_file->GetClassDef(i)));
+  }
+
+  // The first lookups search the ids, until the index is ready.
+  uint64_t start_ns = NanoTime();
+  size_t search_lookups = 0;
+  for (; search_lookups < descriptors.size() && !dex_file->HasLookupIndex(); ++search_lookups) {
+    EXPECT_EQ(&dex_file->GetClassDef(search_lookups),
+              dex_file->FindClassDef(descriptors[search_lookups].c_str()));
+  }
+  uint64_t search_ns = NanoTime() - start_ns;
+  dex_file->StartBuildingLookupIndex();
+  while (!dex_file->HasLookupIndex()) {
+    sched_yield();
+  }
+
+  start_ns = NanoTime();
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    EXPECT_EQ(&dex_file->GetClassDef(i), dex_file->FindClassDef(descriptors[i].c_str()));
+  }
+  uint64_t index_ns = NanoTime() - start_ns;
+  for (size_t i = 0; i < dex_file->NumStringIds(); ++i) {
+    const DexFile::StringId& string_id = dex_file->GetStringId(i);
+    const char* string = dex_file->GetStringData(string_id);
+    ASSERT_EQ(&string_id, dex_file->FindStringId(string)) << string;
+    std::vector<uint16_t> utf16(CountModifiedUtf8Chars(string) + 1, 0);
+    ConvertModifiedUtf8ToUtf16(&utf16[0], string);
+    ASSERT_EQ(&string_id, dex_file->FindStringId(&utf16[0])) << string;
+  }
+  EXPECT_TRUE(dex_file->FindStringId("Lno/such/Class;") == nullptr);
+  EXPECT_TRUE(dex_file->FindClassDef("Lno/such/Class;") == nullptr);
+  EXPECT_GT(dex_file->GetLookupIndexSize(), 0U);
+
+  LOG(INFO) << "FindClassDef of " << location << ": "
+            << PrettyDuration(search_ns / std::max<size_t>(search_lookups, 1U)) << " searching, "
+            << PrettyDuration(index_ns / std::max<size_t>(descriptors.size(), 1U))
+            << " with an index of " << PrettySize(dex_file->GetLookupIndexSize()) << " for "
+            << dex_file->NumStringIds() << " strings";
+  STLDeleteElements(&dex_files);
+}
+
+TEST_F(DexFileTest, GetMultiDexLocation) {
+  EXPECT_EQ("classes.dex", DexFile::GetMultiDexClassesDexName(0));
+  EXPECT_EQ("classes2.dex", DexFile::GetMultiDexClassesDexName(1));
+  EXPECT_EQ("classes10.dex", DexFile::GetMultiDexClassesDexName(9));
+  EXPECT_EQ("/app.apk", DexFile::GetMultiDexLocation(0, "/app.apk"));
+  EXPECT_EQ("/app.apk:classes2.dex", DexFile::GetMultiDexLocation(1, "/app.apk"));
+  EXPECT_FALSE(DexFile::IsMultiDexLocation("/app.apk"));
+  EXPECT_TRUE(DexFile::IsMultiDexLocation("/app.apk:classes2.dex"));
+  EXPECT_EQ("/app.apk", DexFile::GetBaseLocation("/app.apk"));
+  EXPECT_EQ("/app.apk", DexFile::GetBaseLocation("/app.apk:classes2.dex"));
+}
+
+TEST_F(DexFileTest, GetChecksumOfMultiDexLocation) {
+  std::string location(GetLibCoreDexFileName());
+  uint32_t checksum;
+  uint32_t entry_checksum;
+  std::string error_msg;
+  ASSERT_TRUE(DexFile::GetChecksum(location.c_str(), &checksum, &error_msg)) << error_msg;
+  // The entry named by a multidex location is checksummed, here classes.dex itself.
+  std::string entry_location(location + DexFile::kMultiDexSeparator + DexFile::kClassesDex);
+  ASSERT_TRUE(DexFile::GetChecksum(entry_location.c_str(), &entry_checksum, &error_msg))
+      << error_msg;
+  EXPECT_EQ(checksum, entry_checksum);
+  std::string missing_location(DexFile::GetMultiDexLocation(99, location));
+  EXPECT_FALSE(DexFile::GetChecksum(missing_location.c_str(), &entry_checksum, &error_msg));
+}
+
+TEST_F(DexFileTest, OpenAll) {
+  std::string location(GetLibCoreDexFileName());
+  std::vector<const DexFile*> serial;
+  std::vector<const DexFile*> parallel;
+  std::string error_msg;
+  ASSERT_TRUE(DexFile::OpenAll(location.c_str(), location.c_str(), nullptr, &error_msg, &serial))
+      << error_msg;
+  {
+    ThreadPool thread_pool("DexFileTest thread pool", 3);
+    ASSERT_TRUE(DexFile::OpenAll(location.c_str(), location.c_str(), &thread_pool, &error_msg,
+                                 &parallel)) << error_msg;
+  }
+  ASSERT_EQ(serial.size(), parallel.size());
+  ASSERT_LE(1U, serial.size());
+  for (size_t i = 0; i < serial.size(); ++i) {
+    EXPECT_EQ(DexFile::GetMultiDexLocation(i, location), serial[i]->GetLocation());
+    EXPECT_EQ(serial[i]->GetLocation(), parallel[i]->GetLocation());
+    EXPECT_EQ(serial[i]->GetLocationChecksum(), parallel[i]->GetLocationChecksum());
+    EXPECT_EQ(serial[i]->GetHeader().checksum_, parallel[i]->GetHeader().checksum_);
+    EXPECT_TRUE(parallel[i]->IsReadOnly());
+  }
+  EXPECT_EQ(java_lang_dex_file_->GetLocationChecksum(), serial[0]->GetLocationChecksum());
+  STLDeleteElements(&serial);
+  STLDeleteElements(&parallel);
+}
+
 TEST_F(DexFileTest, ClassDefs) {
   ScopedObjectAccess soa(Thread::Current());
   const DexFile* raw(OpenTestDexFile("Nested"));
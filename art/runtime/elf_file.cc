@@ -16,6 +16,8 @@
 
 #include "elf_file.h"
 
+#include <dlfcn.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -969,6 +971,209 @@ bool ElfFile::ValidPointer(const byte* start) const {
   return false;
 }
 
+bool ElfFile::WritablePointer(const byte* start, size_t size) const {
+  for (size_t i = 0; i < segments_.size(); ++i) {
+    const MemMap* segment = segments_[i];
+    if (segment->Begin() <= start && start + size <= segment->End() &&
+        (segment->GetProtect() & PROT_WRITE) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Dynamic relocation types of ARM and x86. They are not taken from the ELF headers since LLVM
+// declares the same names in its own headers.
+static constexpr uint32_t kArmNone = 0;
+static constexpr uint32_t kArmAbs32 = 2;
+static constexpr uint32_t kArmGlobDat = 21;
+static constexpr uint32_t kArmJumpSlot = 22;
+static constexpr uint32_t kArmRelative = 23;
+static constexpr uint32_t k386None = 0;
+static constexpr uint32_t k386Abs32 = 1;
+static constexpr uint32_t k386Pc32 = 2;
+static constexpr uint32_t k386GlobDat = 6;
+static constexpr uint32_t k386JumpSlot = 7;
+static constexpr uint32_t k386Relative = 8;
+
+enum RelocationKind {
+  kRelocationNone,
+  kRelocationRelative,     // *P += B
+  kRelocationAbsolute,     // *P += S
+  kRelocationSymbol,       // *P = S
+  kRelocationPcRelative,   // *P += S - P
+  kRelocationUnsupported,
+};
+
+static RelocationKind GetRelocationKind(Elf32_Half machine, uint32_t type) {
+  if (machine == EM_ARM) {
+    switch (type) {
+      case kArmNone: return kRelocationNone;
+      case kArmRelative: return kRelocationRelative;
+      case kArmAbs32: return kRelocationAbsolute;
+      case kArmGlobDat:
+      case kArmJumpSlot: return kRelocationSymbol;
+      default: return kRelocationUnsupported;
+    }
+  }
+  if (machine == EM_386) {
+    switch (type) {
+      case k386None: return kRelocationNone;
+      case k386Relative: return kRelocationRelative;
+      case k386Abs32: return kRelocationAbsolute;
+      case k386Pc32: return kRelocationPcRelative;
+      case k386GlobDat:
+      case k386JumpSlot: return kRelocationSymbol;
+      default: return kRelocationUnsupported;
+    }
+  }
+  return kRelocationUnsupported;
+}
+
+bool ElfFile::BindSymbol(Elf32_Word index, std::vector<Elf32_Addr>* addresses,
+                         std::vector<bool>* bound, Elf32_Addr* address,
+                         std::string* error_msg) const {
+  if (index >= addresses->size()) {
+    *error_msg = StringPrintf("Relocation refers to symbol %d of %zd in %s",
+                              index, addresses->size(), file_->GetPath().c_str());
+    return false;
+  }
+  if ((*bound)[index]) {
+    *address = (*addresses)[index];
+    return true;
+  }
+  Elf32_Sym& symbol = GetSymbol(SHT_DYNSYM, index);
+  if (symbol.st_shndx != SHN_UNDEF) {
+    *address = static_cast<Elf32_Addr>(reinterpret_cast<uintptr_t>(base_address_) +
+                                       symbol.st_value);
+  } else {
+    // Undefined symbols are the runtime support functions, which are already loaded.
+    const char* name = GetString(SHT_DYNSYM, symbol.st_name);
+    void* resolved = (name != NULL) ? dlsym(RTLD_DEFAULT, name) : NULL;
+    if (resolved == NULL && ELF32_ST_BIND(symbol.st_info) != STB_WEAK) {
+      *error_msg = StringPrintf("Undefined symbol '%s' in %s",
+                                (name != NULL) ? name : "", file_->GetPath().c_str());
+      return false;
+    }
+    *address = static_cast<Elf32_Addr>(reinterpret_cast<uintptr_t>(resolved));
+  }
+  (*addresses)[index] = *address;
+  (*bound)[index] = true;
+  return true;
+}
+
+bool ElfFile::ApplyRelocations(Elf32_Addr rel_address, Elf32_Word rel_size,
+                               std::vector<Elf32_Addr>* addresses, std::vector<bool>* bound,
+                               std::string* error_msg) {
+  if (rel_size == 0) {
+    return true;
+  }
+  const byte* rel_start = base_address_ + rel_address;
+  if (!ValidPointer(rel_start) || !ValidPointer(rel_start + rel_size - 1)) {
+    *error_msg = StringPrintf("Relocations at %p do not refer to a loaded ELF segment of %s",
+                              rel_start, file_->GetPath().c_str());
+    return false;
+  }
+  const Elf32_Half machine = GetHeader().e_machine;
+  const Elf32_Addr base = static_cast<Elf32_Addr>(reinterpret_cast<uintptr_t>(base_address_));
+  const Elf32_Rel* rels = reinterpret_cast<const Elf32_Rel*>(rel_start);
+  for (Elf32_Word i = 0; i < rel_size / sizeof(Elf32_Rel); i++) {
+    const Elf32_Rel& rel = rels[i];
+    const uint32_t type = ELF32_R_TYPE(rel.r_info);
+    RelocationKind kind = GetRelocationKind(machine, type);
+    if (kind == kRelocationNone) {
+      continue;
+    }
+    if (kind == kRelocationUnsupported) {
+      *error_msg = StringPrintf("Unsupported relocation type %d at 0x%x in %s",
+                                type, rel.r_offset, file_->GetPath().c_str());
+      return false;
+    }
+    byte* target = base_address_ + rel.r_offset;
+    if (!WritablePointer(target, sizeof(Elf32_Addr))) {
+      *error_msg = StringPrintf("Relocation at 0x%x does not refer to a writable segment of %s",
+                                rel.r_offset, file_->GetPath().c_str());
+      return false;
+    }
+    Elf32_Addr* word = reinterpret_cast<Elf32_Addr*>(target);
+    if (kind == kRelocationRelative) {
+      // Nothing to do when the file is at its link address, which keeps the pages clean.
+      if (base != 0) {
+        *word += base;
+      }
+      continue;
+    }
+    Elf32_Addr symbol_address;
+    if (!BindSymbol(ELF32_R_SYM(rel.r_info), addresses, bound, &symbol_address, error_msg)) {
+      return false;
+    }
+    switch (kind) {
+      case kRelocationAbsolute:
+        *word += symbol_address;
+        break;
+      case kRelocationSymbol:
+        *word = symbol_address;
+        break;
+      case kRelocationPcRelative:
+        *word += symbol_address - static_cast<Elf32_Addr>(reinterpret_cast<uintptr_t>(target));
+        break;
+      default:
+        LOG(FATAL) << "Unexpected relocation kind " << kind;
+    }
+  }
+  return true;
+}
+
+bool ElfFile::Relocate(std::string* error_msg) {
+  CHECK(program_header_only_) << file_->GetPath();
+  const Elf32_Half machine = GetHeader().e_machine;
+  if ((machine != EM_ARM && machine != EM_386) || sizeof(uintptr_t) != sizeof(Elf32_Addr)) {
+    *error_msg = StringPrintf("Relocation of machine %d not supported for %s",
+                              machine, file_->GetPath().c_str());
+    return false;
+  }
+  Elf32_Addr rel = 0;
+  Elf32_Word rel_size = 0;
+  Elf32_Addr jmprel = 0;
+  Elf32_Word jmprel_size = 0;
+  for (Elf32_Word i = 0; i < GetDynamicNum(); i++) {
+    Elf32_Dyn& elf_dyn = GetDynamic(i);
+    switch (elf_dyn.d_tag) {
+      case DT_REL:
+        rel = elf_dyn.d_un.d_ptr;
+        break;
+      case DT_RELSZ:
+        rel_size = elf_dyn.d_un.d_val;
+        break;
+      case DT_JMPREL:
+        jmprel = elf_dyn.d_un.d_ptr;
+        break;
+      case DT_PLTRELSZ:
+        jmprel_size = elf_dyn.d_un.d_val;
+        break;
+      case DT_PLTREL:
+        if (elf_dyn.d_un.d_val != DT_REL) {
+          *error_msg = StringPrintf("Unsupported DT_PLTREL %d in %s",
+                                    elf_dyn.d_un.d_val, file_->GetPath().c_str());
+          return false;
+        }
+        break;
+      case DT_RELA:
+      case DT_TEXTREL:
+        *error_msg = StringPrintf("Unsupported dynamic entry %d in %s",
+                                  elf_dyn.d_tag, file_->GetPath().c_str());
+        return false;
+      default:
+        break;
+    }
+  }
+  // The number of chains is the number of dynamic symbols.
+  std::vector<Elf32_Addr> addresses(GetHashChainNum(), 0);
+  std::vector<bool> bound(addresses.size(), false);
+  return ApplyRelocations(rel, rel_size, &addresses, &bound, error_msg) &&
+      ApplyRelocations(jmprel, jmprel_size, &addresses, &bound, error_msg);
+}
+
 static bool check_section_name(ElfFile& file, int section_num, const char *name) {
   Elf32_Shdr& section_header = file.GetSectionHeader(section_num);
   const char *section_name = file.GetString(SHT_SYMTAB, section_header.sh_name);
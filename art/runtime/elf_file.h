@@ -122,6 +122,12 @@ class ElfFile {
   // executable is true at run time, false at compile time.
   bool Load(bool executable, std::string* error_msg);
 
+  // Applies the dynamic relocations of a file after Load, binding its undefined symbols to the
+  // symbols already loaded into the process. Relative relocations are skipped when the file was
+  // loaded at the address it was linked for. Fails on relocations it does not support, including
+  // any that would modify a read-only segment.
+  bool Relocate(std::string* error_msg);
+
  private:
   ElfFile(File* file, bool writable, bool program_header_only);
 
@@ -147,6 +153,14 @@ class ElfFile {
   SymbolTable** GetSymbolTable(Elf32_Word section_type);
 
   bool ValidPointer(const byte* start) const;
+  bool WritablePointer(const byte* start, size_t size) const;
+
+  // Returns the address of the dynamic symbol at index, resolving each symbol only once.
+  bool BindSymbol(Elf32_Word index, std::vector<Elf32_Addr>* addresses, std::vector<bool>* bound,
+                  Elf32_Addr* address, std::string* error_msg) const;
+  bool ApplyRelocations(Elf32_Addr rel_address, Elf32_Word rel_size,
+                        std::vector<Elf32_Addr>* addresses, std::vector<bool>* bound,
+                        std::string* error_msg);
 
   const File* const file_;
   const bool writable_;
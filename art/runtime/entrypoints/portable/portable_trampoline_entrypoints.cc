@@ -48,16 +48,33 @@ class PortableArgumentVisitor {
 #define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FRAME_SIZE 0
 #define PORTABLE_STACK_ARG_SKIP 4
 #elif defined(__x86_64__)
-// TODO: implement and check these.
-#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__R1_OFFSET 16
-#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FRAME_SIZE 96
+// The portable stubs spill rdi (the Method*), rsi, rdx, rcx, r8 and r9 followed by xmm0-xmm7. Each
+// argument takes a full 8-byte register or stack slot and floating point arguments are allocated
+// independently of the integral ones.
+#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__R1_OFFSET 8
+#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FRAME_SIZE 128
+#define PORTABLE_STACK_ARG_SKIP 0
+#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FPR_OFFSET 48
+#define PORTABLE_NUM_GPR_ARGS 5
+#define PORTABLE_NUM_FPR_ARGS 8
+#elif defined(__aarch64__)
+// The portable stubs spill x0 (the Method*) to x7 followed by d0-d7 and the frame pointer and link
+// register. As for x86-64, arguments take full 8-byte slots and floating point arguments are
+// allocated independently of the integral ones.
+#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__R1_OFFSET 8
+#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FRAME_SIZE 144
 #define PORTABLE_STACK_ARG_SKIP 0
+#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FPR_OFFSET 64
+#define PORTABLE_NUM_GPR_ARGS 7
+#define PORTABLE_NUM_FPR_ARGS 8
 #else
-// TODO: portable should be disabled for aarch64 for now.
 // #error "Unsupported architecture"
 #define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__R1_OFFSET 0
 #define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FRAME_SIZE 0
 #define PORTABLE_STACK_ARG_SKIP 0
+#endif
+#ifndef PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FPR_OFFSET
+#define PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FPR_OFFSET 0
 #endif
 
   PortableArgumentVisitor(MethodHelper& caller_mh, mirror::ArtMethod** sp)
@@ -66,6 +83,7 @@ class PortableArgumentVisitor {
     args_in_regs_(ComputeArgsInRegs(caller_mh)),
     num_params_(caller_mh.NumArgs()),
     reg_args_(reinterpret_cast<byte*>(sp) + PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__R1_OFFSET),
+    fpr_args_(reinterpret_cast<byte*>(sp) + PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FPR_OFFSET),
     stack_args_(reinterpret_cast<byte*>(sp) + PORTABLE_CALLEE_SAVE_FRAME__REF_AND_ARGS__FRAME_SIZE
                 + PORTABLE_STACK_ARG_SKIP),
     cur_args_(reg_args_),
@@ -94,6 +112,30 @@ class PortableArgumentVisitor {
   }
 
   void VisitArguments() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+#if defined(PORTABLE_NUM_FPR_ARGS)
+    size_t gpr_index = 0;
+    size_t fpr_index = 0;
+    size_t stack_index = 0;
+    for (; param_index_ < num_params_; param_index_++) {
+      Primitive::Type type = GetParamPrimitiveType();
+      if (type == Primitive::kPrimFloat || type == Primitive::kPrimDouble) {
+        if (fpr_index < PORTABLE_NUM_FPR_ARGS) {
+          cur_args_ = fpr_args_;
+          cur_arg_index_ = fpr_index++;
+          Visit();
+          continue;
+        }
+      } else if (gpr_index < PORTABLE_NUM_GPR_ARGS) {
+        cur_args_ = reg_args_;
+        cur_arg_index_ = gpr_index++;
+        Visit();
+        continue;
+      }
+      cur_args_ = stack_args_;
+      cur_arg_index_ = stack_index++;
+      Visit();
+    }
+#else
     for (cur_arg_index_ = 0;  cur_arg_index_ < args_in_regs_ && param_index_ < num_params_; ) {
 #if (defined(__arm__) || defined(__mips__))
       if (IsParamALongOrDouble() && cur_arg_index_ == 2) {
@@ -116,6 +158,7 @@ class PortableArgumentVisitor {
       cur_arg_index_ += (IsParamALongOrDouble() ? 2 : 1);
       param_index_++;
     }
+#endif
   }
 
  private:
@@ -139,6 +182,7 @@ class PortableArgumentVisitor {
   const size_t args_in_regs_;
   const size_t num_params_;
   byte* const reg_args_;
+  byte* const fpr_args_;
   byte* const stack_args_;
   byte* cur_args_;
   size_t cur_arg_index_;
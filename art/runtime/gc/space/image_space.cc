@@ -16,6 +16,11 @@
 
 #include "image_space.h"
 
+#include <pthread.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "atomic.h"
 #include "base/stl_util.h"
 #include "base/unix_file/fd_file.h"
 #include "gc/accounting/space_bitmap-inl.h"
@@ -183,6 +188,135 @@ void ImageSpace::VerifyImageAllocations() {
   }
 }
 
+// Upper bound of the threads that decompress an image.
+static constexpr size_t kMaxDecompressionThreads = 4;
+
+// Decompresses the blocks of a compressed image, see ImageHeader::kStorageModeZlib. The image
+// space is created before the runtime can attach threads, so the workers are plain pthreads that
+// take the next block from a shared counter.
+class ImageDecompressor {
+ public:
+  ImageDecompressor(const uint32_t* block_offsets, const byte* blocks, size_t num_blocks,
+                    byte* image, size_t image_size)
+      : block_offsets_(block_offsets), blocks_(blocks), num_blocks_(num_blocks), image_(image),
+        image_size_(image_size), next_block_(0), failed_blocks_(0) {
+  }
+
+  // Returns false if a block failed to decompress.
+  bool Decompress(size_t num_threads) {
+    std::vector<pthread_t> threads(num_threads - 1);
+    for (pthread_t& thread : threads) {
+      CHECK_PTHREAD_CALL(pthread_create, (&thread, nullptr, &Worker, this),
+                         "image decompression thread");
+    }
+    DecompressBlocks();
+    for (pthread_t& thread : threads) {
+      CHECK_PTHREAD_CALL(pthread_join, (thread, nullptr), "image decompression thread");
+    }
+    return failed_blocks_.Load() == 0;
+  }
+
+ private:
+  static void* Worker(void* arg) {
+    reinterpret_cast<ImageDecompressor*>(arg)->DecompressBlocks();
+    return nullptr;
+  }
+
+  void DecompressBlocks() {
+    for (size_t block = next_block_.FetchAndAdd(1); block < num_blocks_;
+         block = next_block_.FetchAndAdd(1)) {
+      if (!DecompressBlock(block)) {
+        failed_blocks_.FetchAndAdd(1);
+      }
+    }
+  }
+
+  bool DecompressBlock(size_t block) {
+    const size_t begin = block * ImageHeader::kBlockSize;
+    const size_t size = std::min(ImageHeader::kBlockSize, image_size_ - begin);
+    const byte* data = blocks_ + (block_offsets_[block] - block_offsets_[0]);
+    const size_t data_size = block_offsets_[block + 1] - block_offsets_[block];
+    if (data_size == size) {
+      // The block did not compress.
+      memcpy(image_ + begin, data, size);
+      return true;
+    }
+    uLongf uncompressed_size = size;
+    return uncompress(image_ + begin, &uncompressed_size, data, data_size) == Z_OK &&
+        uncompressed_size == size;
+  }
+
+  const uint32_t* const block_offsets_;
+  const byte* const blocks_;
+  const size_t num_blocks_;
+  byte* const image_;
+  const size_t image_size_;
+  Atomic<size_t> next_block_;
+  Atomic<size_t> failed_blocks_;
+
+  DISALLOW_COPY_AND_ASSIGN(ImageDecompressor);
+};
+
+// Maps anonymous memory at the image address and decompresses the image into it. Unlike a mapped
+// uncompressed image the pages are not backed by the file, they stay resident until the space is
+// unmapped.
+static MemMap* DecompressImage(File* file, const char* image_filename,
+                               const ImageHeader& image_header, std::string* error_msg) {
+  uint64_t start_time = NanoTime();
+  const size_t num_blocks = image_header.GetNumBlocks();
+  const size_t index_offset = image_header.GetBlockIndexOffset();
+  std::vector<uint32_t> block_offsets(num_blocks + 1);
+  const int64_t index_size = block_offsets.size() * sizeof(block_offsets[0]);
+  if (file->Read(reinterpret_cast<char*>(&block_offsets[0]), index_size, index_offset) !=
+      index_size) {
+    *error_msg = StringPrintf("Failed to read block index of compressed image '%s'",
+                              image_filename);
+    return nullptr;
+  }
+  bool valid_index = block_offsets[0] == index_offset + index_size &&
+      block_offsets[num_blocks] <= file->GetLength();
+  for (size_t i = 0; valid_index && i < num_blocks; ++i) {
+    valid_index = block_offsets[i] < block_offsets[i + 1] &&
+        block_offsets[i + 1] - block_offsets[i] <= ImageHeader::kBlockSize;
+  }
+  if (!valid_index) {
+    *error_msg = StringPrintf("Invalid block index in compressed image '%s'", image_filename);
+    return nullptr;
+  }
+
+  const size_t compressed_size = block_offsets[num_blocks] - block_offsets[0];
+  UniquePtr<MemMap> blocks(MemMap::MapFile(compressed_size, PROT_READ, MAP_PRIVATE, file->Fd(),
+                                           block_offsets[0], image_filename, error_msg));
+  if (blocks.get() == nullptr) {
+    *error_msg = StringPrintf("Failed to map blocks of compressed image: %s", error_msg->c_str());
+    return nullptr;
+  }
+  UniquePtr<MemMap> map(MemMap::MapAnonymous(image_filename, image_header.GetImageBegin(),
+                                             image_header.GetImageSize(),
+                                             PROT_READ | PROT_WRITE, false, error_msg));
+  if (map.get() == nullptr) {
+    DCHECK(!error_msg->empty());
+    return nullptr;
+  }
+
+  long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t num_threads = std::min(std::min(kMaxDecompressionThreads, num_blocks),
+                                static_cast<size_t>(std::max(num_cpus, 1L)));
+  ImageDecompressor decompressor(&block_offsets[0], blocks->Begin(), num_blocks, map->Begin(),
+                                 image_header.GetImageSize());
+  if (!decompressor.Decompress(num_threads)) {
+    *error_msg = StringPrintf("Failed to decompress image '%s'", image_filename);
+    return nullptr;
+  }
+  if (VLOG_IS_ON(heap) || VLOG_IS_ON(startup)) {
+    LOG(INFO) << "Decompressed image " << image_filename << " from "
+              << PrettySize(compressed_size) << " to " << PrettySize(image_header.GetImageSize())
+              << " with " << num_threads << " threads in "
+              << PrettyDuration(NanoTime() - start_time);
+  }
+  return map.release();
+}
+
 ImageSpace* ImageSpace::Init(const char* image_filename, const char* image_location,
                              bool validate_oat_file, std::string* error_msg) {
   CHECK(image_filename != nullptr);
@@ -206,16 +340,29 @@ ImageSpace* ImageSpace::Init(const char* image_filename, const char* image_locat
     return nullptr;
   }
 
-  // Note: The image header is part of the image due to mmap page alignment required of offset.
-  UniquePtr<MemMap> map(MemMap::MapFileAtAddress(image_header.GetImageBegin(),
-                                                 image_header.GetImageSize(),
-                                                 PROT_READ | PROT_WRITE,
-                                                 MAP_PRIVATE,
-                                                 file->Fd(),
-                                                 0,
-                                                 false,
-                                                 image_filename,
-                                                 error_msg));
+  UniquePtr<MemMap> map;
+  switch (image_header.GetStorageMode()) {
+    case ImageHeader::kStorageModeUncompressed:
+      // Note: The image header is part of the image due to mmap page alignment required of offset.
+      map.reset(MemMap::MapFileAtAddress(image_header.GetImageBegin(),
+                                         image_header.GetImageSize(),
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE,
+                                         file->Fd(),
+                                         0,
+                                         false,
+                                         image_filename,
+                                         error_msg));
+      break;
+    case ImageHeader::kStorageModeZlib:
+      map.reset(DecompressImage(file.get(), image_filename, image_header, error_msg));
+      break;
+    default:
+      // IsValid rejects the unknown modes.
+      LOG(FATAL) << "Unexpected storage mode " << image_header.GetStorageMode() << " of "
+                 << image_filename;
+      return nullptr;
+  }
   if (map.get() == NULL) {
     DCHECK(!error_msg->empty());
     return nullptr;
@@ -225,7 +372,7 @@ ImageSpace* ImageSpace::Init(const char* image_filename, const char* image_locat
 
   UniquePtr<MemMap> image_map(MemMap::MapFileAtAddress(nullptr, image_header.GetImageBitmapSize(),
                                                        PROT_READ, MAP_PRIVATE,
-                                                       file->Fd(), image_header.GetBitmapOffset(),
+                                                       file->Fd(), image_header.GetImageBitmapOffset(),
                                                        false,
                                                        image_filename,
                                                        error_msg));
@@ -28,6 +28,19 @@ namespace art {
 // header of image files written by ImageWriter, read and validated by Space.
 class PACKED(4) ImageHeader {
  public:
+  // How the image objects are stored in the file.
+  enum StorageMode {
+    // The file starts with the image, which is mapped directly.
+    kStorageModeUncompressed,
+    // The header is followed by the bitmap, a block index and the image in blocks of kBlockSize
+    // that are compressed independently with zlib. A block that does not compress is stored as is.
+    kStorageModeZlib,
+    kStorageModeCount,  // Number of elements in enum.
+  };
+
+  // Uncompressed size of the blocks of a compressed image, the last block may be smaller.
+  static constexpr size_t kBlockSize = 64 * KB;
+
   ImageHeader() {}
 
   ImageHeader(uint32_t image_begin,
@@ -39,7 +52,8 @@ class PACKED(4) ImageHeader {
               uint32_t oat_file_begin,
               uint32_t oat_data_begin,
               uint32_t oat_data_end,
-              uint32_t oat_file_end);
+              uint32_t oat_file_end,
+              StorageMode storage_mode);
 
   bool IsValid() const;
   const char* GetMagic() const;
@@ -84,8 +98,23 @@ class PACKED(4) ImageHeader {
     return reinterpret_cast<byte*>(oat_file_end_);
   }
 
-  size_t GetBitmapOffset() const {
-    return RoundUp(image_size_, kPageSize);
+  StorageMode GetStorageMode() const {
+    return static_cast<StorageMode>(storage_mode_);
+  }
+
+  bool IsCompressed() const {
+    return GetStorageMode() == kStorageModeZlib;
+  }
+
+  // Number of blocks of a compressed image.
+  size_t GetNumBlocks() const {
+    return RoundUp(image_size_, kBlockSize) / kBlockSize;
+  }
+
+  // File offset of the block index of a compressed image, GetNumBlocks() + 1 uint32_t file offsets
+  // of the blocks followed by the end of the last one. The blocks follow the index.
+  size_t GetBlockIndexOffset() const {
+    return image_bitmap_offset_ + image_bitmap_size_;
   }
 
   static std::string GetOatLocationFromImageLocation(const std::string& image) {
@@ -153,6 +182,9 @@ class PACKED(4) ImageHeader {
   // Absolute address of an Object[] of objects needed to reinitialize from an image.
   uint32_t image_roots_;
 
+  // A StorageMode.
+  uint32_t storage_mode_;
+
   friend class ImageWriter;
   friend class ImageDumper;  // For GetImageRoots()
 };
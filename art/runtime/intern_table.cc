@@ -16,6 +16,8 @@
 
 #include "intern_table.h"
 
+#include "atomic.h"
+#include "base/stl_util.h"
 #include "gc/space/image_space.h"
 #include "mirror/dex_cache.h"
 #include "mirror/object_array-inl.h"
@@ -27,45 +29,184 @@
 
 namespace art {
 
+// Marks the slot of a removed string, a Find has to probe past it.
+static mirror::String* const kRemovedString = reinterpret_cast<mirror::String*>(1);
+
+static constexpr size_t kMinTableCapacity = 64;
+
+InternTable::Table::Table(bool concurrent_find)
+    : concurrent_find_(concurrent_find), slot_array_(new SlotArray(kMinTableCapacity)), size_(0),
+      num_removed_(0) {
+}
+
+InternTable::Table::~Table() {
+  delete slot_array_;
+  STLDeleteElements(&retired_slot_arrays_);
+}
+
+mirror::String* InternTable::Table::Find(mirror::String* s, int32_t hash_code) const {
+  const SlotArray* slot_array = slot_array_;
+  // Pairs with the barrier of Resize.
+  QuasiAtomic::MembarLoadLoad();
+  // The table is never more than half full, the probing ends at an unused slot.
+  for (size_t i = FirstSlot(hash_code, slot_array->mask); ; i = (i + 1) & slot_array->mask) {
+    const Slot& slot = slot_array->slots[i];
+    mirror::String* existing_string = slot.string;
+    if (existing_string == nullptr) {
+      return nullptr;
+    }
+    // Pairs with the barrier of Insert.
+    QuasiAtomic::MembarLoadLoad();
+    if (existing_string != kRemovedString && slot.hash_code == hash_code &&
+        existing_string->Equals(s)) {
+      return existing_string;
+    }
+  }
+}
+
+InternTable::Table::Slot* InternTable::Table::FindSlot(mirror::String* s, int32_t hash_code) {
+  SlotArray* slot_array = slot_array_;
+  for (size_t i = FirstSlot(hash_code, slot_array->mask); ; i = (i + 1) & slot_array->mask) {
+    Slot* slot = &slot_array->slots[i];
+    if (slot->string == nullptr) {
+      return nullptr;
+    }
+    if (slot->string == s) {
+      DCHECK_EQ(slot->hash_code, hash_code);
+      return slot;
+    }
+  }
+}
+
+void InternTable::Table::Insert(mirror::String* s, int32_t hash_code) {
+  SlotArray* slot_array = slot_array_;
+  if ((size_ + num_removed_ + 1) * 2 > slot_array->mask + 1) {
+    // Grow once a quarter of the capacity holds strings, otherwise only drop the removed slots.
+    size_t capacity = kMinTableCapacity;
+    while (capacity < (size_ + 1) * 4) {
+      capacity *= 2;
+    }
+    Resize(capacity);
+    slot_array = slot_array_;
+  }
+  for (size_t i = FirstSlot(hash_code, slot_array->mask); ; i = (i + 1) & slot_array->mask) {
+    Slot& slot = slot_array->slots[i];
+    if (slot.string == nullptr) {
+      slot.hash_code = hash_code;
+      // A concurrent Find must not see the string before its hash code.
+      QuasiAtomic::MembarStoreStore();
+      slot.string = s;
+      ++size_;
+      return;
+    }
+  }
+}
+
+void InternTable::Table::Remove(mirror::String* s, int32_t hash_code) {
+  Slot* slot = FindSlot(s, hash_code);
+  if (slot != nullptr) {
+    slot->string = kRemovedString;
+    --size_;
+    ++num_removed_;
+  }
+}
+
+void InternTable::Table::Update(mirror::String* old_ref, mirror::String* new_ref,
+                                int32_t hash_code) {
+  Slot* slot = FindSlot(old_ref, hash_code);
+  if (slot != nullptr) {
+    slot->string = new_ref;
+  }
+}
+
+void InternTable::Table::Resize(size_t capacity) {
+  SlotArray* old_slot_array = slot_array_;
+  SlotArray* new_slot_array = new SlotArray(capacity);
+  for (size_t i = 0; i <= old_slot_array->mask; ++i) {
+    const Slot& slot = old_slot_array->slots[i];
+    if (slot.string == nullptr || slot.string == kRemovedString) {
+      continue;
+    }
+    size_t j = FirstSlot(slot.hash_code, new_slot_array->mask);
+    while (new_slot_array->slots[j].string != nullptr) {
+      j = (j + 1) & new_slot_array->mask;
+    }
+    new_slot_array->slots[j].hash_code = slot.hash_code;
+    new_slot_array->slots[j].string = slot.string;
+  }
+  // A concurrent Find must see the filled slots of the new array.
+  QuasiAtomic::MembarStoreStore();
+  slot_array_ = new_slot_array;
+  num_removed_ = 0;
+  if (concurrent_find_) {
+    retired_slot_arrays_.push_back(old_slot_array);
+  } else {
+    delete old_slot_array;
+  }
+}
+
+void InternTable::Table::VisitRoots(RootCallback* callback, void* arg) {
+  SlotArray* slot_array = slot_array_;
+  for (size_t i = 0; i <= slot_array->mask; ++i) {
+    Slot& slot = slot_array->slots[i];
+    mirror::Object* object = slot.string;
+    if (object == nullptr || object == kRemovedString) {
+      continue;
+    }
+    callback(&object, arg, 0, kRootInternedString);
+    DCHECK(object != nullptr);
+    slot.string = down_cast<mirror::String*>(object);
+  }
+}
+
+void InternTable::Table::SweepWeaks(IsMarkedCallback* callback, void* arg) {
+  SlotArray* slot_array = slot_array_;
+  for (size_t i = 0; i <= slot_array->mask; ++i) {
+    Slot& slot = slot_array->slots[i];
+    mirror::Object* object = slot.string;
+    if (object == nullptr || object == kRemovedString) {
+      continue;
+    }
+    mirror::Object* new_object = callback(object, arg);
+    if (new_object == nullptr) {
+      slot.string = kRemovedString;
+      --size_;
+      ++num_removed_;
+    } else {
+      slot.string = down_cast<mirror::String*>(new_object);
+    }
+  }
+}
+
 InternTable::InternTable()
     : log_new_roots_(false), allow_new_interns_(true),
-      new_intern_condition_("New intern condition", *Locks::intern_table_lock_) {
+      new_intern_condition_("New intern condition", *Locks::intern_table_lock_),
+      strong_interns_(true), weak_interns_(false) {
 }
 
 size_t InternTable::Size() const {
   MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  return strong_interns_.size() + weak_interns_.size();
+  return strong_interns_.Size() + weak_interns_.Size();
 }
 
 void InternTable::DumpForSigQuit(std::ostream& os) const {
   MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  os << "Intern table: " << strong_interns_.size() << " strong; "
-     << weak_interns_.size() << " weak\n";
+  os << "Intern table: " << strong_interns_.Size() << " strong; "
+     << weak_interns_.Size() << " weak\n";
 }
 
 void InternTable::VisitRoots(RootCallback* callback, void* arg, VisitRootFlags flags) {
   MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
   if ((flags & kVisitRootFlagAllRoots) != 0) {
-    for (auto& strong_intern : strong_interns_) {
-      callback(reinterpret_cast<mirror::Object**>(&strong_intern.second), arg, 0,
-               kRootInternedString);
-      DCHECK(strong_intern.second != nullptr);
-    }
+    strong_interns_.VisitRoots(callback, arg);
   } else if ((flags & kVisitRootFlagNewRoots) != 0) {
     for (auto& pair : new_strong_intern_roots_) {
        mirror::String* old_ref = pair.second;
        callback(reinterpret_cast<mirror::Object**>(&pair.second), arg, 0, kRootInternedString);
        if (UNLIKELY(pair.second != old_ref)) {
-         // Uh ohes, GC moved a root in the log. Need to search the strong interns and update the
-         // corresponding object. This is slow, but luckily for us, this may only happen with a
-         // concurrent moving GC.
-         for (auto it = strong_interns_.lower_bound(pair.first), end = strong_interns_.end();
-             it != end && it->first == pair.first; ++it) {
-           // If the class stored matches the old class, update it to the new value.
-           if (old_ref == it->second) {
-             it->second = pair.second;
-           }
-         }
+         // Uh ohes, GC moved a root in the log. Need to update the corresponding object in the
+         // strong interns. This may only happen with a concurrent moving GC.
+         strong_interns_.Update(old_ref, pair.second, pair.first);
        }
      }
   }
@@ -81,17 +222,6 @@ void InternTable::VisitRoots(RootCallback* callback, void* arg, VisitRootFlags f
   // Note: we deliberately don't visit the weak_interns_ table and the immutable image roots.
 }
 
-mirror::String* InternTable::Lookup(Table& table, mirror::String* s, int32_t hash_code) {
-  Locks::intern_table_lock_->AssertHeld(Thread::Current());
-  for (auto it = table.find(hash_code), end = table.end(); it != end; ++it) {
-    mirror::String* existing_string = it->second;
-    if (existing_string->Equals(s)) {
-      return existing_string;
-    }
-  }
-  return NULL;
-}
-
 mirror::String* InternTable::InsertStrong(mirror::String* s, int32_t hash_code) {
   Runtime* runtime = Runtime::Current();
   if (runtime->IsActiveTransaction()) {
@@ -100,7 +230,7 @@ mirror::String* InternTable::InsertStrong(mirror::String* s, int32_t hash_code)
   if (log_new_roots_) {
     new_strong_intern_roots_.push_back(std::make_pair(hash_code, s));
   }
-  strong_interns_.insert(std::make_pair(hash_code, s));
+  strong_interns_.Insert(s, hash_code);
   return s;
 }
 
@@ -109,7 +239,7 @@ mirror::String* InternTable::InsertWeak(mirror::String* s, int32_t hash_code) {
   if (runtime->IsActiveTransaction()) {
     runtime->RecordWeakStringInsertion(s, hash_code);
   }
-  weak_interns_.insert(std::make_pair(hash_code, s));
+  weak_interns_.Insert(s, hash_code);
   return s;
 }
 
@@ -118,16 +248,7 @@ void InternTable::RemoveWeak(mirror::String* s, int32_t hash_code) {
   if (runtime->IsActiveTransaction()) {
     runtime->RecordWeakStringRemoval(s, hash_code);
   }
-  Remove(weak_interns_, s, hash_code);
-}
-
-void InternTable::Remove(Table& table, mirror::String* s, int32_t hash_code) {
-  for (auto it = table.find(hash_code), end = table.end(); it != end; ++it) {
-    if (it->second == s) {
-      table.erase(it);
-      return;
-    }
-  }
+  weak_interns_.Remove(s, hash_code);
 }
 
 // Insert/remove methods used to undo changes made during an aborted transaction.
@@ -141,11 +262,11 @@ mirror::String* InternTable::InsertWeakFromTransaction(mirror::String* s, int32_
 }
 void InternTable::RemoveStrongFromTransaction(mirror::String* s, int32_t hash_code) {
   DCHECK(!Runtime::Current()->IsActiveTransaction());
-  Remove(strong_interns_, s, hash_code);
+  strong_interns_.Remove(s, hash_code);
 }
 void InternTable::RemoveWeakFromTransaction(mirror::String* s, int32_t hash_code) {
   DCHECK(!Runtime::Current()->IsActiveTransaction());
-  Remove(weak_interns_, s, hash_code);
+  weak_interns_.Remove(s, hash_code);
 }
 
 static mirror::String* LookupStringFromImage(mirror::String* s)
@@ -187,19 +308,26 @@ void InternTable::DisallowNewInterns() {
 }
 
 mirror::String* InternTable::Insert(mirror::String* s, bool is_strong) {
-  Thread* self = Thread::Current();
-  MutexLock mu(self, *Locks::intern_table_lock_);
-
   DCHECK(s != NULL);
   uint32_t hash_code = s->GetHashCode();
 
+  // Strings that are already strongly interned, such as the ones of resolved const-strings, are
+  // found without taking the lock. They are roots, unlike weak interns they can't be swept.
+  mirror::String* strong = strong_interns_.Find(s, hash_code);
+  if (strong != NULL) {
+    return strong;
+  }
+
+  Thread* self = Thread::Current();
+  MutexLock mu(self, *Locks::intern_table_lock_);
+
   while (UNLIKELY(!allow_new_interns_)) {
     new_intern_condition_.WaitHoldingLocks(self);
   }
 
   if (is_strong) {
-    // Check the strong table for a match.
-    mirror::String* strong = Lookup(strong_interns_, s, hash_code);
+    // Check the strong table again now that no other thread inserts.
+    strong = strong_interns_.Find(s, hash_code);
     if (strong != NULL) {
       return strong;
     }
@@ -211,7 +339,7 @@ mirror::String* InternTable::Insert(mirror::String* s, bool is_strong) {
     }
 
     // There is no match in the strong table, check the weak table.
-    mirror::String* weak = Lookup(weak_interns_, s, hash_code);
+    mirror::String* weak = weak_interns_.Find(s, hash_code);
     if (weak != NULL) {
       // A match was found in the weak table. Promote to the strong table.
       RemoveWeak(weak, hash_code);
@@ -223,8 +351,8 @@ mirror::String* InternTable::Insert(mirror::String* s, bool is_strong) {
     return InsertStrong(s, hash_code);
   }
 
-  // Check the strong table for a match.
-  mirror::String* strong = Lookup(strong_interns_, s, hash_code);
+  // Check the strong table again now that no other thread inserts.
+  strong = strong_interns_.Find(s, hash_code);
   if (strong != NULL) {
     return strong;
   }
@@ -234,7 +362,7 @@ mirror::String* InternTable::Insert(mirror::String* s, bool is_strong) {
     return InsertWeak(image, hash_code);
   }
   // Check the weak table for a match.
-  mirror::String* weak = Lookup(weak_interns_, s, hash_code);
+  mirror::String* weak = weak_interns_.Find(s, hash_code);
   if (weak != NULL) {
     return weak;
   }
@@ -269,23 +397,13 @@ mirror::String* InternTable::InternWeak(mirror::String* s) {
 
 bool InternTable::ContainsWeak(mirror::String* s) {
   MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  const mirror::String* found = Lookup(weak_interns_, s, s->GetHashCode());
+  const mirror::String* found = weak_interns_.Find(s, s->GetHashCode());
   return found == s;
 }
 
 void InternTable::SweepInternTableWeaks(IsMarkedCallback* callback, void* arg) {
   MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  for (auto it = weak_interns_.begin(), end = weak_interns_.end(); it != end;) {
-    mirror::Object* object = it->second;
-    mirror::Object* new_object = callback(object, arg);
-    if (new_object == nullptr) {
-      // TODO: use it = weak_interns_.erase(it) when we get a c++11 stl.
-      weak_interns_.erase(it++);
-    } else {
-      it->second = down_cast<mirror::String*>(new_object);
-      ++it;
-    }
-  }
+  weak_interns_.SweepWeaks(callback, arg);
 }
 
 }  // namespace art
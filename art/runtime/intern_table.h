@@ -17,8 +17,9 @@
 #ifndef ART_RUNTIME_INTERN_TABLE_H_
 #define ART_RUNTIME_INTERN_TABLE_H_
 
-#include <map>
+#include <vector>
 
+#include "base/macros.h"
 #include "base/mutex.h"
 #include "object_callbacks.h"
 
@@ -73,22 +74,83 @@ class InternTable {
   void AllowNewInterns() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
  private:
-  typedef std::multimap<int32_t, mirror::String*> Table;
+  // Open addressing hash table of strings with linear probing. Modifications are serialized by
+  // the intern table lock. Find may run concurrently with them when the table is created with
+  // concurrent_find, in which case the slot arrays replaced on growth are only freed with the
+  // table since a concurrent Find may still be probing them.
+  class Table {
+   public:
+    explicit Table(bool concurrent_find);
+    ~Table();
+
+    // Returns the string of the table equal to s, or NULL.
+    mirror::String* Find(mirror::String* s, int32_t hash_code) const
+        SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+    void Insert(mirror::String* s, int32_t hash_code)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
+    // Removes s itself, not a string equal to it.
+    void Remove(mirror::String* s, int32_t hash_code)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
+    // Replaces old_ref, moved by the GC, with new_ref.
+    void Update(mirror::String* old_ref, mirror::String* new_ref, int32_t hash_code)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
+    void VisitRoots(RootCallback* callback, void* arg)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
+    void SweepWeaks(IsMarkedCallback* callback, void* arg)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
+
+    size_t Size() const {
+      return size_;
+    }
+
+   private:
+    struct Slot {
+      volatile int32_t hash_code;
+      // NULL if the slot was never used.
+      mirror::String* volatile string;
+    };
+
+    struct SlotArray {
+      explicit SlotArray(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]()) {
+      }
+      ~SlotArray() {
+        delete[] slots;
+      }
+
+      const size_t mask;
+      Slot* const slots;
+    };
+
+    static size_t FirstSlot(int32_t hash_code, size_t mask) {
+      uint32_t hash = static_cast<uint32_t>(hash_code);
+      return (hash ^ (hash >> 16)) & mask;
+    }
+
+    Slot* FindSlot(mirror::String* s, int32_t hash_code)
+        EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
+    void Resize(size_t capacity) EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
+
+    const bool concurrent_find_;
+    SlotArray* volatile slot_array_;
+    // Arrays replaced by Resize that a concurrent Find may still be using.
+    std::vector<SlotArray*> retired_slot_arrays_;
+    // Number of strings and of removed slots, which are skipped but not reused.
+    size_t size_;
+    size_t num_removed_;
+
+    DISALLOW_COPY_AND_ASSIGN(Table);
+  };
 
   mirror::String* Insert(mirror::String* s, bool is_strong)
       LOCKS_EXCLUDED(Locks::intern_table_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  mirror::String* Lookup(Table& table, mirror::String* s, int32_t hash_code)
-      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   mirror::String* InsertStrong(mirror::String* s, int32_t hash_code)
       EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
   mirror::String* InsertWeak(mirror::String* s, int32_t hash_code)
       EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
   void RemoveWeak(mirror::String* s, int32_t hash_code)
       EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
-  void Remove(Table& table, mirror::String* s, int32_t hash_code)
-      EXCLUSIVE_LOCKS_REQUIRED(Locks::intern_table_lock_);
 
   // Transaction rollback access.
   mirror::String* InsertStrongFromTransaction(mirror::String* s, int32_t hash_code)
@@ -104,7 +166,9 @@ class InternTable {
   bool log_new_roots_ GUARDED_BY(Locks::intern_table_lock_);
   bool allow_new_interns_ GUARDED_BY(Locks::intern_table_lock_);
   ConditionVariable new_intern_condition_ GUARDED_BY(Locks::intern_table_lock_);
-  Table strong_interns_ GUARDED_BY(Locks::intern_table_lock_);
+  // Modified with the intern table lock held, but looked up without it so that interning an
+  // already strongly interned string does not need the lock.
+  Table strong_interns_;
   std::vector<std::pair<int32_t, mirror::String*> > new_strong_intern_roots_
       GUARDED_BY(Locks::intern_table_lock_);
   Table weak_interns_ GUARDED_BY(Locks::intern_table_lock_);
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "intern_table.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/stringprintf.h"
+#include "common_runtime_test.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace art {
+
+// Not a correctness test, reports how many strings per second the intern table interns as the
+// number of threads grows.
+//
+// Inserts are serialized by the single intern_table_lock_, finds of strong interns take no lock.
+// The lock is kept rather than striped by hash because most interns at runtime are finds of the
+// strings of resolved const-strings, the inserts happen mostly while the class path is loaded.
+// The critical section of an insert is a probe of the open addressing table, the allocation of
+// the string happens before the lock is taken. Striping would also have to split the image
+// lookup, the weak to strong promotion and the DisallowNewInterns handshake with the GC across
+// the stripes. The insert numbers below show what a striped table could gain.
+class InternTableBenchmarkTest : public CommonRuntimeTest {};
+
+class InternRangeTask : public Task {
+ public:
+  InternRangeTask(InternTable* intern_table, const std::vector<std::string>* strings,
+                  size_t begin, size_t end)
+      : intern_table_(intern_table), strings_(strings), begin_(begin), end_(end) {
+  }
+
+  void Run(Thread* self) {
+    ScopedObjectAccess soa(self);
+    for (size_t i = begin_; i < end_; ++i) {
+      intern_table_->InternStrong((*strings_)[i].c_str());
+    }
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  InternTable* const intern_table_;
+  const std::vector<std::string>* const strings_;
+  const size_t begin_;
+  const size_t end_;
+};
+
+// Interns the strings with num_threads threads, each taking a slice if split, or all of them
+// otherwise. Returns the wall time in nanoseconds.
+static uint64_t TimeInterns(InternTable* intern_table, const std::vector<std::string>& strings,
+                            size_t num_threads, bool split) {
+  Thread* self = Thread::Current();
+  ThreadPool thread_pool("Intern table benchmark thread pool", num_threads);
+  size_t slice = (strings.size() + num_threads - 1) / num_threads;
+  for (size_t i = 0; i < num_threads; ++i) {
+    size_t begin = split ? std::min(i * slice, strings.size()) : 0;
+    size_t end = split ? std::min(begin + slice, strings.size()) : strings.size();
+    thread_pool.AddTask(self, new InternRangeTask(intern_table, &strings, begin, end));
+  }
+  uint64_t start_ns = NanoTime();
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, false, false);
+  return NanoTime() - start_ns;
+}
+
+TEST_F(InternTableBenchmarkTest, InternThroughput) {
+  const size_t kNumStrings = 20000;
+  // The runtime's table, so that the interned strings are roots if a GC happens.
+  InternTable* t = Runtime::Current()->GetInternTable();
+  for (size_t num_threads = 1; num_threads <= 16; num_threads *= 2) {
+    std::vector<std::string> strings;
+    for (size_t i = 0; i < kNumStrings; ++i) {
+      strings.push_back(StringPrintf("InternThroughput%zd_%zd", num_threads, i));
+    }
+    // All new strings, every intern takes the lock.
+    uint64_t insert_ns = TimeInterns(t, strings, num_threads, true);
+    // Every thread finds all the strings, without the lock.
+    uint64_t find_ns = TimeInterns(t, strings, num_threads, false);
+    LOG(INFO) << num_threads << " threads: "
+              << kNumStrings * 1000000000ULL / std::max<uint64_t>(insert_ns, 1)
+              << " inserts/s, "
+              << num_threads * kNumStrings * 1000000000ULL / std::max<uint64_t>(find_ns, 1)
+              << " finds/s";
+  }
+}
+
+}  // namespace art
@@ -16,9 +16,11 @@
 
 #include "intern_table.h"
 
+#include "base/stringprintf.h"
 #include "common_runtime_test.h"
 #include "mirror/object.h"
 #include "handle_scope-inl.h"
+#include "thread_pool.h"
 
 namespace art {
 
@@ -180,4 +182,99 @@ TEST_F(InternTableTest, ContainsWeak) {
   }
 }
 
+TEST_F(InternTableTest, ManyStrings) {
+  // Enough strings to grow the tables several times, half of the weak ones are then swept.
+  ScopedObjectAccess soa(Thread::Current());
+  InternTable t;
+  const size_t kNumStrings = 200;
+  StackHandleScope<2 * kNumStrings> hs(soa.Self());
+  std::vector<Handle<mirror::String> > strong_strings;
+  for (size_t i = 0; i < kNumStrings; ++i) {
+    strong_strings.push_back(hs.NewHandle(t.InternStrong(StringPrintf("strong%zd", i).c_str())));
+  }
+  TestPredicate p;
+  for (size_t i = 0; i < kNumStrings; ++i) {
+    Handle<mirror::String> s(hs.NewHandle(
+        mirror::String::AllocFromModifiedUtf8(soa.Self(), StringPrintf("weak%zd", i).c_str())));
+    EXPECT_EQ(s.Get(), t.InternWeak(s.Get()));
+    if (i % 2 == 0) {
+      p.Expect(s.Get());
+    }
+  }
+  EXPECT_EQ(2 * kNumStrings, t.Size());
+  // Keep the odd weak strings.
+  struct KeepOdd {
+    static mirror::Object* IsMarked(mirror::Object* object, void* arg) {
+      TestPredicate* predicate = reinterpret_cast<TestPredicate*>(arg);
+      std::string utf8 = object->AsString()->ToModifiedUtf8();
+      if ((utf8[utf8.size() - 1] - '0') % 2 == 1) {
+        return object;
+      }
+      return predicate->IsMarked(object) ? object : nullptr;
+    }
+  };
+  t.SweepInternTableWeaks(KeepOdd::IsMarked, &p);
+  EXPECT_EQ(kNumStrings + kNumStrings / 2, t.Size());
+  for (size_t i = 0; i < kNumStrings; ++i) {
+    EXPECT_EQ(strong_strings[i].Get(), t.InternStrong(StringPrintf("strong%zd", i).c_str()));
+  }
+}
+
+class InternStringsTask : public Task {
+ public:
+  InternStringsTask(InternTable* intern_table, size_t num_strings,
+                    std::vector<mirror::String*>* interned)
+      : intern_table_(intern_table), num_strings_(num_strings), interned_(interned) {
+  }
+
+  void Run(Thread* self) {
+    ScopedObjectAccess soa(self);
+    for (size_t i = 0; i < num_strings_; ++i) {
+      interned_->push_back(
+          intern_table_->InternStrong(StringPrintf("ConcurrentInternStrong%zd", i).c_str()));
+    }
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  InternTable* const intern_table_;
+  const size_t num_strings_;
+  std::vector<mirror::String*>* const interned_;
+};
+
+// Threads interning the same strings concurrently, some inserting them and some finding them,
+// all get the same strings.
+TEST_F(InternTableTest, ConcurrentInternStrong) {
+  const size_t kNumThreads = 4;
+  const size_t kNumStrings = 2000;
+  Thread* self = Thread::Current();
+  // The runtime's table, so that the interned strings are roots if a GC happens.
+  InternTable* t = Runtime::Current()->GetInternTable();
+  size_t initial_size = t->Size();
+  std::vector<std::vector<mirror::String*> > interned(kNumThreads);
+  ThreadPool thread_pool("Intern table test thread pool", kNumThreads);
+  for (size_t i = 0; i < kNumThreads; ++i) {
+    thread_pool.AddTask(self, new InternStringsTask(t, kNumStrings, &interned[i]));
+  }
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, false, false);
+
+  ScopedObjectAccess soa(self);
+  EXPECT_EQ(initial_size + kNumStrings, t->Size());
+  for (size_t j = 0; j < kNumStrings; ++j) {
+    std::string utf8(StringPrintf("ConcurrentInternStrong%zd", j));
+    mirror::String* expected = t->InternStrong(utf8.c_str());
+    ASSERT_TRUE(expected != nullptr);
+    EXPECT_TRUE(expected->Equals(utf8.c_str()));
+    for (size_t i = 0; i < kNumThreads; ++i) {
+      ASSERT_EQ(kNumStrings, interned[i].size());
+      EXPECT_EQ(expected, interned[i][j]) << utf8 << " on thread " << i;
+    }
+  }
+  EXPECT_EQ(initial_size + kNumStrings, t->Size());
+}
+
 }  // namespace art
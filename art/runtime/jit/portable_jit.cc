@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "portable_jit.h"
+
+#include "entrypoints/entrypoint_utils.h"
+#include "instrumentation.h"
+#include "mirror/art_method-inl.h"
+#include "runtime.h"
+#include "scoped_thread_state_change.h"
+#include "thread.h"
+#include "thread_list.h"
+#include "utils.h"
+
+namespace art {
+
+PortableJit::PortableJit(JitCompiler* compiler, uint32_t hot_threshold)
+    : compiler_(compiler),
+      hot_threshold_(hot_threshold),
+      lock_("portable JIT lock"),
+      queue_condition_("portable JIT queue condition", lock_),
+      shutting_down_(false),
+      out_of_code_space_(false),
+      compiler_pthread_(0U),
+      methods_compiled_(0),
+      methods_failed_(0),
+      compile_time_ns_(0),
+      sample_decays_(0) {
+  CHECK(compiler_ != nullptr);
+  CHECK_GT(hot_threshold_, 0U);
+}
+
+PortableJit::~PortableJit() {
+  Stop();
+}
+
+void PortableJit::Start() {
+  {
+    MutexLock mu(Thread::Current(), lock_);
+    if (compiler_pthread_ != 0U) {
+      return;
+    }
+    shutting_down_ = false;
+  }
+  CHECK_PTHREAD_CALL(pthread_create, (&compiler_pthread_, nullptr, &RunCompilerThread, this),
+                     "Portable JIT thread");
+}
+
+void PortableJit::Stop() {
+  Thread* self = Thread::Current();
+  {
+    MutexLock mu(self, lock_);
+    if (compiler_pthread_ == 0U) {
+      return;
+    }
+    shutting_down_ = true;
+    queue_condition_.Broadcast(self);
+  }
+  CHECK_PTHREAD_CALL(pthread_join, (compiler_pthread_, nullptr), "Portable JIT thread shutdown");
+  compiler_pthread_ = 0U;
+  if (VLOG_IS_ON(compiler)) {
+    DumpInfo(LOG(INFO));
+  }
+}
+
+bool PortableJit::IsCompilable(mirror::ArtMethod* method) {
+  if (method->IsNative() || method->IsAbstract() || method->IsProxyMethod() ||
+      method->IsPortableCompiled()) {
+    return false;
+  }
+  // Only replace the interpreter. Static methods of classes that are not initialized yet still
+  // go through the resolution trampoline and are picked up again by later samples.
+  return method->GetEntryPointFromPortableCompiledCode() == GetPortableToInterpreterBridge();
+}
+
+void PortableJit::AddSample(mirror::ArtMethod* method) {
+  if (!IsCompilable(method)) {
+    return;
+  }
+  Thread* self = Thread::Current();
+  MutexLock mu(self, lock_);
+  if (out_of_code_space_) {
+    return;
+  }
+  if (samples_.size() >= kMaxSampledMethods && samples_.find(method) == samples_.end()) {
+    DecaySamples();
+  }
+  uint32_t& count = samples_.GetOrCreate(method, []() { return 0U; });
+  if (count == kQueued) {
+    return;
+  }
+  if (++count >= hot_threshold_) {
+    count = kQueued;
+    queue_.push_back(method);
+    queue_condition_.Signal(self);
+  }
+}
+
+void PortableJit::DecaySamples() {
+  ++sample_decays_;
+  const size_t target_size = kMaxSampledMethods - kMaxSampledMethods / 4;
+  bool decayed = true;
+  while (samples_.size() > target_size && decayed) {
+    decayed = false;
+    for (auto it = samples_.begin(); it != samples_.end(); ) {
+      if (it->second == kQueued) {
+        ++it;
+        continue;
+      }
+      decayed = true;
+      it->second /= 2;
+      if (it->second == 0) {
+        it = samples_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+bool PortableJit::TakeBatch(Thread* self, std::vector<mirror::ArtMethod*>* batch) {
+  MutexLock mu(self, lock_);
+  while (queue_.empty() && !shutting_down_) {
+    queue_condition_.Wait(self);
+  }
+  if (shutting_down_) {
+    return false;
+  }
+  while (!queue_.empty() && batch->size() < kMaxInstallBatch) {
+    batch->push_back(queue_.front());
+    queue_.pop_front();
+  }
+  return true;
+}
+
+void* PortableJit::RunCompilerThread(void* arg) {
+  PortableJit* jit = reinterpret_cast<PortableJit*>(arg);
+  Runtime* runtime = Runtime::Current();
+  CHECK(runtime->AttachCurrentThread("Portable JIT", true, runtime->GetSystemThreadGroup(),
+                                     !runtime->IsCompiler()));
+  Thread* self = Thread::Current();
+
+  std::vector<mirror::ArtMethod*> batch;
+  CompiledCode compiled_code;
+  while (jit->TakeBatch(self, &batch)) {
+    for (mirror::ArtMethod* method : batch) {
+      uint64_t start_ns = NanoTime();
+      const void* code = jit->compiler_->CompileMethod(self, method);
+      uint64_t duration_ns = NanoTime() - start_ns;
+      {
+        MutexLock mu(self, jit->lock_);
+        jit->compile_time_ns_ += duration_ns;
+        if (code != nullptr) {
+          ++jit->methods_compiled_;
+        } else {
+          ++jit->methods_failed_;
+        }
+      }
+      if (code != nullptr) {
+        compiled_code.push_back(std::make_pair(method, code));
+      }
+    }
+    bool committed = false;
+    if (!compiled_code.empty()) {
+      committed = jit->compiler_->CommitCode();
+      if (committed) {
+        jit->InstallCode(compiled_code);
+      }
+    }
+    bool has_code_space = jit->compiler_->HasCodeSpace();
+    {
+      MutexLock mu(self, jit->lock_);
+      if (committed) {
+        // The installed methods are no longer sampled, see IsCompilable. The methods that failed
+        // keep their queued entry so that they are not compiled again.
+        for (const std::pair<mirror::ArtMethod*, const void*>& entry : compiled_code) {
+          jit->samples_.erase(entry.first);
+        }
+      } else {
+        jit->methods_compiled_ -= compiled_code.size();
+        jit->methods_failed_ += compiled_code.size();
+      }
+      if (!has_code_space && !jit->out_of_code_space_) {
+        LOG(WARNING) << "Portable JIT out of code space, " << jit->queue_.size()
+                     << " queued methods stay interpreted";
+        jit->out_of_code_space_ = true;
+        jit->queue_.clear();
+        jit->samples_.clear();
+      }
+    }
+    batch.clear();
+    compiled_code.clear();
+  }
+
+  runtime->DetachCurrentThread();
+  return nullptr;
+}
+
+void PortableJit::InstallCode(const CompiledCode& compiled_code) {
+  Runtime* runtime = Runtime::Current();
+  instrumentation::Instrumentation* instrumentation = runtime->GetInstrumentation();
+  ThreadList* thread_list = runtime->GetThreadList();
+  thread_list->SuspendAll();
+  for (const std::pair<mirror::ArtMethod*, const void*>& entry : compiled_code) {
+    mirror::ArtMethod* method = entry.first;
+    // The method may have been changed (e.g. deoptimized) while it was being compiled.
+    if (!IsCompilable(method)) {
+      continue;
+    }
+    VLOG(compiler) << "JIT installing " << PrettyMethod(method) << " at " << entry.second;
+    instrumentation->UpdateMethodsCode(method, GetQuickToPortableBridge(), entry.second, true);
+  }
+  thread_list->ResumeAll();
+}
+
+void PortableJit::DumpInfo(std::ostream& os) {
+  MutexLock mu(Thread::Current(), lock_);
+  os << "Portable JIT: " << methods_compiled_ << " methods compiled, " << methods_failed_
+     << " failed, " << queue_.size() << " queued, " << samples_.size() << " sampled, "
+     << sample_decays_ << " sample decays, compile time " << PrettyDuration(compile_time_ns_)
+     << (out_of_code_space_ ? ", out of code space" : "") << "\n";
+}
+
+}  // namespace art
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_JIT_PORTABLE_JIT_H_
+#define ART_RUNTIME_JIT_PORTABLE_JIT_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "safe_map.h"
+
+namespace art {
+
+namespace mirror {
+  class ArtMethod;
+}  // namespace mirror
+class Thread;
+
+// The compiler used by the JIT. Like CompilerCallbacks it is implemented outside of the runtime
+// and handed to it by the embedder, with the "jitcompiler" runtime option.
+class JitCompiler {
+ public:
+  virtual ~JitCompiler() {}
+
+  // Called by Runtime::Start before the runtime is started. Returns false and sets error_msg if
+  // the compiler cannot be used, the runtime then runs without the JIT.
+  virtual bool Init(std::string* error_msg) = 0;
+
+  // Compiles the method to portable code and returns its entry point, or nullptr if the method
+  // could not be compiled. The code must stay valid for the lifetime of the compiler, it may only
+  // be executed once CommitCode returned true. Called without the mutator lock held.
+  virtual const void* CompileMethod(Thread* self, mirror::ArtMethod* method)
+      LOCKS_EXCLUDED(Locks::mutator_lock_) = 0;
+
+  // Makes the code of the methods compiled since the last call executable, so that a batch of
+  // methods shares the pages of its code. Returns false if the code cannot be used.
+  virtual bool CommitCode() = 0;
+
+  // Returns false once there is no room left for code, the remaining methods stay interpreted.
+  virtual bool HasCodeSpace() const = 0;
+
+ protected:
+  JitCompiler() {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(JitCompiler);
+};
+
+// Compiles the methods that the sampling profiler finds hot on a background thread and installs
+// the resulting code. Code is installed in batches while all threads are suspended, so callers
+// never see a method with a partially updated set of entry points.
+class PortableJit {
+ public:
+  PortableJit(JitCompiler* compiler, uint32_t hot_threshold);
+  ~PortableJit();
+
+  void Start() LOCKS_EXCLUDED(lock_);
+  void Stop() LOCKS_EXCLUDED(lock_);
+
+  // Counts a profiler sample of the method and queues it for compilation once it is hot.
+  void AddSample(mirror::ArtMethod* method)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) LOCKS_EXCLUDED(lock_);
+
+  void DumpInfo(std::ostream& os) LOCKS_EXCLUDED(lock_);
+
+ private:
+  typedef std::vector<std::pair<mirror::ArtMethod*, const void*> > CompiledCode;
+
+  // Methods past the threshold have their sample count set to this value so that they are queued
+  // only once.
+  static constexpr uint32_t kQueued = 0xFFFFFFFF;
+
+  // Maximum number of methods compiled before their code is installed.
+  static constexpr size_t kMaxInstallBatch = 16;
+
+  // Number of sampled methods above which the sample counts decay, so that methods sampled rarely
+  // over a long run are forgotten instead of adding up to the threshold.
+  static constexpr size_t kMaxSampledMethods = 4096;
+
+  static void* RunCompilerThread(void* arg) LOCKS_EXCLUDED(lock_);
+
+  // Waits for queued methods and takes up to kMaxInstallBatch of them. Returns false on shutdown.
+  bool TakeBatch(Thread* self, std::vector<mirror::ArtMethod*>* batch) LOCKS_EXCLUDED(lock_);
+
+  void InstallCode(const CompiledCode& compiled_code)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
+  static bool IsCompilable(mirror::ArtMethod* method) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Halves the sample counts and drops the methods whose count reaches zero, until a quarter of
+  // kMaxSampledMethods is free. Queued methods keep their entry.
+  void DecaySamples() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  JitCompiler* const compiler_;
+  const uint32_t hot_threshold_;
+
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  ConditionVariable queue_condition_ GUARDED_BY(lock_);
+  SafeMap<mirror::ArtMethod*, uint32_t> samples_ GUARDED_BY(lock_);
+  std::deque<mirror::ArtMethod*> queue_ GUARDED_BY(lock_);
+  bool shutting_down_ GUARDED_BY(lock_);
+  // Set once the compiler is out of code space, no more methods are queued.
+  bool out_of_code_space_ GUARDED_BY(lock_);
+
+  // Compiler thread, non-zero when started.
+  pthread_t compiler_pthread_;
+
+  // Compilation statistics.
+  size_t methods_compiled_ GUARDED_BY(lock_);
+  size_t methods_failed_ GUARDED_BY(lock_);
+  uint64_t compile_time_ns_ GUARDED_BY(lock_);
+  size_t sample_decays_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(PortableJit);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_JIT_PORTABLE_JIT_H_
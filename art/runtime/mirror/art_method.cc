@@ -37,7 +37,14 @@
 namespace art {
 namespace mirror {
 
+#ifdef __LP64__
+extern "C" void art_portable_invoke_stub(ArtMethod*, uint32_t*, uint32_t, Thread*, JValue*,
+                                         const char*);
+extern "C" void art_portable_invoke_static_stub(ArtMethod*, uint32_t*, uint32_t, Thread*, JValue*,
+                                                const char*);
+#else
 extern "C" void art_portable_invoke_stub(ArtMethod*, uint32_t*, uint32_t, Thread*, JValue*, char);
+#endif
 extern "C" void art_quick_invoke_stub(ArtMethod*, uint32_t*, uint32_t, Thread*, JValue*,
                                       const char*);
 #ifdef __LP64__
@@ -323,7 +330,15 @@ void ArtMethod::Invoke(Thread* self, uint32_t* args, uint32_t args_size, JValue*
         (*art_quick_invoke_stub)(this, args, args_size, self, result, shorty);
 #endif
       } else {
+#ifdef __LP64__
+        if (!IsStatic()) {
+          (*art_portable_invoke_stub)(this, args, args_size, self, result, shorty);
+        } else {
+          (*art_portable_invoke_static_stub)(this, args, args_size, self, result, shorty);
+        }
+#else
         (*art_portable_invoke_stub)(this, args, args_size, self, result, shorty[0]);
+#endif
       }
       if (UNLIKELY(self->GetException(nullptr) == Thread::GetDeoptimizationException())) {
         // Unusual case where we were running generated code and an
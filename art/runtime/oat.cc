@@ -99,6 +99,11 @@ void OatHeader::UpdateChecksum(const void* data, size_t length) {
   adler32_checksum_ = adler32(adler32_checksum_, bytes, length);
 }
 
+void OatHeader::UpdateChecksumWithDataChecksum(uint32_t data_checksum, size_t length) {
+  DCHECK(IsValid());
+  adler32_checksum_ = adler32_combine(adler32_checksum_, data_checksum, length);
+}
+
 InstructionSet OatHeader::GetInstructionSet() const {
   CHECK(IsValid());
   return instruction_set_;
@@ -43,6 +43,9 @@ class PACKED(4) OatHeader {
   const char* GetMagic() const;
   uint32_t GetChecksum() const;
   void UpdateChecksum(const void* data, size_t length);
+  // Same as UpdateChecksum() of data of the given length whose own adler32 is data_checksum, so
+  // the checksums of large data can be computed in parallel and then added in order.
+  void UpdateChecksumWithDataChecksum(uint32_t data_checksum, size_t length);
   uint32_t GetDexFileCount() const {
     DCHECK(IsValid());
     return dex_file_count_;
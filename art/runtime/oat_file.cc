@@ -67,13 +67,31 @@ OatFile* OatFile::Open(const std::string& filename,
   CHECK(!filename.empty()) << location;
   CheckLocation(filename);
   if (kUsePortableCompiler) {
-    // If we are using PORTABLE, use dlopen to deal with relocations.
+    // If we are using PORTABLE, our own ELF loader applies the relocations and binds the runtime
+    // support symbols once, the boot oat file is linked at its address so only those remain.
+    // dlopen is the fallback for files with relocations the loader does not handle.
     //
     // We use our own ELF loader for Quick to deal with legacy apps that
     // open a generated dex file by name, remove the file, then open
     // another generated dex file with the same name. http://b/10614658
     if (executable) {
-      return OpenDlopen(filename, location, requested_base, error_msg);
+      uint64_t start_ns = NanoTime();
+      UniquePtr<File> file(OS::OpenFileForReading(filename.c_str()));
+      if (file.get() != NULL) {
+        std::string elf_error_msg;
+        OatFile* oat_file = OpenElfFile(file.get(), location, requested_base, false, true,
+                                        &elf_error_msg);
+        if (oat_file != nullptr) {
+          VLOG(startup) << "Loaded " << filename << " in " << PrettyDuration(NanoTime() - start_ns);
+          return oat_file;
+        }
+        VLOG(startup) << "Falling back to dlopen for " << filename << ": " << elf_error_msg;
+      }
+      start_ns = NanoTime();
+      OatFile* oat_file = OpenDlopen(filename, location, requested_base, error_msg);
+      VLOG(startup) << "Opened " << filename << " with dlopen in "
+                    << PrettyDuration(NanoTime() - start_ns);
+      return oat_file;
     }
   }
   // If we aren't trying to execute, we just use our own ElfFile loader for a couple reasons:
@@ -81,7 +99,7 @@ OatFile* OatFile::Open(const std::string& filename,
   // On target, dlopen may fail when compiling due to selinux restrictions on installd.
   //
   // On host, dlopen is expected to fail when cross compiling, so fall back to OpenElfFile.
-  // This won't work for portable runtime execution because it doesn't process relocations.
+  // Relocations are only processed for portable runtime execution.
   UniquePtr<File> file(OS::OpenFileForReading(filename.c_str()));
   if (file.get() == NULL) {
     *error_msg = StringPrintf("Failed to open oat filename for reading: %s", strerror(errno));
@@ -141,7 +159,8 @@ bool OatFile::Dlopen(const std::string& elf_filename, byte* requested_base,
     *error_msg = StringPrintf("Failed to find absolute path for '%s'", elf_filename.c_str());
     return false;
   }
-  dlopen_handle_ = dlopen(absolute_path, RTLD_NOW);
+  // The runtime support functions are bound on their first call.
+  dlopen_handle_ = dlopen(absolute_path, RTLD_LAZY);
   free(absolute_path);
   if (dlopen_handle_ == NULL) {
     *error_msg = StringPrintf("Failed to dlopen '%s': %s", elf_filename.c_str(), dlerror());
@@ -183,6 +202,10 @@ bool OatFile::ElfFileOpen(File* file, byte* requested_base, bool writable, bool
     DCHECK(!error_msg->empty());
     return false;
   }
+  if (kUsePortableCompiler && executable && !elf_file_->Relocate(error_msg)) {
+    DCHECK(!error_msg->empty());
+    return false;
+  }
   begin_ = elf_file_->FindDynamicSymbolAddress("oatdata");
   if (begin_ == NULL) {
     *error_msg = StringPrintf("Failed to find oatdata symbol in '%s'", file->GetPath().c_str());
@@ -69,6 +69,11 @@ class OatFile {
 
   const OatHeader& GetOatHeader() const;
 
+  // Returns true if the file was loaded by the dynamic linker instead of ART's ELF loader.
+  bool IsDlopened() const {
+    return dlopen_handle_ != NULL;
+  }
+
   class OatDexFile;
 
   class OatMethod {
@@ -208,6 +208,7 @@ bool ParsedOptions::Parse(const Runtime::Options& options, bool ignore_unrecogni
   verify_post_gc_rosalloc_ = false;
 
   compiler_callbacks_ = nullptr;
+  jit_compiler_ = nullptr;
   is_zygote_ = false;
   if (kPoisonHeapReferences) {
     // kPoisonHeapReferences currently works only with the interpreter only.
@@ -255,6 +256,7 @@ bool ParsedOptions::Parse(const Runtime::Options& options, bool ignore_unrecogni
   profile_backoff_coefficient_ = 2.0;
   profile_start_immediately_ = true;
   profile_clock_source_ = kDefaultProfilerClockSource;
+  jit_threshold_ = 10;              // Profiler samples.
 
   verify_ = true;
   image_isa_ = kRuntimeISA;
@@ -424,6 +426,8 @@ bool ParsedOptions::Parse(const Runtime::Options& options, bool ignore_unrecogni
     } else if (option == "compilercallbacks") {
       compiler_callbacks_ =
           reinterpret_cast<CompilerCallbacks*>(const_cast<void*>(options[i].second));
+    } else if (option == "jitcompiler") {
+      jit_compiler_ = reinterpret_cast<JitCompiler*>(const_cast<void*>(options[i].second));
     } else if (option == "imageinstructionset") {
       image_isa_ = GetInstructionSetFromString(
           reinterpret_cast<const char*>(options[i].second));
@@ -557,6 +561,11 @@ bool ParsedOptions::Parse(const Runtime::Options& options, bool ignore_unrecogni
       }
     } else if (option == "-Xprofile-start-lazy") {
       profile_start_immediately_ = false;
+    } else if (StartsWith(option, "-Xjitthreshold:")) {
+      if (!ParseUnsignedInteger(option, ':', &jit_threshold_) || jit_threshold_ == 0) {
+        Usage("-Xjitthreshold: needs a positive value");
+        return false;
+      }
     } else if (StartsWith(option, "-implicit-checks:")) {
       std::string checks;
       if (!ParseStringAfterChar(option, ':', &checks)) {
@@ -651,7 +660,6 @@ bool ParsedOptions::Parse(const Runtime::Options& options, bool ignore_unrecogni
                (option == "-Xincludeselectedop") ||
                StartsWith(option, "-Xjitop:") ||
                (option == "-Xincludeselectedmethod") ||
-               StartsWith(option, "-Xjitthreshold:") ||
                StartsWith(option, "-Xjitcodecachesize:") ||
                (option == "-Xjitblocking") ||
                StartsWith(option, "-Xjitmethod:") ||
@@ -36,6 +36,7 @@ class ParsedOptions {
   bool check_jni_;
   std::string jni_trace_;
   CompilerCallbacks* compiler_callbacks_;
+  JitCompiler* jit_compiler_;
   bool is_zygote_;
   bool interpreter_only_;
   bool is_explicit_gc_disabled_;
@@ -84,6 +85,7 @@ class ParsedOptions {
   double profile_backoff_coefficient_;
   bool profile_start_immediately_;
   ProfilerClockSource profile_clock_source_;
+  unsigned int jit_threshold_;
   bool verify_;
   InstructionSet image_isa_;
 
@@ -28,6 +28,7 @@
 #include "debugger.h"
 #include "dex_file-inl.h"
 #include "instrumentation.h"
+#include "jit/portable_jit.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/dex_cache.h"
@@ -416,6 +417,10 @@ void BackgroundMethodSamplingProfiler::RecordMethod(mirror::ArtMethod* method) {
   // Add to the profile table unless it is filtered out.
   if (!is_filtered) {
     profile_table_.Put(method);
+    PortableJit* jit = Runtime::Current()->GetPortableJit();
+    if (jit != nullptr) {
+      jit->AddSample(method);
+    }
   }
 }
 
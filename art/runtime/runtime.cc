@@ -71,6 +71,7 @@
 #include "thread_list.h"
 #include "trace.h"
 #include "transaction.h"
+#include "jit/portable_jit.h"
 #include "profiler.h"
 #include "UniquePtr.h"
 #include "verifier/method_verifier.h"
@@ -129,6 +130,9 @@ Runtime::Runtime()
       profile_interval_us_(0),
       profile_backoff_coefficient_(0),
       profile_start_immediately_(true),
+      jit_compiler_(nullptr),
+      jit_threshold_(0),
+      portable_jit_(nullptr),
       method_trace_(false),
       method_trace_file_size_(0),
       instrumentation_(),
@@ -173,6 +177,7 @@ Runtime::~Runtime() {
   // Make sure our internal threads are dead before we start tearing down things they're using.
   Dbg::StopJdwp();
   delete signal_catcher_;
+  delete portable_jit_;
 
   // Make sure all other non-daemon threads have terminated, and all daemon threads are suspended.
   delete thread_list_;
@@ -372,6 +377,14 @@ bool Runtime::Start() {
   Thread* self = Thread::Current();
   self->TransitionFromRunnableToSuspended(kNative);
 
+  if (jit_compiler_ != nullptr) {
+    std::string error_msg;
+    if (!jit_compiler_->Init(&error_msg)) {
+      LOG(WARNING) << "Running without the portable JIT: " << error_msg;
+      jit_compiler_ = nullptr;
+    }
+  }
+
   started_ = true;
 
   // InitNativeMethods needs to be after started_ so that the classes
@@ -411,6 +424,11 @@ bool Runtime::Start() {
     StartProfiler(profile_output_filename_.c_str(), "");
   }
 
+  if (jit_compiler_ != nullptr) {
+    portable_jit_ = new PortableJit(jit_compiler_, jit_threshold_);
+    portable_jit_->Start();
+  }
+
   return true;
 }
 
@@ -518,6 +536,7 @@ bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
   properties_ = options->properties_;
 
   compiler_callbacks_ = options->compiler_callbacks_;
+  jit_compiler_ = options->jit_compiler_;
   is_zygote_ = options->is_zygote_;
   is_explicit_gc_disabled_ = options->is_explicit_gc_disabled_;
 
@@ -640,6 +659,7 @@ bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
   profile_start_immediately_ = options->profile_start_immediately_;
   profile_ = options->profile_;
   profile_output_filename_ = options->profile_output_filename_;
+  jit_threshold_ = options->jit_threshold_;
   // TODO: move this to just be an Trace::Start argument
   Trace::SetDefaultClockSource(options->profile_clock_source_);
 
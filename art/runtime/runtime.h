@@ -62,8 +62,10 @@ class CompilerCallbacks;
 class DexFile;
 class InternTable;
 class JavaVMExt;
+class JitCompiler;
 class MonitorList;
 class MonitorPool;
+class PortableJit;
 class SignalCatcher;
 class ThreadList;
 class Trace;
@@ -387,6 +389,10 @@ class Runtime {
   void StartProfiler(const char* appDir, const char* procName);
   void UpdateProfilerState(int state);
 
+  PortableJit* GetPortableJit() const {
+    return portable_jit_;
+  }
+
   // Transaction support.
   bool IsActiveTransaction() const {
     return preinitialization_transaction_ != nullptr;
@@ -558,6 +564,11 @@ class Runtime {
   bool profile_start_immediately_;      // Whether the profile should start upon app
                                         // startup or be delayed by some random offset.
 
+  // Runtime compilation of hot methods.
+  JitCompiler* jit_compiler_;           // Compiles hot methods, set with "jitcompiler".
+  uint32_t jit_threshold_;              // Profiler samples before a method is compiled.
+  PortableJit* portable_jit_;
+
   bool method_trace_;
   std::string method_trace_file_;
   size_t method_trace_file_size_;
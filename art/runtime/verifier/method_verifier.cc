@@ -41,6 +41,7 @@
 #include "runtime.h"
 #include "scoped_thread_state_change.h"
 #include "handle_scope-inl.h"
+#include "thread_pool.h"
 #include "verifier/dex_gc_map.h"
 
 namespace art {
@@ -121,6 +122,174 @@ MethodVerifier::FailureKind MethodVerifier::VerifyClass(mirror::Class* klass,
   return VerifyClass(&dex_file, dex_cache, class_loader, class_def, allow_soft_failures, error);
 }
 
+// Classes with fewer methods are verified by the calling thread only.
+static constexpr size_t kMinMethodsForParallelVerification = 64;
+// Methods for each helper thread the verification of a class asks for.
+static constexpr size_t kMethodsPerVerificationHelper = 16;
+
+ThreadPool* MethodVerifier::method_thread_pool_ = nullptr;
+
+void MethodVerifier::SetMethodThreadPool(ThreadPool* thread_pool) {
+  method_thread_pool_ = thread_pool;
+}
+
+// The methods are handed out one at a time to the threads verifying them, each of which uses its
+// own MethodVerifier and so its own RegTypeCache. The results are kept per method so that they
+// can be merged in declaration order whichever thread verified a method. Helper tasks may run
+// after the class is done, so the object is reference counted.
+class MethodVerifier::ClassMethods {
+ public:
+  ClassMethods(const DexFile* dex_file, Handle<mirror::DexCache>* dex_cache,
+               Handle<mirror::ClassLoader>* class_loader, const DexFile::ClassDef* class_def,
+               bool allow_soft_failures)
+      : dex_file_(dex_file), dex_cache_(dex_cache), class_loader_(class_loader),
+        class_def_(class_def), allow_soft_failures_(allow_soft_failures), next_method_(0),
+        references_(1), lock_("verifier class methods lock"),
+        methods_verified_cond_("verifier class methods condition", lock_), num_verified_(0) {
+  }
+
+  void AddMethod(const ClassDataItemIterator& it) {
+    Method method;
+    method.method_idx = it.GetMemberIndex();
+    method.code_item = it.GetMethodCodeItem();
+    method.access_flags = it.GetMemberAccessFlags();
+    method.invoke_type = it.GetMethodInvokeType(*class_def_);
+    method.result = kNoFailure;
+    methods_.push_back(method);
+  }
+
+  size_t NumMethods() const {
+    return methods_.size();
+  }
+
+  // Verifies methods until none is left.
+  void VerifyMethods(Thread* self) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    ClassLinker* linker = Runtime::Current()->GetClassLinker();
+    size_t num_verified = 0;
+    while (true) {
+      const size_t index = next_method_.FetchAndAdd(1);
+      if (index >= methods_.size()) {
+        break;
+      }
+      Method& method = methods_[index];
+      mirror::ArtMethod* resolved_method =
+          linker->ResolveMethod(*dex_file_, method.method_idx, *dex_cache_, *class_loader_, NULL,
+                                method.invoke_type);
+      if (resolved_method == NULL) {
+        DCHECK(self->IsExceptionPending());
+        // We couldn't resolve the method, but continue regardless.
+        self->ClearException();
+      }
+      method.result = VerifyMethod(method.method_idx, dex_file_, *dex_cache_, *class_loader_,
+                                   class_def_, method.code_item, resolved_method,
+                                   method.access_flags, allow_soft_failures_);
+      ++num_verified;
+    }
+    if (num_verified != 0) {
+      MutexLock mu(self, lock_);
+      num_verified_ += num_verified;
+      if (num_verified_ == methods_.size()) {
+        methods_verified_cond_.Broadcast(self);
+      }
+    }
+  }
+
+  // Verifies the methods with the help of up to num_helpers workers of the thread pool and waits
+  // until all methods are verified.
+  void VerifyMethods(Thread* self, ThreadPool* thread_pool, size_t num_helpers)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    for (size_t i = 0; i < num_helpers; ++i) {
+      references_.FetchAndAdd(1);
+      thread_pool->AddTask(self, new HelperTask(this));
+    }
+    VerifyMethods(self);
+    // Don't hold the mutator lock while waiting for the helpers.
+    ScopedThreadStateChange tsc(self, kNative);
+    MutexLock mu(self, lock_);
+    while (num_verified_ != methods_.size()) {
+      methods_verified_cond_.Wait(self);
+    }
+  }
+
+  FailureKind MergeResults(std::string* error) const {
+    size_t error_count = 0;
+    bool hard_fail = false;
+    for (const Method& method : methods_) {
+      if (method.result != kNoFailure) {
+        if (method.result == kHardFailure) {
+          hard_fail = true;
+          if (error_count > 0) {
+            *error += "\n";
+          }
+          *error = "Verifier rejected class ";
+          *error += PrettyDescriptor(dex_file_->GetClassDescriptor(*class_def_));
+          *error += " due to bad method ";
+          *error += PrettyMethod(method.method_idx, *dex_file_);
+        }
+        ++error_count;
+      }
+    }
+    if (error_count == 0) {
+      return kNoFailure;
+    } else {
+      return hard_fail ? kHardFailure : kSoftFailure;
+    }
+  }
+
+  void Release() {
+    if (references_.FetchAndSub(1) == 1) {
+      delete this;
+    }
+  }
+
+ private:
+  class HelperTask : public Task {
+   public:
+    explicit HelperTask(ClassMethods* methods) : methods_(methods) {
+    }
+
+    void Run(Thread* self) {
+      ScopedObjectAccess soa(self);
+      methods_->VerifyMethods(self);
+      self->AssertNoPendingException();
+    }
+
+    void Finalize() {
+      methods_->Release();
+      delete this;
+    }
+
+   private:
+    ClassMethods* const methods_;
+  };
+
+  struct Method {
+    uint32_t method_idx;
+    const DexFile::CodeItem* code_item;
+    uint32_t access_flags;
+    InvokeType invoke_type;
+    FailureKind result;
+  };
+
+  ~ClassMethods() {
+  }
+
+  const DexFile* const dex_file_;
+  // Handles of the thread verifying the class, which outlive the verification of the methods.
+  Handle<mirror::DexCache>* const dex_cache_;
+  Handle<mirror::ClassLoader>* const class_loader_;
+  const DexFile::ClassDef* const class_def_;
+  const bool allow_soft_failures_;
+  std::vector<Method> methods_;
+  AtomicInteger next_method_;
+  AtomicInteger references_;
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  ConditionVariable methods_verified_cond_ GUARDED_BY(lock_);
+  size_t num_verified_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(ClassMethods);
+};
+
 MethodVerifier::FailureKind MethodVerifier::VerifyClass(const DexFile* dex_file,
                                                         Handle<mirror::DexCache>& dex_cache,
                                                         Handle<mirror::ClassLoader>& class_loader,
@@ -137,9 +306,8 @@ MethodVerifier::FailureKind MethodVerifier::VerifyClass(const DexFile* dex_file,
   while (it.HasNextStaticField() || it.HasNextInstanceField()) {
     it.Next();
   }
-  size_t error_count = 0;
-  bool hard_fail = false;
-  ClassLinker* linker = Runtime::Current()->GetClassLinker();
+  ClassMethods* methods = new ClassMethods(dex_file, &dex_cache, &class_loader, class_def,
+                                           allow_soft_failures);
   int64_t previous_direct_method_idx = -1;
   while (it.HasNextDirectMethod()) {
     uint32_t method_idx = it.GetMemberIndex();
@@ -150,36 +318,7 @@ MethodVerifier::FailureKind MethodVerifier::VerifyClass(const DexFile* dex_file,
       continue;
     }
     previous_direct_method_idx = method_idx;
-    InvokeType type = it.GetMethodInvokeType(*class_def);
-    mirror::ArtMethod* method =
-        linker->ResolveMethod(*dex_file, method_idx, dex_cache, class_loader, NULL, type);
-    if (method == NULL) {
-      DCHECK(Thread::Current()->IsExceptionPending());
-      // We couldn't resolve the method, but continue regardless.
-      Thread::Current()->ClearException();
-    }
-    MethodVerifier::FailureKind result = VerifyMethod(method_idx,
-                                                      dex_file,
-                                                      dex_cache,
-                                                      class_loader,
-                                                      class_def,
-                                                      it.GetMethodCodeItem(),
-                                                      method,
-                                                      it.GetMemberAccessFlags(),
-                                                      allow_soft_failures);
-    if (result != kNoFailure) {
-      if (result == kHardFailure) {
-        hard_fail = true;
-        if (error_count > 0) {
-          *error += "\n";
-        }
-        *error = "Verifier rejected class ";
-        *error += PrettyDescriptor(dex_file->GetClassDescriptor(*class_def));
-        *error += " due to bad method ";
-        *error += PrettyMethod(method_idx, *dex_file);
-      }
-      ++error_count;
-    }
+    methods->AddMethod(it);
     it.Next();
   }
   int64_t previous_virtual_method_idx = -1;
@@ -192,43 +331,21 @@ MethodVerifier::FailureKind MethodVerifier::VerifyClass(const DexFile* dex_file,
       continue;
     }
     previous_virtual_method_idx = method_idx;
-    InvokeType type = it.GetMethodInvokeType(*class_def);
-    mirror::ArtMethod* method =
-        linker->ResolveMethod(*dex_file, method_idx, dex_cache, class_loader, NULL, type);
-    if (method == NULL) {
-      DCHECK(Thread::Current()->IsExceptionPending());
-      // We couldn't resolve the method, but continue regardless.
-      Thread::Current()->ClearException();
-    }
-    MethodVerifier::FailureKind result = VerifyMethod(method_idx,
-                                                      dex_file,
-                                                      dex_cache,
-                                                      class_loader,
-                                                      class_def,
-                                                      it.GetMethodCodeItem(),
-                                                      method,
-                                                      it.GetMemberAccessFlags(),
-                                                      allow_soft_failures);
-    if (result != kNoFailure) {
-      if (result == kHardFailure) {
-        hard_fail = true;
-        if (error_count > 0) {
-          *error += "\n";
-        }
-        *error = "Verifier rejected class ";
-        *error += PrettyDescriptor(dex_file->GetClassDescriptor(*class_def));
-        *error += " due to bad method ";
-        *error += PrettyMethod(method_idx, *dex_file);
-      }
-      ++error_count;
-    }
+    methods->AddMethod(it);
     it.Next();
   }
-  if (error_count == 0) {
-    return kNoFailure;
+  Thread* self = Thread::Current();
+  ThreadPool* thread_pool = method_thread_pool_;
+  if (thread_pool != nullptr && methods->NumMethods() >= kMinMethodsForParallelVerification) {
+    size_t num_helpers = std::min(thread_pool->GetThreadCount(),
+                                  methods->NumMethods() / kMethodsPerVerificationHelper - 1);
+    methods->VerifyMethods(self, thread_pool, num_helpers);
   } else {
-    return hard_fail ? kHardFailure : kSoftFailure;
+    methods->VerifyMethods(self);
   }
+  FailureKind result = methods->MergeResults(error);
+  methods->Release();
+  return result;
 }
 
 MethodVerifier::FailureKind MethodVerifier::VerifyMethod(uint32_t method_idx,
@@ -39,6 +39,7 @@ namespace art {
 
 struct ReferenceMap2Visitor;
 template<class T> class Handle;
+class ThreadPool;
 
 namespace verifier {
 
@@ -201,6 +202,12 @@ class MethodVerifier {
   static void Init() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   static void Shutdown();
 
+  // Sets the pool whose workers help verifying the methods of classes with many methods, the
+  // methods of other classes are verified by the calling thread only. NULL disables the helpers.
+  // The pool must outlive all verification, have its workers started and not be the pool whose
+  // workers verify the classes.
+  static void SetMethodThreadPool(ThreadPool* thread_pool);
+
   bool CanLoadClasses() const {
     return can_load_classes_;
   }
@@ -243,6 +250,9 @@ class MethodVerifier {
   // Adds the given string to the end of the last failure message.
   void AppendToLastFailMessage(std::string);
 
+  // The methods of a class that remain to be verified and their results.
+  class ClassMethods;
+
   /*
    * Perform verification on a single method.
    *
@@ -680,6 +690,8 @@ class MethodVerifier {
   // Indicates the method being verified contains at least one invoke-virtual/range
   // or invoke-interface/range.
   bool has_virtual_or_interface_invokes_;
+
+  static ThreadPool* method_thread_pool_;
 };
 std::ostream& operator<<(std::ostream& os, const MethodVerifier::FailureKind& rhs);
 
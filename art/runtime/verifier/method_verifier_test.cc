@@ -21,7 +21,11 @@
 #include "UniquePtr.h"
 #include "class_linker.h"
 #include "common_runtime_test.h"
-#include "dex_file.h"
+#include "dex_file-inl.h"
+#include "handle_scope-inl.h"
+#include "mirror/dex_cache.h"
+#include "thread_pool.h"
+#include "utils.h"
 
 namespace art {
 namespace verifier {
@@ -57,5 +61,68 @@ TEST_F(MethodVerifierTest, LibCore) {
   VerifyDexFile(java_lang_dex_file_);
 }
 
+TEST_F(MethodVerifierTest, ParallelMethodsMatchSerial) {
+  // Verifying the methods of large classes with helper threads must give the same results.
+  Thread* self = Thread::Current();
+  ThreadPool thread_pool("Method verifier test thread pool", 3);
+  thread_pool.StartWorkers(self);
+  ScopedObjectAccess soa(self);
+  size_t num_large_classes = 0;
+  for (size_t i = 0; i < java_lang_dex_file_->NumClassDefs(); i++) {
+    const DexFile::ClassDef& class_def = java_lang_dex_file_->GetClassDef(i);
+    const byte* class_data = java_lang_dex_file_->GetClassData(class_def);
+    if (class_data == NULL) {
+      continue;
+    }
+    ClassDataItemIterator it(*java_lang_dex_file_, class_data);
+    if (it.NumDirectMethods() + it.NumVirtualMethods() < 64) {
+      continue;
+    }
+    ++num_large_classes;
+    StackHandleScope<2> hs(soa.Self());
+    Handle<mirror::DexCache> dex_cache(
+        hs.NewHandle(class_linker_->FindDexCache(*java_lang_dex_file_)));
+    Handle<mirror::ClassLoader> class_loader(hs.NewHandle<mirror::ClassLoader>(nullptr));
+    std::string serial_error;
+    MethodVerifier::FailureKind serial_result =
+        MethodVerifier::VerifyClass(java_lang_dex_file_, dex_cache, class_loader, &class_def,
+                                    true, &serial_error);
+    MethodVerifier::SetMethodThreadPool(&thread_pool);
+    std::string parallel_error;
+    MethodVerifier::FailureKind parallel_result =
+        MethodVerifier::VerifyClass(java_lang_dex_file_, dex_cache, class_loader, &class_def,
+                                    true, &parallel_error);
+    MethodVerifier::SetMethodThreadPool(nullptr);
+    EXPECT_EQ(serial_result, parallel_result);
+    EXPECT_EQ(serial_error, parallel_error);
+  }
+  EXPECT_NE(num_large_classes, 0U);
+  ScopedThreadStateChange tsc(self, kNative);
+  thread_pool.Wait(self, true, false);
+}
+
+// Not a correctness test, reports the time spent verifying the methods of the boot class path so
+// that changes to the verifier and its RegTypeCache can be compared.
+TEST_F(MethodVerifierTest, LibCoreTimePerMethod) {
+  ScopedObjectAccess soa(Thread::Current());
+  // Load the classes first so that only the verification is measured.
+  VerifyDexFile(java_lang_dex_file_);
+  size_t num_methods = 0;
+  for (size_t i = 0; i < java_lang_dex_file_->NumClassDefs(); i++) {
+    const byte* class_data =
+        java_lang_dex_file_->GetClassData(java_lang_dex_file_->GetClassDef(i));
+    if (class_data != NULL) {
+      ClassDataItemIterator it(*java_lang_dex_file_, class_data);
+      num_methods += it.NumDirectMethods() + it.NumVirtualMethods();
+    }
+  }
+  ASSERT_NE(num_methods, 0U);
+  uint64_t start_ns = NanoTime();
+  VerifyDexFile(java_lang_dex_file_);
+  uint64_t duration_ns = NanoTime() - start_ns;
+  LOG(INFO) << "Verified " << num_methods << " methods in " << PrettyDuration(duration_ns)
+            << ", " << PrettyDuration(duration_ns / num_methods) << " per method";
+}
+
 }  // namespace verifier
 }  // namespace art
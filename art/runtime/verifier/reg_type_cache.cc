@@ -30,6 +30,18 @@ bool RegTypeCache::primitive_initialized_ = false;
 uint16_t RegTypeCache::primitive_count_ = 0;
 PreciseConstType* RegTypeCache::small_precise_constants_[kMaxSmallConstant - kMinSmallConstant + 1];
 
+static size_t HashDescriptor(const char* descriptor) {
+  size_t hash = 0;
+  for (; *descriptor != '\0'; ++descriptor) {
+    hash = hash * 31 + *descriptor;
+  }
+  return hash;
+}
+
+static size_t HashClass(mirror::Class* klass) {
+  return reinterpret_cast<uintptr_t>(klass);
+}
+
 static bool MatchingPrecisionForClass(RegType* entry, bool precise)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
   if (entry->IsPreciseReference() == precise) {
@@ -160,9 +172,10 @@ mirror::Class* RegTypeCache::ResolveClass(const char* descriptor, mirror::ClassL
 const RegType& RegTypeCache::From(mirror::ClassLoader* loader, const char* descriptor,
                                   bool precise) {
   // Try looking up the class in the cache first.
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    if (MatchDescriptor(i, descriptor, precise)) {
-      return *(entries_[i]);
+  auto range = descriptor_index_.equal_range(HashDescriptor(descriptor));
+  for (auto it = range.first; it != range.second; ++it) {
+    if (MatchDescriptor(it->second, descriptor, precise)) {
+      return *(entries_[it->second]);
     }
   }
   // Class not found in the cache, will create a new type for that.
@@ -186,7 +199,7 @@ const RegType& RegTypeCache::From(mirror::ClassLoader* loader, const char* descr
     } else {
       entry = new ReferenceType(klass, descriptor, entries_.size());
     }
-    entries_.push_back(entry);
+    AddEntry(entry);
     return *entry;
   } else {  // Class not resolved.
     // We tried loading the class and failed, this might get an exception raised
@@ -199,7 +212,7 @@ const RegType& RegTypeCache::From(mirror::ClassLoader* loader, const char* descr
     }
     if (IsValidDescriptor(descriptor)) {
       RegType* entry = new UnresolvedReferenceType(descriptor, entries_.size());
-      entries_.push_back(entry);
+      AddEntry(entry);
       return *entry;
     } else {
       // The descriptor is broken return the unknown type as there's nothing sensible that
@@ -217,9 +230,10 @@ const RegType& RegTypeCache::FromClass(const char* descriptor, mirror::Class* kl
     return RegTypeFromPrimitiveType(klass->GetPrimitiveType());
   } else {
     // Look for the reference in the list of entries to have.
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      RegType* cur_entry = entries_[i];
-      if (cur_entry->klass_ == klass && MatchingPrecisionForClass(cur_entry, precise)) {
+    auto range = class_index_.equal_range(HashClass(klass));
+    for (auto it = range.first; it != range.second; ++it) {
+      RegType* cur_entry = entries_[it->second];
+      if (MatchingPrecisionForClass(cur_entry, precise)) {
         return *cur_entry;
       }
     }
@@ -230,7 +244,7 @@ const RegType& RegTypeCache::FromClass(const char* descriptor, mirror::Class* kl
     } else {
       entry = new ReferenceType(klass, descriptor, entries_.size());
     }
-    entries_.push_back(entry);
+    AddEntry(entry);
     return *entry;
   }
 }
@@ -340,7 +354,7 @@ const RegType& RegTypeCache::FromUnresolvedMerge(const RegType& left, const RegT
   }
   // Create entry.
   RegType* entry = new UnresolvedMergedType(left.GetId(), right.GetId(), this, entries_.size());
-  entries_.push_back(entry);
+  AddEntry(entry);
   if (kIsDebugBuild) {
     UnresolvedMergedType* tmp_entry = down_cast<UnresolvedMergedType*>(entry);
     std::set<uint16_t> check_types = tmp_entry->GetMergedTypes();
@@ -364,18 +378,18 @@ const RegType& RegTypeCache::FromUnresolvedSuperClass(const RegType& child) {
     }
   }
   RegType* entry = new UnresolvedSuperClass(child.GetId(), this, entries_.size());
-  entries_.push_back(entry);
+  AddEntry(entry);
   return *entry;
 }
 
 const UninitializedType& RegTypeCache::Uninitialized(const RegType& type, uint32_t allocation_pc) {
   UninitializedType* entry = NULL;
   const std::string& descriptor(type.GetDescriptor());
+  auto range = allocation_pc_index_.equal_range(allocation_pc);
   if (type.IsUnresolvedTypes()) {
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      RegType* cur_entry = entries_[i];
+    for (auto it = range.first; it != range.second; ++it) {
+      RegType* cur_entry = entries_[it->second];
       if (cur_entry->IsUnresolvedAndUninitializedReference() &&
-          down_cast<UnresolvedUninitializedRefType*>(cur_entry)->GetAllocationPc() == allocation_pc &&
           (cur_entry->GetDescriptor() == descriptor)) {
         return *down_cast<UnresolvedUninitializedRefType*>(cur_entry);
       }
@@ -383,18 +397,15 @@ const UninitializedType& RegTypeCache::Uninitialized(const RegType& type, uint32
     entry = new UnresolvedUninitializedRefType(descriptor, allocation_pc, entries_.size());
   } else {
     mirror::Class* klass = type.GetClass();
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      RegType* cur_entry = entries_[i];
-      if (cur_entry->IsUninitializedReference() &&
-          down_cast<UninitializedReferenceType*>(cur_entry)
-              ->GetAllocationPc() == allocation_pc &&
-          cur_entry->GetClass() == klass) {
+    for (auto it = range.first; it != range.second; ++it) {
+      RegType* cur_entry = entries_[it->second];
+      if (cur_entry->IsUninitializedReference() && cur_entry->GetClass() == klass) {
         return *down_cast<UninitializedReferenceType*>(cur_entry);
       }
     }
     entry = new UninitializedReferenceType(klass, descriptor, allocation_pc, entries_.size());
   }
-  entries_.push_back(entry);
+  AddEntry(entry);
   return *entry;
 }
 
@@ -403,8 +414,9 @@ const RegType& RegTypeCache::FromUninitialized(const RegType& uninit_type) {
 
   if (uninit_type.IsUnresolvedTypes()) {
     const std::string& descriptor(uninit_type.GetDescriptor());
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      RegType* cur_entry = entries_[i];
+    auto range = descriptor_index_.equal_range(HashDescriptor(descriptor.c_str()));
+    for (auto it = range.first; it != range.second; ++it) {
+      RegType* cur_entry = entries_[it->second];
       if (cur_entry->IsUnresolvedReference() &&
           cur_entry->GetDescriptor() == descriptor) {
         return *cur_entry;
@@ -413,11 +425,12 @@ const RegType& RegTypeCache::FromUninitialized(const RegType& uninit_type) {
     entry = new UnresolvedReferenceType(descriptor.c_str(), entries_.size());
   } else {
     mirror::Class* klass = uninit_type.GetClass();
+    auto range = class_index_.equal_range(HashClass(klass));
     if (uninit_type.IsUninitializedThisReference() && !klass->IsFinal()) {
       // For uninitialized "this reference" look for reference types that are not precise.
-      for (size_t i = primitive_count_; i < entries_.size(); i++) {
-        RegType* cur_entry = entries_[i];
-        if (cur_entry->IsReference() && cur_entry->GetClass() == klass) {
+      for (auto it = range.first; it != range.second; ++it) {
+        RegType* cur_entry = entries_[it->second];
+        if (cur_entry->IsReference()) {
           return *cur_entry;
         }
       }
@@ -425,9 +438,9 @@ const RegType& RegTypeCache::FromUninitialized(const RegType& uninit_type) {
     } else if (klass->IsInstantiable()) {
       // We're uninitialized because of allocation, look or create a precise type as allocations
       // may only create objects of that type.
-      for (size_t i = primitive_count_; i < entries_.size(); i++) {
-        RegType* cur_entry = entries_[i];
-        if (cur_entry->IsPreciseReference() && cur_entry->GetClass() == klass) {
+      for (auto it = range.first; it != range.second; ++it) {
+        RegType* cur_entry = entries_[it->second];
+        if (cur_entry->IsPreciseReference()) {
           return *cur_entry;
         }
       }
@@ -436,7 +449,7 @@ const RegType& RegTypeCache::FromUninitialized(const RegType& uninit_type) {
       return Conflict();
     }
   }
-  entries_.push_back(entry);
+  AddEntry(entry);
   return *entry;
 }
 
@@ -480,9 +493,11 @@ const ImpreciseConstType& RegTypeCache::PosShortConstant() {
 const UninitializedType& RegTypeCache::UninitializedThisArgument(const RegType& type) {
   UninitializedType* entry;
   const std::string& descriptor(type.GetDescriptor());
+  // Uninitialized this types are all allocated at pc 0.
+  auto range = allocation_pc_index_.equal_range(0);
   if (type.IsUnresolvedTypes()) {
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      RegType* cur_entry = entries_[i];
+    for (auto it = range.first; it != range.second; ++it) {
+      RegType* cur_entry = entries_[it->second];
       if (cur_entry->IsUnresolvedAndUninitializedThisReference() &&
           cur_entry->GetDescriptor() == descriptor) {
         return *down_cast<UninitializedType*>(cur_entry);
@@ -491,24 +506,24 @@ const UninitializedType& RegTypeCache::UninitializedThisArgument(const RegType&
     entry = new UnresolvedUninitializedThisRefType(descriptor, entries_.size());
   } else {
     mirror::Class* klass = type.GetClass();
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      RegType* cur_entry = entries_[i];
+    for (auto it = range.first; it != range.second; ++it) {
+      RegType* cur_entry = entries_[it->second];
       if (cur_entry->IsUninitializedThisReference() && cur_entry->GetClass() == klass) {
         return *down_cast<UninitializedType*>(cur_entry);
       }
     }
     entry = new UninitializedThisReferenceType(klass, descriptor, entries_.size());
   }
-  entries_.push_back(entry);
+  AddEntry(entry);
   return *entry;
 }
 
 const ConstantType& RegTypeCache::FromCat1NonSmallConstant(int32_t value, bool precise) {
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    RegType* cur_entry = entries_[i];
+  auto range = constant_index_.equal_range(static_cast<uint32_t>(value));
+  for (auto it = range.first; it != range.second; ++it) {
+    RegType* cur_entry = entries_[it->second];
     if (cur_entry->klass_ == NULL && cur_entry->IsConstant() &&
-        cur_entry->IsPreciseConstant() == precise &&
-        (down_cast<ConstantType*>(cur_entry))->ConstantValue() == value) {
+        cur_entry->IsPreciseConstant() == precise) {
       return *down_cast<ConstantType*>(cur_entry);
     }
   }
@@ -518,15 +533,15 @@ const ConstantType& RegTypeCache::FromCat1NonSmallConstant(int32_t value, bool p
   } else {
     entry = new ImpreciseConstType(value, entries_.size());
   }
-  entries_.push_back(entry);
+  AddEntry(entry);
   return *entry;
 }
 
 const ConstantType& RegTypeCache::FromCat2ConstLo(int32_t value, bool precise) {
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    RegType* cur_entry = entries_[i];
-    if (cur_entry->IsConstantLo() && (cur_entry->IsPrecise() == precise) &&
-        (down_cast<ConstantType*>(cur_entry))->ConstantValueLo() == value) {
+  auto range = constant_index_.equal_range(static_cast<uint32_t>(value));
+  for (auto it = range.first; it != range.second; ++it) {
+    RegType* cur_entry = entries_[it->second];
+    if (cur_entry->IsConstantLo() && (cur_entry->IsPrecise() == precise)) {
       return *down_cast<ConstantType*>(cur_entry);
     }
   }
@@ -536,15 +551,15 @@ const ConstantType& RegTypeCache::FromCat2ConstLo(int32_t value, bool precise) {
   } else {
     entry = new ImpreciseConstLoType(value, entries_.size());
   }
-  entries_.push_back(entry);
+  AddEntry(entry);
   return *entry;
 }
 
 const ConstantType& RegTypeCache::FromCat2ConstHi(int32_t value, bool precise) {
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    RegType* cur_entry = entries_[i];
-    if (cur_entry->IsConstantHi() && (cur_entry->IsPrecise() == precise) &&
-        (down_cast<ConstantType*>(cur_entry))->ConstantValueHi() == value) {
+  auto range = constant_index_.equal_range(static_cast<uint32_t>(value));
+  for (auto it = range.first; it != range.second; ++it) {
+    RegType* cur_entry = entries_[it->second];
+    if (cur_entry->IsConstantHi() && (cur_entry->IsPrecise() == precise)) {
       return *down_cast<ConstantType*>(cur_entry);
     }
   }
@@ -554,7 +569,7 @@ const ConstantType& RegTypeCache::FromCat2ConstHi(int32_t value, bool precise) {
   } else {
     entry = new ImpreciseConstHiType(value, entries_.size());
   }
-  entries_.push_back(entry);
+  AddEntry(entry);
   return *entry;
 }
 
@@ -581,9 +596,45 @@ void RegTypeCache::Dump(std::ostream& os) {
   }
 }
 
+void RegTypeCache::AddEntry(RegType* new_entry) {
+  DCHECK_EQ(new_entry->GetId(), entries_.size());
+  entries_.push_back(new_entry);
+  IndexEntry(new_entry);
+}
+
+void RegTypeCache::IndexEntry(RegType* entry) {
+  uint16_t id = entry->GetId();
+  if (!entry->descriptor_.empty()) {
+    descriptor_index_.insert(std::make_pair(HashDescriptor(entry->descriptor_.c_str()), id));
+  }
+  if (entry->klass_ != nullptr) {
+    class_index_.insert(std::make_pair(HashClass(entry->klass_), id));
+  }
+  if (entry->IsUninitializedTypes()) {
+    uint32_t allocation_pc = down_cast<UninitializedType*>(entry)->GetAllocationPc();
+    allocation_pc_index_.insert(std::make_pair(allocation_pc, id));
+  }
+  if (entry->IsConstantTypes()) {
+    uint32_t value = static_cast<uint32_t>(down_cast<ConstantType*>(entry)->ConstantValue());
+    constant_index_.insert(std::make_pair(value, id));
+  }
+}
+
 void RegTypeCache::VisitRoots(RootCallback* callback, void* arg) {
+  bool classes_moved = false;
   for (RegType* entry : entries_) {
+    mirror::Class* old_klass = entry->klass_;
     entry->VisitRoots(callback, arg);
+    classes_moved = classes_moved || entry->klass_ != old_klass;
+  }
+  if (classes_moved) {
+    // Re-insert in id order so that lookups still return the first match.
+    class_index_.clear();
+    for (size_t i = primitive_count_; i < entries_.size(); i++) {
+      if (entries_[i]->klass_ != nullptr) {
+        class_index_.insert(std::make_pair(HashClass(entries_[i]->klass_), entries_[i]->GetId()));
+      }
+    }
   }
 }
 
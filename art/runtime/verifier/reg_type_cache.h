@@ -25,6 +25,7 @@
 #include "runtime.h"
 
 #include <stdint.h>
+#include <map>
 #include <vector>
 
 namespace art {
@@ -153,15 +154,32 @@ class RegTypeCache {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   const ConstantType& FromCat1NonSmallConstant(int32_t value, bool precise)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Appends a new entry, whose id must be the next free one, and adds it to the lookup indices.
+  void AddEntry(RegType* new_entry) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void IndexEntry(RegType* entry) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   template <class Type>
   static Type* CreatePrimitiveTypeInstance(const std::string& descriptor)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   static void CreatePrimitiveAndSmallConstantTypes() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  // The actual storage for the RegTypes.
+  // The actual storage for the RegTypes, the id of a RegType is its index.
   std::vector<RegType*> entries_;
 
+  // Indices of the non primitive entries so that lookups don't scan all entries. Entries with
+  // equal keys are kept in insertion order and so in id order, a lookup returns the first match
+  // like a scan of entries_ would. The order of equal keys in a hashed multimap is unspecified, and
+  // the caches are per method and small, so an ordered map is kept.
+  typedef std::multimap<size_t, uint16_t> EntryIndex;
+  // Hash of the descriptor to id, for entries with a descriptor.
+  EntryIndex descriptor_index_;
+  // Class address to id, for entries with a class. Rebuilt when a moving GC updates the classes.
+  EntryIndex class_index_;
+  // Allocation pc to id, for uninitialized types.
+  EntryIndex allocation_pc_index_;
+  // Constant value to id, for constant types.
+  EntryIndex constant_index_;
+
   // A quick look up for popular small constants.
   static constexpr int32_t kMinSmallConstant = -1;
   static constexpr int32_t kMaxSmallConstant = 4;
@@ -391,6 +391,37 @@ TEST_F(RegTypeReferenceTest, UnresolvedUnintializedType) {
   EXPECT_TRUE(unresolved_unintialised.Equals(unresolved_unintialised_2));
 }
 
+TEST_F(RegTypeReferenceTest, LookupsAfterManyTypes) {
+  // Tests that lookups find the existing entries once the cache holds many types and that the
+  // ids of the entries do not change.
+  ScopedObjectAccess soa(Thread::Current());
+  RegTypeCache cache(true);
+  const RegType& string_type = cache.JavaLangString();
+  const RegType& object_type = cache.JavaLangObject(false);
+  const RegType& unresolved_type = cache.FromDescriptor(NULL, "Ljava/lang/DoesNotExist;", false);
+  for (int32_t i = 100; i < 1100; ++i) {
+    cache.FromCat1Const(i, true);
+    cache.Uninitialized(string_type, i);
+  }
+  EXPECT_TRUE(string_type.Equals(cache.FromDescriptor(NULL, "Ljava/lang/String;", true)));
+  EXPECT_TRUE(object_type.Equals(cache.JavaLangObject(false)));
+  EXPECT_TRUE(unresolved_type.Equals(
+      cache.FromDescriptor(NULL, "Ljava/lang/DoesNotExist;", false)));
+  EXPECT_TRUE(string_type.Equals(cache.FromClass("Ljava/lang/String;", string_type.GetClass(),
+                                                 true)));
+  const RegType& constant = cache.FromCat1Const(500, true);
+  EXPECT_TRUE(constant.IsPreciseConstant());
+  EXPECT_EQ(500, down_cast<const ConstantType*>(&constant)->ConstantValue());
+  EXPECT_TRUE(constant.Equals(cache.FromCat1Const(500, true)));
+  EXPECT_FALSE(constant.Equals(cache.FromCat1Const(500, false)));
+  const RegType& uninitialized = cache.Uninitialized(string_type, 500);
+  EXPECT_TRUE(uninitialized.Equals(cache.Uninitialized(string_type, 500)));
+  EXPECT_FALSE(uninitialized.Equals(cache.Uninitialized(object_type, 500)));
+  EXPECT_TRUE(string_type.Equals(cache.FromUninitialized(uninitialized)));
+  EXPECT_TRUE(cache.GetFromId(uninitialized.GetId()).Equals(uninitialized));
+  EXPECT_TRUE(cache.GetFromId(string_type.GetId()).Equals(string_type));
+}
+
 TEST_F(RegTypeReferenceTest, Dump) {
   // Tests types for proper Dump messages.
   ScopedObjectAccess soa(Thread::Current());
@@ -19,6 +19,7 @@
 #include <vector>
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -26,6 +27,7 @@
 
 #include "base/stringprintf.h"
 #include "base/unix_file/fd_file.h"
+#include "utils.h"
 #include "UniquePtr.h"
 
 namespace art {
@@ -38,6 +40,15 @@ uint32_t ZipEntry::GetCrc32() {
   return zip_entry_->crc32;
 }
 
+bool ZipEntry::IsUncompressed() {
+  return zip_entry_->method == kCompressStored;
+}
+
+bool ZipEntry::IsAlignedTo(size_t alignment) {
+  DCHECK(IsPowerOfTwo(alignment)) << alignment;
+  return IsAlignedParam(zip_entry_->offset, static_cast<int>(alignment));
+}
+
 ZipEntry::~ZipEntry() {
   delete zip_entry_;
 }
@@ -74,6 +85,45 @@ MemMap* ZipEntry::ExtractToMemMap(const char* entry_filename, std::string* error
   return map.release();
 }
 
+MemMap* ZipEntry::MapDirectlyFromFile(const char* zip_filename, std::string* error_msg) {
+  if (!IsUncompressed()) {
+    *error_msg = StringPrintf("Cannot map '%s' directly, the entry is compressed", zip_filename);
+    return nullptr;
+  }
+  // Dex files and most other mapped data need word alignment, which zipalign provides.
+  if (!IsAlignedTo(4)) {
+    *error_msg = StringPrintf("Cannot map '%s' directly, the entry is at unaligned offset %" PRId64,
+                              zip_filename, static_cast<int64_t>(zip_entry_->offset));
+    return nullptr;
+  }
+  CHECK_EQ(zip_entry_->compressed_length, zip_entry_->uncompressed_length);
+
+  std::string name(zip_filename);
+  name += " mapped directly in memory";
+  UniquePtr<MemMap> map(MemMap::MapFileAtAddress(nullptr, GetUncompressedLength(), PROT_READ,
+                                                 MAP_PRIVATE, GetFileDescriptor(handle_),
+                                                 zip_entry_->offset, false, name.c_str(),
+                                                 error_msg));
+  if (map.get() == nullptr) {
+    DCHECK(!error_msg->empty());
+    return nullptr;
+  }
+  return map.release();
+}
+
+MemMap* ZipEntry::MapDirectlyOrExtract(const char* zip_filename, const char* entry_filename,
+                                       std::string* error_msg) {
+  if (IsUncompressed() && IsAlignedTo(4) && GetFileDescriptor(handle_) >= 0) {
+    MemMap* map = MapDirectlyFromFile(zip_filename, error_msg);
+    if (map != nullptr) {
+      return map;
+    }
+    VLOG(startup) << "Falling back to extracting " << entry_filename << ": " << *error_msg;
+    error_msg->clear();
+  }
+  return ExtractToMemMap(entry_filename, error_msg);
+}
+
 static void SetCloseOnExec(int fd) {
   // This dance is more portable than Linux's O_CLOEXEC open(2) flag.
   int flags = fcntl(fd, F_GETFD);
@@ -38,11 +38,22 @@ class ZipEntry {
  public:
   bool ExtractToFile(File& file, std::string* error_msg);
   MemMap* ExtractToMemMap(const char* entry_filename, std::string* error_msg);
+  // Maps a stored entry read-only straight from the archive file. Returns NULL if the entry is
+  // compressed or its data is not 4 byte aligned within the archive. Unlike extraction, this does
+  // not check the CRC-32 of the entry, which would read every page of it up front. Dex files
+  // mapped this way are checked against the checksum in their header by DexFileVerifier instead.
+  MemMap* MapDirectlyFromFile(const char* zip_filename, std::string* error_msg);
+  // Maps the entry from the archive if possible, otherwise extracts it to an anonymous map.
+  MemMap* MapDirectlyOrExtract(const char* zip_filename, const char* entry_filename,
+                               std::string* error_msg);
   virtual ~ZipEntry();
 
   uint32_t GetUncompressedLength();
   uint32_t GetCrc32();
 
+  bool IsUncompressed();
+  bool IsAlignedTo(size_t alignment);
+
  private:
   ZipEntry(ZipArchiveHandle handle,
            ::ZipEntry* zip_entry) : handle_(handle), zip_entry_(zip_entry) {}
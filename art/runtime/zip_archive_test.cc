@@ -21,9 +21,13 @@
 #include <sys/types.h>
 #include <zlib.h>
 
+#include <vector>
+
 #include "UniquePtr.h"
 #include "common_runtime_test.h"
+#include "mem_map.h"
 #include "os.h"
+#include "utils.h"
 
 namespace art {
 
@@ -62,4 +66,144 @@ TEST_F(ZipArchiveTest, FindAndExtract) {
   EXPECT_EQ(zip_entry->GetCrc32(), computed_crc);
 }
 
+static void PutLe16(std::vector<uint8_t>* out, uint16_t value) {
+  out->push_back(value & 0xff);
+  out->push_back(value >> 8);
+}
+
+static void PutLe32(std::vector<uint8_t>* out, uint32_t value) {
+  PutLe16(out, value & 0xffff);
+  PutLe16(out, value >> 16);
+}
+
+// Writes an archive with a single stored entry. The padding of the local header's extra field puts
+// the data at a 4 byte aligned offset, or 2 bytes past one, as zipalign would or would not.
+static void WriteStoredZip(const ScratchFile& zip_file, const char* entry_name,
+                           const std::vector<uint8_t>& data, bool aligned) {
+  const uint16_t name_length = strlen(entry_name);
+  const size_t kLocalHeaderSize = 30;
+  uint16_t extra_length = RoundUp(kLocalHeaderSize + name_length, 4) - kLocalHeaderSize -
+                          name_length + (aligned ? 0 : 2);
+  uint32_t crc = crc32(crc32(0L, Z_NULL, 0), &data[0], data.size());
+
+  std::vector<uint8_t> zip;
+  PutLe32(&zip, 0x04034b50);  // Local file header signature.
+  PutLe16(&zip, 10);  // Version needed to extract.
+  PutLe16(&zip, 0);  // Flags.
+  PutLe16(&zip, 0);  // Stored.
+  PutLe16(&zip, 0);  // Modification time.
+  PutLe16(&zip, 0);  // Modification date.
+  PutLe32(&zip, crc);
+  PutLe32(&zip, data.size());  // Compressed size.
+  PutLe32(&zip, data.size());  // Uncompressed size.
+  PutLe16(&zip, name_length);
+  PutLe16(&zip, extra_length);
+  zip.insert(zip.end(), entry_name, entry_name + name_length);
+  zip.insert(zip.end(), extra_length, 0);
+  ASSERT_EQ(aligned, IsAligned<4>(zip.size()));
+  zip.insert(zip.end(), data.begin(), data.end());
+
+  const uint32_t central_directory_offset = zip.size();
+  PutLe32(&zip, 0x02014b50);  // Central directory file header signature.
+  PutLe16(&zip, 10);  // Version made by.
+  PutLe16(&zip, 10);  // Version needed to extract.
+  PutLe16(&zip, 0);  // Flags.
+  PutLe16(&zip, 0);  // Stored.
+  PutLe16(&zip, 0);  // Modification time.
+  PutLe16(&zip, 0);  // Modification date.
+  PutLe32(&zip, crc);
+  PutLe32(&zip, data.size());  // Compressed size.
+  PutLe32(&zip, data.size());  // Uncompressed size.
+  PutLe16(&zip, name_length);
+  PutLe16(&zip, 0);  // Extra field length.
+  PutLe16(&zip, 0);  // Comment length.
+  PutLe16(&zip, 0);  // Disk number.
+  PutLe16(&zip, 0);  // Internal attributes.
+  PutLe32(&zip, 0);  // External attributes.
+  PutLe32(&zip, 0);  // Offset of the local header.
+  zip.insert(zip.end(), entry_name, entry_name + name_length);
+  const uint32_t central_directory_size = zip.size() - central_directory_offset;
+
+  PutLe32(&zip, 0x06054b50);  // End of central directory signature.
+  PutLe16(&zip, 0);  // Disk number.
+  PutLe16(&zip, 0);  // Disk with the central directory.
+  PutLe16(&zip, 1);  // Entries on this disk.
+  PutLe16(&zip, 1);  // Entries.
+  PutLe32(&zip, central_directory_size);
+  PutLe32(&zip, central_directory_offset);
+  PutLe16(&zip, 0);  // Comment length.
+
+  ASSERT_TRUE(zip_file.GetFile()->WriteFully(&zip[0], zip.size()));
+}
+
+class ZipArchiveMapTest : public ZipArchiveTest {
+ protected:
+  // Extracts the classes.dex of libcore, so that the archives written by the tests hold a real
+  // dex file.
+  void ExtractLibCoreDex(std::vector<uint8_t>* dex) {
+    std::string error_msg;
+    UniquePtr<ZipArchive> zip_archive(ZipArchive::Open(GetLibCoreDexFileName().c_str(),
+                                                       &error_msg));
+    ASSERT_TRUE(zip_archive.get() != nullptr) << error_msg;
+    UniquePtr<ZipEntry> zip_entry(zip_archive->Find("classes.dex", &error_msg));
+    ASSERT_TRUE(zip_entry.get() != nullptr) << error_msg;
+    UniquePtr<MemMap> extracted(zip_entry->ExtractToMemMap("classes.dex", &error_msg));
+    ASSERT_TRUE(extracted.get() != nullptr) << error_msg;
+    dex->assign(extracted->Begin(), extracted->End());
+  }
+
+  // Opens the archive with MapDirectlyOrExtract and checks that the map holds the dex file.
+  void MapDirectlyOrExtract(bool aligned, UniquePtr<MemMap>* map) {
+    std::vector<uint8_t> dex;
+    ASSERT_NO_FATAL_FAILURE(ExtractLibCoreDex(&dex));
+    ScratchFile zip_file;
+    ASSERT_NO_FATAL_FAILURE(WriteStoredZip(zip_file, "classes.dex", dex, aligned));
+
+    std::string error_msg;
+    UniquePtr<ZipArchive> zip_archive(ZipArchive::Open(zip_file.GetFilename().c_str(),
+                                                       &error_msg));
+    ASSERT_TRUE(zip_archive.get() != nullptr) << error_msg;
+    UniquePtr<ZipEntry> zip_entry(zip_archive->Find("classes.dex", &error_msg));
+    ASSERT_TRUE(zip_entry.get() != nullptr) << error_msg;
+    ASSERT_TRUE(zip_entry->IsUncompressed());
+    ASSERT_EQ(aligned, zip_entry->IsAlignedTo(4));
+    map->reset(zip_entry->MapDirectlyOrExtract(zip_file.GetFilename().c_str(), "classes.dex",
+                                               &error_msg));
+    ASSERT_TRUE(map->get() != nullptr) << error_msg;
+    ASSERT_EQ(dex.size(), (*map)->Size());
+    EXPECT_EQ(0, memcmp(&dex[0], (*map)->Begin(), dex.size()));
+  }
+};
+
+TEST_F(ZipArchiveMapTest, MapsAlignedStoredEntryDirectly) {
+  UniquePtr<MemMap> map;
+  ASSERT_NO_FATAL_FAILURE(MapDirectlyOrExtract(true, &map));
+  // An extracted entry is in a writable anonymous map.
+  EXPECT_EQ(PROT_READ, map->GetProtect());
+  EXPECT_NE(std::string::npos, map->GetName().find("mapped directly"));
+}
+
+TEST_F(ZipArchiveMapTest, ExtractsUnalignedStoredEntry) {
+  UniquePtr<MemMap> map;
+  ASSERT_NO_FATAL_FAILURE(MapDirectlyOrExtract(false, &map));
+  EXPECT_EQ(PROT_READ | PROT_WRITE, map->GetProtect());
+  EXPECT_NE(std::string::npos, map->GetName().find("extracted in memory"));
+}
+
+TEST_F(ZipArchiveTest, MapCompressedEntryFails) {
+  std::string error_msg;
+  std::string zip_filename(GetLibCoreDexFileName());
+  UniquePtr<ZipArchive> zip_archive(ZipArchive::Open(zip_filename.c_str(), &error_msg));
+  ASSERT_TRUE(zip_archive.get() != nullptr) << error_msg;
+  UniquePtr<ZipEntry> zip_entry(zip_archive->Find("classes.dex", &error_msg));
+  ASSERT_TRUE(zip_entry.get() != nullptr) << error_msg;
+  if (zip_entry->IsUncompressed()) {
+    LOG(INFO) << "Skipping, " << zip_filename << " stores its classes.dex";
+    return;
+  }
+  UniquePtr<MemMap> direct(zip_entry->MapDirectlyFromFile(zip_filename.c_str(), &error_msg));
+  EXPECT_TRUE(direct.get() == nullptr);
+  EXPECT_FALSE(error_msg.empty());
+}
+
 }  // namespace art
@@ -55,6 +55,7 @@
 #include "runtime.h"
 #include "ScopedLocalRef.h"
 #include "scoped_thread_state_change.h"
+#include "thread_pool.h"
 #include "vector_output_stream.h"
 #include "well_known_classes.h"
 #include "zip_archive.h"
@@ -122,12 +123,41 @@ static void Usage(const char* fmt, ...) {
   UsageError("  --bitcode=<file.bc>: specifies the optional bitcode filename.");
   UsageError("      Example: --bitcode=/system/framework/boot.bc");
   UsageError("");
+  UsageError("  --whole-program-bitcode=<file.bc>: also emits all compiled methods as a single");
+  UsageError("      module, optimized across methods, and generates its code in partitions");
+  UsageError("      written to <file.bc>.<n>.o. The oat file is linked from these partitions.");
+  UsageError("      Example: --whole-program-bitcode=/data/local/tmp/app.bc");
+  UsageError("");
+  UsageError("  --whole-program-partitions=<count>: number of code generation partitions for");
+  UsageError("      --whole-program-bitcode. Defaults to the -j thread count.");
+  UsageError("      Example: --whole-program-partitions=4");
+  UsageError("");
+  UsageError("  --verification-results=<file>: loads the verification results of an earlier");
+  UsageError("      compilation from the file if they are still valid for the dex files, class path");
+  UsageError("      and boot image, otherwise verifies the classes and saves the results to it.");
+  UsageError("      Example: --verification-results=/data/local/tmp/app.vrf");
+  UsageError("");
+  UsageError("  --spill-file=<file>: moves the ELF objects of portable methods to a temporary");
+  UsageError("      file as soon as each dex file is compiled, instead of keeping them in memory");
+  UsageError("      until the oat file is written. The file is deleted when it is created.");
+  UsageError("      Example: --spill-file=/data/local/tmp/dex2oat.spill");
+  UsageError("");
   UsageError("  --image=<file.art>: specifies the output image filename.");
   UsageError("      Example: --image=/system/framework/boot.art");
   UsageError("");
   UsageError("  --image-classes=<classname-file>: specifies classes to include in an image.");
   UsageError("      Example: --image=frameworks/base/preloaded-classes");
   UsageError("");
+  UsageError("  --image-startup-classes=<classname-file>: classes in the order they are first");
+  UsageError("      used at startup, for example from a class initialization trace. Their objects");
+  UsageError("      are laid out together at the start of the image, and the objects the runtime");
+  UsageError("      writes to are put on pages of their own.");
+  UsageError("      Example: --image-startup-classes=/data/local/tmp/startup-classes");
+  UsageError("");
+  UsageError("  --compress-image: writes the image in compressed blocks that are decompressed in");
+  UsageError("      parallel when the image is loaded. The image file is smaller but the runtime");
+  UsageError("      keeps the decompressed image in memory that is not backed by the file.");
+  UsageError("");
   UsageError("  --base=<hex-address>: specifies the base address when creating a boot image.");
   UsageError("      Example: --base=0x50000000");
   UsageError("");
@@ -253,6 +283,25 @@ class Dex2Oat {
               << " (threads: " << thread_count_ << ")";
   }
 
+  // Records the resident set size and its peak so far at the end of a phase.
+  void RecordMemoryUsage(const char* phase) {
+    std::string status;
+    if (!ReadFileToString("/proc/self/status", &status)) {
+      return;
+    }
+    MemoryUsage usage = { phase, ParseStatusKb(status, "VmRSS:") * KB,
+                          ParseStatusKb(status, "VmHWM:") * KB };
+    memory_usage_.push_back(usage);
+  }
+
+  void DumpMemoryUsage(std::ostream& os) const {
+    os << "dex2oat memory usage:\n";
+    for (const MemoryUsage& usage : memory_usage_) {
+      os << "  " << usage.phase << ": RSS " << PrettySize(usage.rss)
+         << ", peak RSS " << PrettySize(usage.peak_rss) << "\n";
+    }
+  }
+
 
   // Reads the class names (java.lang.Object) and returns a set of descriptors (Ljava/lang/Object;)
   CompilerDriver::DescriptorSet* ReadImageClassesFromFile(const char* image_classes_filename) {
@@ -281,6 +330,26 @@ class Dex2Oat {
     return image_classes.release();
   }
 
+  // Reads the class names (java.lang.Object) and returns the descriptors (Ljava/lang/Object;) in
+  // the order of the file.
+  bool ReadStartupClassesFromFile(const char* startup_classes_filename,
+                                  std::vector<std::string>* startup_classes) {
+    std::ifstream startup_classes_file(startup_classes_filename, std::ifstream::in);
+    if (!startup_classes_file.good()) {
+      LOG(ERROR) << "Failed to open startup classes file " << startup_classes_filename;
+      return false;
+    }
+    while (startup_classes_file.good()) {
+      std::string dot;
+      std::getline(startup_classes_file, dot);
+      if (StartsWith(dot, "#") || dot.empty()) {
+        continue;
+      }
+      startup_classes->push_back(DotToDescriptor(dot.c_str()));
+    }
+    return true;
+  }
+
   // Reads the class names (java.lang.Object) and returns a set of descriptors (Ljava/lang/Object;)
   CompilerDriver::DescriptorSet* ReadImageClassesFromZip(const char* zip_filename,
                                                          const char* image_classes_filename,
@@ -314,6 +383,10 @@ class Dex2Oat {
                                       const std::vector<const DexFile*>& dex_files,
                                       File* oat_file,
                                       const std::string& bitcode_filename,
+                                      const std::string& whole_program_filename,
+                                      size_t whole_program_partitions,
+                                      const std::string& verification_results_filename,
+                                      const std::string& spill_filename,
                                       bool image,
                                       UniquePtr<CompilerDriver::DescriptorSet>& image_classes,
                                       bool dump_stats,
@@ -354,8 +427,23 @@ class Dex2Oat {
                                                         profile_file));
 
     driver->GetCompiler()->SetBitcodeFileName(*driver.get(), bitcode_filename);
+    driver->SetVerificationResultsFile(verification_results_filename);
+    driver->SetSpillFile(spill_filename);
+    if (!whole_program_filename.empty()) {
+      driver->GetCompiler()->SetWholeProgramModule(*driver.get(), whole_program_filename,
+                                                   whole_program_partitions);
+    }
 
     driver->CompileAll(class_loader, dex_files, &timings);
+    RecordMemoryUsage("Compile");
+
+    if (!whole_program_filename.empty()) {
+      TimingLogger::ScopedSplit split("dex2oat WholeProgramModule", &timings);
+      if (!driver->GetCompiler()->WriteWholeProgramModule(*driver.get(), thread_count_)) {
+        LOG(ERROR) << "Failed to write whole program module " << whole_program_filename;
+        return nullptr;
+      }
+    }
 
     timings.NewSplit("dex2oat OatWriter");
     std::string image_file_location;
@@ -382,6 +470,7 @@ class Dex2Oat {
       LOG(ERROR) << "Failed to write ELF file " << oat_file->GetPath();
       return nullptr;
     }
+    RecordMemoryUsage("Write oat file");
 
     return driver.release();
   }
@@ -390,12 +479,16 @@ class Dex2Oat {
                        uintptr_t image_base,
                        const std::string& oat_filename,
                        const std::string& oat_location,
+                       const std::vector<std::string>& startup_classes,
+                       bool compress_image,
                        const CompilerDriver& compiler)
       LOCKS_EXCLUDED(Locks::mutator_lock_) {
     uintptr_t oat_data_begin;
     {
       // ImageWriter is scoped so it can free memory before doing FixupElf
       ImageWriter image_writer(compiler);
+      image_writer.SetStartupClasses(startup_classes);
+      image_writer.SetCompressImage(compress_image);
       if (!image_writer.Write(image_filename, image_base, oat_filename, oat_location)) {
         LOG(ERROR) << "Failed to create image file " << image_filename;
         return false;
@@ -437,6 +530,21 @@ class Dex2Oat {
     CHECK(method_inliner_map != nullptr);
   }
 
+  struct MemoryUsage {
+    const char* phase;
+    size_t rss;
+    size_t peak_rss;
+  };
+
+  // Returns the value of a "<name> <n> kB" line of /proc/self/status, or 0 if there is none.
+  static size_t ParseStatusKb(const std::string& status, const char* name) {
+    size_t pos = status.find(name);
+    if (pos == std::string::npos) {
+      return 0;
+    }
+    return strtoul(status.c_str() + pos + strlen(name), nullptr, 10);
+  }
+
   bool CreateRuntime(const Runtime::Options& runtime_options, InstructionSet instruction_set)
       SHARED_TRYLOCK_FUNCTION(true, Locks::mutator_lock_) {
     if (!Runtime::Create(runtime_options, false)) {
@@ -500,6 +608,7 @@ class Dex2Oat {
   Runtime* runtime_;
   size_t thread_count_;
   uint64_t start_ns_;
+  std::vector<MemoryUsage> memory_usage_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(Dex2Oat);
 };
@@ -514,8 +623,11 @@ static bool ParseInt(const char* in, int* out) {
   return true;
 }
 
+// Opens the dex files and all dex files of multidex archives. thread_pool is used to verify the
+// dex files of an archive in parallel, it must be null before the runtime is created.
 static size_t OpenDexFiles(const std::vector<const char*>& dex_filenames,
                            const std::vector<const char*>& dex_locations,
+                           ThreadPool* thread_pool,
                            std::vector<const DexFile*>& dex_files) {
   size_t failure_count = 0;
   for (size_t i = 0; i < dex_filenames.size(); i++) {
@@ -527,12 +639,9 @@ static size_t OpenDexFiles(const std::vector<const char*>& dex_filenames,
       LOG(WARNING) << "Skipping non-existent dex file '" << dex_filename << "'";
       continue;
     }
-    const DexFile* dex_file = DexFile::Open(dex_filename, dex_location, &error_msg);
-    if (dex_file == nullptr) {
+    if (!DexFile::OpenAll(dex_filename, dex_location, thread_pool, &error_msg, &dex_files)) {
       LOG(WARNING) << "Failed to open .dex from file '" << dex_filename << "': " << error_msg;
       ++failure_count;
-    } else {
-      dex_files.push_back(dex_file);
     }
     ATRACE_END();
   }
@@ -728,8 +837,14 @@ static int dex2oat(int argc, char** argv) {
   std::string oat_location;
   int oat_fd = -1;
   std::string bitcode_filename;
+  std::string whole_program_filename;
+  int whole_program_partitions = 0;
+  std::string verification_results_filename;
+  std::string spill_filename;
   const char* image_classes_zip_filename = nullptr;
   const char* image_classes_filename = nullptr;
+  const char* image_startup_classes_filename = nullptr;
+  bool compress_image = false;
   std::string image_filename;
   std::string boot_image_filename;
   uintptr_t image_base = 0;
@@ -812,10 +927,26 @@ static int dex2oat(int argc, char** argv) {
       oat_location = option.substr(strlen("--oat-location=")).data();
     } else if (option.starts_with("--bitcode=")) {
       bitcode_filename = option.substr(strlen("--bitcode=")).data();
+    } else if (option.starts_with("--whole-program-bitcode=")) {
+      whole_program_filename = option.substr(strlen("--whole-program-bitcode=")).data();
+    } else if (option.starts_with("--verification-results=")) {
+      verification_results_filename = option.substr(strlen("--verification-results=")).data();
+    } else if (option.starts_with("--spill-file=")) {
+      spill_filename = option.substr(strlen("--spill-file=")).data();
+    } else if (option.starts_with("--whole-program-partitions=")) {
+      const char* partitions_str = option.substr(strlen("--whole-program-partitions=")).data();
+      if (!ParseInt(partitions_str, &whole_program_partitions) || whole_program_partitions <= 0) {
+        Usage("Failed to parse --whole-program-partitions argument '%s' as a positive integer",
+              partitions_str);
+      }
     } else if (option.starts_with("--image=")) {
       image_filename = option.substr(strlen("--image=")).data();
     } else if (option.starts_with("--image-classes=")) {
       image_classes_filename = option.substr(strlen("--image-classes=")).data();
+    } else if (option.starts_with("--image-startup-classes=")) {
+      image_startup_classes_filename = option.substr(strlen("--image-startup-classes=")).data();
+    } else if (option == "--compress-image") {
+      compress_image = true;
     } else if (option.starts_with("--image-classes-zip=")) {
       image_classes_zip_filename = option.substr(strlen("--image-classes-zip=")).data();
     } else if (option.starts_with("--base=")) {
@@ -978,6 +1109,14 @@ static int dex2oat(int argc, char** argv) {
     Usage("--image-classes-zip should be used with --image-classes");
   }
 
+  if (image_startup_classes_filename != nullptr && !image) {
+    Usage("--image-startup-classes should only be used with --image");
+  }
+
+  if (compress_image && !image) {
+    Usage("--compress-image should only be used with --image");
+  }
+
   if (dex_filenames.empty() && zip_fd == -1) {
     Usage("Input must be supplied with either --dex-file or --zip-fd");
   }
@@ -1090,7 +1229,7 @@ static int dex2oat(int argc, char** argv) {
   Runtime::Options runtime_options;
   std::vector<const DexFile*> boot_class_path;
   if (boot_image_option.empty()) {
-    size_t failure_count = OpenDexFiles(dex_filenames, dex_locations, boot_class_path);
+    size_t failure_count = OpenDexFiles(dex_filenames, dex_locations, nullptr, boot_class_path);
     if (failure_count > 0) {
       LOG(ERROR) << "Failed to open some dex files: " << failure_count;
       return EXIT_FAILURE;
@@ -1155,10 +1294,19 @@ static int dex2oat(int argc, char** argv) {
     image_classes.reset(new CompilerDriver::DescriptorSet);
   }
 
+  std::vector<std::string> startup_classes;
+  if (image_startup_classes_filename != nullptr &&
+      !dex2oat->ReadStartupClassesFromFile(image_startup_classes_filename, &startup_classes)) {
+    return EXIT_FAILURE;
+  }
+
   std::vector<const DexFile*> dex_files;
   if (boot_image_option.empty()) {
     dex_files = Runtime::Current()->GetClassLinker()->GetBootClassPath();
   } else {
+    // The dex files of multidex archives are verified in parallel.
+    ThreadPool thread_pool("dex2oat dex file open thread pool",
+                           std::max(thread_count, 1) - 1);
     if (dex_filenames.empty()) {
       ATRACE_BEGIN("Opening zip archive from file descriptor");
       std::string error_msg;
@@ -1169,16 +1317,15 @@ static int dex2oat(int argc, char** argv) {
             << error_msg;
         return EXIT_FAILURE;
       }
-      const DexFile* dex_file = DexFile::Open(*zip_archive.get(), zip_location, &error_msg);
-      if (dex_file == nullptr) {
+      if (!DexFile::OpenAll(*zip_archive.get(), zip_location, &thread_pool, &error_msg,
+                            &dex_files)) {
         LOG(ERROR) << "Failed to open dex from file descriptor for zip file '" << zip_location
             << "': " << error_msg;
         return EXIT_FAILURE;
       }
-      dex_files.push_back(dex_file);
       ATRACE_END();
     } else {
-      size_t failure_count = OpenDexFiles(dex_filenames, dex_locations, dex_files);
+      size_t failure_count = OpenDexFiles(dex_filenames, dex_locations, &thread_pool, dex_files);
       if (failure_count > 0) {
         LOG(ERROR) << "Failed to open some dex files: " << failure_count;
         return EXIT_FAILURE;
@@ -1231,6 +1378,12 @@ static int dex2oat(int argc, char** argv) {
                                                                   dex_files,
                                                                   oat_file.get(),
                                                                   bitcode_filename,
+                                                                  whole_program_filename,
+                                                                  whole_program_partitions > 0
+                                                                      ? whole_program_partitions
+                                                                      : thread_count,
+                                                                  verification_results_filename,
+                                                                  spill_filename,
                                                                   image,
                                                                   image_classes,
                                                                   dump_stats,
@@ -1302,16 +1455,28 @@ static int dex2oat(int argc, char** argv) {
                                                            image_base,
                                                            oat_unstripped,
                                                            oat_location,
+                                                           startup_classes,
+                                                           compress_image,
                                                            *compiler.get());
     if (!image_creation_success) {
       return EXIT_FAILURE;
     }
+    dex2oat->RecordMemoryUsage("Write image");
     VLOG(compiler) << "Image written successfully: " << image_filename;
   }
 
   if (is_host) {
     if (dump_timing || (dump_slow_timing && timings.GetTotalNs() > MsToNs(1000))) {
       LOG(INFO) << Dumpable<TimingLogger>(timings);
+      std::ostringstream dedupe_stats;
+      compiler->DumpDedupeStats(dedupe_stats);
+      LOG(INFO) << dedupe_stats.str();
+      std::ostringstream arena_stats;
+      compiler->DumpArenaStats(arena_stats);
+      LOG(INFO) << arena_stats.str();
+      std::ostringstream memory_usage;
+      dex2oat->DumpMemoryUsage(memory_usage);
+      LOG(INFO) << memory_usage.str();
     }
     if (dump_passes) {
       LOG(INFO) << Dumpable<CumulativeLogger>(*compiler.get()->GetTimingsLogger());
@@ -1357,6 +1522,15 @@ static int dex2oat(int argc, char** argv) {
 
   if (dump_timing || (dump_slow_timing && timings.GetTotalNs() > MsToNs(1000))) {
     LOG(INFO) << Dumpable<TimingLogger>(timings);
+    std::ostringstream dedupe_stats;
+    compiler->DumpDedupeStats(dedupe_stats);
+    LOG(INFO) << dedupe_stats.str();
+    std::ostringstream arena_stats;
+    compiler->DumpArenaStats(arena_stats);
+    LOG(INFO) << arena_stats.str();
+    std::ostringstream memory_usage;
+    dex2oat->DumpMemoryUsage(memory_usage);
+    LOG(INFO) << memory_usage.str();
   }
   if (dump_passes) {
     LOG(INFO) << Dumpable<CumulativeLogger>(compiler_phases_timings);
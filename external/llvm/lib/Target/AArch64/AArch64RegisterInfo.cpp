@@ -73,6 +73,11 @@ AArch64RegisterInfo::getReservedRegs(const MachineFunction &MF) const {
     Reserved.set(AArch64::W29);
   }
 
+  if (MF.getTarget().getSubtarget<AArch64Subtarget>().isX18Reserved()) {
+    Reserved.set(AArch64::X18);
+    Reserved.set(AArch64::W18);
+  }
+
   return Reserved;
 }
 
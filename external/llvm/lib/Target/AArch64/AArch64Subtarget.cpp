@@ -27,7 +27,7 @@ using namespace llvm;
 
 AArch64Subtarget::AArch64Subtarget(StringRef TT, StringRef CPU, StringRef FS)
     : AArch64GenSubtargetInfo(TT, CPU, FS), HasNEON(false), HasCrypto(false),
-      TargetTriple(TT) {
+      ReserveX18(false), TargetTriple(TT) {
 
   ParseSubtargetFeatures(CPU, FS);
 }
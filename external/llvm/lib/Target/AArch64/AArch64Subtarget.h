@@ -31,6 +31,9 @@ protected:
   bool HasNEON;
   bool HasCrypto;
 
+  /// ReserveX18 - X18 is a platform register and must not be allocated.
+  bool ReserveX18;
+
   /// TargetTriple - What processor and OS we're targeting.
   Triple TargetTriple;
 public:
@@ -51,6 +54,8 @@ public:
   bool hasNEON() const { return HasNEON; }
 
   bool hasCrypto() const { return HasCrypto; }
+
+  bool isX18Reserved() const { return ReserveX18; }
 };
 } // End llvm namespace
 
@@ -0,0 +1,82 @@
+; RUN: llc -verify-machineinstrs < %s -mtriple=aarch64-none-linux-gnu | FileCheck %s --check-prefix=CHECK-DEFAULT
+; RUN: llc -verify-machineinstrs < %s -mtriple=aarch64-none-linux-gnu -mattr=+reserve-x18 | FileCheck %s --check-prefix=CHECK-RESERVE
+
+@var = global i64 0
+
+define void @keep_live() {
+; CHECK-DEFAULT-LABEL: keep_live:
+; CHECK-DEFAULT: x18
+; CHECK-RESERVE-LABEL: keep_live:
+; CHECK-RESERVE-NOT: {{[xw]}}18
+; CHECK-RESERVE: ret
+
+  ; Create more live values than there are general purpose registers so that
+  ; every allocatable register is used.
+  %val1 = load volatile i64* @var
+  %val2 = load volatile i64* @var
+  %val3 = load volatile i64* @var
+  %val4 = load volatile i64* @var
+  %val5 = load volatile i64* @var
+  %val6 = load volatile i64* @var
+  %val7 = load volatile i64* @var
+  %val8 = load volatile i64* @var
+  %val9 = load volatile i64* @var
+  %val10 = load volatile i64* @var
+  %val11 = load volatile i64* @var
+  %val12 = load volatile i64* @var
+  %val13 = load volatile i64* @var
+  %val14 = load volatile i64* @var
+  %val15 = load volatile i64* @var
+  %val16 = load volatile i64* @var
+  %val17 = load volatile i64* @var
+  %val18 = load volatile i64* @var
+  %val19 = load volatile i64* @var
+  %val20 = load volatile i64* @var
+  %val21 = load volatile i64* @var
+  %val22 = load volatile i64* @var
+  %val23 = load volatile i64* @var
+  %val24 = load volatile i64* @var
+  %val25 = load volatile i64* @var
+  %val26 = load volatile i64* @var
+  %val27 = load volatile i64* @var
+  %val28 = load volatile i64* @var
+  %val29 = load volatile i64* @var
+  %val30 = load volatile i64* @var
+  %val31 = load volatile i64* @var
+  %val32 = load volatile i64* @var
+
+  store volatile i64 %val1, i64* @var
+  store volatile i64 %val2, i64* @var
+  store volatile i64 %val3, i64* @var
+  store volatile i64 %val4, i64* @var
+  store volatile i64 %val5, i64* @var
+  store volatile i64 %val6, i64* @var
+  store volatile i64 %val7, i64* @var
+  store volatile i64 %val8, i64* @var
+  store volatile i64 %val9, i64* @var
+  store volatile i64 %val10, i64* @var
+  store volatile i64 %val11, i64* @var
+  store volatile i64 %val12, i64* @var
+  store volatile i64 %val13, i64* @var
+  store volatile i64 %val14, i64* @var
+  store volatile i64 %val15, i64* @var
+  store volatile i64 %val16, i64* @var
+  store volatile i64 %val17, i64* @var
+  store volatile i64 %val18, i64* @var
+  store volatile i64 %val19, i64* @var
+  store volatile i64 %val20, i64* @var
+  store volatile i64 %val21, i64* @var
+  store volatile i64 %val22, i64* @var
+  store volatile i64 %val23, i64* @var
+  store volatile i64 %val24, i64* @var
+  store volatile i64 %val25, i64* @var
+  store volatile i64 %val26, i64* @var
+  store volatile i64 %val27, i64* @var
+  store volatile i64 %val28, i64* @var
+  store volatile i64 %val29, i64* @var
+  store volatile i64 %val30, i64* @var
+  store volatile i64 %val31, i64* @var
+  store volatile i64 %val32, i64* @var
+
+  ret void
+}